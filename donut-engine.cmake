@@ -52,6 +52,11 @@ if (DONUT_WITH_AUDIO)
     target_compile_definitions(donut_engine PUBLIC DONUT_WITH_AUDIO)
 endif()
 
+if (DONUT_WITH_BASISU)
+    target_link_libraries(donut_engine basisu_transcoder)
+    target_compile_definitions(donut_engine PUBLIC DONUT_WITH_BASISU)
+endif()
+
 if (DONUT_WITH_TINYEXR)
     target_link_libraries(donut_engine tinyexr)
     target_compile_definitions(donut_engine PUBLIC DONUT_WITH_TINYEXR)
@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include <donut/core/chunk/chunkFile.h>
 #include <donut/core/math/math.h>
 #include <donut/core/vfs/VFS.h>
 
@@ -132,6 +133,10 @@ public:
 
     donut::math::box3 bbox;
 
+    // description of the materials used by the set, stored in a materials chunk ;
+    // the text is opaque to the chunk format (see engine::ChunkImporter)
+    char const * materials;
+
     std::shared_ptr<donut::vfs::IBlob const> blob;
 };
 
@@ -167,8 +172,20 @@ struct MeshletSet : public MeshSetBase
     MeshletInfo const * meshInfos;
 };
 
-std::shared_ptr<donut::vfs::IBlob const> serialize(MeshSetBase const & mset);
+// chunks are compressed with 'codec' (see ChunkFile::setCompression)
+std::shared_ptr<donut::vfs::IBlob const> serialize(MeshSetBase const & mset,
+    ChunkCodec codec = ChunkCodec::None, int level = 0);
 
 std::shared_ptr<MeshSetBase const> deserialize(std::weak_ptr<donut::vfs::IBlob const> blob, char const * assetpath);
 
+// deserializes a mesh set from a streamed file (see ChunkFile::open) : only the
+// chunks of the set are read, and they stay resident while the set is alive
+std::shared_ptr<MeshSetBase const> deserialize(std::shared_ptr<ChunkFile const> cfile);
+
+// opens a mesh set file for streaming ; files written with older chunk layouts are
+// upgraded and written back (see ChunkFile::openAndUpgrade)
+// note : deserialize() upgrades outdated chunks in memory
+std::shared_ptr<ChunkFile const> open(
+    std::shared_ptr<donut::vfs::IFileSystem> fs, std::filesystem::path const & path);
+
 }
@@ -24,7 +24,10 @@
 
 #include <donut/core/log.h>
 
+#include <atomic>
 #include <cstdint>
+#include <filesystem>
+#include <functional>
 #include <memory>
 #include <vector>
 #include <string>
@@ -32,6 +35,7 @@
 namespace donut::vfs
 {
     class IBlob;
+    class IFileSystem;
 }
 
 //
@@ -70,6 +74,17 @@ private:
 
 
 
+//
+// ChunkCodec : compression of the chunk payloads stored in a file
+//
+
+enum class ChunkCodec : uint32_t
+{
+    None = 0,
+    LZ4,        // requires DONUT_WITH_LZ4
+    Zstd,       // requires DONUT_WITH_ZSTD
+};
+
 //
 // Chunk : individual chunk descriptor
 //
@@ -83,25 +98,44 @@ struct Chunk
     size_t offset,          // offset of chunk in file/blob
            size;            // size of chunk user data (in bytes)
 
-    void const * data;      // chunk user data
+    void const * data;      // chunk user data (decompressed)
 };
 
 //
 // ChunkFile
 //
 
-class ChunkFile
+class ChunkFile : public std::enable_shared_from_this<ChunkFile>
 {
 
+public:
+
+    ChunkFile();
+
+    ~ChunkFile();
+
 public:
 
     // deserialization interface
+    //
+    // deserialize() works on a blob holding the whole file, which can be a
+    // memory mapping (see IFileSystem::mapFile) : payloads are only paged in
+    // by the OS when chunks are accessed.
+    //
+    // open() reads only the header and the chunk table of a file, and streams
+    // the payloads in with ranged reads (IFileSystem::readFileRange) when the
+    // chunks are acquired : see acquireChunk().
 
     static std::shared_ptr<ChunkFile const> deserialize(
         std::weak_ptr<donut::vfs::IBlob const> blobPtr, char const * filepath);
 
+    static std::shared_ptr<ChunkFile const> open(
+        std::shared_ptr<donut::vfs::IFileSystem> fs, std::filesystem::path const & path);
+
     std::string const & getFilePath() const { return _filepath; }
 
+    bool isStreaming() const { return _fs != nullptr; }
+
 public:
 
     // serialization interface
@@ -110,11 +144,26 @@ public:
 
     template <typename ChunkDesc> ChunkId addChunk(void const * data, size_t size);
 
+    // note : the data must stay alive until the file is serialized
+    ChunkId addChunk(uint32_t type, uint32_t version, void const * data, size_t size);
+
+    // chunks are compressed with this codec when serialized, and stored raw
+    // if they don't get smaller ; level 0 selects the codec's default level
+    void setCompression(ChunkCodec codec, int level = 0);
+
     void reset();
 
 public:
 
     // general chunk access interface
+    //
+    // chunk payloads are checksummed ; compressed payloads are decompressed and
+    // all payloads are verified on first access through getChunk / getChunks.
+    // Corrupt chunks are reported and never returned.
+    // note : records returned by getChunks() have no data until then
+    //
+    // With streamed files, chunks accessed through getChunk / getChunks / loadChunks
+    // stay resident until the file is destroyed.
 
     auto const & getChunks() const { return _chunks; }
 
@@ -122,23 +171,104 @@ public:
 
     void getChunks(uint32_t chunkType, std::vector<Chunk const *> & result) const;
 
+    // decompresses & verifies a set of chunks ahead of access, using multiple
+    // threads ; returns false if any of the chunks is missing or corrupt
+    bool loadChunks(std::vector<ChunkId> const & chunkIds) const;
+
+public:
+
+    // residency interface
+    //
+    // acquired chunks hold a reference on their payload : with streamed files, the
+    // payload is read when the chunk is first acquired, shared by all the handles,
+    // and released with the last one. Handles also keep the ChunkFile alive.
+
+    std::shared_ptr<Chunk const> acquireChunk(ChunkId chunkId) const;
+
+    // acquires a set of chunks, reading & decompressing them on multiple threads ;
+    // returns false if any of the chunks is missing or corrupt
+    bool acquireChunks(std::vector<ChunkId> const & chunkIds,
+        std::vector<std::shared_ptr<Chunk const>> & result) const;
+
+    // total size of the streamed chunk payloads currently resident (decompressed)
+    size_t getResidentSize() const { return _residentSize; }
+
     template <typename ChunkDesc> Chunk const * getChunk(ChunkId chunkId) const;
 
     template <typename ChunkDesc> bool validateChunk(Chunk const * chunk) const;
 
+public:
+
+    // upgrade interface
+    //
+    // chunk layouts are versioned : when the layout of a chunk type changes, a
+    // function converting payloads from the previous version is registered, so
+    // that files written with older layouts can still be loaded. Upgrades are
+    // chained until each chunk reaches the latest version of its layout.
+
+    typedef std::function<bool(Chunk const & chunk, std::vector<uint8_t> & result)> UpgradeFunction;
+
+    static void registerUpgrade(uint32_t chunkType, uint32_t fromVersion, uint32_t toVersion, UpgradeFunction upgrade);
+
+    // number of chunks with a registered upgrade
+    size_t getOutdatedChunkCount() const;
+
+    // returns a file built in memory with all the chunks upgraded, or nullptr if
+    // any upgrade fails ; chunks are read & upgraded on multiple threads, and the
+    // chunks that are already up to date are shared with this file
+    std::shared_ptr<ChunkFile const> upgrade() const;
+
+    // opens a streamed file (see open) ; if it has outdated chunks, the upgraded
+    // file is written back (see IFileSystem::writeFileAtomic) and opened instead
+    static std::shared_ptr<ChunkFile const> openAndUpgrade(
+        std::shared_ptr<donut::vfs::IFileSystem> fs, std::filesystem::path const & path);
+
 private:
 
     struct Header;
 
+    struct ChunkTableEntry_0x100;
+
     struct ChunkTableEntry;
 
-    ChunkId addChunk(uint32_t type, uint32_t version, void const * data, size_t size);
+    struct ChunkStorage;
+
+    struct ResidentChunk;
+
+    size_t findChunk(ChunkId chunkId) const;
+
+    bool loadChunk(size_t index) const;
+
+    std::shared_ptr<Chunk const> acquireChunk(size_t index) const;
+
+    std::shared_ptr<Chunk const> readChunk(size_t index) const;
+
+    static size_t getChunkTableSize(Header const & header, char const * filepath);
+
+    static std::shared_ptr<ChunkFile> parseTable(
+        Header const & header, uint8_t const * table, uint64_t fileSize, char const * filepath);
 
     std::string _filepath;
 
     std::vector<std::unique_ptr<Chunk const>> _chunks;
 
+    // stored payloads of deserialized chunks, parallel to _chunks
+    // (empty for files built in memory)
+    std::vector<std::unique_ptr<ChunkStorage>> _storage;
+
+    ChunkCodec _codec = ChunkCodec::None;
+
+    int _compressionLevel = 0;
+
     std::shared_ptr<donut::vfs::IBlob const> _data;
+
+    // streamed files
+    std::shared_ptr<donut::vfs::IFileSystem> _fs;
+
+    // upgraded files : upgraded payloads & handles on the chunks of the source file
+    std::vector<std::shared_ptr<void const>> _payloads;
+
+    mutable std::atomic<size_t> _residentSize = 0;
 };
 
 
@@ -199,6 +199,15 @@ namespace donut::math
 	template <typename T, int n>
 	affine<T, n> operator * (affine<T, n> const & a, affine<T, n> const & b)
 	{
+#if DM_SIMD
+		if constexpr (std::is_same_v<T, float> && n == 3)
+		{
+			static_assert(sizeof(affine<T, n>) == 12 * sizeof(float));
+			affine<T, n> result;
+			simd::mulAffine3(a.m_linear.m_data, b.m_linear.m_data, result.m_linear.m_data);
+			return result;
+		}
+#endif
 		affine<T, n> result =
 		{
 			a.m_linear * b.m_linear,
@@ -251,6 +260,15 @@ namespace donut::math
 	template <typename T, int n>
 	affine<T, n> inverse(affine<T, n> const & a)
 	{
+#if DM_SIMD
+		if constexpr (std::is_same_v<T, float> && n == 3)
+		{
+			static_assert(sizeof(affine<T, n>) == 12 * sizeof(float));
+			affine<T, n> result;
+			if (simd::inverseAffine3(a.m_linear.m_data, epsilon, result.m_linear.m_data))
+				return result;
+		}
+#endif
 		auto mInverted = inverse(a.m_linear);
 		affine<T, n> result =
 		{
@@ -0,0 +1,67 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+namespace tf
+{
+	class Executor;
+}
+
+// Functions that apply the same operation to arrays of points, boxes and transforms. They use the
+// SIMD kernels from simd.h when available and, given an 'executor', split large arrays into tasks
+// on it (builds with DONUT_WITH_TASKFLOW only); small arrays are always processed on the calling
+// thread. The results are the same as applying the scalar operators to each element, within the
+// precision notes in simd.h.
+// The result arrays may be the same as the input arrays, but must not partially overlap them.
+
+namespace donut::math::batch
+{
+	// result[i] = transform.transformPoint(points[i])
+	void transformPoints(affine3 const & transform, float3 const * points, float3 * result, size_t count, tf::Executor* executor = nullptr);
+
+	// result[i] = boxes[i] * transform
+	void transformBoxes(affine3 const & transform, box3 const * boxes, box3 * result, size_t count, tf::Executor* executor = nullptr);
+
+	// result[i] = boxes[i] * transforms[i]
+	void transformBoxes(affine3 const * transforms, box3 const * boxes, box3 * result, size_t count, tf::Executor* executor = nullptr);
+
+	// result[i] = a[i] * b[i]
+	void multiply(affine3 const * a, affine3 const * b, affine3 * result, size_t count, tf::Executor* executor = nullptr);
+
+	// result[i] = a[i] * b
+	void multiply(affine3 const * a, affine3 const & b, affine3 * result, size_t count, tf::Executor* executor = nullptr);
+
+	// result[i] = a[i] * affineToHomogeneous(b[i]), e.g. inverse bind matrices times joint transforms
+	void multiply(float4x4 const * a, affine3 const * b, float4x4 * result, size_t count, tf::Executor* executor = nullptr);
+
+	// result[i] = affine3(a[i])
+	void convert(daffine3 const * a, affine3 * result, size_t count, tf::Executor* executor = nullptr);
+
+	// affineToColumnMajor(a[i], result + i * resultStride bytes), for filling arrays of GPU structures
+	void affineToColumnMajor(affine3 const * a, float * result, size_t resultStride, size_t count, tf::Executor* executor = nullptr);
+
+	// the bounding box of the points, box3::empty() if count is 0
+	box3 bounds(float3 const * points, size_t count);
+}
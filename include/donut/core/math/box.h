@@ -200,6 +200,14 @@ namespace donut::math
         {
             // fast method to apply an affine transform to an AABB
             box<T, n> result;
+#if DM_SIMD
+            if constexpr (std::is_same_v<T, float> && n == 3)
+            {
+                static_assert(sizeof(box<T, n>) == 6 * sizeof(float));
+                simd::transformBox3(m_mins.data(), transform.m_linear.m_data, result.m_mins.data());
+                return result;
+            }
+#endif
             result.m_mins = transform.m_translation;
             result.m_maxs = transform.m_translation;
             const vector<T, n>* row = &transform.m_linear.row0;
@@ -26,6 +26,7 @@ namespace donut::math {}
 namespace dm = donut::math;
 
 #include "basics.h"
+#include "simd.h"
 #include "vector.h"
 #include "matrix.h"
 #include "affine.h"
@@ -34,3 +35,4 @@ namespace dm = donut::math;
 #include "quat.h"
 #include "sphere.h"
 #include "frustum.h"
+#include "batch.h"
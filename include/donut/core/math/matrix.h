@@ -23,6 +23,7 @@
 #pragma once
 #include <cmath>
 #include <algorithm>
+#include <type_traits>
 
 namespace donut::math
 {
@@ -567,6 +568,14 @@ namespace donut::math
 	template <typename T, int rows, int inner, int cols>
 	matrix<T, rows, cols> operator * (matrix<T, rows, inner> const & a, matrix<T, inner, cols> const & b)
 	{
+#if DM_SIMD
+		if constexpr (std::is_same_v<T, float> && rows == 4 && inner == 4 && cols == 4)
+		{
+			matrix<T, rows, cols> result;
+			simd::mulMatrix4x4(a.m_data, b.m_data, result.m_data);
+			return result;
+		}
+#endif
 		auto result = matrix<T, rows, cols>::zero();
 		for (int i = 0; i < rows; ++i)
 			for (int j = 0; j < cols; ++j)
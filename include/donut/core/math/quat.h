@@ -93,6 +93,14 @@ namespace donut::math
 		// Convert to a matrix
 		[[nodiscard]] matrix<T, 3, 3> toMatrix() const
 		{
+#if DM_SIMD
+			if constexpr (std::is_same_v<T, float>)
+			{
+				matrix<T, 3, 3> result;
+				simd::quaternionToMatrix3(w, x, y, z, result.m_data);
+				return result;
+			}
+#endif
 			return matrix<T, 3, 3>(
 							1 - 2*(y*y + z*z), 2*(x*y + z*w), 2*(x*z - y*w),
 							2*(x*y - z*w), 1 - 2*(x*x + z*z), 2*(y*z + x*w),
@@ -0,0 +1,289 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+// SIMD kernels for the float operations that dominate transform-heavy code: 4x4 matrix
+// products, affine composition and inverse, quaternion to matrix conversion and box transforms.
+// They are selected at compile time by the generic operators (operator * in matrix.h and
+// affine.h, inverse() in affine.h, quaternion::toMatrix() and box::operator *), which keeps the
+// public API unchanged, and are not meant to be called directly.
+//
+// x86-64 builds use SSE2, and builds with AVX enabled (see DONUT_WITH_AVX2) compute two rows of
+// a 4x4 product at once. Other platforms, and builds that define DM_NO_SIMD, use the scalar code;
+// a NEON port mostly needs the primitives and the load/store helpers.
+//
+// Precision: products, box transforms and quaternion conversions evaluate the same operations in
+// the same order as the scalar code, so the results are identical (up to the sign of zeros) unless
+// the compiler contracts the scalar code into FMA instructions. The affine inverse uses cofactors
+// instead of Gaussian elimination: its results are within 1e-5 of the scalar code relative to the
+// largest element of the inverse for matrices with a condition number below 1e3. Nearly singular
+// matrices (|det| <= epsilon) use the scalar code.
+
+#if !defined(DM_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define DM_SIMD 1
+#include <emmintrin.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+#else
+#define DM_SIMD 0
+#endif
+
+#if DM_SIMD
+
+namespace donut::math::simd
+{
+	// Primitives
+
+	typedef __m128 float4_t;
+
+	inline float4_t load4(const float* p) { return _mm_loadu_ps(p); }
+
+	// loads p[0..2] without reading past them, w = 0
+	inline float4_t load3(const float* p)
+	{
+		__m128 xy = _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+		return _mm_movelh_ps(xy, _mm_load_ss(p + 2));
+	}
+
+	inline void store4(float* p, float4_t v) { _mm_storeu_ps(p, v); }
+
+	// stores x, y to p[0..1] ; the 64-bit integer forms are used because the double forms
+	// (_mm_load_sd, _mm_store_sd) are not exempt from strict aliasing on GCC and Clang
+	inline void storeLow2(float* p, float4_t v) { _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_castps_si128(v)); }
+
+	inline float4_t splat(float a) { return _mm_set1_ps(a); }
+
+	template<int i> inline float4_t splat(float4_t v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(i, i, i, i)); }
+
+	inline float4_t add(float4_t a, float4_t b) { return _mm_add_ps(a, b); }
+	inline float4_t sub(float4_t a, float4_t b) { return _mm_sub_ps(a, b); }
+	inline float4_t mul(float4_t a, float4_t b) { return _mm_mul_ps(a, b); }
+	inline float4_t div(float4_t a, float4_t b) { return _mm_div_ps(a, b); }
+
+	// min/max with the semantics of dm::min(a, b) and dm::max(a, b), including NaNs
+	inline float4_t min(float4_t a, float4_t b) { return _mm_min_ps(a, b); }
+	inline float4_t max(float4_t a, float4_t b) { return _mm_max_ps(b, a); }
+
+	// (a.y, a.z, a.x, a.w)
+	inline float4_t yzx(float4_t a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1)); }
+
+	inline float4_t cross(float4_t a, float4_t b)
+	{
+		return yzx(sub(mul(a, yzx(b)), mul(yzx(a), b)));
+	}
+
+	inline float dot3(float4_t a, float4_t b)
+	{
+		float4_t p = mul(a, b);
+		return _mm_cvtss_f32(add(add(p, splat<1>(p)), splat<2>(p)));
+	}
+
+	// a.x * r0 + a.y * r1 + a.z * r2, the row-vector product with a 3x3 matrix
+	inline float4_t transform3(float4_t a, float4_t r0, float4_t r1, float4_t r2)
+	{
+		return add(add(mul(splat<0>(a), r0), mul(splat<1>(a), r1)), mul(splat<2>(a), r2));
+	}
+
+	// Kernels - matrices are row-major and use row-vector math, like the scalar code
+
+	// result = a * b, for 4x4 matrices
+	inline void mulMatrix4x4(const float* a, const float* b, float* result)
+	{
+#if defined(__AVX__)
+		__m256 b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b + 0));
+		__m256 b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b + 4));
+		__m256 b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b + 8));
+		__m256 b3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b + 12));
+
+		for (int i = 0; i < 16; i += 8)
+		{
+			__m256 rows = _mm256_loadu_ps(a + i);
+			__m256 r = _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, 0x00), b0);
+			r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, 0x55), b1));
+			r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, 0xaa), b2));
+			r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, 0xff), b3));
+			_mm256_storeu_ps(result + i, r);
+		}
+#else
+		float4_t b0 = load4(b + 0);
+		float4_t b1 = load4(b + 4);
+		float4_t b2 = load4(b + 8);
+		float4_t b3 = load4(b + 12);
+
+		for (int i = 0; i < 16; i += 4)
+		{
+			float4_t row = load4(a + i);
+			float4_t r = mul(splat<0>(row), b0);
+			r = add(r, mul(splat<1>(row), b1));
+			r = add(r, mul(splat<2>(row), b2));
+			r = add(r, mul(splat<3>(row), b3));
+			store4(result + i, r);
+		}
+#endif
+	}
+
+	// Affine transforms are stored as 12 contiguous floats, the 3x3 linear part followed by the
+	// translation, like affine<float, 3>: four packed 3-vectors, as are two boxes or four points.
+	// They are loaded and stored as whole vectors: piecewise stores of overlapping rows defeat
+	// store forwarding when the result is read back right away.
+
+	// loads four packed 3-vectors from p[0..11], the w lanes are undefined
+	inline void load3x4(const float* p, float4_t& a, float4_t& b, float4_t& c, float4_t& d)
+	{
+		a = load4(p + 0);
+		b = load4(p + 3);
+		c = load4(p + 6);
+		float4_t v = load4(p + 8);
+		d = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 2, 1));
+	}
+
+	// packs the x, y, z lanes of r0, r1 and r2 into 9 floats and stores them
+	inline void storeRows3(float* p, float4_t r0, float4_t r1, float4_t r2)
+	{
+		float4_t r0zr1x = _mm_shuffle_ps(r0, r1, _MM_SHUFFLE(0, 0, 2, 2));
+		store4(p + 0, _mm_shuffle_ps(r0, r0zr1x, _MM_SHUFFLE(2, 0, 1, 0)));
+		store4(p + 4, _mm_shuffle_ps(r1, r2, _MM_SHUFFLE(1, 0, 2, 1)));
+		_mm_store_ss(p + 8, _mm_movehl_ps(r2, r2));
+	}
+
+	// packs the x, y, z lanes of a, b, c and d into p[0..11]
+	inline void store3x4(float* p, float4_t a, float4_t b, float4_t c, float4_t d)
+	{
+		float4_t azbx = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 2, 2));
+		float4_t czdx = _mm_shuffle_ps(c, d, _MM_SHUFFLE(0, 0, 2, 2));
+		store4(p + 0, _mm_shuffle_ps(a, azbx, _MM_SHUFFLE(2, 0, 1, 0)));
+		store4(p + 4, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 2, 1)));
+		store4(p + 8, _mm_shuffle_ps(czdx, d, _MM_SHUFFLE(2, 1, 2, 0)));
+	}
+
+	// result = a * b, for affine transforms, with b already loaded
+	inline void mulAffine3(const float* a, float4_t b0, float4_t b1, float4_t b2, float4_t bt, float* result)
+	{
+		float4_t a0, a1, a2, at;
+		load3x4(a, a0, a1, a2, at);
+
+		store3x4(result,
+			transform3(a0, b0, b1, b2),
+			transform3(a1, b0, b1, b2),
+			transform3(a2, b0, b1, b2),
+			add(transform3(at, b0, b1, b2), bt));
+	}
+
+	// result = a * b, for affine transforms
+	inline void mulAffine3(const float* a, const float* b, float* result)
+	{
+		float4_t b0, b1, b2, bt;
+		load3x4(b, b0, b1, b2, bt);
+		mulAffine3(a, b0, b1, b2, bt, result);
+	}
+
+	// result = inverse(a) ; returns false, without writing the result, if |det(a)| <= epsilon
+	inline bool inverseAffine3(const float* a, float epsilon, float* result)
+	{
+		float4_t r0, r1, r2, t;
+		load3x4(a, r0, r1, r2, t);
+
+		// the columns of the inverse are the cross products of the rows, divided by the determinant
+		float4_t c0 = cross(r1, r2);
+		float4_t c1 = cross(r2, r0);
+		float4_t c2 = cross(r0, r1);
+
+		float det = dot3(r0, c0);
+		if (!(det > epsilon || det < -epsilon))
+			return false;
+
+		float4_t zero = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(c0, c1, c2, zero);
+
+		float4_t invDet = splat(det);
+		float4_t i0 = div(c0, invDet);
+		float4_t i1 = div(c1, invDet);
+		float4_t i2 = div(c2, invDet);
+
+		store3x4(result, i0, i1, i2, sub(_mm_setzero_ps(), transform3(t, i0, i1, i2)));
+		return true;
+	}
+
+	// result = the rotation matrix of the unit quaternion (w, x, y, z)
+	inline void quaternionToMatrix3(float w, float x, float y, float z, float* result)
+	{
+		// each element is base + scale * (p * q + sign * r * s), as in quaternion::toMatrix()
+		float4_t r0 = add(mul(_mm_setr_ps(y, x, x, 0), _mm_setr_ps(y, y, z, 0)),
+			mul(_mm_setr_ps(z, z, -y, 0), _mm_setr_ps(z, w, w, 0)));
+		float4_t r1 = add(mul(_mm_setr_ps(x, x, y, 0), _mm_setr_ps(y, x, z, 0)),
+			mul(_mm_setr_ps(-z, z, x, 0), _mm_setr_ps(w, z, w, 0)));
+		float4_t r2 = add(mul(_mm_setr_ps(x, y, x, 0), _mm_setr_ps(z, z, x, 0)),
+			mul(_mm_setr_ps(y, -x, y, 0), _mm_setr_ps(w, w, y, 0)));
+
+		r0 = add(_mm_setr_ps(1, 0, 0, 0), mul(_mm_setr_ps(-2, 2, 2, 0), r0));
+		r1 = add(_mm_setr_ps(0, 1, 0, 0), mul(_mm_setr_ps(2, -2, 2, 0), r1));
+		r2 = add(_mm_setr_ps(0, 0, 1, 0), mul(_mm_setr_ps(2, 2, -2, 0), r2));
+
+		storeRows3(result, r0, r1, r2);
+	}
+
+	// (rmins, rmaxs) = the bounds of the box (mins, maxs) transformed by the affine transform (r0, r1, r2, t)
+	inline void transformBox3(float4_t mins, float4_t maxs, float4_t r0, float4_t r1, float4_t r2, float4_t t,
+		float4_t& rmins, float4_t& rmaxs)
+	{
+		rmins = t;
+		rmaxs = t;
+
+		float4_t e = mul(splat<0>(mins), r0);
+		float4_t f = mul(splat<0>(maxs), r0);
+		rmins = add(rmins, min(e, f));
+		rmaxs = add(rmaxs, max(e, f));
+		e = mul(splat<1>(mins), r1);
+		f = mul(splat<1>(maxs), r1);
+		rmins = add(rmins, min(e, f));
+		rmaxs = add(rmaxs, max(e, f));
+		e = mul(splat<2>(mins), r2);
+		f = mul(splat<2>(maxs), r2);
+		rmins = add(rmins, min(e, f));
+		rmaxs = add(rmaxs, max(e, f));
+	}
+
+	// result = the bounds of a box transformed by an affine transform, with the transform already
+	// loaded ; boxes are stored as 6 contiguous floats, the mins followed by the maxs, like box<float, 3>
+	inline void transformBox3(const float* box, float4_t r0, float4_t r1, float4_t r2, float4_t t, float* result)
+	{
+		float4_t rmins, rmaxs;
+		transformBox3(load4(box), load3(box + 3), r0, r1, r2, t, rmins, rmaxs);
+
+		// (mins.xyz, maxs.x) and (maxs.yz)
+		float4_t minszmaxsx = _mm_shuffle_ps(rmins, rmaxs, _MM_SHUFFLE(0, 0, 2, 2));
+		store4(result, _mm_shuffle_ps(rmins, minszmaxsx, _MM_SHUFFLE(2, 0, 1, 0)));
+		storeLow2(result + 4, _mm_shuffle_ps(rmaxs, rmaxs, _MM_SHUFFLE(3, 3, 2, 1)));
+	}
+
+	// result = the bounds of a box transformed by an affine transform
+	inline void transformBox3(const float* box, const float* transform, float* result)
+	{
+		float4_t r0, r1, r2, t;
+		load3x4(transform, r0, r1, r2, t);
+		transformBox3(box, r0, r1, r2, t, result);
+	}
+}
+
+#endif
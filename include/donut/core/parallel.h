@@ -0,0 +1,53 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace tf
+{
+    class Executor;
+}
+
+namespace donut::parallel
+{
+    // Runs task(begin, end) over [0, count), split into at most 'maxRanges' ranges that run as tasks on the executor,
+    // and waits for them. The range boundaries are multiples of 'alignment', except for the end of the last range.
+    // The whole range runs on the calling thread if there is no executor, if there would be fewer than two ranges,
+    // in builds without DONUT_WITH_TASKFLOW, and when the caller is itself a taskflow worker: this version of
+    // taskflow cannot join nested work from a worker (it has no Executor::corun), and blocking the worker
+    // while it waits could deadlock a small pool.
+    void forEachRange(tf::Executor* executor, size_t count, size_t maxRanges, size_t alignment,
+        const std::function<void(size_t begin, size_t end)>& task);
+
+    // Runs task(index) for every index in [0, count) on up to 'maxTasks' tasks, which take the next index
+    // whenever they finish one; that balances items of different cost. The indices are started in order.
+    // Runs on the calling thread in the same cases as forEachRange.
+    void forEachIndex(tf::Executor* executor, size_t count, size_t maxTasks, const std::function<void(size_t index)>& task);
+
+    // Returns an executor shared by the library code that is not given one by the application, such as the
+    // decompression in the file system layers, so that concurrent callers don't each start their own threads.
+    // The executor is created on first use. Returns nullptr in builds without DONUT_WITH_TASKFLOW.
+    tf::Executor* getSharedExecutor();
+}
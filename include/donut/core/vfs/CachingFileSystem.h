@@ -0,0 +1,140 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/vfs/VFS.h>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace donut::vfs
+{
+    /*
+    Read-through caching layer for the virtual file system.
+
+    Keeps the blobs returned by readFile in memory, up to a budget in bytes, and evicts
+    the least recently used blobs when the budget is exceeded. Files that are larger than
+    the budget are never cached. fileExists also remembers the names of files that don't exist,
+    and readFile returns nullptr for such files without asking the underlying file system.
+    This makes repeated probing for optional variants of a file (such as the '.dds' versions
+    of textures or the '.lz4' versions in CompressionLayer) cost nothing after the first time.
+
+    The prefetch function starts reading the provided files into the cache in the background,
+    using readFilesAsync of the underlying file system. readFile calls for files that are being
+    prefetched wait for the prefetch to finish instead of reading the file again.
+
+    Writes through this layer go to the underlying file system and invalidate the cached
+    contents of the file. Changes made to the underlying file system directly are not
+    detected: call invalidate or clear after making such changes.
+
+    Intended usage is on top of slow file systems, such as network shares or compressed
+    archives, when the same files are read multiple times, for example when loading
+    several scenes that share textures and includes.
+    */
+
+    class CachingFileSystem : public IFileSystem
+    {
+    public:
+        struct Statistics
+        {
+            uint64_t hits = 0;          // readFile and mapFile calls served from the cache
+            uint64_t misses = 0;        // readFile calls that read the underlying file system
+            uint64_t negativeHits = 0;  // fileExists and readFile calls for files known to be missing
+            uint64_t evictions = 0;     // blobs removed from the cache to fit the budget
+            uint64_t prefetches = 0;    // files read by prefetch
+            size_t cachedBytes = 0;
+            size_t cachedFiles = 0;
+        };
+
+    private:
+        struct CacheEntry
+        {
+            std::shared_ptr<IBlob> blob;
+            std::list<std::string>::iterator lruPosition;
+        };
+
+        std::shared_ptr<IFileSystem> m_fs;
+        size_t m_Budget;
+
+        std::mutex m_Mutex;
+        std::condition_variable m_ReadCompleted;
+        std::list<std::string> m_LruList; // most recently used first
+        std::unordered_map<std::string, CacheEntry> m_Entries;
+        std::unordered_set<std::string> m_MissingFiles;
+        std::unordered_set<std::string> m_PendingPrefetches;
+        size_t m_NumPrefetchesInFlight = 0;
+        size_t m_NumReadsInFlight = 0; // readFilesAsync requests whose callbacks reference the cache
+        uint64_t m_Generation = 0; // incremented on invalidation to discard the results of reads in flight
+        Statistics m_Statistics;
+
+        static std::string getCacheKey(const std::filesystem::path& name);
+
+        // These functions must be called with m_Mutex locked.
+        std::shared_ptr<IBlob> findBlob(const std::string& key);
+        void insertBlob(const std::string& key, std::shared_ptr<IBlob> blob);
+        void eraseBlob(const std::string& key);
+
+    public:
+        CachingFileSystem(std::shared_ptr<IFileSystem> fs, size_t budgetBytes);
+
+        // Waits for all prefetches to finish.
+        ~CachingFileSystem() override;
+
+        // Changes the budget, evicting blobs if the cache is now over it.
+        void setBudget(size_t budgetBytes);
+        [[nodiscard]] size_t getBudget() const { return m_Budget; }
+
+        // Starts reading the files into the cache in the background.
+        // Files that are already cached, known to be missing, or being prefetched are skipped.
+        void prefetch(const std::vector<std::filesystem::path>& names, ReadPriority priority = ReadPriority::Low);
+
+        // Blocks until all prefetches started so far are finished.
+        void waitForPrefetches();
+
+        // Removes the cached contents and the missing status of one file.
+        void invalidate(const std::filesystem::path& name);
+
+        // Removes all cached contents and missing file records. Statistics are preserved.
+        void clear();
+
+        [[nodiscard]] Statistics getStatistics();
+        void resetStatistics();
+
+        bool folderExists(const std::filesystem::path& name) override;
+        bool fileExists(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> readFile(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> mapFile(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size) override;
+        bool getFileSize(const std::filesystem::path& name, uint64_t& size) override;
+        void readFilesAsync(std::vector<AsyncReadRequest> requests) override;
+        bool writeFile(const std::filesystem::path& name, const void* data, size_t size) override;
+        bool writeFileAtomic(const std::filesystem::path& name, const void* data, size_t size) override;
+        int enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates = false) override;
+        int enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback, bool allowDuplicates = false) override;
+
+        CachingFileSystem(const CachingFileSystem&) = delete;
+        CachingFileSystem& operator=(const CachingFileSystem&) = delete;
+    };
+}
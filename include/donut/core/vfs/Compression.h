@@ -25,25 +25,45 @@
 #include <donut/core/vfs/VFS.h>
 #include <utility>
 
+struct ZSTD_DDict_s;
+
 namespace donut::vfs
 {
     /* 
     Transparent compression and decompression layer for the virtual file system.
-    Currently, it only supports LZ4 frame compression.
+    It supports LZ4 frame compression ('.lz4' files) and Zstandard compression ('.zst' files).
 
     Behavior:
     
     The readFile function tries to read the file with an extra '.lz4' extension
-    appended first. If such file exists, it will be decompressed and returned.
-    If no .lz4 file exists, the compression layer will read and return the file
-    with the exact name requested.
+    appended first, then with a '.zst' extension. If such file exists, it will be
+    decompressed and returned. If no compressed file exists, the compression layer
+    will read and return the file with the exact name requested.
 
     The writeFile function will compress the input data if the provided file name
-    has an '.lz4' extension. If no such extension is present, the file will be 
+    has an '.lz4' or '.zst' extension. If no such extension is present, the file will be 
     written uncompressed.
 
+    Compressed files are written as LZ4 frames with independent 1 MB blocks, followed by
+    a skippable frame that stores the offsets of all blocks. Such files remain readable
+    by any LZ4 decoder, while readFile uses the block index to decompress large files
+    on multiple threads. Frames with linked blocks, as well as frames with independent
+    blocks but without an index, are also supported.
+
+    Zstandard files are written as a sequence of independent frames of up to 4 MB of
+    data each, which is still a valid Zstandard stream. readFile decompresses the frames
+    of large files on multiple threads. A shared dictionary, typically trained on the
+    files of one archive and stored in it, can be loaded with loadZstdDictionary.
+    It is then used for all .zst files written through the layer, and for reading
+    the files that were compressed with it.
+
+    The readFileRange function only decompresses the LZ4 blocks or Zstandard frames that overlap
+    the requested range. For LZ4 files with a block index, it only reads the frame header, the index
+    and the overlapping blocks from the underlying file system; other files are read entirely.
+    Files that can't be split into blocks or frames are decompressed entirely.
+
     The enumerateFiles function will search for files with the requested extensions
-    and with extra '.lz4' extensions. The .lz4 extensions will be removed from 
+    and with extra '.lz4' or '.zst' extensions. These extensions will be removed from 
     the returned file names and de-duplicated in case the same file exists in both
     compressed and uncompressed forms.
 
@@ -62,17 +82,39 @@ namespace donut::vfs
     private:
         std::shared_ptr<IFileSystem> m_fs;
         int m_CompressionLevel = 5;
+        uint32_t m_MaxDecompressionThreads = 0;
+        std::shared_ptr<IBlob> m_ZstdDictionary;
+        std::shared_ptr<ZSTD_DDict_s> m_ZstdDDict;
+
+        [[nodiscard]] uint32_t getDecompressionThreadCount() const;
+        std::shared_ptr<IBlob> decompressLZ4(const std::shared_ptr<IBlob>& compressedBlob, const std::filesystem::path& name);
+        std::shared_ptr<IBlob> decompressZstd(const std::shared_ptr<IBlob>& compressedBlob, const std::filesystem::path& name);
+        bool readIndexedRangeLZ4(const std::filesystem::path& compressedName, uint64_t compressedSize, uint64_t offset, size_t size, std::shared_ptr<IBlob>& result);
+        std::shared_ptr<IBlob> readRangeLZ4(const std::shared_ptr<IBlob>& compressedBlob, const std::filesystem::path& name, uint64_t offset, size_t size);
+        std::shared_ptr<IBlob> readRangeZstd(const std::shared_ptr<IBlob>& compressedBlob, const std::filesystem::path& name, uint64_t offset, size_t size);
+        bool compressLZ4(const std::filesystem::path& name, const void* data, size_t size);
+        bool compressZstd(const std::filesystem::path& name, const void* data, size_t size);
 
     public:
         explicit CompressionLayer(std::shared_ptr<IFileSystem> fs)
             : m_fs(std::move(fs))
         { }
 
+        // Sets the compression level used by writeFile, see the LZ4 or Zstandard documentation for the ranges.
         void setCompressionLevel(int level) { m_CompressionLevel = level; }
+
+        // Loads a Zstandard dictionary from the underlying file system.
+        // Returns false if the dictionary cannot be read or Zstandard support is not enabled.
+        bool loadZstdDictionary(const std::filesystem::path& name);
+
+        // Sets the maximum number of threads used to decompress one file, 0 means the number of CPU cores.
+        void setMaxDecompressionThreads(uint32_t threads) { m_MaxDecompressionThreads = threads; }
         
         bool folderExists(const std::filesystem::path& name) override;
         bool fileExists(const std::filesystem::path& name) override;
         std::shared_ptr<IBlob> readFile(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> mapFile(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size) override;
         bool writeFile(const std::filesystem::path& name, const void* data, size_t size) override;
         int enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates = false) override;
         int enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback, bool allowDuplicates = false) override;
@@ -0,0 +1,138 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/vfs/VFS.h>
+#include <fstream>
+#include <unordered_set>
+
+namespace donut::vfs
+{
+    // Compression method of an individual file in a pack archive.
+    enum class PackCompression : uint32_t
+    {
+        None = 0,
+        LZ4 = 1,  // raw LZ4 block
+        Zstd = 2  // single Zstandard frame
+    };
+
+    /*
+    A read-only file system that provides access to files in a donut pack archive.
+
+    Pack archive layout:
+        - PackHeader, padded to the alignment (4 KB by default)
+        - file data, every file starts at an aligned offset
+        - table of contents: entries sorted by the xxh64 hash of their normalized path, then the path strings
+        - PackFooter with the location and size of the table of contents
+
+    Opening a pack maps the archive into memory and validates the footer; nothing is parsed per file,
+    so the open time doesn't depend on the number of files. Lookups are binary searches by the path hash.
+    The directory index used by enumerateFiles and enumerateDirectories is built when it's first needed.
+    Every file can be stored uncompressed, or compressed with LZ4 or Zstandard when donut is built with
+    the respective library. Uncompressed files are returned as views into the mapping without copying.
+    The archive is immutable, so multiple threads can read from the same PackFile concurrently.
+
+    Packs can be created with the PackWriter class or the scripts/donut_pack.py tool.
+    */
+    class PackFile : public IFileSystem
+    {
+    public:
+        struct Entry;
+
+    private:
+        std::string m_ArchivePath;
+        std::shared_ptr<MappedFileBlob> m_Mapping;
+        const Entry* m_Entries = nullptr;
+        const char* m_Names = nullptr;
+        uint32_t m_NumEntries = 0;
+        std::once_flag m_IndexCreated;
+        DirectoryIndex m_Index;
+
+        const DirectoryIndex& getIndex();
+        [[nodiscard]] const Entry* findEntry(const std::filesystem::path& name) const;
+        [[nodiscard]] std::string_view getEntryName(const Entry& entry) const;
+        [[nodiscard]] std::shared_ptr<IBlob> readEntry(const Entry& entry, uint64_t offset, size_t size) const;
+        
+    public:
+        PackFile(const std::filesystem::path& archivePath);
+
+        [[nodiscard]] bool isOpen() const;
+        [[nodiscard]] uint32_t getNumEntries() const { return m_NumEntries; }
+        
+        bool folderExists(const std::filesystem::path& name) override;
+        bool fileExists(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> readFile(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size) override;
+        bool getFileSize(const std::filesystem::path& name, uint64_t& size) override;
+        bool writeFile(const std::filesystem::path& name, const void* data, size_t size) override;
+        int enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates = false) override;
+        int enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback, bool allowDuplicates = false) override;
+    };
+
+    /*
+    Creates pack archives that can be read with PackFile.
+    Files are written to the archive as they are added, the table of contents is written by finish().
+    If compression of a file doesn't make it smaller, the file is stored uncompressed.
+    */
+    class PackWriter
+    {
+    private:
+        struct PendingEntry
+        {
+            std::string name;
+            uint64_t offset = 0;
+            uint64_t storedSize = 0;
+            uint64_t size = 0;
+            PackCompression compression = PackCompression::None;
+            bool directory = false;
+        };
+
+        std::string m_ArchivePath;
+        std::ofstream m_Stream;
+        std::vector<PendingEntry> m_Entries;
+        std::unordered_set<std::string> m_Names;
+        uint64_t m_Position = 0;
+        uint32_t m_Alignment = 4096;
+        int m_CompressionLevel = 9;
+        bool m_Errors = false;
+
+        bool writeAligned(const void* data, size_t size);
+        void addDirectories(const std::string& fileName);
+
+    public:
+        // Creates the archive file. Alignment must be a power of 2.
+        PackWriter(const std::filesystem::path& archivePath, uint32_t alignment = 4096);
+        ~PackWriter();
+
+        [[nodiscard]] bool isOpen() const;
+
+        // Sets the compression level used for subsequent addFile calls, see the LZ4 or Zstandard documentation for the ranges.
+        void setCompressionLevel(int level) { m_CompressionLevel = level; }
+
+        // Adds a file to the archive. Returns false if the name is invalid or the data cannot be written.
+        bool addFile(const std::filesystem::path& name, const void* data, size_t size, PackCompression compression = PackCompression::None);
+
+        // Writes the table of contents and closes the archive. Called by the destructor if necessary.
+        bool finish();
+    };
+}
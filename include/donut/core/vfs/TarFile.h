@@ -25,7 +25,6 @@
 #include <donut/core/vfs/VFS.h>
 #include <mutex>
 #include <unordered_map>
-#include <unordered_set>
 
 namespace donut::vfs
 {
@@ -34,13 +33,19 @@ namespace donut::vfs
     The archive is partially read to enumerate the files when TarFile is created.
     TarFile can only operate on real files, i.e. underlying virtual file systems are not supported.
     Designed to work in combination with CompressionLayer to store packaged assets.
+    The file index is immutable after construction, and file contents are read with positional I/O,
+    so multiple threads can read from the same archive concurrently without locking.
+    Files can also be returned as views into a memory mapping of the archive, see mapFile and setMappingThreshold.
     */
     class TarFile : public IFileSystem
     {
     private:
         std::string m_ArchivePath;
-        std::mutex m_Mutex;
-        FILE* m_ArchiveFile = nullptr;
+#ifdef WIN32
+        void* m_ArchiveFile = nullptr; // HANDLE
+#else
+        int m_ArchiveFile = -1;
+#endif
 
         struct FileEntry
         {
@@ -49,17 +54,30 @@ namespace donut::vfs
         };
 
         std::unordered_map<std::string, FileEntry> m_Files;
-        std::unordered_set<std::string> m_Directories;
+        DirectoryIndex m_Index;
+
+        size_t m_MappingThreshold = 0;
+        std::once_flag m_MappingCreated;
+        std::shared_ptr<MappedFileBlob> m_Mapping;
+
+        std::shared_ptr<IBlob> mapEntry(const FileEntry& entry);
         
     public:
         TarFile(const std::filesystem::path& archivePath);
         ~TarFile() override;
 
         [[nodiscard]] bool isOpen() const;
+
+        // Makes readFile return views into a memory mapping of the archive for files of at least 'bytes' in size.
+        // Zero disables mapping in readFile, which is the default.
+        void setMappingThreshold(size_t bytes) { m_MappingThreshold = bytes; }
         
         bool folderExists(const std::filesystem::path& name) override;
         bool fileExists(const std::filesystem::path& name) override;
         std::shared_ptr<IBlob> readFile(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> mapFile(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size) override;
+        bool getFileSize(const std::filesystem::path& name, uint64_t& size) override;
         bool writeFile(const std::filesystem::path& name, const void* data, size_t size) override;
         int enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates = false) override;
         int enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback, bool allowDuplicates = false) override;
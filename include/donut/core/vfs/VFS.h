@@ -26,6 +26,8 @@
 #include <string>
 #include <filesystem>
 #include <functional>
+#include <future>
+#include <unordered_map>
 #include <vector>
 
 /* 
@@ -83,6 +85,171 @@ namespace donut::vfs
         [[nodiscard]] size_t size() const override;
     };
 
+    // Blob that references a read-only memory mapping of an entire file.
+    // The file contents are paged in by the OS on access and never copied into the process heap.
+    // The mapping is released when the blob is deleted.
+    class MappedFileBlob : public IBlob
+    {
+    private:
+        void* m_data = nullptr;
+        size_t m_size = 0;
+#ifdef WIN32
+        void* m_mappingHandle = nullptr;
+#endif
+
+        MappedFileBlob() = default;
+
+    public:
+        // Maps the file into memory. Returns nullptr if the file cannot be opened or mapped, or if it's empty.
+        static std::shared_ptr<MappedFileBlob> create(const std::filesystem::path& name);
+
+        ~MappedFileBlob() override;
+        [[nodiscard]] const void* data() const override;
+        [[nodiscard]] size_t size() const override;
+
+        MappedFileBlob(const MappedFileBlob&) = delete;
+        MappedFileBlob& operator=(const MappedFileBlob&) = delete;
+    };
+
+    // Blob that references a part of another blob, such as a file in a mapped archive, and keeps that blob alive.
+    class BlobView : public IBlob
+    {
+    private:
+        std::shared_ptr<IBlob> m_parent;
+        const void* m_data;
+        size_t m_size;
+
+    public:
+        BlobView(std::shared_ptr<IBlob> parent, const void* data, size_t size);
+        [[nodiscard]] const void* data() const override;
+        [[nodiscard]] size_t size() const override;
+    };
+
+    // Priority of asynchronous read requests. Requests with a higher priority are started first.
+    enum class ReadPriority : uint8_t
+    {
+        Low,
+        Normal,
+        High
+    };
+
+    // Receives the file contents, or nullptr if the file cannot be read.
+    typedef std::function<void(std::shared_ptr<IBlob>)> read_callback_t;
+
+    struct AsyncReadRequest
+    {
+        std::filesystem::path name;
+        read_callback_t callback;
+        ReadPriority priority = ReadPriority::Normal;
+    };
+
+    // A pool of threads that run blocking reads in the background, ordered by priority and then by submission.
+    // The default implementation of IFileSystem::readFilesAsync submits its reads to the queue returned by getDefault().
+    class IAsyncReadQueue
+    {
+    public:
+        // Runs all submitted tasks to completion and stops the threads.
+        virtual ~IAsyncReadQueue() = default;
+
+        virtual void submit(std::function<void()> task, ReadPriority priority = ReadPriority::Normal) = 0;
+
+        [[nodiscard]] virtual uint32_t getNumThreads() const = 0;
+
+        // Starts a new queue. Zero threads means a default number based on the CPU count.
+        static std::unique_ptr<IAsyncReadQueue> create(uint32_t numThreads = 0);
+
+        // Returns the process-wide queue used by file systems that don't implement asynchronous reads natively.
+        static IAsyncReadQueue& getDefault();
+    };
+
+    // Compiled form of the file search done by enumerateFiles. Matches the names of files that are located
+    // directly in 'path' and end with one of the 'extensions', or all files in 'path' if there are no extensions.
+    // The path and the extensions can contain wildcards: '?' matches zero or one character, and '*' matches
+    // one or more characters. Wildcards never match '/'. The syntax is the same as in getFileSearchRegex,
+    // but matching doesn't use std::regex and is much faster.
+    class FileSearchPattern
+    {
+    private:
+        struct GlobToken
+        {
+            enum class Type : uint8_t { Literal, Optional, One, Star };
+            Type type;
+            char character;
+        };
+
+        struct Glob
+        {
+            std::vector<GlobToken> tokens;
+            std::string literalSuffix; // set if the glob is a '*' followed only by literal characters
+            bool isSuffixGlob = false;
+        };
+
+        std::string m_Path;
+        Glob m_PathGlob;
+        std::vector<Glob> m_FileNameGlobs;
+        bool m_PathHasWildcards = false;
+
+        static Glob compileGlob(std::string_view pattern);
+        static bool matchGlob(const Glob& glob, std::string_view text);
+
+    public:
+        FileSearchPattern(const std::filesystem::path& path, const std::vector<std::string>& extensions);
+
+        // Tests if the path of a file, relative to the root of the file system, matches the pattern.
+        [[nodiscard]] bool match(std::string_view name) const;
+
+        // Tests if the path of a directory matches the path part of the pattern.
+        [[nodiscard]] bool matchDirectory(std::string_view path) const;
+
+        // Tests if a file name without the directory matches one of the extensions.
+        [[nodiscard]] bool matchFileName(std::string_view fileName) const;
+
+        // Returns the normalized path of the pattern without leading or trailing slashes, or an empty string for the root.
+        [[nodiscard]] const std::string& getPath() const { return m_Path; }
+
+        // Returns true if the path contains wildcards and can match multiple directories.
+        [[nodiscard]] bool pathHasWildcards() const { return m_PathHasWildcards; }
+    };
+
+    // Lists of the files and directories in an archive, grouped by the parent directory and sorted by name.
+    // Archive file systems use it to find directories and enumerate their contents without scanning all entries.
+    // Paths are relative to the archive root and use '/' as the separator, the root itself is an empty string.
+    class DirectoryIndex
+    {
+    private:
+        struct Directory
+        {
+            std::vector<std::string> files;
+            std::vector<std::string> subdirectories;
+        };
+
+        std::unordered_map<std::string, Directory> m_Directories;
+        std::string m_LastDirectoryPath; // archives usually list the files of one directory together
+        Directory* m_LastDirectory = nullptr;
+
+        Directory& addDirectoryAndParents(std::string_view path);
+        Directory& findOrAddDirectory(std::string_view path);
+
+    public:
+        // Adds a file and all its parent directories. The path must be normalized, like "textures/wall.dds".
+        // The index must be finalized after adding all files.
+        void addFile(std::string_view path);
+
+        // Adds a directory and all its parent directories, which is only necessary for empty directories.
+        void addDirectory(std::string_view path);
+
+        // Sorts the lists and removes duplicate names.
+        void finalize();
+
+        void clear();
+
+        [[nodiscard]] bool directoryExists(const std::filesystem::path& path) const;
+
+        // Implementations of IFileSystem::enumerateFiles and enumerateDirectories, the results are sorted by name.
+        int enumerateFiles(const FileSearchPattern& pattern, enumerate_callback_t callback) const;
+        int enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback) const;
+    };
+
     // Basic interface for the virtual file system.
     class IFileSystem
     {
@@ -99,10 +266,44 @@ namespace donut::vfs
         // Returns nullptr if the file cannot be read.
         virtual std::shared_ptr<IBlob> readFile(const std::filesystem::path& name) = 0;
 
+        // Read the entire file, avoiding a copy into the process heap if the file system supports it,
+        // for example by memory-mapping the file. The blob keeps the file mapped until it's deleted.
+        // The default implementation just calls readFile.
+        // Returns nullptr if the file cannot be read.
+        virtual std::shared_ptr<IBlob> mapFile(const std::filesystem::path& name) { return readFile(name); }
+
+        // Read 'size' bytes of the file starting at 'offset', or fewer bytes if the file ends before that.
+        // Returns nullptr if the file cannot be read or 'offset' is past the end of the file.
+        // The default implementation reads the entire file and copies the range.
+        virtual std::shared_ptr<IBlob> readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size);
+
+        // Get the size of the file in bytes, without reading it if the file system supports that.
+        // Returns false if the file cannot be read.
+        // The default implementation reads the entire file.
+        virtual bool getFileSize(const std::filesystem::path& name, uint64_t& size);
+
+        // Start reading the files in the background.
+        // The callback of every request is called once, usually on a background thread, and possibly
+        // before this function returns. The file system must stay alive until all callbacks are called.
+        // The default implementation calls readFile for every request on the default AsyncReadQueue.
+        virtual void readFilesAsync(std::vector<AsyncReadRequest> requests);
+
+        // Start reading one file in the background, see readFilesAsync.
+        void readFileAsync(const std::filesystem::path& name, read_callback_t callback, ReadPriority priority = ReadPriority::Normal);
+
+        // Start reading one file in the background and return a future for its contents, see readFilesAsync.
+        std::future<std::shared_ptr<IBlob>> readFileAsync(const std::filesystem::path& name, ReadPriority priority = ReadPriority::Normal);
+
         // Write the entire file.
         // Returns false if the file cannot be written.
         virtual bool writeFile(const std::filesystem::path& name, const void* data, size_t size) = 0;
 
+        // Write the entire file so that readers see either the old or the new contents, never a partial file.
+        // Blobs mapped from the old file keep their contents where the file system supports it.
+        // The default implementation just calls writeFile.
+        // Returns false if the file cannot be written, in which case the old file is left unchanged.
+        virtual bool writeFileAtomic(const std::filesystem::path& name, const void* data, size_t size) { return writeFile(name, data, size); }
+
         // Search for files with any of the provided 'extensions' in 'path'.
         // Extensions should not include any wildcard characters.
         // Returns the number of files found, or a negative number on errors - see donut::vfs::status.
@@ -113,16 +314,32 @@ namespace donut::vfs
         // Returns the number of directories found, or a negative number on errors - see donut::vfs::status.
         // The directory names, relative to the 'path', are passed to 'callback' in no particular order.
         virtual int enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback, bool allowDuplicates = false) = 0;
+
+    protected:
+        // Copies a range of the data into a new blob, using the same rules as readFileRange.
+        static std::shared_ptr<IBlob> copyBlobRange(const void* data, size_t dataSize, uint64_t offset, size_t size);
     };
 
     // An implementation of virtual file system that directly maps to the OS files.
     class NativeFileSystem : public IFileSystem
     {
+    private:
+        size_t m_MappingThreshold = 0;
+
     public:
+        // Makes readFile return memory-mapped blobs for files of at least 'bytes' in size, see MappedFileBlob.
+        // Mapped files are not copied into the heap, but they must not be modified while the blob exists.
+        // Zero disables mapping in readFile, which is the default.
+        void setMappingThreshold(size_t bytes) { m_MappingThreshold = bytes; }
+
 		bool folderExists(const std::filesystem::path& name) override;
         bool fileExists(const std::filesystem::path& name) override;
         std::shared_ptr<IBlob> readFile(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> mapFile(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size) override;
+        bool getFileSize(const std::filesystem::path& name, uint64_t& size) override;
         bool writeFile(const std::filesystem::path& name, const void* data, size_t size) override;
+        bool writeFileAtomic(const std::filesystem::path& name, const void* data, size_t size) override;
         int enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates = false) override;
         int enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback, bool allowDuplicates = false) override;
     };
@@ -143,17 +360,30 @@ namespace donut::vfs
         bool folderExists(const std::filesystem::path& name) override;
         bool fileExists(const std::filesystem::path& name) override;
         std::shared_ptr<IBlob> readFile(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> mapFile(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size) override;
+        bool getFileSize(const std::filesystem::path& name, uint64_t& size) override;
+        void readFilesAsync(std::vector<AsyncReadRequest> requests) override;
         bool writeFile(const std::filesystem::path& name, const void* data, size_t size) override;
+        bool writeFileAtomic(const std::filesystem::path& name, const void* data, size_t size) override;
         int enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates = false) override;
         int enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback, bool allowDuplicates = false) override;
     };
 
     // A virtual file system that allows mounting, or attaching, other VFS objects to paths.
     // Does not have any file systems by default, all of them must be mounted first.
+    // Mount points are stored in a tree of path components, so finding the file system for a path
+    // takes time proportional to the depth of the path and not to the number of mount points.
     class RootFileSystem : public IFileSystem
     {
     private:
-        std::vector<std::pair<std::string, std::shared_ptr<IFileSystem>>> m_MountPoints;
+        struct MountNode
+        {
+            std::shared_ptr<IFileSystem> fs;
+            std::unordered_map<std::string, std::unique_ptr<MountNode>> children;
+        };
+
+        MountNode m_MountTree;
 
         bool findMountPoint(const std::filesystem::path& path, std::filesystem::path* pRelativePath, IFileSystem** ppFS);
     public:
@@ -164,10 +394,16 @@ namespace donut::vfs
 		bool folderExists(const std::filesystem::path& name) override;
         bool fileExists(const std::filesystem::path& name) override;
         std::shared_ptr<IBlob> readFile(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> mapFile(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size) override;
+        bool getFileSize(const std::filesystem::path& name, uint64_t& size) override;
+        void readFilesAsync(std::vector<AsyncReadRequest> requests) override;
         bool writeFile(const std::filesystem::path& name, const void* data, size_t size) override;
+        bool writeFileAtomic(const std::filesystem::path& name, const void* data, size_t size) override;
         int enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates = false) override;
         int enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback, bool allowDuplicates = false) override;
     };
 
+    // Returns a regular expression with the same meaning as FileSearchPattern.
     std::string getFileSearchRegex(const std::filesystem::path& path, const std::vector<std::string>& extensions);
 }
\ No newline at end of file
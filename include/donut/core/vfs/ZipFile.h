@@ -23,9 +23,7 @@
 #pragma once
 
 #include <donut/core/vfs/VFS.h>
-#include <mutex>
 #include <unordered_map>
-#include <unordered_set>
 
 namespace donut::vfs
 {
@@ -33,35 +31,50 @@ namespace donut::vfs
     A read-only file system that provides access to files in a zip archive.
     ZipFile can only operate on real files, i.e. underlying virtual file systems are not supported.
 
+    The archive is memory-mapped, and the central directory is parsed once when the archive
+    is opened. Reading a file doesn't use any shared decompressor state, so files can be
+    read and inflated on multiple threads concurrently, for example with readFilesAsync.
+    Stored (uncompressed) files are returned as views into the mapping without copying.
+    Only stored and deflated files are supported, and encrypted files are not.
+
     Note: zip file support is provided because it's a ubiquitous standard. Reading large assets
-    from zip files is very slow compared to other storage methods. Donut supports reading assets
-    compressed with LZ4 and stored in tar archives, which is significantly faster, in part because 
-    such files can be decompressed in parallel. See the TarFile and CompressionLayer classes.
+    from zip files is slow compared to other storage methods because every file is inflated on
+    one thread. Donut supports reading assets compressed with LZ4 and stored in tar archives,
+    which is significantly faster, in part because large files can be decompressed in parallel.
+    See the TarFile and CompressionLayer classes.
     */
     class ZipFile : public IFileSystem
     {
     private:
-        std::string m_ArchivePath;
-        std::mutex m_Mutex;
+        struct FileEntry
+        {
+            uint64_t localHeaderOffset;
+            uint64_t compressedSize;
+            uint64_t uncompressedSize;
+            uint32_t method;
+            uint32_t crc; // not 'crc32', which miniz.h defines as a zlib compatibility macro
+        };
 
-        // mz_zip_archive* really
-        // void* because we don't want to include miniz here and can't forward declare the mz_aip_archive struct
-        void* m_ZipArchive = nullptr;
+        std::string m_ArchivePath;
+        std::shared_ptr<MappedFileBlob> m_Mapping;
         
-        std::unordered_map<std::string, uint32_t> m_Files; // name -> index in zip file
-        std::unordered_set<std::string> m_Directories;
+        std::unordered_map<std::string, FileEntry> m_Files;
+        DirectoryIndex m_Index;
 
-        void close();
+        const FileEntry* findFile(const std::filesystem::path& name) const;
+        const uint8_t* getFileData(const FileEntry& entry, const std::string& name) const;
+        std::shared_ptr<IBlob> inflateFile(const FileEntry& entry, const uint8_t* data, const std::string& name) const;
         
     public:
         ZipFile(const std::filesystem::path& archivePath);
-        ~ZipFile() override;
 
         [[nodiscard]] bool isOpen() const;
         
         bool folderExists(const std::filesystem::path& name) override;
         bool fileExists(const std::filesystem::path& name) override;
         std::shared_ptr<IBlob> readFile(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size) override;
+        bool getFileSize(const std::filesystem::path& name, uint64_t& size) override;
         bool writeFile(const std::filesystem::path& name, const void* data, size_t size) override;
         int enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates = false) override;
         int enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback, bool allowDuplicates = false) override;
@@ -0,0 +1,88 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/chunk/chunkFile.h>
+#include <memory>
+#include <filesystem>
+
+namespace donut::vfs
+{
+    class IFileSystem;
+}
+
+namespace donut::engine
+{
+    struct SceneImportResult;
+    class SceneTypeFactory;
+    class TextureCache;
+}
+
+namespace tf
+{
+    class Executor;
+}
+
+namespace donut::engine
+{
+    // Loads and saves models in the native chunk format (.donutmesh files, see donut/core/chunk/chunk.h).
+    //
+    // The vertex and index streams of a chunk MeshSet are stored in the same layout as BufferGroup
+    // (float3 positions, snorm8-packed normals and tangents, float2 texture coordinates, indices relative
+    // to the first vertex of each geometry), so loading a model is a bulk copy of each stream.
+    //
+    // Every chunk mesh info describes one MeshGeometry. A MeshInfo with several geometries is stored as
+    // a run of consecutive mesh infos, and each node that uses the mesh has a run of consecutive chunk
+    // mesh instances referencing them. The material parameters and texture file paths are stored as
+    // JSON in a materials chunk; textures are referenced relative to the chunk file when possible.
+    // Files without a materials chunk get one default Material per distinct material name.
+    class ChunkImporter
+    {
+    protected:
+        std::shared_ptr<vfs::IFileSystem> m_fs;
+        std::shared_ptr<SceneTypeFactory> m_SceneTypeFactory;
+
+    public:
+        explicit ChunkImporter(std::shared_ptr<vfs::IFileSystem> fs, std::shared_ptr<SceneTypeFactory> sceneTypeFactory);
+
+        // Textures are loaded through 'textureCache', asynchronously when 'executor' is provided.
+        // Files written with older chunk layouts are upgraded in memory; use chunk::open to upgrade them on disk.
+        bool Load(
+            const std::filesystem::path& fileName,
+            TextureCache& textureCache,
+            tf::Executor* executor,
+            SceneImportResult& result) const;
+
+        // Writes the meshes, mesh instances and node hierarchy of a loaded model into a chunk file.
+        // Use this to convert glTF models: load them with GltfImporter, then save the result here.
+        // Skinned meshes, morph targets, curves and line geometry have no chunk representation and are skipped.
+        // Models whose materials use textures that are not files (e.g. embedded in .glb files) cannot be saved.
+        // The chunks are compressed with 'codec', which makes the files 2-6x smaller; loading them decompresses
+        // the chunks on multiple threads.
+        bool Save(
+            const std::filesystem::path& fileName,
+            const SceneImportResult& model,
+            chunk::ChunkCodec codec = chunk::ChunkCodec::None,
+            int compressionLevel = 0) const;
+    };
+}
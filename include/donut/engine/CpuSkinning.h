@@ -0,0 +1,57 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <cstdint>
+
+namespace tf
+{
+    class Executor;
+}
+
+namespace donut::engine
+{
+    struct BufferGroup;
+    class SkinnedMeshInstance;
+
+    // CPU implementation of the skinning pass in skinning_cs.hlsl, for validating and profiling skinning
+    // without a GPU and for CPU-side ray casting or picking against skinned meshes.
+    // The input streams are positionData, normalData, tangentData, texcoord1Data, texcoord2Data, jointData
+    // and weightData, and the output streams are positionData, prevPositionData, normalData, tangentData,
+    // texcoord1Data and texcoord2Data. The normals and tangents are skinned and written when the input has them,
+    // and the texture coordinates are copied. The results are the same as the shader up to float rounding.
+    // The vertices are processed with SSE2 when it is available, and split into tasks on the executor if provided.
+
+    // Skins the input vertices [firstVertex, firstVertex + vertexCount) into the output vertices [0, vertexCount).
+    // The previous positions are the output positions before the call, or the new positions if the output
+    // doesn't have vertexCount positions yet, which is the first frame of the shader.
+    // Joint indices outside of [0, jointCount) are ignored. Returns false if the input streams are too short.
+    bool SkinVertices(const BufferGroup& input, uint32_t firstVertex, uint32_t vertexCount,
+        const dm::float4x4* jointMatrices, size_t jointCount, BufferGroup& output, tf::Executor* executor = nullptr);
+
+    // Computes the joint matrices of the instance like Scene::UpdateSkinnedMeshes and skins the vertices
+    // of its prototype mesh into 'output'. The CPU streams of the prototype are released by Scene when
+    // the mesh buffers are uploaded, so this is meant for scenes that are not rendered through Scene.
+    bool SkinVertices(const SkinnedMeshInstance& instance, BufferGroup& output, tf::Executor* executor = nullptr);
+}
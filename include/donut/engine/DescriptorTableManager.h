@@ -96,6 +96,7 @@ namespace donut::engine
         std::vector<nvrhi::BindingSetItem> m_Descriptors;
         std::unordered_map<nvrhi::BindingSetItem, DescriptorIndex, BindingSetItemHasher, BindingSetItemsEqual> m_DescriptorIndexMap;
         std::vector<bool> m_AllocatedDescriptors;
+        std::vector<uint32_t> m_DescriptorRefCounts;
         int m_SearchStart = 0;
         
     public:
@@ -104,6 +105,8 @@ namespace donut::engine
         
         nvrhi::IDescriptorTable* GetDescriptorTable() const { return m_DescriptorTable; }
 
+        // Creates a descriptor for the item, or returns the index of an existing identical descriptor.
+        // Descriptors are reference counted: every call must be matched by a ReleaseDescriptor call.
         DescriptorIndex CreateDescriptor(nvrhi::BindingSetItem item);
         DescriptorHandle CreateDescriptorHandle(nvrhi::BindingSetItem item);
         nvrhi::BindingSetItem GetDescriptor(DescriptorIndex index);
@@ -48,14 +48,27 @@ namespace tf
 
 namespace donut::engine
 {
+    // Error tolerances for compressing the imported animations, see animation::Sampler::Compress.
+    struct AnimationCompressionSettings
+    {
+        bool enabled = false;
+        float translationTolerance = 1e-4f; // in scene units
+        float rotationTolerance = 1e-4f;    // in radians
+        float scalingTolerance = 1e-4f;
+    };
+
     class GltfImporter
     {   
     protected:
         std::shared_ptr<vfs::IFileSystem> m_fs;
         std::shared_ptr<SceneTypeFactory> m_SceneTypeFactory;
+        AnimationCompressionSettings m_AnimationCompression;
         
     public:
         explicit GltfImporter(std::shared_ptr<vfs::IFileSystem> fs, std::shared_ptr<SceneTypeFactory> sceneTypeFactory);
+
+        void SetAnimationCompression(const AnimationCompressionSettings& settings) { m_AnimationCompression = settings; }
+        [[nodiscard]] const AnimationCompressionSettings& GetAnimationCompression() const { return m_AnimationCompression; }
         
         bool Load(
             const std::filesystem::path& fileName,
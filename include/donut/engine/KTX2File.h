@@ -0,0 +1,35 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+namespace donut::engine
+{
+    struct TextureData;
+
+    // Initializes the TextureInfo from the 'data' array, which must be populated with KTX2 data.
+    // Supported payloads:
+    //  - Regular Vulkan formats that map to NVRHI formats, uncompressed or supercompressed with Zstandard or zlib;
+    //  - Basis Universal ETC1S (BasisLZ) and UASTC payloads, transcoded to BC7, or to BC1 for ETC1S without alpha.
+    // When the payload needs to be decompressed or transcoded, 'data' is replaced with a new blob.
+    bool LoadKTX2TextureFromMemory(TextureData& textureInfo);
+}
@@ -57,21 +57,88 @@ namespace donut::engine::animation
         const Keyframe& a, const Keyframe& b,
         const Keyframe& c, const Keyframe& d, float t, float dt);
 
+    // Remembers the keyframe interval used by the last evaluation of a sampler. Evaluating at the
+    // same or the next interval, which is the common case during playback, then skips the search.
+    struct SamplerCursor
+    {
+        size_t interval = 0;
+    };
+
+    // Keyframes of a sampler in the compact form produced by Sampler::Compress.
+    // The keyframe times are 16-bit multiples of timeStep. The values are stored
+    // depending on the encoding, and only for the components in componentMask, the other components
+    // have the same value in all keyframes and are stored once in 'offset'.
+    struct CompressedKeyframes
+    {
+        enum class Encoding : uint8_t
+        {
+            Quantized,  // value = offset + q * scale, 16 bits per component
+            Quaternion, // normalized quaternion, 3 smallest components in 48 bits
+            Float       // 32 bits per component, used when quantization exceeds the tolerance
+        };
+
+        Encoding encoding = Encoding::Quantized;
+        uint8_t componentMask = 0;
+        uint8_t componentCount = 0; // number of values stored per keyframe
+        float startTime = 0.f;
+        float timeStep = 0.f;
+        dm::float4 offset = 0.f;
+        dm::float4 scale = 0.f;
+        std::vector<uint16_t> times;
+        std::vector<uint16_t> values;
+        std::vector<float> floatValues;
+
+        [[nodiscard]] size_t GetKeyframeCount() const { return times.size(); }
+        [[nodiscard]] float GetTime(size_t index) const { return startTime + float(times[index]) * timeStep; }
+        [[nodiscard]] dm::float4 GetValue(size_t index) const;
+        [[nodiscard]] size_t GetMemoryUsage() const;
+    };
+
     class Sampler
     {
     protected:
         std::vector<Keyframe> m_Keyframes;
         InterpolationMode m_Mode = InterpolationMode::Step;
+        std::shared_ptr<const CompressedKeyframes> m_Compressed; // replaces m_Keyframes when set
+
+        std::optional<dm::float4> EvaluateCompressed(float time, SamplerCursor& cursor, bool extrapolateLastValues) const;
 
     public:
         Sampler() = default;
         virtual ~Sampler() = default;
 
+        // Random access evaluation, uses a binary search over the keyframes.
         std::optional<dm::float4> Evaluate(float time, bool extrapolateLastValues = false) const;
 
+        // Sequential evaluation, starts the search from the cursor and updates it.
+        // A cursor can be used with any sampler, but works best when it's always used with the same one.
+        std::optional<dm::float4> Evaluate(float time, SamplerCursor& cursor, bool extrapolateLastValues = false) const;
+
+        // Returns the uncompressed keyframes, which is an empty array for compressed samplers.
         [[nodiscard]] std::vector<Keyframe>& GetKeyframes() { return m_Keyframes; }
+        [[nodiscard]] const std::vector<Keyframe>& GetKeyframes() const { return m_Keyframes; }
+        // Adds a keyframe, decompressing the sampler first if necessary.
         void AddKeyframe(const Keyframe keyframe);
 
+        // Returns the keyframes of the sampler, decoding them if the sampler is compressed.
+        [[nodiscard]] std::vector<Keyframe> DecodeKeyframes() const;
+        [[nodiscard]] size_t GetKeyframeCount() const { return m_Compressed ? m_Compressed->GetKeyframeCount() : m_Keyframes.size(); }
+
+        // Replaces the keyframes with a compressed representation: components that never change are stored once,
+        // keyframes that can be interpolated from the neighbors are removed, and the remaining times and values
+        // are quantized. The keyframe times are exact for uniformly sampled keyframes, and quantized to 1/65535
+        // of the duration otherwise. At the keyframe times, the compressed sampler differs from the original
+        // keyframe values by at most 'tolerance', which is the rotation angle in radians for Slerp samplers,
+        // and the difference in every component for other samplers. Only Step, Linear and Slerp samplers
+        // are supported. Returns false if the sampler could not be compressed and was left unchanged.
+        bool Compress(float tolerance);
+        void Decompress();
+        [[nodiscard]] bool IsCompressed() const { return m_Compressed != nullptr; }
+        [[nodiscard]] const std::shared_ptr<const CompressedKeyframes>& GetCompressedKeyframes() const { return m_Compressed; }
+
+        // Returns the size of the keyframe storage in bytes.
+        [[nodiscard]] size_t GetMemoryUsage() const;
+
         [[nodiscard]] InterpolationMode GetMode() const { return m_Mode; }
         void SetInterpolationMode(InterpolationMode mode) { m_Mode = mode; }
 
@@ -81,6 +148,46 @@ namespace donut::engine::animation
         void Load(Json::Value& node);
     };
 
+    // Evaluates many samplers at once, for example all the channels of the animations in a scene.
+    // The keyframes are copied into flat arrays with the times, values and tangents stored separately,
+    // so that the interval search only touches the times, and every sampler has its own cursor.
+    // Changes made to the samplers after they have been added are not reflected in the batch.
+    // Compressed samplers are decoded when they are added.
+    class SamplerBatch
+    {
+    private:
+        struct Track
+        {
+            uint32_t firstKeyframe = 0;
+            uint32_t keyframeCount = 0;
+            uint32_t firstTangent = 0; // in m_InTangents and m_OutTangents, only HermiteSpline tracks have tangents
+            InterpolationMode mode = InterpolationMode::Step;
+            SamplerCursor cursor;
+        };
+
+        std::vector<Track> m_Tracks;
+        std::vector<float> m_Times;
+        std::vector<dm::float4> m_Values;
+        std::vector<dm::float4> m_InTangents;
+        std::vector<dm::float4> m_OutTangents;
+
+    public:
+        // Adds a copy of the sampler and returns its index in the batch.
+        size_t AddSampler(const Sampler& sampler);
+
+        [[nodiscard]] size_t GetSamplerCount() const { return m_Tracks.size(); }
+
+        // Evaluates the samplers [first, first + count) like Sampler::Evaluate and writes the results
+        // into results[0, count). Calls with disjoint ranges of samplers can run concurrently.
+        void Evaluate(float time, size_t first, size_t count, std::optional<dm::float4>* results, bool extrapolateLastValues = false);
+
+        // Evaluates all samplers, results must have GetSamplerCount() elements.
+        void Evaluate(float time, std::optional<dm::float4>* results, bool extrapolateLastValues = false)
+        {
+            Evaluate(time, 0, GetSamplerCount(), results, extrapolateLastValues);
+        }
+    };
+
     class Sequence
     {
     protected:
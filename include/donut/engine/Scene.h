@@ -51,6 +51,7 @@ namespace donut::engine
     class TextureCache;
     class DescriptorTableManager;
     class GltfImporter;
+    class ChunkImporter;
     
     class Scene
     {
@@ -61,6 +62,7 @@ namespace donut::engine
         std::shared_ptr<DescriptorTableManager> m_DescriptorTable;
         std::shared_ptr<SceneGraph> m_SceneGraph;
         std::shared_ptr<GltfImporter> m_GltfImporter;
+        std::shared_ptr<ChunkImporter> m_ChunkImporter;
         std::vector<SceneImportResult> m_Models;
         bool m_EnableBindlessResources = false;
         
@@ -77,6 +79,8 @@ namespace donut::engine
         bool m_SceneTransformsChanged = false;
         bool m_SceneStructureChanged = false;
 
+        std::vector<dm::affine3> m_InstanceTransforms;
+
         struct Resources; // Hide the implementation to avoid including <material_cb.h> and <bindless.h> here
         std::shared_ptr<Resources> m_Resources;
 
@@ -97,6 +101,7 @@ namespace donut::engine
         void UpdateMaterial(const std::shared_ptr<Material>& material);
         void UpdateGeometry(const std::shared_ptr<MeshInfo>& mesh);
         void UpdateInstance(const std::shared_ptr<MeshInstance>& instance);
+        void UpdateInstanceTransforms(tf::Executor* executor);
 
         void UpdateSkinnedMeshes(nvrhi::ICommandList* commandList, uint32_t frameIndex);
 
@@ -128,10 +133,11 @@ namespace donut::engine
         void RefreshSceneGraph(uint32_t frameIndex);
 
         // Creates missing buffers, uploads vertex buffers, instance data, materials, etc.
-        void RefreshBuffers(nvrhi::ICommandList* commandList, uint32_t frameIndex);
+        // The instance transforms of large scenes are converted in parallel on the executor, if there is one.
+        void RefreshBuffers(nvrhi::ICommandList* commandList, uint32_t frameIndex, tf::Executor* executor = nullptr);
 
         // A combination of RefreshSceneGraph and RefreshBuffers
-        void Refresh(nvrhi::ICommandList* commandList, uint32_t frameIndex);
+        void Refresh(nvrhi::ICommandList* commandList, uint32_t frameIndex, tf::Executor* executor = nullptr);
 
         bool Load(const std::filesystem::path& jsonFileName);
 
@@ -32,6 +32,11 @@
 #include <filesystem>
 #include <stack>
 
+namespace tf
+{
+    class Executor;
+}
+
 namespace donut::engine
 {
     class SceneGraph;
@@ -127,6 +132,11 @@ namespace donut::engine
         [[nodiscard]] const std::shared_ptr<MeshInfo>& GetPrototypeMesh() const { return m_PrototypeMesh; }
         [[nodiscard]] uint32_t GetLastUpdateFrameIndex() const { return m_LastUpdateFrameIndex; }
         [[nodiscard]] std::shared_ptr<SceneGraphLeaf> Clone() override;
+
+        // Computes the skinning matrix of every joint, inverseBindMatrix * jointToRoot, where jointToRoot
+        // is the transform from the joint node to the node of this instance. The matrices are relative
+        // to the root in double precision. Joints whose nodes have been destroyed use an identity transform.
+        void ComputeJointMatrices(dm::float4x4* jointMatrices) const;
     };
 
     // This leaf is attached to the joint nodes for a skeleton, and it makes them point at the mesh.
@@ -265,6 +275,7 @@ namespace donut::engine
 
     private:
         friend class SceneGraph;
+        friend class SceneGraphAnimator;
         std::weak_ptr<SceneGraph> m_Graph;
         SceneGraphNode* m_Parent = nullptr;
         std::vector<std::shared_ptr<SceneGraphNode>> m_Children;
@@ -407,6 +418,7 @@ namespace donut::engine
         std::weak_ptr<Material> m_TargetMaterial;
         AnimationAttribute m_Attribute;
         std::string m_LeafPropertyName;
+        mutable animation::SamplerCursor m_Cursor;
 
     public:
         SceneGraphAnimationChannel(std::shared_ptr<animation::Sampler> sampler, const std::shared_ptr<SceneGraphNode>& targetNode, AnimationAttribute attribute)
@@ -448,6 +460,60 @@ namespace donut::engine
         void AddChannel(const std::shared_ptr<SceneGraphAnimationChannel>& channel);
     };
 
+    // Applies many animations at once. The channel targets are resolved when an animation is added,
+    // and the transform channels are evaluated through an animation::SamplerBatch, in parallel if an
+    // executor is provided, and then written into the nodes in a single serial pass.
+    // Channels that target leaf or material properties are applied through SceneGraphAnimationChannel::Apply.
+    // The animator keeps its own copies of the samplers, so it must be rebuilt when the animations are modified.
+    class SceneGraphAnimator
+    {
+    private:
+        struct TransformChannel
+        {
+            uint32_t targetIndex = 0; // in m_Targets
+            AnimationAttribute attribute = AnimationAttribute::Undefined;
+        };
+
+        struct Target
+        {
+            SceneGraphNode* node = nullptr; // only dereferenced when 'ref' has not expired
+            std::weak_ptr<SceneGraphNode> ref;
+        };
+
+        // A range of transform channels from one animation, evaluated by one task
+        struct Range
+        {
+            uint32_t animationIndex = 0;
+            uint32_t firstChannel = 0;
+            uint32_t channelCount = 0;
+        };
+
+        animation::SamplerBatch m_Samplers;
+        std::vector<TransformChannel> m_Channels; // parallel to the samplers in m_Samplers
+        std::vector<Range> m_Ranges;
+        std::vector<Target> m_Targets;
+        std::unordered_map<SceneGraphNode*, uint32_t> m_TargetIndices;
+        std::vector<std::vector<std::shared_ptr<SceneGraphAnimationChannel>>> m_PropertyChannels; // per animation
+        std::vector<std::optional<dm::float4>> m_Values;
+        std::vector<uint8_t> m_TargetAlive;
+        std::vector<float> m_Times;
+
+        void EvaluateRange(const Range& range, const float* times);
+
+    public:
+        // Resolves the channels of the animation and returns its index in the animator.
+        size_t AddAnimation(const std::shared_ptr<SceneGraphAnimation>& animation);
+
+        [[nodiscard]] size_t GetAnimationCount() const { return m_PropertyChannels.size(); }
+        [[nodiscard]] size_t GetTransformChannelCount() const { return m_Channels.size(); }
+
+        // Applies all animations at the same time. Returns false if any channel could not be applied.
+        bool Apply(float time, tf::Executor* executor = nullptr);  // NOLINT(modernize-use-nodiscard)
+
+        // Applies every animation at its own time, 'times' must have GetAnimationCount() elements.
+        bool Apply(const float* times, tf::Executor* executor = nullptr);  // NOLINT(modernize-use-nodiscard)
+    };
+
     // A container that tracks unique resources of the same type used by some entity, for example unique meshes used in a scene graph.
     // It works by putting the resource shared pointers into a map and associating a reference count with each resource.
     // When the resource is added and released an equal number of times, its refrence count reaches zero, and it's removed from the container.
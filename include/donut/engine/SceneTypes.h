@@ -204,6 +204,7 @@ namespace donut::engine
         std::vector<nvrhi::BufferRange> morphTargetBufferRange;
         std::vector<uint32_t> indexData;
         std::vector<dm::float3> positionData;
+        std::vector<dm::float3> prevPositionData; // only written by the CPU skinning, see CpuSkinning.h
         std::vector<dm::float2> texcoord1Data;
         std::vector<dm::float2> texcoord2Data;
         std::vector<uint32_t> normalData;
@@ -74,6 +74,42 @@ namespace donut::engine
 
         // ArraySlice -> MipLevel -> TextureSubresourceData
         std::vector<std::vector<TextureSubresourceData>> dataLayout;
+
+        // Hash of the decoded texture contents, only computed when content deduplication is enabled
+        uint64_t contentHash = 0;
+
+        // Previously loaded texture with the same contents, whose GPU texture and descriptor will be shared
+        std::shared_ptr<TextureData> contentOwner;
+
+        // Set when a thread starts uploading the texture, so that it's never uploaded twice.
+        // Guarded by the texture cache's upload mutex, like the publication of the 'texture' handle.
+        bool uploadStarted = false;
+    };
+
+    // State of a texture that is being uploaded to the GPU one subresource at a time
+    struct TextureUpload
+    {
+        std::shared_ptr<TextureData> texture;
+
+        // Texture being uploaded. It is only published in texture->texture and the bindless descriptor table
+        // by EndTextureUpload, so that nothing binds it while some of its subresources are still in flight.
+        nvrhi::TextureHandle finalTexture;
+
+        // Texture that receives the subresource data: either finalTexture,
+        // or a temporary texture that is downscaled into finalTexture after the upload
+        nvrhi::TextureHandle destination;
+
+        // State of the destination texture at the end of the last command list that used it
+        nvrhi::ResourceStates destinationState = nvrhi::ResourceStates::Common;
+
+        // Subresources are uploaded in the order of (arraySlice * mipLevels + mipLevel)
+        uint32_t mipLevels = 0;
+        uint32_t nextSubresource = 0;
+        uint32_t numSubresources = 0;
+
+        // Number of block rows of the next subresource that have already been uploaded,
+        // when a subresource larger than the upload budget is copied in parts
+        uint32_t nextRow = 0;
     };
 
     class TextureCache
@@ -81,6 +117,7 @@ namespace donut::engine
     protected:
         nvrhi::DeviceHandle m_Device;
         nvrhi::CommandListHandle m_CommandList;
+        nvrhi::CommandListHandle m_CopyCommandList;
         std::unordered_map<std::string, std::shared_ptr<TextureData>> m_LoadedTextures;
         mutable std::shared_mutex m_LoadedTexturesMutex;
 
@@ -94,14 +131,39 @@ namespace donut::engine
 
         bool m_GenerateMipmaps = true;
 
+        TextureUpload m_CurrentUpload;
+        size_t m_UploadBudgetBytes = 0;
+        size_t m_UploadChunkSize = 0;
+        bool m_UseCopyQueue = false;
+        std::atomic<uint64_t> m_BytesUploaded = 0;
+
+        // Ring of staging textures for the subresources that are uploaded in row ranges, reused across
+        // ProcessRenderingThreadCommands calls. A staging texture is only reused after the command list
+        // that copies from it has been submitted, mapping it then waits until the GPU is done with it.
+        std::vector<nvrhi::StagingTextureHandle> m_StagingTextures;
+        size_t m_NextStagingTexture = 0;
+        size_t m_StagingTexturesRecorded = 0;
+
+        // Textures can be finalized by the synchronous Load* functions on any thread,
+        // and by ProcessRenderingThreadCommands on the rendering thread
+        std::mutex m_TextureUploadMutex;
+
         log::Severity m_InfoLogSeverity = log::Severity::Info;
         log::Severity m_ErrorLogSeverity = log::Severity::Warning;
 
         std::atomic<uint32_t> m_TexturesRequested = 0;
         std::atomic<uint32_t> m_TexturesLoaded = 0;
-        uint32_t m_TexturesFinalized = 0;
+        std::atomic<uint32_t> m_TexturesFinalized = 0;
+
+        bool m_DeduplicateByContent = false;
+        std::unordered_map<uint64_t, std::weak_ptr<TextureData>> m_TexturesByContent;
+        std::mutex m_TexturesByContentMutex;
+        std::atomic<uint32_t> m_TexturesDeduplicated = 0;
+        std::atomic<uint64_t> m_DeduplicatedBytes = 0;
 
         bool FindTextureInCache(const std::filesystem::path& path, std::shared_ptr<TextureData>& texture);
+        void FindTextureContentOwner(const std::shared_ptr<TextureData>& texture);
+        static bool IsMappedTextureFile(const std::filesystem::path& path);
         std::shared_ptr<vfs::IBlob> ReadTextureFile(const std::filesystem::path& path) const;
 
         bool FillTextureData(
@@ -115,6 +177,42 @@ namespace donut::engine
             CommonRenderPasses* passes,
             nvrhi::ICommandList* commandList);
 
+        // The stages of FinalizeTexture, used separately by ProcessRenderingThreadCommands
+        // to spread the uploads of large textures over multiple frames.
+        TextureUpload BeginTextureUpload(
+            const std::shared_ptr<TextureData>& texture,
+            CommonRenderPasses* passes,
+            nvrhi::ICommandList* commandList);
+
+        // Uploads the next subresource, or the next range of its rows if the subresource is larger than maxBytes.
+        // maxBytes = 0 means the whole subresource is always written at once. Returns the number of bytes uploaded.
+        size_t UploadNextSubresource(TextureUpload& upload, nvrhi::ICommandList* commandList, size_t maxBytes = 0);
+
+        void EndTextureUpload(
+            TextureUpload& upload,
+            CommonRenderPasses* passes,
+            nvrhi::ICommandList* commandList);
+
+        // Marks the texture as being uploaded by the calling thread.
+        // Returns false if another thread has already started uploading it.
+        bool ClaimTextureUpload(TextureData& texture);
+
+        // Shares the GPU texture of the content owner with a duplicate texture.
+        // Returns false if the owner hasn't been uploaded yet.
+        bool ShareContentOwnerTexture(const std::shared_ptr<TextureData>& texture);
+
+        // Finalizes a duplicate texture on the rendering thread, uploading its content owner first if necessary.
+        // Returns false if the owner is being uploaded by another thread, in which case the duplicate has to wait.
+        bool FinalizeDuplicateTexture(
+            const std::shared_ptr<TextureData>& texture,
+            CommonRenderPasses* passes,
+            nvrhi::ICommandList* commandList);
+
+        nvrhi::ICommandList* GetUploadCommandList(bool copyQueue);
+
+        // Returns the next staging texture of the ring, at least 'width' by 'height' pixels large.
+        nvrhi::IStagingTexture* AcquireStagingTexture(nvrhi::Format format, uint32_t width, uint32_t height);
+
         virtual void TextureLoaded(std::shared_ptr<TextureData> texture);
         virtual std::shared_ptr<TextureData> CreateTextureData();
 
@@ -142,7 +240,8 @@ namespace donut::engine
             bool sRGB);
 
 #ifdef DONUT_WITH_TASKFLOW
-        // Asynchronous read and decode, deferred upload and mip generation (in the ProcessRenderingThreadCommands queue).
+        // Asynchronous read on the file system's I/O threads, decode on the executor,
+        // deferred upload and mip generation (in the ProcessRenderingThreadCommands queue).
         virtual std::shared_ptr<LoadedTexture> LoadTextureFromFileAsync(
             const std::filesystem::path& path,
             bool sRGB,
@@ -187,14 +286,32 @@ namespace donut::engine
         //       Texture lifetimes are tracked by NVRHI and the texture object is only destroyed when no references exist.
         bool UnloadTexture(const std::shared_ptr<LoadedTexture>& texture);
 
-        // Process a portion of the upload queue, taking up to `timeLimitMilliseconds` CPU time.
-        // If `timeLimitMilliseconds` is 0, processes the entire queue.
-        // Returns true if any textures have been processed.
+        // Process a portion of the upload queue, taking up to `timeLimitMilliseconds` CPU time
+        // and uploading up to the number of bytes set with SetUploadBudget.
+        // Textures are uploaded one subresource at a time, so a large texture may take multiple calls to finalize.
+        // If `timeLimitMilliseconds` is 0 and there is no upload budget, processes the entire queue.
+        // Returns true if any textures or subresources have been processed.
         bool ProcessRenderingThreadCommands(CommonRenderPasses& passes, float timeLimitMilliseconds);
 
-        // Destroys the internal command list in order to release the upload buffers used in it.
+        // Destroys the internal command lists and staging textures in order to release the upload buffers used in them.
         void LoadingFinished();
 
+        // Sets the maximum number of bytes uploaded by one ProcessRenderingThreadCommands call, 0 means unlimited.
+        // Subresources larger than the budget are copied in ranges of block rows over multiple calls, through
+        // a ring of staging textures that is reused across calls and released by LoadingFinished.
+        // At least one row of blocks is always uploaded per call, even if it is larger than the budget.
+        void SetUploadBudget(size_t bytes) { m_UploadBudgetBytes = bytes; }
+
+        // Sets the size of the staging buffer chunks used by the internal upload command lists.
+        // The chunks are kept by the command lists and reused once the GPU is done with them, until LoadingFinished.
+        // Setting the chunk size to the upload budget makes them work as a persistent staging ring buffer.
+        // Takes effect when the command lists are created next time; 0 means the NVRHI default.
+        void SetUploadChunkSize(size_t bytes) { m_UploadChunkSize = bytes; }
+
+        // Enables uploading the deferred textures on the copy queue, if the device has one
+        // (see DeviceCreationParameters::enableCopyQueue). Mip generation still happens on the graphics queue.
+        void SetUseCopyQueue(bool enable) { m_UseCopyQueue = enable; }
+
         // Set the maximum texture size allowed after load. Larger textures are resized to fit this constraint.
         // Currently does not affect DDS textures.
         void SetMaxTextureSize(uint32_t size);
@@ -202,6 +319,13 @@ namespace donut::engine
         // Enables or disables automatic mip generation for loaded textures.
         void SetGenerateMipmaps(bool generateMipmaps);
 
+        // Enables or disables deduplication of textures by their decoded contents.
+        // When enabled, textures with identical contents share one GPU texture and one bindless descriptor,
+        // even if they were loaded from different files or memory blobs. Affects textures loaded after the call.
+        // Duplicates of textures that are not uploaded yet are finalized by ProcessRenderingThreadCommands,
+        // even when they are loaded with the synchronous Load* functions.
+        void SetDeduplicateByContent(bool enable) { m_DeduplicateByContent = enable; }
+
         // Sets the Severity of log messages about textures being loaded.
         void SetInfoLogSeverity(log::Severity value) { m_InfoLogSeverity = value; }
 
@@ -210,7 +334,10 @@ namespace donut::engine
 
         uint32_t GetNumberOfLoadedTextures() { return m_TexturesLoaded.load(); }
         uint32_t GetNumberOfRequestedTextures() { return m_TexturesRequested.load(); }
-        uint32_t GetNumberOfFinalizedTextures() { return m_TexturesFinalized; }
+        uint32_t GetNumberOfFinalizedTextures() { return m_TexturesFinalized.load(); }
+        uint32_t GetNumberOfDeduplicatedTextures() { return m_TexturesDeduplicated.load(); }
+        uint64_t GetDeduplicatedBytes() { return m_DeduplicatedBytes.load(); }
+        uint64_t GetNumberOfUploadedBytes() { return m_BytesUploaded.load(); }
 
 		std::shared_ptr<TextureData> GetLoadedTexture(std::filesystem::path const& path);
 
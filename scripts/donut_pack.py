@@ -0,0 +1,232 @@
+#!/usr/bin/python
+#
+# Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+# DEALINGS IN THE SOFTWARE.
+
+
+# Creates donut pack archives, see donut/core/vfs/PackFile.h for the format description.
+
+import argparse
+import os
+import struct
+import sys
+
+parser = argparse.ArgumentParser(description = "Donut pack archive tool", fromfile_prefix_chars='@')
+parser.add_argument('inputs', nargs = '*')
+parser.add_argument('--output', '-o', required = True, help = "Output file name")
+parser.add_argument('--compression', '-c', default = 'none', choices = ['none', 'lz4', 'zstd'], help = "Compression method for the files")
+parser.add_argument('--level', '-l', default = 9, type = int, help = "Compression level")
+parser.add_argument('--alignment', '-a', default = 4096, type = int, help = "Alignment of the files in the archive, must be a power of 2")
+parser.add_argument('--prefix', '-p', default = '', help="Path prefix for archive files")
+parser.add_argument('--no-compress', '-n', action = 'append', default = [], help="File types to skip compression for")
+
+args = parser.parse_args()
+
+if args.compression == 'lz4':
+    import lz4.block
+elif args.compression == 'zstd':
+    import zstandard
+
+PACK_MAGIC = 0x4B415044 # "DPAK"
+PACK_VERSION = 1
+ENTRY_FLAG_DIRECTORY = 1
+COMPRESSION_NONE = 0
+COMPRESSION_LZ4 = 1
+COMPRESSION_ZSTD = 2
+
+MASK64 = 0xFFFFFFFFFFFFFFFF
+PRIME64_1 = 0x9E3779B185EBCA87
+PRIME64_2 = 0xC2B2AE3D27D4EB4F
+PRIME64_3 = 0x165667B19E3779F9
+PRIME64_4 = 0x85EBCA77C2B2AE63
+PRIME64_5 = 0x27D4EB2F165667C5
+
+def rotl64(x, r):
+    return ((x << r) | (x >> (64 - r))) & MASK64
+
+def xxh64_round(acc, lane):
+    acc = (acc + lane * PRIME64_2) & MASK64
+    return (rotl64(acc, 31) * PRIME64_1) & MASK64
+
+def xxh64_merge_round(acc, val):
+    acc ^= xxh64_round(0, val)
+    return (acc * PRIME64_1 + PRIME64_4) & MASK64
+
+def xxh64(data, seed = 0):
+    # The names are short, a pure Python implementation is fast enough and avoids another dependency
+    length = len(data)
+    position = 0
+
+    if length >= 32:
+        v1 = (seed + PRIME64_1 + PRIME64_2) & MASK64
+        v2 = (seed + PRIME64_2) & MASK64
+        v3 = seed
+        v4 = (seed - PRIME64_1) & MASK64
+        while position + 32 <= length:
+            l1, l2, l3, l4 = struct.unpack_from('<QQQQ', data, position)
+            v1 = xxh64_round(v1, l1)
+            v2 = xxh64_round(v2, l2)
+            v3 = xxh64_round(v3, l3)
+            v4 = xxh64_round(v4, l4)
+            position += 32
+        h = (rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18)) & MASK64
+        for v in (v1, v2, v3, v4):
+            h = xxh64_merge_round(h, v)
+    else:
+        h = (seed + PRIME64_5) & MASK64
+
+    h = (h + length) & MASK64
+
+    while position + 8 <= length:
+        lane, = struct.unpack_from('<Q', data, position)
+        h ^= xxh64_round(0, lane)
+        h = (rotl64(h, 27) * PRIME64_1 + PRIME64_4) & MASK64
+        position += 8
+
+    if position + 4 <= length:
+        lane, = struct.unpack_from('<I', data, position)
+        h ^= (lane * PRIME64_1) & MASK64
+        h = (rotl64(h, 23) * PRIME64_2 + PRIME64_3) & MASK64
+        position += 4
+
+    while position < length:
+        h ^= (data[position] * PRIME64_5) & MASK64
+        h = (rotl64(h, 11) * PRIME64_1) & MASK64
+        position += 1
+
+    h ^= h >> 33
+    h = (h * PRIME64_2) & MASK64
+    h ^= h >> 29
+    h = (h * PRIME64_3) & MASK64
+    h ^= h >> 32
+    return h
+
+def normalize_path(path):
+    path = os.path.normpath(path)
+    if args.prefix:
+        path = os.path.join(args.prefix, path)
+    path = path.replace('\\', '/')
+    return path.lstrip('/')
+
+def compress(contents):
+    if args.compression == 'lz4':
+        return COMPRESSION_LZ4, lz4.block.compress(contents, mode = 'high_compression', compression = args.level, store_size = False)
+    if args.compression == 'zstd':
+        return COMPRESSION_ZSTD, zstandard.ZstdCompressor(level = args.level, write_content_size = True).compress(contents)
+    return COMPRESSION_NONE, contents
+
+class PackWriter:
+    def __init__(self, file, alignment):
+        self.file = file
+        self.alignment = alignment
+        self.position = 0
+        self.entries = [] # (name, offset, stored size, size, compression, flags)
+        self.names = set()
+        self.write_aligned(struct.pack('<IIII', PACK_MAGIC, PACK_VERSION, alignment, 0))
+
+    def write_aligned(self, data):
+        self.file.write(data)
+        self.position += len(data)
+        padding = -self.position % self.alignment
+        self.file.write(b'\0' * padding)
+        self.position += padding
+
+    def add_directories(self, name):
+        directory = os.path.dirname(name)
+        while directory and directory not in self.names:
+            self.names.add(directory)
+            self.entries.append((directory, 0, 0, 0, COMPRESSION_NONE, ENTRY_FLAG_DIRECTORY))
+            directory = os.path.dirname(directory)
+
+    def add_file(self, name, contents, compress_file):
+        if name in self.names:
+            print("ERROR: Duplicate file name: %s" % name)
+            sys.exit(1)
+
+        compression, stored = compress(contents) if compress_file else (COMPRESSION_NONE, contents)
+        if len(stored) >= len(contents):
+            # compression didn't help
+            compression, stored = COMPRESSION_NONE, contents
+
+        self.entries.append((name, self.position, len(stored), len(contents), compression, 0))
+        self.names.add(name)
+        self.add_directories(name)
+        self.write_aligned(stored)
+        return len(stored)
+
+    def finish(self):
+        toc = b''
+        names = b''
+        records = []
+        for name, offset, stored_size, size, compression, flags in self.entries:
+            encoded = name.encode('utf-8')
+            records.append((xxh64(encoded), offset, stored_size, size, len(names), len(encoded), compression, flags))
+            names += encoded
+
+        records.sort(key = lambda record: record[0])
+        for record in records:
+            toc += struct.pack('<QQQQIIII', *record)
+
+        self.file.write(toc)
+        self.file.write(names)
+        self.file.write(struct.pack('<QIIII', self.position, len(records), len(names), PACK_VERSION, PACK_MAGIC))
+
+if args.alignment < 16 or (args.alignment & (args.alignment - 1)) != 0:
+    print("ERROR: Alignment must be a power of 2 and at least 16")
+    sys.exit(1)
+
+original_size = 0
+stored_size = 0
+
+def process_file(path, writer):
+    global original_size, stored_size
+
+    archive_path = normalize_path(path)
+    print(archive_path)
+
+    try:
+        with open(path, 'rb') as file:
+            contents = file.read()
+    except:
+        print("ERROR: Cannot read file: %s" % path)
+        sys.exit(1)
+
+    extension = os.path.splitext(path)[1]
+
+    original_size += len(contents)
+    stored_size += writer.add_file(archive_path, contents, extension not in args.no_compress)
+
+with open(args.output, 'wb') as output:
+    writer = PackWriter(output, args.alignment)
+    for input_name in args.inputs:
+        if os.path.isdir(input_name):
+            # if the line references a directory, recursively collect everything from that directory
+            for dirpath, dirnames, filenames in os.walk(input_name):
+                for file_name in filenames:
+                    path = os.path.join(dirpath, file_name)
+                    process_file(path, writer)
+        else:
+            # just take one file
+            process_file(input_name, writer)
+    writer.finish()
+
+if args.compression != 'none':
+    print("Original size: {0:,} bytes, stored size: {1:,} bytes (ratio = {2:.2f}x)"
+        .format(original_size, stored_size, float(original_size) / float(max(stored_size, 1))))
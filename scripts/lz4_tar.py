@@ -23,21 +23,29 @@
 
 import tarfile
 import os
-import lz4.frame
 import argparse
 import sys
 import io
+import struct
 
-parser = argparse.ArgumentParser(description = "Tar/LZ4 packaging tool", fromfile_prefix_chars='@')
+parser = argparse.ArgumentParser(description = "Tar/LZ4/Zstandard packaging tool", fromfile_prefix_chars='@')
 parser.add_argument('inputs', nargs = '*')
 parser.add_argument('--output', '-o', required = True, help = "Output file name")
 parser.add_argument('--compress', '-c', default = 0, type = int, help = "LZ4 compression level, 0 = uncompressed")
 parser.add_argument('--prefix', '-p', default = '', help="Path prefix for archive files")
+parser.add_argument('--zstd', '-z', default = 0, type = int, help = "Zstandard compression level, 0 = use LZ4 or no compression")
+parser.add_argument('--dictionary-size', default = 0, type = int, help = "Size of the Zstandard dictionary to train on the input files, 0 = no dictionary")
+parser.add_argument('--dictionary-name', default = 'zstd.dict', help = "Archive path of the Zstandard dictionary, relative to the prefix")
 parser.add_argument('--no-compress', '-n', action = 'append', default = [], help="File types to skip compression for")
 
 
 args = parser.parse_args()
 
+if args.zstd:
+    import zstandard
+elif args.compress:
+    import lz4.frame
+
 original_size = 0
 compressed_size = 0
 
@@ -48,45 +56,112 @@ def normalize_path(path):
     path = path.replace('\\', '/')
     return path
 
-def process_file(path, tar):
-    global original_size, compressed_size
+# The block index is stored in a skippable LZ4 frame after the data frame, see donut/core/vfs/Compression.h
+SKIPPABLE_FRAME_MAGIC = 0x184D2A5D
+BLOCK_INDEX_TAG = 0x58444942 # "BIDX"
+BLOCK_SIZE = 1024 * 1024
 
-    archive_path = normalize_path(path)
-    print(archive_path)
-    
+def append_block_index(frame):
+    flags = frame[4]
+    block_checksums = (flags >> 4) & 1
+    content_size = (flags >> 3) & 1
+    content_checksum = (flags >> 2) & 1
+    dict_id = flags & 1
+
+    # magic, FLG, BD, optional content size and dictionary ID, header checksum
+    position = 4 + 2 + (8 if content_size else 0) + (4 if dict_id else 0) + 1
+
+    blocks = []
+    while True:
+        block_header, = struct.unpack_from('<I', frame, position)
+        if block_header == 0:
+            break
+
+        blocks.append((position, len(blocks) * BLOCK_SIZE))
+        position += 4 + (block_header & 0x7fffffff) + (4 if block_checksums else 0)
+
+    payload = b''.join(struct.pack('<QQ', compressed_offset, decompressed_offset)
+        for compressed_offset, decompressed_offset in blocks)
+    payload += struct.pack('<II', len(blocks), BLOCK_INDEX_TAG)
+
+    return frame + struct.pack('<II', SKIPPABLE_FRAME_MAGIC, len(payload)) + payload
+
+# Zstandard files are split into independent frames so that they can be decompressed in parallel, see CompressionLayer
+ZSTD_FRAME_SIZE = 4 * 1024 * 1024
+
+def compress_zstd(contents, dictionary):
+    compressor = zstandard.ZstdCompressor(level = args.zstd, dict_data = dictionary, write_content_size = True)
+    return b''.join(compressor.compress(contents[offset:offset + ZSTD_FRAME_SIZE])
+        for offset in range(0, len(contents), ZSTD_FRAME_SIZE))
+
+def read_file(path):
     try:
         with open(path, 'rb') as file:
-            contents = file.read()
+            return file.read()
     except:
         print("ERROR: Cannot read file: %s" % path)
         sys.exit(1)
 
-    original_size += len(contents)
+def should_compress(path):
+    return os.path.splitext(path)[1] not in args.no_compress
+
+def add_file(tar, archive_path, contents):
+    tarinfo = tarfile.TarInfo(archive_path)
+    tarinfo.size = len(contents)
+    tar.addfile(tarinfo, io.BytesIO(contents))
+
+def train_dictionary(paths):
+    samples = [read_file(path) for path in paths if should_compress(path)]
+    return zstandard.train_dictionary(args.dictionary_size, samples, level = args.zstd)
 
-    extension = os.path.splitext(path)[1]
+def process_file(path, tar, dictionary):
+    global original_size, compressed_size
+
+    archive_path = normalize_path(path)
+    print(archive_path)
+    
+    contents = read_file(path)
+
+    original_size += len(contents)
 
-    if args.compress and (extension not in args.no_compress):
-        contents = lz4.frame.compress(contents, compression_level = args.compress, store_size = True, return_bytearray = True)
+    if args.zstd and should_compress(path):
+        contents = compress_zstd(contents, dictionary)
+        archive_path += '.zst'
+    elif args.compress and should_compress(path):
+        # independent blocks with an index allow parallel decompression, see CompressionLayer
+        contents = lz4.frame.compress(contents, compression_level = args.compress, store_size = True,
+            block_size = lz4.frame.BLOCKSIZE_MAX1MB, block_linked = False, block_checksum = True, return_bytearray = True)
+        contents = append_block_index(contents)
         archive_path += '.lz4'
 
     compressed_size += len(contents)
 
-    tarinfo = tarfile.TarInfo(archive_path)
-    tarinfo.size = len(contents)
-    tar.addfile(tarinfo, io.BytesIO(contents))
-    
+    add_file(tar, archive_path, contents)
+
+paths = []
+for input_name in args.inputs:
+    if os.path.isdir(input_name):
+        # if the line references a directory, recursively collect everything from that directory
+        for dirpath, dirnames, filenames in os.walk(input_name):
+            for file_name in filenames:
+                paths.append(os.path.join(dirpath, file_name))
+    else:
+        # just take one file
+        paths.append(input_name)
+
 with tarfile.open(args.output, mode = 'w', format = tarfile.USTAR_FORMAT) as tar:
-    for input_name in args.inputs:
-        if os.path.isdir(input_name):
-            # if the line references a directory, recursively collect everything from that directory
-            for dirpath, dirnames, filenames in os.walk(input_name):
-                for file_name in filenames:
-                    path = os.path.join(dirpath, file_name)
-                    process_file(path, tar)
-        else:
-            # just take one file
-            process_file(input_name, tar)
-
-if args.compress:
+    dictionary = None
+    if args.zstd and args.dictionary_size:
+        # the dictionary is stored in the archive, load it with CompressionLayer::loadZstdDictionary
+        dictionary = train_dictionary(paths)
+        dictionary_data = dictionary.as_bytes()
+        add_file(tar, normalize_path(args.dictionary_name), dictionary_data)
+        compressed_size += len(dictionary_data)
+        print("Trained a {0:,} byte dictionary".format(len(dictionary_data)))
+
+    for path in paths:
+        process_file(path, tar, dictionary)
+
+if args.compress or args.zstd:
     print("Original size: {0:,} bytes, compressed size: {1:,} bytes (ratio = {2:.2f}x)"
         .format(original_size, compressed_size, float(original_size) / float(compressed_size)))
\ No newline at end of file
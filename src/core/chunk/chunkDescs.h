@@ -239,9 +239,40 @@ struct MeshInstances_ChunkDesc_0x100
 
     uint32_t ninstances;
 
+    // data starts here (misaligned : see version 0x101)
+};
+
+struct MeshInstances_ChunkDesc_0x101
+{
+    static constexpr uint32_t const version = 0x101;
+    static constexpr ChunkType const chunktype = CHUNKTYPE_MESH_INSTANCES;
+
+    MeshInstances_ChunkDesc_0x101() : ninstances(0), padding(0) {}
+
+    uint32_t ninstances,
+             padding;   // aligns the instances on 8 bytes
+
     // data starts here
 };
 
+//
+// Materials chunk
+//
+
+struct Materials_ChunkDesc_0x100
+{
+    static constexpr uint32_t const version = 0x100;
+    static constexpr ChunkType const chunktype = CHUNKTYPE_MATERIALS;
+
+    Materials_ChunkDesc_0x100() : flags(0), length(0) {}
+
+    uint32_t flags;
+
+    size_t length; // null terminator excluded
+
+    // text starts here
+};
+
 struct MeshSet_ChunkDesc_0x100
 {
     static constexpr uint32_t const version = 0x100;
@@ -22,9 +22,24 @@
 
 #include <donut/core/chunk/chunkFile.h>
 #include <donut/core/vfs/VFS.h>
+#include <donut/core/hash.h>
+#include <donut/core/parallel.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <limits>
+#include <map>
+#include <mutex>
+
+#ifdef DONUT_WITH_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+
+#ifdef DONUT_WITH_ZSTD
+#include <zstd.h>
+#endif
 
 namespace donut::chunk
 {
@@ -43,7 +58,9 @@ struct ChunkFile::Header
 
     static char const * validSignature() { return "NVDACHNK"; }
 
-    static uint32_t currentVersion() { return 0x100; }
+    // 0x100 : raw chunks
+    // 0x101 : compressed & checksummed chunks, aligned chunk table & payloads
+    static uint32_t currentVersion() { return 0x101; }
 
     bool isValid() const
     {
@@ -56,7 +73,7 @@ struct ChunkFile::Header
 // Chunks Table
 //
 
-struct ChunkFile::ChunkTableEntry
+struct ChunkFile::ChunkTableEntry_0x100
 {
     ChunkId  chunkId;
     uint32_t chunkType,
@@ -65,10 +82,162 @@ struct ChunkFile::ChunkTableEntry
            size;
 };
 
+struct ChunkFile::ChunkTableEntry
+{
+    ChunkId  chunkId;
+    uint32_t chunkType,
+             chunkVersion;
+    ChunkCodec codec;
+    uint64_t offset,     // offset of the stored payload in file/blob
+             storedSize, // size of the stored (compressed) payload
+             size,       // size of the decompressed payload
+             checksum;   // xxHash64 of the stored payload
+};
+
+//
+// Chunk storage : payload as stored in the file, decompressed on demand
+//
+
+struct ChunkFile::ChunkStorage
+{
+    ChunkCodec codec;
+    uint64_t offset,
+             storedSize,
+             checksum;
+    bool hasChecksum;        // version 0x100 files have no checksums
+
+    // deserialized blobs : decompressed once, for the lifetime of the file
+    uint8_t const * stored = nullptr;
+    std::once_flag loaded;
+    std::unique_ptr<uint8_t[]> decompressed;
+    bool valid = false;
+
+    // streamed files : resident while acquired
+    std::mutex mutex;
+    std::weak_ptr<Chunk const> resident;
+    std::shared_ptr<Chunk const> pinned;
+};
+
+//
+// Resident chunk : payload of a streamed chunk, shared by all its handles
+//
+
+struct ChunkFile::ResidentChunk
+{
+    Chunk chunk;
+    std::shared_ptr<ChunkFile const> file;
+    std::shared_ptr<donut::vfs::IBlob const> stored;
+    std::unique_ptr<uint8_t[]> decompressed;
+
+    ~ResidentChunk() { if (file) file->_residentSize -= chunk.size; }
+};
+
+
+static constexpr size_t c_tableAlignment = 8;
+static constexpr size_t c_chunkAlignment = 16;
+
+// sets of chunks smaller than this are (de)compressed on the calling thread
+static constexpr size_t c_minParallelSize = 256 * 1024;
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static char const * getCodecName(ChunkCodec codec)
+{
+    switch (codec)
+    {
+        case ChunkCodec::None : return "none";
+        case ChunkCodec::LZ4 : return "LZ4";
+        case ChunkCodec::Zstd : return "Zstd";
+        default: return "unknown";
+    }
+}
+
+static bool isCodecSupported(ChunkCodec codec)
+{
+    switch (codec)
+    {
+        case ChunkCodec::None : return true;
+#ifdef DONUT_WITH_LZ4
+        case ChunkCodec::LZ4 : return true;
+#endif
+#ifdef DONUT_WITH_ZSTD
+        case ChunkCodec::Zstd : return true;
+#endif
+        default: return false;
+    }
+}
+
+// runs task(i) for i in [0, count), as tasks on the shared executor if 'parallel' is set
+template <typename Task> static void runParallel(size_t count, bool parallel, Task const & task)
+{
+    donut::parallel::forEachIndex(parallel ? donut::parallel::getSharedExecutor() : nullptr, count, count, task);
+}
+
+// returns false if the data cannot be compressed with the codec or doesn't get smaller
+static bool compressChunk(ChunkCodec codec, [[maybe_unused]] int level,
+    [[maybe_unused]] void const * data, size_t size, std::vector<uint8_t> & result)
+{
+    switch (codec)
+    {
+#ifdef DONUT_WITH_LZ4
+        case ChunkCodec::LZ4 : {
+            if (size > LZ4_MAX_INPUT_SIZE)
+                return false;
+            result.resize(LZ4_compressBound(int(size)));
+            int csize = level > 0
+                ? LZ4_compress_HC((char const *)data, (char *)result.data(), int(size), int(result.size()), level)
+                : LZ4_compress_default((char const *)data, (char *)result.data(), int(size), int(result.size()));
+            if (csize <= 0)
+                return false;
+            result.resize(csize);
+        } break;
+#endif
+#ifdef DONUT_WITH_ZSTD
+        case ChunkCodec::Zstd : {
+            result.resize(ZSTD_compressBound(size));
+            size_t csize = ZSTD_compress(result.data(), result.size(), data, size, level);
+            if (ZSTD_isError(csize))
+                return false;
+            result.resize(csize);
+        } break;
+#endif
+        default:
+            return false;
+    }
+    return result.size() < size;
+}
+
+static bool decompressChunk(ChunkCodec codec, [[maybe_unused]] void const * data,
+    [[maybe_unused]] size_t storedSize, [[maybe_unused]] void * result, [[maybe_unused]] size_t size)
+{
+    switch (codec)
+    {
+#ifdef DONUT_WITH_LZ4
+        case ChunkCodec::LZ4 :
+            return storedSize <= LZ4_MAX_INPUT_SIZE && size <= LZ4_MAX_INPUT_SIZE &&
+                LZ4_decompress_safe((char const *)data, (char *)result, int(storedSize), int(size)) == int(size);
+#endif
+#ifdef DONUT_WITH_ZSTD
+        case ChunkCodec::Zstd :
+            return ZSTD_decompress(result, size, data, storedSize) == size;
+#endif
+        default:
+            return false;
+    }
+}
+
 //
 // Implementation
 //
 
+
+ChunkFile::ChunkFile() = default;
+
+ChunkFile::~ChunkFile() = default;
+
 ChunkId ChunkFile::addChunk(uint32_t type, uint32_t version, void const * data, size_t size)
 {
      ChunkId chunkId = (uint32_t)_chunks.size()+1;
@@ -81,39 +250,322 @@ ChunkId ChunkFile::addChunk(uint32_t type, uint32_t version, void const * data,
     return chunkId;
 }
 
+void ChunkFile::setCompression(ChunkCodec codec, int level)
+{
+    if (!isCodecSupported(codec))
+    {
+        log::warning("ChunkFile '%s' : %s compression is not supported in this build,"
+            " chunks will be stored uncompressed", _filepath.c_str(), getCodecName(codec));
+        codec = ChunkCodec::None;
+    }
+    _codec = codec;
+    _compressionLevel = level;
+}
 
-Chunk const * ChunkFile::getChunk(ChunkId const chunkId) const
+size_t ChunkFile::findChunk(ChunkId const chunkId) const
 {
-    if (!chunkId.valid()) {
+    if (!chunkId.valid())
+        return _chunks.size();
+
+    // chunks are numbered sequentially by addChunk
+    size_t index = size_t(chunkId._chunkId) - 1;
+    if (index < _chunks.size() && _chunks[index] && _chunks[index]->chunkId == chunkId)
+        return index;
+
+    for (index = 0; index < _chunks.size(); ++index)
+        if (_chunks[index] && _chunks[index]->chunkId == chunkId)
+            break;
+    return index;
+}
+
+// verifies the stored payload of a chunk and sets its data, decompressing it if needed
+static bool decodeChunk(Chunk & chunk, ChunkCodec codec, uint64_t storedSize,
+    uint8_t const * stored, uint64_t const * checksum,
+    std::unique_ptr<uint8_t[]> & decompressed, std::string const & filepath)
+{
+    if (checksum && hash::xxh64(stored, storedSize) != *checksum)
+    {
+        log::error("ChunkFile '%s' : chunk %d is corrupt (checksum mismatch)",
+            filepath.c_str(), chunk.chunkId);
+        return false;
+    }
+
+    if (codec == ChunkCodec::None)
+    {
+        chunk.data = stored;
+        return true;
+    }
+
+    decompressed.reset(new (std::nothrow) uint8_t[chunk.size]);
+
+    if (!decompressed || !decompressChunk(codec, stored, storedSize, decompressed.get(), chunk.size))
+    {
+        log::error("ChunkFile '%s' : chunk %d : %s decompression failed",
+            filepath.c_str(), chunk.chunkId, getCodecName(codec));
+        decompressed.reset();
+        return false;
+    }
+
+    chunk.data = decompressed.get();
+    return true;
+}
+
+bool ChunkFile::loadChunk(size_t index) const
+{
+    if (_storage.empty())
+        return true;
+
+    ChunkStorage & storage = *_storage[index];
+
+    if (isStreaming())
+    {
+        std::shared_ptr<Chunk const> chunk = acquireChunk(index);
+
+        std::lock_guard<std::mutex> lock(storage.mutex);
+        if (chunk && !storage.pinned)
+            storage.pinned = chunk;
+        return chunk != nullptr;
+    }
+
+    std::call_once(storage.loaded, [&]() {
+        Chunk & chunk = *const_cast<Chunk *>(_chunks[index].get());
+        storage.valid = decodeChunk(chunk, storage.codec, storage.storedSize, storage.stored,
+            storage.hasChecksum ? &storage.checksum : nullptr, storage.decompressed, _filepath);
+    });
+
+    return storage.valid;
+}
+
+std::shared_ptr<Chunk const> ChunkFile::readChunk(size_t index) const
+{
+    ChunkStorage const & storage = *_storage[index];
+
+    auto resident = std::make_shared<ResidentChunk>();
+    resident->chunk = *_chunks[index];
+
+    resident->stored = _fs->readFileRange(_filepath, storage.offset, storage.storedSize);
+    if (!resident->stored || resident->stored->size() != storage.storedSize)
+    {
+        log::error("ChunkFile '%s' : chunk %d : read failed", _filepath.c_str(), resident->chunk.chunkId);
         return nullptr;
     }
 
-    // XXXX manuelk augment this w/ map for faster search
-    for (auto const & chunk : _chunks) {
-        if (chunk && chunk->chunkId == chunkId) {
-            return chunk.get();
-        }
+    resident->file = shared_from_this();
+    _residentSize += resident->chunk.size;
+
+    if (!decodeChunk(resident->chunk, storage.codec, storage.storedSize, (uint8_t const *)resident->stored->data(),
+        storage.hasChecksum ? &storage.checksum : nullptr, resident->decompressed, _filepath))
+        return nullptr;
+
+    // compressed payloads are not needed once decompressed
+    if (resident->decompressed)
+        resident->stored.reset();
+
+    return std::shared_ptr<Chunk const>(resident, &resident->chunk);
+}
+
+std::shared_ptr<Chunk const> ChunkFile::acquireChunk(size_t index) const
+{
+    if (!isStreaming())
+    {
+        if (!loadChunk(index))
+            return nullptr;
+
+        // blob payloads live as long as the file ; files built in memory return non-owning handles
+        return std::shared_ptr<Chunk const>(weak_from_this().lock(), _chunks[index].get());
     }
-    return nullptr;
+
+    ChunkStorage & storage = *_storage[index];
+
+    std::lock_guard<std::mutex> lock(storage.mutex);
+
+    std::shared_ptr<Chunk const> chunk = storage.resident.lock();
+    if (!chunk)
+    {
+        chunk = readChunk(index);
+        storage.resident = chunk;
+    }
+    return chunk;
+}
+
+std::shared_ptr<Chunk const> ChunkFile::acquireChunk(ChunkId chunkId) const
+{
+    size_t index = findChunk(chunkId);
+    if (index >= _chunks.size())
+        return nullptr;
+
+    return acquireChunk(index);
+}
+
+Chunk const * ChunkFile::getChunk(ChunkId const chunkId) const
+{
+    size_t index = findChunk(chunkId);
+    if (index >= _chunks.size() || !loadChunk(index))
+        return nullptr;
+
+    return isStreaming() ? _storage[index]->pinned.get() : _chunks[index].get();
 }
 
 void ChunkFile::getChunks(uint32_t chunkType, std::vector<Chunk const *> & result) const
 {
     result.clear();
+
+    std::vector<ChunkId> chunkIds;
     for (auto const & chunk : _chunks)
         if (chunk && chunk->chunkType == chunkType)
-            result.push_back(chunk.get());
+            chunkIds.push_back(chunk->chunkId);
+
+    loadChunks(chunkIds);
+
+    for (ChunkId chunkId : chunkIds)
+        if (Chunk const * chunk = getChunk(chunkId))
+            result.push_back(chunk);
+}
+
+bool ChunkFile::loadChunks(std::vector<ChunkId> const & chunkIds) const
+{
+    std::vector<std::shared_ptr<Chunk const>> chunks;
+    if (!acquireChunks(chunkIds, chunks))
+        return false;
+
+    for (ChunkId chunkId : chunkIds)
+        if (!loadChunk(findChunk(chunkId)))
+            return false;
+
+    return true;
+}
+
+bool ChunkFile::acquireChunks(std::vector<ChunkId> const & chunkIds,
+    std::vector<std::shared_ptr<Chunk const>> & result) const
+{
+    result.clear();
+
+    std::vector<size_t> indices;
+    indices.reserve(chunkIds.size());
+
+    // streamed chunks are read in parallel to overlap I/O, blob chunks only need threads to decompress
+    size_t parallelSize = 0;
+    for (ChunkId chunkId : chunkIds)
+    {
+        size_t index = findChunk(chunkId);
+        if (index >= _chunks.size())
+            return false;
+
+        indices.push_back(index);
+        if (!_storage.empty() && (isStreaming() || _storage[index]->codec != ChunkCodec::None))
+            parallelSize += _storage[index]->storedSize;
+    }
+
+    bool parallel = parallelSize >= c_minParallelSize;
+
+    // largest chunks first to balance the threads
+    std::vector<size_t> order(indices.size());
+    for (size_t i=0; i<order.size(); ++i)
+        order[i] = i;
+    if (parallel)
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return _chunks[indices[a]]->size > _chunks[indices[b]]->size; });
+
+    result.resize(indices.size());
+
+    runParallel(indices.size(), parallel, [&](size_t i) {
+        result[order[i]] = acquireChunk(indices[order[i]]);
+    });
+
+    return std::all_of(result.begin(), result.end(), [](auto const & chunk) { return chunk != nullptr; });
 }
 
 void ChunkFile::reset()
 {
     _filepath.clear();
     _chunks.clear();
+    _storage.clear();
     _data.reset();
+    _fs.reset();
+    _payloads.clear();
 }
 
 typedef typename vfs::IBlob IBlob;
 
+// validates the header & chunk table of a file and creates the chunk records
+std::shared_ptr<ChunkFile> ChunkFile::parseTable(
+    Header const & header, uint8_t const * table, uint64_t fileSize, char const * filepath)
+{
+    uint32_t nchunks = header.chunkCount;
+
+    auto result = std::make_shared<ChunkFile>();
+
+    result->_chunks.reserve(nchunks);
+    result->_storage.reserve(nchunks);
+
+    for (uint32_t index = 0; index < nchunks; index++)
+    {
+        std::unique_ptr<ChunkStorage> storage = std::make_unique<ChunkStorage>();
+        ChunkTableEntry e;
+
+        if (header.version == 0x100)
+        {
+            ChunkTableEntry_0x100 const & e0 = ((ChunkTableEntry_0x100 const *)table)[index];
+            e = {e0.chunkId, e0.chunkType, e0.chunkVersion, ChunkCodec::None, e0.offset, e0.size, e0.size, 0};
+            storage->hasChecksum = false;
+        }
+        else
+        {
+            e = ((ChunkTableEntry const *)table)[index];
+            storage->hasChecksum = true;
+        }
+
+        if (e.offset > fileSize || fileSize - e.offset < e.storedSize
+            || (e.codec == ChunkCodec::None && e.storedSize != e.size)) {
+            log::error("ChunkFile '%s' : chunk %d invalid size/offset", filepath, e.chunkId);
+            return nullptr;
+        }
+
+        if (!isCodecSupported(e.codec)) {
+            log::error("ChunkFile '%s' : chunk %d is compressed with codec '%s',"
+                " which is not supported in this build", filepath, e.chunkId, getCodecName(e.codec));
+            return nullptr;
+        }
+
+        storage->codec = e.codec;
+        storage->offset = e.offset;
+        storage->storedSize = e.storedSize;
+        storage->checksum = e.checksum;
+
+        result->_chunks.push_back(std::make_unique<Chunk>(
+            Chunk({e.chunkId, e.chunkType, e.chunkVersion, size_t(e.offset), size_t(e.size), nullptr})));
+        result->_storage.push_back(std::move(storage));
+    }
+
+    result->_filepath = filepath;
+    return result;
+}
+
+// returns the size of the chunk table, or 0 if the header is invalid
+size_t ChunkFile::getChunkTableSize(Header const & header, char const * filepath)
+{
+    if (!header.isValid())
+    {
+        log::error("ChunkFile '%s' : invalid chunkfile signature", filepath);
+        return 0;
+    }
+
+    if (header.version != 0x100 && header.version != Header::currentVersion())
+    {
+        log::error("ChunkFile '%s' : unsupported chunkfile version 0x%x", filepath, header.version);
+        return 0;
+    }
+
+    uint32_t nchunks = header.chunkCount;
+    if (nchunks == 0 || nchunks > 1000000)
+    {
+        log::error("ChunkFile '%s' : invalid number of chunks in file", filepath);
+        return 0;
+    }
+
+    return nchunks * (header.version == 0x100 ? sizeof(ChunkTableEntry_0x100) : sizeof(ChunkTableEntry));
+}
+
 std::shared_ptr<ChunkFile const> ChunkFile::deserialize(
     std::weak_ptr<IBlob const> blobPtr, char const * filepath)
 {
@@ -130,111 +582,324 @@ std::shared_ptr<ChunkFile const> ChunkFile::deserialize(
 
         Header const & header = *(Header const *)(data);
 
-        if (!header.isValid())
-        {
-            log::error("ChunkFile '%s' : invalid chunkfile signature", filepath);
-        }
-
-        uint32_t nchunks = header.chunkCount;
-        if (nchunks == 0 || nchunks > 1000000)
-        {
-            log::error("ChunkFile '%s' : invalid number of chunks in file", filepath);
+        size_t tableSize = getChunkTableSize(header, filepath);
+        if (tableSize == 0)
             return nullptr;
-        }
 
-        if (blob->size() < header.chunkTableOffset + nchunks * sizeof(ChunkTableEntry))
+        if (blob->size() < header.chunkTableOffset + tableSize)
         {
             log::error("ChunkFile '%s' : invalid chunks table", filepath);
             return nullptr;
         }
 
-        ChunkTableEntry const * chunktable =
-            (ChunkTableEntry const *)(data + header.chunkTableOffset);
+        std::shared_ptr<ChunkFile> result = parseTable(header, data + header.chunkTableOffset, blob->size(), filepath);
+        if (!result)
+            return nullptr;
+
+        for (auto & storage : result->_storage)
+            storage->stored = data + storage->offset;
+
+        result->_data = blob;
+        return result;
+    }
+    else
+    {
+        log::error("ChunkFile '%s' : no data", filepath);
+    }
+    return nullptr;
+}
+
+std::shared_ptr<ChunkFile const> ChunkFile::open(
+    std::shared_ptr<vfs::IFileSystem> fs, std::filesystem::path const & path)
+{
+    std::string filepath = path.generic_string();
 
-        auto result = std::make_shared<ChunkFile>();
+    std::shared_ptr<IBlob> headerBlob = fs->readFileRange(path, 0, sizeof(Header));
+    if (!headerBlob)
+    {
+        log::error("ChunkFile '%s' : cannot read file", filepath.c_str());
+        return nullptr;
+    }
+    if (headerBlob->size() < sizeof(Header))
+    {
+        log::error("ChunkFile '%s' : invalid header", filepath.c_str());
+        return nullptr;
+    }
 
-        result->_chunks.reserve(nchunks);
+    Header header;
+    memcpy(&header, headerBlob->data(), sizeof(Header));
 
-        for (uint32_t index = 0; index < nchunks; index++)
-        {
+    size_t tableSize = getChunkTableSize(header, filepath.c_str());
+    if (tableSize == 0)
+        return nullptr;
 
-            ChunkTableEntry const & e = chunktable[index];
+    std::shared_ptr<IBlob> tableBlob = fs->readFileRange(path, header.chunkTableOffset, tableSize);
+    if (!tableBlob || tableBlob->size() < tableSize)
+    {
+        log::error("ChunkFile '%s' : invalid chunks table", filepath.c_str());
+        return nullptr;
+    }
 
-            if (blob->size() < e.offset + e.size) {
-                log::error("ChunkFile '%s' : chunk %d invalid size/offset", filepath, e.chunkId);
-                return nullptr;
-            }
+    // chunk bounds are validated against the file size when the chunks are read
+    std::shared_ptr<ChunkFile> result = parseTable(header, (uint8_t const *)tableBlob->data(),
+        std::numeric_limits<uint64_t>::max(), filepath.c_str());
+    if (!result)
+        return nullptr;
+
+    result->_fs = std::move(fs);
+    return result;
+}
+
+//
+// Upgrades
+//
+
+struct ChunkUpgrade
+{
+    uint32_t toVersion;
+    ChunkFile::UpgradeFunction upgrade;
+};
+
+struct ChunkUpgradeRegistry
+{
+    std::mutex mutex;
+    std::map<std::pair<uint32_t, uint32_t>, ChunkUpgrade> upgrades; // (type, from version)
+};
+
+static ChunkUpgradeRegistry & getUpgradeRegistry()
+{
+    static ChunkUpgradeRegistry registry;
+    return registry;
+}
+
+static bool findUpgrade(uint32_t chunkType, uint32_t version, ChunkUpgrade & result)
+{
+    ChunkUpgradeRegistry & registry = getUpgradeRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
 
-            std::unique_ptr<Chunk> chunk = std::make_unique<Chunk>(
-                Chunk({e.chunkId, e.chunkType, e.chunkVersion, e.offset, e.size, data+e.offset}));
+    auto it = registry.upgrades.find({chunkType, version});
+    if (it == registry.upgrades.end())
+        return false;
 
-            result->_chunks.push_back(std::move(chunk));
+    result = it->second;
+    return true;
+}
+
+void ChunkFile::registerUpgrade(uint32_t chunkType, uint32_t fromVersion, uint32_t toVersion, UpgradeFunction upgrade)
+{
+    // upgrades only go forward, which guarantees that chains end
+    if (toVersion <= fromVersion || !upgrade)
+    {
+        log::error("ChunkFile : invalid upgrade of chunk type 0x%x from version 0x%x to 0x%x",
+            chunkType, fromVersion, toVersion);
+        return;
+    }
+
+    ChunkUpgradeRegistry & registry = getUpgradeRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    registry.upgrades[{chunkType, fromVersion}] = {toVersion, std::move(upgrade)};
+}
+
+size_t ChunkFile::getOutdatedChunkCount() const
+{
+    ChunkUpgradeRegistry & registry = getUpgradeRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    if (registry.upgrades.empty())
+        return 0;
+
+    size_t count = 0;
+    for (auto const & chunk : _chunks)
+        if (registry.upgrades.find({chunk->chunkType, chunk->chunkVersion}) != registry.upgrades.end())
+            ++count;
+    return count;
+}
+
+std::shared_ptr<ChunkFile const> ChunkFile::upgrade() const
+{
+    size_t nchunks = _chunks.size();
+
+    std::vector<ChunkId> chunkIds;
+    chunkIds.reserve(nchunks);
+    for (auto const & chunk : _chunks)
+        chunkIds.push_back(chunk->chunkId);
+
+    // read & decompress the whole file
+    std::vector<std::shared_ptr<Chunk const>> sources;
+    if (!acquireChunks(chunkIds, sources))
+    {
+        log::error("ChunkFile '%s' : cannot upgrade a file with missing or corrupt chunks", _filepath.c_str());
+        return nullptr;
+    }
+
+    std::vector<Chunk> upgraded(nchunks);
+    std::vector<std::shared_ptr<std::vector<uint8_t>>> payloads(nchunks);
+    std::vector<char> failed(nchunks, 0);
+
+    size_t upgradeSize = 0;
+    for (size_t i=0; i<nchunks; ++i)
+    {
+        upgraded[i] = *sources[i];
+        ChunkUpgrade upgrade;
+        if (findUpgrade(upgraded[i].chunkType, upgraded[i].chunkVersion, upgrade))
+            upgradeSize += upgraded[i].size;
+    }
+
+    runParallel(nchunks, upgradeSize >= c_minParallelSize, [&](size_t i) {
+
+        Chunk & chunk = upgraded[i];
+
+        ChunkUpgrade upgrade;
+        while (findUpgrade(chunk.chunkType, chunk.chunkVersion, upgrade))
+        {
+            auto payload = std::make_shared<std::vector<uint8_t>>();
+            if (!upgrade.upgrade(chunk, *payload))
+            {
+                log::error("ChunkFile '%s' : chunk %d : upgrade of chunk type 0x%x from version 0x%x to 0x%x failed",
+                    _filepath.c_str(), chunk.chunkId, chunk.chunkType, chunk.chunkVersion, upgrade.toVersion);
+                failed[i] = 1;
+                return;
+            }
+
+            chunk.chunkVersion = upgrade.toVersion;
+            chunk.size = payload->size();
+            chunk.data = payload->data();
+            payloads[i] = std::move(payload);
         }
+    });
 
-        result->_filepath = filepath;
-        result->_data = blob;
-        return result;
+    if (std::find(failed.begin(), failed.end(), 1) != failed.end())
+        return nullptr;
+
+    auto result = std::make_shared<ChunkFile>();
+    result->_filepath = _filepath;
+
+    // write the upgraded file with the codec of the original
+    for (auto const & storage : _storage)
+        if (storage->codec != ChunkCodec::None)
+            result->_codec = storage->codec;
+
+    result->_chunks.reserve(nchunks);
+    result->_payloads.reserve(nchunks);
+    for (size_t i=0; i<nchunks; ++i)
+    {
+        upgraded[i].offset = 0;
+        result->_chunks.push_back(std::make_unique<Chunk>(upgraded[i]));
+        if (payloads[i])
+            result->_payloads.push_back(std::move(payloads[i]));
+        else
+            result->_payloads.push_back(std::move(sources[i]));
     }
-    else
+
+    return result;
+}
+
+std::shared_ptr<ChunkFile const> ChunkFile::openAndUpgrade(
+    std::shared_ptr<vfs::IFileSystem> fs, std::filesystem::path const & path)
+{
+    std::shared_ptr<ChunkFile const> cfile = open(fs, path);
+    if (!cfile)
+        return nullptr;
+
+    size_t outdated = cfile->getOutdatedChunkCount();
+    if (outdated == 0)
+        return cfile;
+
+    std::shared_ptr<ChunkFile const> upgraded = cfile->upgrade();
+    if (!upgraded)
+        return nullptr;
+
+    cfile.reset();
+
+    std::shared_ptr<IBlob const> blob = upgraded->serialize();
+    if (!blob || !fs->writeFileAtomic(path, blob->data(), blob->size()))
     {
-        log::error("ChunkFile '%s' : no data", filepath);
+        log::warning("ChunkFile '%s' : cannot write back the upgraded file", upgraded->getFilePath().c_str());
+        return upgraded;
     }
-    return nullptr;
+
+    log::info("ChunkFile '%s' : upgraded %d chunks", upgraded->getFilePath().c_str(), int(outdated));
+
+    // stream the new file, instead of keeping it in memory
+    if (std::shared_ptr<ChunkFile const> reopened = open(fs, path))
+        return reopened;
+
+    return upgraded;
 }
 
 std::shared_ptr<IBlob const> ChunkFile::serialize() const {
 
+    static_assert(sizeof(ChunkTableEntry) == 48);
+
     uint32_t nchunks = (uint32_t)_chunks.size();
 
-    size_t chunkTableSize = nchunks*sizeof(ChunkTableEntry);
+    // compress chunks
 
-    size_t blobSize = 0;
-    blobSize += sizeof(Header);
-    blobSize += chunkTableSize;
-    for (auto const & chunk : _chunks)
-        blobSize += chunk->size;
+    std::vector<std::vector<uint8_t>> compressed(nchunks);
+
+    if (_codec != ChunkCodec::None)
+    {
+        size_t totalSize = 0;
+        for (auto const & chunk : _chunks)
+            totalSize += chunk->size;
+
+        runParallel(nchunks, totalSize >= c_minParallelSize, [&](size_t i) {
+            Chunk const & chunk = *_chunks[i];
+            if (!compressChunk(_codec, _compressionLevel, chunk.data, chunk.size, compressed[i]))
+                compressed[i].clear();
+        });
+    }
+
+    size_t chunkTableOffset = alignUp(sizeof(Header), c_tableAlignment),
+           chunkTableSize = nchunks*sizeof(ChunkTableEntry);
+
+    size_t blobSize = chunkTableOffset + chunkTableSize;
+    for (uint32_t i=0; i<nchunks; ++i)
+    {
+        size_t storedSize = compressed[i].empty() ? _chunks[i]->size : compressed[i].size();
+        blobSize = alignUp(blobSize, c_chunkAlignment) + storedSize;
+    }
 
     if (uint8_t * data = (uint8_t *)malloc(blobSize))
     {
-        size_t offset = 0;
+        memset(data, 0, chunkTableOffset);
 
         // write header
         {
-            Header & header = *(Header *)(data+offset);
-            header = {{}, Header::currentVersion(), nchunks, sizeof(Header)};
+            Header & header = *(Header *)data;
+            header = {{}, Header::currentVersion(), nchunks, (uint32_t)chunkTableOffset};
             memcpy(header.signature, Header::validSignature(), 8);
-
-            offset += sizeof(Header);
         }
 
-        // write chunks table
+        // write chunks table & chunks
 
-        {
-            ChunkTableEntry * chunkTable = (ChunkTableEntry *)(data+offset);
+        ChunkTableEntry * chunkTable = (ChunkTableEntry *)(data+chunkTableOffset);
 
-            for (size_t i=0, chunkOffset=offset+chunkTableSize; i<nchunks; ++i)
-            {
-                Chunk * chunk = const_cast<Chunk *>(_chunks[i].get());
-
-                chunkTable[i] = {
-                    chunk->chunkId,
-                    chunk->chunkType,
-                    chunk->chunkVersion,
-                    chunk->offset = chunkOffset, // set chunk offset
-                    chunk->size
-                };
-                chunkOffset += chunk->size;
-            }
-
-            offset += chunkTableSize;
-        }
-
-        // write chunks
-        for (auto const & chunk : _chunks) 
+        for (size_t i=0, chunkOffset=chunkTableOffset+chunkTableSize; i<nchunks; ++i)
         {
-//            assert(offset == chunk->offset);
-            memcpy(data+chunk->offset, chunk->data, chunk->size);
-//            offset += chunk->size;
+            Chunk * chunk = const_cast<Chunk *>(_chunks[i].get());
+
+            bool isCompressed = !compressed[i].empty();
+
+            void const * stored = isCompressed ? compressed[i].data() : chunk->data;
+            size_t storedSize = isCompressed ? compressed[i].size() : chunk->size;
+
+            size_t alignedOffset = alignUp(chunkOffset, c_chunkAlignment);
+            memset(data+chunkOffset, 0, alignedOffset-chunkOffset);
+            memcpy(data+alignedOffset, stored, storedSize);
+
+            chunkTable[i] = {
+                chunk->chunkId,
+                chunk->chunkType,
+                chunk->chunkVersion,
+                isCompressed ? _codec : ChunkCodec::None,
+                chunk->offset = alignedOffset, // set chunk offset
+                storedSize,
+                chunk->size,
+                hash::xxh64(stored, storedSize)
+            };
+            chunkOffset = alignedOffset + storedSize;
         }
 
         return std::make_shared<donut::vfs::Blob const>(data, blobSize);
@@ -248,4 +913,3 @@ std::shared_ptr<IBlob const> ChunkFile::serialize() const {
 }
 
 };
-
@@ -27,12 +27,30 @@
 #include "./chunkDescs.h"
 
 #include <cassert>
+#include <cstring>
+#include <mutex>
 #include <memory>
 #include <vector>
 
 namespace donut::chunk
 {
 
+// blob that owns the data a deserialized mesh set points to : the ChunkFile,
+// handles on its resident chunks & the copies of the chunks with patched strings
+class MeshSetBlob : public donut::vfs::IBlob
+{
+public:
+
+    std::shared_ptr<donut::vfs::IBlob const> blob; // file data (deserialized files only)
+    std::shared_ptr<ChunkFile const> cfile;
+    std::vector<std::shared_ptr<Chunk const>> chunks;
+    std::vector<std::unique_ptr<uint8_t[]>> copies;
+
+    void const * data() const override { return blob ? blob->data() : nullptr; }
+
+    size_t size() const override { return blob ? blob->size() : 0; }
+};
+
 // helper class to deserialize chunks blob
 struct ChunkReader
 {
@@ -42,14 +60,29 @@ struct ChunkReader
 
     bool loadMeshInfosChunk_0x100(ChunkId chunkId, std::shared_ptr<MeshSetBase> mset);
 
-    bool loadMeshInstancesChunk_0x100(ChunkId chunkId, std::shared_ptr<MeshSetBase> mset);
+    bool loadMeshInstancesChunk_0x101(ChunkId chunkId, std::shared_ptr<MeshSetBase> mset);
 
     bool loadMeshNodesChunk_0x100(ChunkId chunkId, std::shared_ptr<MeshSetBase> mset);
 
+    bool loadMaterialsChunk_0x100(std::shared_ptr<MeshSetBase> mset);
+
     std::shared_ptr<MeshSetBase> loadMeshSetChunk_0x100(Chunk const * chunk);
 
+    std::shared_ptr<MeshSetBase> loadMeshSet();
+
+    // acquires a chunk & keeps it resident for the lifetime of the mesh set
+    template <typename ChunkDesc> Chunk const * acquireChunk(ChunkId chunkId);
+
+    // returns a copy of the chunk data owned by the mesh set : string
+    // indices are patched in place, which file data must not be
+    uint8_t * copyChunk(Chunk const * chunk);
+
+    Chunk const * findUniqueChunk(uint32_t chunkType, char const * name);
+
     std::shared_ptr<ChunkFile const> cfile;
 
+    std::shared_ptr<MeshSetBlob> holder = std::make_shared<MeshSetBlob>();
+
     inline char const * uncacheString(size_t index)
     {
         if (index!=~size_t(0) && index<stringsmap.size())
@@ -61,6 +94,56 @@ struct ChunkReader
     std::vector<char const *> stringsmap;
 };
 
+template <typename ChunkDesc> Chunk const * ChunkReader::acquireChunk(ChunkId chunkId)
+{
+    if (!chunkId.valid())
+        return nullptr;
+
+    std::shared_ptr<Chunk const> chunk = cfile->acquireChunk(chunkId);
+    if (!cfile->validateChunk<ChunkDesc>(chunk.get()))
+        return nullptr;
+
+    holder->chunks.push_back(chunk);
+    return chunk.get();
+}
+
+uint8_t * ChunkReader::copyChunk(Chunk const * chunk)
+{
+    holder->copies.emplace_back(new uint8_t[chunk->size]);
+    uint8_t * data = holder->copies.back().get();
+    memcpy(data, chunk->data, chunk->size);
+    return data;
+}
+
+Chunk const * ChunkReader::findUniqueChunk(uint32_t chunkType, char const * name)
+{
+    // chunk records are listed without acquiring the payloads
+    ChunkId chunkId;
+    size_t count = 0;
+    for (auto const & chunk : cfile->getChunks())
+    {
+        if (chunk->chunkType == chunkType)
+        {
+            chunkId = chunk->chunkId;
+            ++count;
+        }
+    }
+
+    if (count!=1)
+    {
+        log::error("Chunk deserialize : invalid number of"
+            " %s chunks in asset '%s'", name, cfile->getFilePath().c_str());
+        return nullptr;
+    }
+
+    std::shared_ptr<Chunk const> chunk = cfile->acquireChunk(chunkId);
+    if (!chunk)
+        return nullptr;
+
+    holder->chunks.push_back(chunk);
+    return chunk.get();
+}
+
 bool ChunkReader::loadStringsTableChunk_0x100(Chunk const * chunk)
 {
     typedef StringsTable_ChunkDesc_0x100 Desc;
@@ -98,9 +181,9 @@ bool ChunkReader::loadMeshInfosChunk_0x100(
 
     typedef MeshInfos_ChunkDesc_0x100 Desc;
 
-    if (Chunk const * chunk = cfile->getChunk<Desc>(chunkId))
+    if (Chunk const * chunk = acquireChunk<Desc>(chunkId))
     {
-        uint8_t const * chunkData = (uint8_t const *)chunk->data;
+        uint8_t * chunkData = copyChunk(chunk);
 
         Desc const & desc = *(Desc const *)chunkData;
 
@@ -121,7 +204,7 @@ bool ChunkReader::loadMeshInfosChunk_0x100(
 
         mset->nmeshInfos = desc.nelems;
 
-        uint8_t const * minfosData = (uint8_t *)chunkData+sizeof(Desc);
+        uint8_t * minfosData = chunkData+sizeof(Desc);
 
         auto setStrings = [&] (auto * minfos) {
             for (uint32_t i=0; i<mset->nmeshInfos; ++i) {
@@ -155,7 +238,7 @@ bool ChunkReader::loadMeshInfosChunk_0x100(
     return false;
 }
 
-bool ChunkReader::loadMeshInstancesChunk_0x100(
+bool ChunkReader::loadMeshInstancesChunk_0x101(
     ChunkId chunkId, std::shared_ptr<MeshSetBase> mset)
 {
     assert(mset);
@@ -163,11 +246,11 @@ bool ChunkReader::loadMeshInstancesChunk_0x100(
     if (!chunkId.valid())
         return false;
 
-    typedef MeshInstances_ChunkDesc_0x100 Desc;
+    typedef MeshInstances_ChunkDesc_0x101 Desc;
 
-    if (Chunk const * chunk = cfile->getChunk<Desc>(chunkId))
+    if (Chunk const * chunk = acquireChunk<Desc>(chunkId))
     {
-        uint8_t const * chunkData = (uint8_t const *)chunk->data;
+        uint8_t * chunkData = copyChunk(chunk);
 
         Desc const & desc = *(Desc const *)chunkData;
 
@@ -195,9 +278,9 @@ bool ChunkReader::loadMeshNodesChunk_0x100(
 
     typedef MeshNodes_ChunkDesc_0x100 Desc;
 
-    if (Chunk const * chunk = cfile->getChunk<Desc>(chunkId))
+    if (Chunk const * chunk = acquireChunk<Desc>(chunkId))
     {
-        uint8_t const * chunkData = (uint8_t const *)chunk->data;
+        uint8_t * chunkData = copyChunk(chunk);
 
         Desc const & desc = *(Desc const *)chunkData;
 
@@ -217,6 +300,55 @@ bool ChunkReader::loadMeshNodesChunk_0x100(
     return false;
 }
 
+bool ChunkReader::loadMaterialsChunk_0x100(std::shared_ptr<MeshSetBase> mset)
+{
+    assert(mset);
+
+    typedef Materials_ChunkDesc_0x100 Desc;
+
+    // the materials chunk is optional : sets without one have no materials description
+    ChunkId chunkId;
+    size_t count = 0;
+    for (auto const & chunk : cfile->getChunks())
+    {
+        if (chunk->chunkType == CHUNKTYPE_MATERIALS)
+        {
+            chunkId = chunk->chunkId;
+            ++count;
+        }
+    }
+
+    if (count==0)
+        return true;
+
+    if (count>1)
+    {
+        log::error("Chunk deserialize : invalid number of"
+            " materials chunks in asset '%s'", cfile->getFilePath().c_str());
+        return false;
+    }
+
+    if (Chunk const * chunk = acquireChunk<Desc>(chunkId))
+    {
+        char const * text = (char const *)chunk->data + sizeof(Desc);
+
+        if (chunk->size > sizeof(Desc))
+        {
+            Desc const & desc = *(Desc const *)chunk->data;
+
+            if (desc.length == chunk->size - sizeof(Desc) - 1 && text[desc.length] == '\0')
+            {
+                mset->materials = text;
+                return true;
+            }
+        }
+    }
+
+    log::error("bad Materials chunk in asset '%s'", cfile->getFilePath().c_str());
+
+    return false;
+}
+
 bool ChunkReader::loadStreamChunk_0x100(ChunkId chunkId, StreamHandle * handle) {
 
     typedef Stream_ChunkDesc_0x100 Desc;
@@ -224,7 +356,7 @@ bool ChunkReader::loadStreamChunk_0x100(ChunkId chunkId, StreamHandle * handle)
     if (!chunkId.valid())
         return false;
 
-    if (Chunk const * chunk = cfile->getChunk<Desc>(chunkId))
+    if (Chunk const * chunk = acquireChunk<Desc>(chunkId))
     {
         uint8_t const * chunkData = (uint8_t const *)chunk->data;
 
@@ -310,6 +442,23 @@ std::shared_ptr<MeshSetBase> ChunkReader::loadMeshSetChunk_0x100(Chunk const * c
     mset->name = uncacheString(desc.name);
     mset->bbox = desc.bbox;
 
+    // read, decompress & verify all the chunks of the set at once, using multiple threads
+    std::vector<ChunkId> chunkIds;
+    for (ChunkId chunkId : desc.streamChunkIds)
+        if (chunkId.valid())
+            chunkIds.push_back(chunkId);
+    for (ChunkId chunkId : {desc.minfosChunkId, desc.instancesChunkId, desc.nodesChunkId})
+        if (chunkId.valid())
+            chunkIds.push_back(chunkId);
+
+    std::vector<std::shared_ptr<Chunk const>> chunks;
+    if (!cfile->acquireChunks(chunkIds, chunks))
+    {
+        log::error("Chunk deserialize : missing or corrupt chunks in asset '%s'",
+            cfile->getFilePath().c_str());
+        return nullptr;
+    }
+
     StreamHandle handle;
 
     handle = {"Position", FP32, VERTEX, POSITION, 0, sizeof(donut::math::float3), nullptr};
@@ -390,7 +539,7 @@ std::shared_ptr<MeshSetBase> ChunkReader::loadMeshSetChunk_0x100(Chunk const * c
     if (!loadMeshInfosChunk_0x100(desc.minfosChunkId, mset))
         return nullptr;
 
-    if (!loadMeshInstancesChunk_0x100(desc.instancesChunkId, mset))
+    if (!loadMeshInstancesChunk_0x101(desc.instancesChunkId, mset))
         return nullptr;
 
     if (desc.nodesChunkId.valid())
@@ -400,6 +549,69 @@ std::shared_ptr<MeshSetBase> ChunkReader::loadMeshSetChunk_0x100(Chunk const * c
     return mset;
 }
 
+std::shared_ptr<MeshSetBase> ChunkReader::loadMeshSet()
+{
+    // files with outdated chunks are upgraded in memory
+    if (cfile->getOutdatedChunkCount() > 0)
+    {
+        if (!(cfile = cfile->upgrade()))
+            return nullptr;
+    }
+
+    holder->cfile = cfile;
+
+    // load strings table chunk
+    Chunk const * chunk = findUniqueChunk(CHUNKTYPE_STRINGS_TABLE, "string table");
+    if (!chunk || !loadStringsTableChunk_0x100(chunk))
+        return nullptr;
+
+    // load meshset chunk
+    chunk = findUniqueChunk(CHUNKTYPE_MESHSET, "meshset");
+    if (!chunk)
+        return nullptr;
+
+    std::shared_ptr<MeshSetBase> mset = loadMeshSetChunk_0x100(chunk);
+    if (!mset || !loadMaterialsChunk_0x100(mset))
+        return nullptr;
+
+    mset->blob = holder;
+    return mset;
+}
+
+//
+// upgrades
+//
+
+// 0x101 : aligns the instances on 8 bytes
+static bool upgradeMeshInstancesChunk_0x100(Chunk const & chunk, std::vector<uint8_t> & result)
+{
+    typedef MeshInstances_ChunkDesc_0x100 OldDesc;
+    typedef MeshInstances_ChunkDesc_0x101 Desc;
+
+    if (chunk.size < sizeof(OldDesc))
+        return false;
+
+    Desc desc;
+    memcpy(&desc.ninstances, chunk.data, sizeof(uint32_t));
+
+    size_t dataSize = chunk.size - sizeof(OldDesc);
+    if (dataSize != desc.ninstances * sizeof(MeshInstance))
+        return false;
+
+    result.resize(sizeof(Desc) + dataSize);
+    memcpy(result.data(), &desc, sizeof(Desc));
+    memcpy(result.data() + sizeof(Desc), (uint8_t const *)chunk.data + sizeof(OldDesc), dataSize);
+    return true;
+}
+
+static void registerUpgrades()
+{
+    static std::once_flag registered;
+    std::call_once(registered, []() {
+        ChunkFile::registerUpgrade(CHUNKTYPE_MESH_INSTANCES, 0x100, 0x101, upgradeMeshInstancesChunk_0x100);
+    });
+}
+
 //
 // implementation
 //
@@ -408,41 +620,16 @@ std::shared_ptr<MeshSetBase const> deserialize(
     std::weak_ptr<donut::vfs::IBlob const> iblob, char const * assetpath)
 {
 
+    registerUpgrades();
+
     ChunkReader reader;
 
     if (auto const blob = iblob.lock())
     {
         if ((reader.cfile = ChunkFile::deserialize(blob, assetpath)))
         {
-            std::vector<Chunk const *> chunks(1);
-
-            // load strings table chunk
-            reader.cfile->getChunks(CHUNKTYPE_STRINGS_TABLE, chunks);
-            if (chunks.size()!=1)
-            {
-                log::error("Chunk deserialize : invalid number of"
-                    " string table chunks in asset '%s'", assetpath);
-                return nullptr;
-            }
-            if (!reader.loadStringsTableChunk_0x100(chunks[0]))
-                return nullptr;
-
-            // load meshset chunk
-            reader.cfile->getChunks(CHUNKTYPE_MESHSET, chunks);
-            if (chunks.size()!=1)
-            {
-                log::error("Chunk deserialize : invalid number of"
-                    " meshset chunks in asset '%s'", assetpath);
-                return nullptr;
-            }
-
-            std::shared_ptr<MeshSetBase> mset =
-                reader.loadMeshSetChunk_0x100(chunks[0]);
-            if (mset)
-            {
-                mset->blob = blob;
-                return mset;
-            }
+            reader.holder->blob = blob;
+            return reader.loadMeshSet();
         }
     }
     else
@@ -452,4 +639,24 @@ std::shared_ptr<MeshSetBase const> deserialize(
     return nullptr;
 }
 
+std::shared_ptr<MeshSetBase const> deserialize(std::shared_ptr<ChunkFile const> cfile)
+{
+    if (!cfile)
+        return nullptr;
+
+    registerUpgrades();
+
+    ChunkReader reader;
+    reader.cfile = std::move(cfile);
+    return reader.loadMeshSet();
+}
+
+std::shared_ptr<ChunkFile const> open(
+    std::shared_ptr<donut::vfs::IFileSystem> fs, std::filesystem::path const & path)
+{
+    registerUpgrades();
+
+    return ChunkFile::openAndUpgrade(std::move(fs), path);
+}
+
 }
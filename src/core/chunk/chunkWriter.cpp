@@ -26,7 +26,10 @@
 
 #include "./chunkDescs.h"
 
+#include <cstring>
 #include <map>
+#include <memory>
+#include <vector>
 
 namespace donut::chunk
 {
@@ -43,10 +46,21 @@ public:
 
     ChunkId createStringsTableChunk();
 
+    // chunk data is owned by the writer until the file is serialized
+    uint8_t * allocateChunk(size_t size);
+
 private:
     std::map<std::string, size_t> m_stringsmap;
+
+    std::vector<std::unique_ptr<uint8_t[]>> m_chunksData;
 };
 
+uint8_t * ChunkWriter::allocateChunk(size_t size)
+{
+    m_chunksData.emplace_back(new uint8_t[size]);
+    return m_chunksData.back().get();
+}
+
 size_t ChunkWriter::cacheString(char const * str)
 {
     if (str)
@@ -101,7 +115,7 @@ ChunkId ChunkWriter::createStringsTableChunk()
 
     size_t chunkSize = descSize + tableSize + stringsSize;
 
-    uint8_t * chunkData = new uint8_t[chunkSize];
+    uint8_t * chunkData = allocateChunk(chunkSize);
 
     Desc * desc = (Desc *)chunkData;
     desc->flags = 0;
@@ -142,7 +156,7 @@ static ChunkId chunkStream(StreamHandle const & handle, ChunkWriter & writer)
            dataSize = handle.elemSize * handle.elemCount,
            chunkSize = descSize + dataSize;
 
-    uint8_t * chunkData = new uint8_t[chunkSize];
+    uint8_t * chunkData = writer.allocateChunk(chunkSize);
 
     // fill descriptor
 
@@ -177,7 +191,7 @@ template <typename T> static ChunkId chunkMeshInfos(
     Desc::Type type =
         std::is_same<T, MeshletInfo>::value ? Desc::MESHLET : Desc::MESH;
 
-    uint8_t * chunkData = new uint8_t[chunkSize];
+    uint8_t * chunkData = writer.allocateChunk(chunkSize);
 
     // fill descriptor
 
@@ -206,18 +220,19 @@ static ChunkId chunkMeshInstances(
     if (ninstances==0)
         return ChunkId();
 
-    typedef MeshInstances_ChunkDesc_0x100 Desc;
+    typedef MeshInstances_ChunkDesc_0x101 Desc;
 
     size_t descSize = sizeof(Desc),
            dataSize = ninstances * sizeof(MeshInstance),
            chunkSize = descSize + dataSize;
 
-    uint8_t * chunkData = new uint8_t[chunkSize];
+    uint8_t * chunkData = writer.allocateChunk(chunkSize);
 
     // fill descriptor
 
     Desc * desc = (Desc *)chunkData;
     desc->ninstances = ninstances;
+    desc->padding = 0;
 
     // process instances entries
 
@@ -245,7 +260,7 @@ static ChunkId chunkMeshNodes(
            dataSize = nnodes * sizeof(MeshNode),
            chunkSize = descSize + dataSize;
 
-    uint8_t * chunkData = new uint8_t[chunkSize];
+    uint8_t * chunkData = writer.allocateChunk(chunkSize);
 
     // fill descriptor
 
@@ -268,12 +283,38 @@ static ChunkId chunkMeshNodes(
     return writer.cfile.addChunk<Desc>(chunkData, chunkSize);
 }
 
+// serialize the materials description
+static ChunkId chunkMaterials(char const * materials, ChunkWriter & writer)
+{
+    typedef Materials_ChunkDesc_0x100 Desc;
+
+    size_t descSize = sizeof(Desc),
+           length = strlen(materials),
+           chunkSize = descSize + length + 1;
+
+    uint8_t * chunkData = writer.allocateChunk(chunkSize);
+
+    // fill descriptor
+
+    Desc * desc = (Desc *)chunkData;
+    desc->flags = 0;
+    desc->length = length;
+
+    // copy the text, including the null terminator
+
+    memcpy(chunkData + descSize, materials, length + 1);
+
+    return writer.cfile.addChunk<Desc>(chunkData, chunkSize);
+}
+
 // serialize MeshSets
-std::shared_ptr<donut::vfs::IBlob const> serialize(MeshSetBase const & mset)
+std::shared_ptr<donut::vfs::IBlob const> serialize(MeshSetBase const & mset, ChunkCodec codec, int level)
 {
 
     ChunkWriter writer;
 
+    writer.cfile.setCompression(codec, level);
+
     typedef MeshSet_ChunkDesc_0x100 Desc;
 
     Desc::Type type;
@@ -380,13 +421,16 @@ std::shared_ptr<donut::vfs::IBlob const> serialize(MeshSetBase const & mset)
 
     size_t chunkSize = sizeof(Desc);
 
-    uint8_t * chunkData = new uint8_t[chunkSize];
+    uint8_t * chunkData = writer.allocateChunk(chunkSize);
 
     memcpy(chunkData, &desc, chunkSize);
 
     if (!writer.cfile.addChunk<Desc>(chunkData, chunkSize).valid())
         return nullptr;
 
+    if (mset.materials && !chunkMaterials(mset.materials, writer).valid())
+        return nullptr;
+
     if (!writer.createStringsTableChunk().valid())
         return nullptr;
 
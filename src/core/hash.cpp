@@ -0,0 +1,207 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/core/hash.h>
+#include <cstring>
+
+namespace donut::hash
+{
+    static constexpr uint64_t c_Prime1 = 0x9E3779B185EBCA87ull;
+    static constexpr uint64_t c_Prime2 = 0xC2B2AE3D27D4EB4Full;
+    static constexpr uint64_t c_Prime3 = 0x165667B19E3779F9ull;
+    static constexpr uint64_t c_Prime4 = 0x85EBCA77C2B2AE63ull;
+    static constexpr uint64_t c_Prime5 = 0x27D4EB2F165667C5ull;
+
+    static constexpr uint32_t c_Prime32_1 = 0x9E3779B1u;
+    static constexpr uint32_t c_Prime32_2 = 0x85EBCA77u;
+    static constexpr uint32_t c_Prime32_3 = 0xC2B2AE3Du;
+    static constexpr uint32_t c_Prime32_4 = 0x27D4EB2Fu;
+    static constexpr uint32_t c_Prime32_5 = 0x165667B1u;
+
+    static inline uint64_t rotl(uint64_t x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    static inline uint32_t rotl32(uint32_t x, int r)
+    {
+        return (x << r) | (x >> (32 - r));
+    }
+
+    // Unaligned little-endian reads; memcpy compiles into a single load on all relevant platforms
+    static inline uint64_t read64(const uint8_t* p)
+    {
+        uint64_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static inline uint32_t read32(const uint8_t* p)
+    {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static inline uint64_t accumulate(uint64_t acc, uint64_t input)
+    {
+        acc += input * c_Prime2;
+        acc = rotl(acc, 31);
+        acc *= c_Prime1;
+        return acc;
+    }
+
+    static inline uint32_t accumulate32(uint32_t acc, uint32_t input)
+    {
+        acc += input * c_Prime32_2;
+        acc = rotl32(acc, 13);
+        acc *= c_Prime32_1;
+        return acc;
+    }
+
+    static inline uint64_t mergeAccumulator(uint64_t acc, uint64_t val)
+    {
+        val = accumulate(0, val);
+        acc ^= val;
+        acc = acc * c_Prime1 + c_Prime4;
+        return acc;
+    }
+
+    uint64_t xxh64(const void* data, size_t size, uint64_t seed)
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        const uint8_t* const end = p + size;
+        uint64_t h64;
+
+        if (size >= 32)
+        {
+            const uint8_t* const limit = end - 32;
+            uint64_t v1 = seed + c_Prime1 + c_Prime2;
+            uint64_t v2 = seed + c_Prime2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - c_Prime1;
+
+            do
+            {
+                v1 = accumulate(v1, read64(p)); p += 8;
+                v2 = accumulate(v2, read64(p)); p += 8;
+                v3 = accumulate(v3, read64(p)); p += 8;
+                v4 = accumulate(v4, read64(p)); p += 8;
+            } while (p <= limit);
+
+            h64 = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            h64 = mergeAccumulator(h64, v1);
+            h64 = mergeAccumulator(h64, v2);
+            h64 = mergeAccumulator(h64, v3);
+            h64 = mergeAccumulator(h64, v4);
+        }
+        else
+        {
+            h64 = seed + c_Prime5;
+        }
+
+        h64 += uint64_t(size);
+
+        while (p + 8 <= end)
+        {
+            h64 ^= accumulate(0, read64(p));
+            h64 = rotl(h64, 27) * c_Prime1 + c_Prime4;
+            p += 8;
+        }
+
+        if (p + 4 <= end)
+        {
+            h64 ^= uint64_t(read32(p)) * c_Prime1;
+            h64 = rotl(h64, 23) * c_Prime2 + c_Prime3;
+            p += 4;
+        }
+
+        while (p < end)
+        {
+            h64 ^= (*p) * c_Prime5;
+            h64 = rotl(h64, 11) * c_Prime1;
+            ++p;
+        }
+
+        h64 ^= h64 >> 33;
+        h64 *= c_Prime2;
+        h64 ^= h64 >> 29;
+        h64 *= c_Prime3;
+        h64 ^= h64 >> 32;
+
+        return h64;
+    }
+
+    uint32_t xxh32(const void* data, size_t size, uint32_t seed)
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        const uint8_t* const end = p + size;
+        uint32_t h32;
+
+        if (size >= 16)
+        {
+            const uint8_t* const limit = end - 16;
+            uint32_t v1 = seed + c_Prime32_1 + c_Prime32_2;
+            uint32_t v2 = seed + c_Prime32_2;
+            uint32_t v3 = seed;
+            uint32_t v4 = seed - c_Prime32_1;
+
+            do
+            {
+                v1 = accumulate32(v1, read32(p)); p += 4;
+                v2 = accumulate32(v2, read32(p)); p += 4;
+                v3 = accumulate32(v3, read32(p)); p += 4;
+                v4 = accumulate32(v4, read32(p)); p += 4;
+            } while (p <= limit);
+
+            h32 = rotl32(v1, 1) + rotl32(v2, 7) + rotl32(v3, 12) + rotl32(v4, 18);
+        }
+        else
+        {
+            h32 = seed + c_Prime32_5;
+        }
+
+        h32 += uint32_t(size);
+
+        while (p + 4 <= end)
+        {
+            h32 += read32(p) * c_Prime32_3;
+            h32 = rotl32(h32, 17) * c_Prime32_4;
+            p += 4;
+        }
+
+        while (p < end)
+        {
+            h32 += (*p) * c_Prime32_5;
+            h32 = rotl32(h32, 11) * c_Prime32_1;
+            ++p;
+        }
+
+        h32 ^= h32 >> 15;
+        h32 *= c_Prime32_2;
+        h32 ^= h32 >> 13;
+        h32 *= c_Prime32_3;
+        h32 ^= h32 >> 16;
+
+        return h32;
+    }
+}
@@ -0,0 +1,226 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/core/math/math.h>
+#include <donut/core/parallel.h>
+
+#include <algorithm>
+
+namespace donut::math::batch
+{
+	// arrays are only split into tasks when every task gets at least this many elements
+	static constexpr size_t c_minParallelCount = 16384;
+
+	// runs task(begin, end) over [0, count), split into one range per executor worker if there is an executor
+	// and the array is large enough; the ranges stay aligned to groups of 4 elements for the SIMD loops
+	template <typename Task> static void forEachRange(size_t count, tf::Executor* executor, Task const & task)
+	{
+		parallel::forEachRange(executor, count, count / c_minParallelCount, 4, task);
+	}
+
+	void transformPoints(affine3 const & transform, float3 const * points, float3 * result, size_t count, tf::Executor* executor)
+	{
+		forEachRange(count, executor, [&](size_t begin, size_t end) {
+			size_t i = begin;
+#if DM_SIMD
+			simd::float4_t r0, r1, r2, t;
+			simd::load3x4(transform.m_linear.m_data, r0, r1, r2, t);
+
+			for (; i + 4 <= end; i += 4)
+			{
+				simd::float4_t p0, p1, p2, p3;
+				simd::load3x4(points[i].data(), p0, p1, p2, p3);
+				simd::store3x4(result[i].data(),
+					simd::add(simd::transform3(p0, r0, r1, r2), t),
+					simd::add(simd::transform3(p1, r0, r1, r2), t),
+					simd::add(simd::transform3(p2, r0, r1, r2), t),
+					simd::add(simd::transform3(p3, r0, r1, r2), t));
+			}
+#endif
+			for (; i < end; i++)
+				result[i] = transform.transformPoint(points[i]);
+		});
+	}
+
+	void transformBoxes(affine3 const & transform, box3 const * boxes, box3 * result, size_t count, tf::Executor* executor)
+	{
+		forEachRange(count, executor, [&](size_t begin, size_t end) {
+#if DM_SIMD
+			simd::float4_t r0, r1, r2, t;
+			simd::load3x4(transform.m_linear.m_data, r0, r1, r2, t);
+
+			// two boxes are four packed 3-vectors
+			size_t i = begin;
+			for (; i + 2 <= end; i += 2)
+			{
+				simd::float4_t mins0, maxs0, mins1, maxs1;
+				simd::load3x4(boxes[i].m_mins.data(), mins0, maxs0, mins1, maxs1);
+				simd::transformBox3(mins0, maxs0, r0, r1, r2, t, mins0, maxs0);
+				simd::transformBox3(mins1, maxs1, r0, r1, r2, t, mins1, maxs1);
+				simd::store3x4(result[i].m_mins.data(), mins0, maxs0, mins1, maxs1);
+			}
+
+			for (; i < end; i++)
+				simd::transformBox3(boxes[i].m_mins.data(), r0, r1, r2, t, result[i].m_mins.data());
+#else
+			for (size_t i = begin; i < end; i++)
+				result[i] = boxes[i] * transform;
+#endif
+		});
+	}
+
+	void transformBoxes(affine3 const * transforms, box3 const * boxes, box3 * result, size_t count, tf::Executor* executor)
+	{
+		forEachRange(count, executor, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+				result[i] = boxes[i] * transforms[i];
+		});
+	}
+
+	void multiply(affine3 const * a, affine3 const * b, affine3 * result, size_t count, tf::Executor* executor)
+	{
+		forEachRange(count, executor, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+				result[i] = a[i] * b[i];
+		});
+	}
+
+	void multiply(affine3 const * a, affine3 const & b, affine3 * result, size_t count, tf::Executor* executor)
+	{
+		forEachRange(count, executor, [&](size_t begin, size_t end) {
+#if DM_SIMD
+			simd::float4_t b0, b1, b2, bt;
+			simd::load3x4(b.m_linear.m_data, b0, b1, b2, bt);
+
+			for (size_t i = begin; i < end; i++)
+				simd::mulAffine3(a[i].m_linear.m_data, b0, b1, b2, bt, result[i].m_linear.m_data);
+#else
+			for (size_t i = begin; i < end; i++)
+				result[i] = a[i] * b;
+#endif
+		});
+	}
+
+	void multiply(float4x4 const * a, affine3 const * b, float4x4 * result, size_t count, tf::Executor* executor)
+	{
+		forEachRange(count, executor, [&](size_t begin, size_t end) {
+#if DM_SIMD
+			const simd::float4_t xyzMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+			const simd::float4_t w1 = _mm_setr_ps(0.f, 0.f, 0.f, 1.f);
+
+			for (size_t i = begin; i < end; i++)
+			{
+				simd::float4_t l0, l1, l2, t;
+				simd::load3x4(b[i].m_linear.m_data, l0, l1, l2, t);
+
+				float homogeneous[16];
+				simd::store4(homogeneous + 0, _mm_and_ps(l0, xyzMask));
+				simd::store4(homogeneous + 4, _mm_and_ps(l1, xyzMask));
+				simd::store4(homogeneous + 8, _mm_and_ps(l2, xyzMask));
+				simd::store4(homogeneous + 12, _mm_or_ps(_mm_and_ps(t, xyzMask), w1));
+
+				// the product reads all of a[i] before writing, so result may be a
+				simd::mulMatrix4x4(a[i].m_data, homogeneous, result[i].m_data);
+			}
+#else
+			for (size_t i = begin; i < end; i++)
+				result[i] = a[i] * affineToHomogeneous(b[i]);
+#endif
+		});
+	}
+
+	void convert(daffine3 const * a, affine3 * result, size_t count, tf::Executor* executor)
+	{
+		forEachRange(count, executor, [&](size_t begin, size_t end) {
+#if DM_SIMD
+			static_assert(sizeof(daffine3) == 12 * sizeof(double));
+			static_assert(sizeof(affine3) == 12 * sizeof(float));
+
+			for (size_t i = begin; i < end; i++)
+			{
+				const double* src = a[i].m_linear.m_data;
+				float* dst = result[i].m_linear.m_data;
+				for (int j = 0; j < 12; j += 4)
+				{
+					simd::float4_t lo = _mm_cvtpd_ps(_mm_loadu_pd(src + j));
+					simd::float4_t hi = _mm_cvtpd_ps(_mm_loadu_pd(src + j + 2));
+					simd::store4(dst + j, _mm_movelh_ps(lo, hi));
+				}
+			}
+#else
+			for (size_t i = begin; i < end; i++)
+				result[i] = affine3(a[i]);
+#endif
+		});
+	}
+
+	void affineToColumnMajor(affine3 const * a, float * result, size_t resultStride, size_t count, tf::Executor* executor)
+	{
+		forEachRange(count, executor, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+			{
+				float* dst = reinterpret_cast<float*>(reinterpret_cast<char*>(result) + i * resultStride);
+#if DM_SIMD
+				simd::float4_t r0, r1, r2, t;
+				simd::load3x4(a[i].m_linear.m_data, r0, r1, r2, t);
+				_MM_TRANSPOSE4_PS(r0, r1, r2, t);
+				simd::store4(dst + 0, r0);
+				simd::store4(dst + 4, r1);
+				simd::store4(dst + 8, r2);
+#else
+				math::affineToColumnMajor(a[i], dst);
+#endif
+			}
+		});
+	}
+
+	box3 bounds(float3 const * points, size_t count)
+	{
+		box3 result = box3::empty();
+		size_t i = 0;
+#if DM_SIMD
+		if (count >= 4)
+		{
+			simd::float4_t mins = simd::load4(result.m_mins.data());
+			simd::float4_t maxs = simd::load3(result.m_maxs.data());
+
+			for (; i + 4 <= count; i += 4)
+			{
+				simd::float4_t p0, p1, p2, p3;
+				simd::load3x4(points[i].data(), p0, p1, p2, p3);
+				mins = simd::min(simd::min(simd::min(simd::min(mins, p0), p1), p2), p3);
+				maxs = simd::max(simd::max(simd::max(simd::max(maxs, p0), p1), p2), p3);
+			}
+
+			float m[4];
+			simd::store4(m, mins);
+			result.m_mins = float3(m[0], m[1], m[2]);
+			simd::store4(m, maxs);
+			result.m_maxs = float3(m[0], m[1], m[2]);
+		}
+#endif
+		for (; i < count; i++)
+			result |= points[i];
+
+		return result;
+	}
+}
@@ -0,0 +1,84 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/core/parallel.h>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+#include <algorithm>
+#include <atomic>
+
+namespace donut::parallel
+{
+    void forEachRange([[maybe_unused]] tf::Executor* executor, size_t count, [[maybe_unused]] size_t maxRanges,
+        [[maybe_unused]] size_t alignment, const std::function<void(size_t begin, size_t end)>& task)
+    {
+        if (count == 0)
+            return;
+
+#ifdef DONUT_WITH_TASKFLOW
+        if (executor && executor->this_worker_id() < 0)
+        {
+            alignment = std::max(alignment, size_t(1));
+            const size_t numRanges = std::min({ maxRanges, executor->num_workers(), (count + alignment - 1) / alignment });
+
+            if (numRanges >= 2)
+            {
+                const size_t rangeSize = ((count + numRanges - 1) / numRanges + alignment - 1) / alignment * alignment;
+
+                tf::Taskflow taskflow;
+                for (size_t begin = 0; begin < count; begin += rangeSize)
+                    taskflow.emplace([&task, begin, end = std::min(begin + rangeSize, count)]() { task(begin, end); });
+                executor->run(taskflow).wait();
+                return;
+            }
+        }
+#endif
+
+        task(size_t(0), count);
+    }
+
+    void forEachIndex(tf::Executor* executor, size_t count, size_t maxTasks, const std::function<void(size_t index)>& task)
+    {
+        std::atomic<size_t> nextIndex = 0;
+
+        // one loop per range, each taking the next index until there are none left
+        const size_t numTasks = std::min(count, std::max(maxTasks, size_t(1)));
+        forEachRange(executor, numTasks, numTasks, 1, [&](size_t, size_t)
+        {
+            for (size_t index; (index = nextIndex++) < count; )
+                task(index);
+        });
+    }
+
+    tf::Executor* getSharedExecutor()
+    {
+#ifdef DONUT_WITH_TASKFLOW
+        static tf::Executor executor;
+        return &executor;
+#else
+        return nullptr;
+#endif
+    }
+}
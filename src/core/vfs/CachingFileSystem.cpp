@@ -0,0 +1,383 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/core/vfs/CachingFileSystem.h>
+
+using namespace donut::vfs;
+
+CachingFileSystem::CachingFileSystem(std::shared_ptr<IFileSystem> fs, size_t budgetBytes)
+    : m_fs(std::move(fs))
+    , m_Budget(budgetBytes)
+{
+}
+
+CachingFileSystem::~CachingFileSystem()
+{
+    // the callbacks of the reads in flight reference the cache
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_ReadCompleted.wait(lock, [this]() { return m_NumPrefetchesInFlight == 0 && m_NumReadsInFlight == 0; });
+}
+
+std::string CachingFileSystem::getCacheKey(const std::filesystem::path& name)
+{
+    return name.lexically_normal().generic_string();
+}
+
+std::shared_ptr<IBlob> CachingFileSystem::findBlob(const std::string& key)
+{
+    auto it = m_Entries.find(key);
+    if (it == m_Entries.end())
+        return nullptr;
+
+    // Move the entry to the front of the LRU list
+    m_LruList.splice(m_LruList.begin(), m_LruList, it->second.lruPosition);
+    return it->second.blob;
+}
+
+void CachingFileSystem::insertBlob(const std::string& key, std::shared_ptr<IBlob> blob)
+{
+    eraseBlob(key);
+
+    const size_t size = blob->size();
+    if (size > m_Budget)
+        return;
+
+    while (m_Statistics.cachedBytes + size > m_Budget && !m_LruList.empty())
+    {
+        eraseBlob(m_LruList.back());
+        ++m_Statistics.evictions;
+    }
+
+    m_LruList.push_front(key);
+    m_Entries[key] = CacheEntry{ std::move(blob), m_LruList.begin() };
+    m_Statistics.cachedBytes += size;
+    ++m_Statistics.cachedFiles;
+}
+
+void CachingFileSystem::eraseBlob(const std::string& key)
+{
+    auto it = m_Entries.find(key);
+    if (it == m_Entries.end())
+        return;
+
+    m_Statistics.cachedBytes -= it->second.blob->size();
+    --m_Statistics.cachedFiles;
+    m_LruList.erase(it->second.lruPosition);
+    m_Entries.erase(it);
+}
+
+void CachingFileSystem::setBudget(size_t budgetBytes)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_Budget = budgetBytes;
+
+    while (m_Statistics.cachedBytes > m_Budget)
+    {
+        eraseBlob(m_LruList.back());
+        ++m_Statistics.evictions;
+    }
+}
+
+void CachingFileSystem::prefetch(const std::vector<std::filesystem::path>& names, ReadPriority priority)
+{
+    std::vector<AsyncReadRequest> requests;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        for (const auto& name : names)
+        {
+            std::string key = getCacheKey(name);
+
+            if (m_Entries.find(key) != m_Entries.end() || m_MissingFiles.find(key) != m_MissingFiles.end())
+                continue;
+
+            if (!m_PendingPrefetches.insert(key).second)
+                continue;
+
+            ++m_NumPrefetchesInFlight;
+
+            const uint64_t generation = m_Generation;
+            requests.push_back(AsyncReadRequest{ name, [this, key, generation](std::shared_ptr<IBlob> blob)
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+
+                // Discard the result if the file was invalidated while it was being read
+                if (m_PendingPrefetches.erase(key) && generation == m_Generation && blob)
+                {
+                    insertBlob(key, std::move(blob));
+                    ++m_Statistics.prefetches;
+                }
+
+                --m_NumPrefetchesInFlight;
+                m_ReadCompleted.notify_all();
+            }, priority });
+        }
+    }
+
+    if (!requests.empty())
+        m_fs->readFilesAsync(std::move(requests));
+}
+
+void CachingFileSystem::waitForPrefetches()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_ReadCompleted.wait(lock, [this]() { return m_NumPrefetchesInFlight == 0; });
+}
+
+void CachingFileSystem::invalidate(const std::filesystem::path& name)
+{
+    const std::string key = getCacheKey(name);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    eraseBlob(key);
+    m_MissingFiles.erase(key);
+    m_PendingPrefetches.erase(key);
+    ++m_Generation;
+    m_ReadCompleted.notify_all();
+}
+
+void CachingFileSystem::clear()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Entries.clear();
+    m_LruList.clear();
+    m_MissingFiles.clear();
+    m_PendingPrefetches.clear();
+    m_Statistics.cachedBytes = 0;
+    m_Statistics.cachedFiles = 0;
+    ++m_Generation;
+    m_ReadCompleted.notify_all();
+}
+
+CachingFileSystem::Statistics CachingFileSystem::getStatistics()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Statistics;
+}
+
+void CachingFileSystem::resetStatistics()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    Statistics statistics;
+    statistics.cachedBytes = m_Statistics.cachedBytes;
+    statistics.cachedFiles = m_Statistics.cachedFiles;
+    m_Statistics = statistics;
+}
+
+bool CachingFileSystem::folderExists(const std::filesystem::path& name)
+{
+    return m_fs->folderExists(name);
+}
+
+bool CachingFileSystem::fileExists(const std::filesystem::path& name)
+{
+    const std::string key = getCacheKey(name);
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        if (m_Entries.find(key) != m_Entries.end())
+            return true;
+
+        if (m_MissingFiles.find(key) != m_MissingFiles.end())
+        {
+            ++m_Statistics.negativeHits;
+            return false;
+        }
+    }
+
+    if (m_fs->fileExists(name))
+        return true;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_MissingFiles.insert(key);
+    return false;
+}
+
+std::shared_ptr<IBlob> CachingFileSystem::readFile(const std::filesystem::path& name)
+{
+    const std::string key = getCacheKey(name);
+    uint64_t generation;
+
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+
+        // Don't read the same file twice if it's being prefetched
+        m_ReadCompleted.wait(lock, [this, &key]() { return m_PendingPrefetches.find(key) == m_PendingPrefetches.end(); });
+
+        if (std::shared_ptr<IBlob> blob = findBlob(key))
+        {
+            ++m_Statistics.hits;
+            return blob;
+        }
+
+        if (m_MissingFiles.find(key) != m_MissingFiles.end())
+        {
+            ++m_Statistics.negativeHits;
+            return nullptr;
+        }
+
+        ++m_Statistics.misses;
+        generation = m_Generation;
+    }
+
+    std::shared_ptr<IBlob> blob = m_fs->readFile(name);
+
+    if (blob)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (generation == m_Generation)
+            insertBlob(key, blob);
+    }
+
+    return blob;
+}
+
+std::shared_ptr<IBlob> CachingFileSystem::mapFile(const std::filesystem::path& name)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (std::shared_ptr<IBlob> blob = findBlob(getCacheKey(name)))
+        {
+            ++m_Statistics.hits;
+            return blob;
+        }
+    }
+
+    // Mapped files don't use heap memory, so they are not added to the cache
+    return m_fs->mapFile(name);
+}
+
+std::shared_ptr<IBlob> CachingFileSystem::readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (std::shared_ptr<IBlob> blob = findBlob(getCacheKey(name)))
+        {
+            ++m_Statistics.hits;
+            return copyBlobRange(blob->data(), blob->size(), offset, size);
+        }
+    }
+
+    return m_fs->readFileRange(name, offset, size);
+}
+
+bool CachingFileSystem::getFileSize(const std::filesystem::path& name, uint64_t& size)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        const std::string key = getCacheKey(name);
+
+        if (std::shared_ptr<IBlob> blob = findBlob(key))
+        {
+            size = blob->size();
+            return true;
+        }
+
+        if (m_MissingFiles.find(key) != m_MissingFiles.end())
+            return false;
+    }
+
+    return m_fs->getFileSize(name, size);
+}
+
+void CachingFileSystem::readFilesAsync(std::vector<AsyncReadRequest> requests)
+{
+    std::vector<AsyncReadRequest> uncachedRequests;
+    std::vector<std::pair<read_callback_t, std::shared_ptr<IBlob>>> completedRequests;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        for (auto& request : requests)
+        {
+            std::string key = getCacheKey(request.name);
+
+            if (std::shared_ptr<IBlob> blob = findBlob(key))
+            {
+                ++m_Statistics.hits;
+                completedRequests.emplace_back(std::move(request.callback), std::move(blob));
+                continue;
+            }
+
+            if (m_MissingFiles.find(key) != m_MissingFiles.end())
+            {
+                ++m_Statistics.negativeHits;
+                completedRequests.emplace_back(std::move(request.callback), nullptr);
+                continue;
+            }
+
+            ++m_Statistics.misses;
+
+            const uint64_t generation = m_Generation;
+            read_callback_t callback = std::move(request.callback);
+            ++m_NumReadsInFlight;
+            request.callback = [this, key, generation, callback](std::shared_ptr<IBlob> blob)
+            {
+                if (blob)
+                {
+                    std::lock_guard<std::mutex> lock(m_Mutex);
+                    if (generation == m_Generation)
+                        insertBlob(key, blob);
+                }
+                callback(std::move(blob));
+
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                --m_NumReadsInFlight;
+                m_ReadCompleted.notify_all();
+            };
+            uncachedRequests.push_back(std::move(request));
+        }
+    }
+
+    for (auto& [callback, blob] : completedRequests)
+        callback(std::move(blob));
+
+    if (!uncachedRequests.empty())
+        m_fs->readFilesAsync(std::move(uncachedRequests));
+}
+
+bool CachingFileSystem::writeFile(const std::filesystem::path& name, const void* data, size_t size)
+{
+    const bool result = m_fs->writeFile(name, data, size);
+    invalidate(name);
+    return result;
+}
+
+bool CachingFileSystem::writeFileAtomic(const std::filesystem::path& name, const void* data, size_t size)
+{
+    const bool result = m_fs->writeFileAtomic(name, data, size);
+    invalidate(name);
+    return result;
+}
+
+int CachingFileSystem::enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates)
+{
+    return m_fs->enumerateFiles(path, extensions, callback, allowDuplicates);
+}
+
+int CachingFileSystem::enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback, bool allowDuplicates)
+{
+    return m_fs->enumerateDirectories(path, callback, allowDuplicates);
+}
@@ -21,16 +21,434 @@
 */
 
 #include <donut/core/vfs/Compression.h>
+#include <donut/core/hash.h>
 #include <donut/core/log.h>
+#include <donut/core/parallel.h>
 #include <donut/core/string_utils.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <thread>
 #include <unordered_set>
 
 #ifdef DONUT_WITH_LZ4
+#include <lz4.h>
 #include <lz4frame.h>
 #endif
 
+#ifdef DONUT_WITH_ZSTD
+#include <zstd.h>
+#endif
+
 using namespace donut::vfs;
 
+#if defined(DONUT_WITH_LZ4) || defined(DONUT_WITH_ZSTD)
+namespace
+{
+    // Independently compressed blocks or frames smaller than this are decompressed on the calling thread
+    constexpr size_t c_MinParallelDecompressionSize = 4 * 1024 * 1024;
+
+    // Runs the task for every index in [0, numItems) on up to 'maxThreads' tasks on the shared executor.
+    // Returns false if any of the tasks has returned false, in which case the remaining tasks may be skipped.
+    bool runParallel(size_t numItems, uint32_t maxThreads, const std::function<bool(size_t)>& task)
+    {
+        std::atomic<bool> failed = false;
+
+        donut::parallel::forEachIndex(maxThreads > 1 ? donut::parallel::getSharedExecutor() : nullptr, numItems, maxThreads,
+            [&](size_t index)
+            {
+                if (!failed && !task(index))
+                    failed = true;
+            });
+
+        return !failed;
+    }
+}
+#endif
+
+#ifdef DONUT_WITH_LZ4
+namespace
+{
+    // The block index is stored in a skippable frame after the LZ4 data frame, so that regular LZ4 decoders ignore it.
+    // Skippable frame layout: magic, payload size, BlockIndexEntry[numBlocks], BlockIndexFooter.
+    constexpr uint32_t c_SkippableFrameMagic = 0x184D2A5D;
+    constexpr uint32_t c_BlockIndexTag = 0x58444942; // "BIDX"
+
+    struct BlockIndexEntry
+    {
+        uint64_t compressedOffset;   // offset of the block header from the start of the file
+        uint64_t decompressedOffset; // offset of the block data in the decompressed file
+    };
+
+    struct BlockIndexFooter
+    {
+        uint32_t numBlocks;
+        uint32_t tag;
+    };
+
+    constexpr uint32_t c_UncompressedBlockFlag = 0x80000000u;
+
+    uint32_t readLE32(const uint8_t* p)
+    {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    size_t getBlockMaxSize(LZ4F_blockSizeID_t blockSizeID)
+    {
+        switch (blockSizeID)
+        {
+        case LZ4F_max256KB: return 256 * 1024;
+        case LZ4F_max1MB: return 1024 * 1024;
+        case LZ4F_max4MB: return 4 * 1024 * 1024;
+        default: return 64 * 1024;
+        }
+    }
+
+    // Walks the block headers of an LZ4 frame with independent blocks and fills the block index.
+    // Assumes that all blocks except the last one contain blockMaxSize bytes of data, which is how LZ4F_compressFrame
+    // and the Python bindings split the input; the decompressor validates the actual sizes.
+    // Returns the size of the data frame, or 0 if the frame is malformed.
+    size_t scanBlocks(const uint8_t* data, size_t size, size_t headerSize, const LZ4F_frameInfo_t& frameInfo,
+        std::vector<BlockIndexEntry>& blocks)
+    {
+        const size_t blockMaxSize = getBlockMaxSize(frameInfo.blockSizeID);
+        const size_t checksumSize = frameInfo.blockChecksumFlag == LZ4F_blockChecksumEnabled ? 4 : 0;
+
+        size_t position = headerSize;
+        while (position + 4 <= size)
+        {
+            const uint32_t blockHeader = readLE32(data + position);
+            if (blockHeader == 0)
+            {
+                // end mark, followed by the optional content checksum
+                position += 4;
+                if (frameInfo.contentChecksumFlag == LZ4F_contentChecksumEnabled)
+                    position += 4;
+
+                return position <= size ? position : 0;
+            }
+
+            BlockIndexEntry entry;
+            entry.compressedOffset = position;
+            entry.decompressedOffset = uint64_t(blocks.size()) * blockMaxSize;
+            blocks.push_back(entry);
+
+            position += 4 + (blockHeader & ~c_UncompressedBlockFlag) + checksumSize;
+        }
+
+        return 0;
+    }
+
+    // Finds the block index stored after the data frame. 'data' holds the last 'size' bytes of the file,
+    // which start at 'dataOffset' in the file.
+    // Returns the size of the data frame, or 0 if there is no valid index.
+    size_t readBlockIndex(const uint8_t* data, size_t size, size_t dataOffset, std::vector<BlockIndexEntry>& blocks)
+    {
+        if (size < 8 + sizeof(BlockIndexFooter))
+            return 0;
+
+        BlockIndexFooter footer;
+        memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+
+        if (footer.tag != c_BlockIndexTag)
+            return 0;
+
+        const size_t payloadSize = size_t(footer.numBlocks) * sizeof(BlockIndexEntry) + sizeof(BlockIndexFooter);
+        if (payloadSize + 8 > size)
+            return 0;
+
+        const size_t indexStart = size - payloadSize - 8;
+        if (readLE32(data + indexStart) != c_SkippableFrameMagic || readLE32(data + indexStart + 4) != payloadSize)
+            return 0;
+
+        blocks.resize(footer.numBlocks);
+        memcpy(blocks.data(), data + indexStart + 8, footer.numBlocks * sizeof(BlockIndexEntry));
+
+        const size_t frameStart = dataOffset + indexStart;
+        for (size_t index = 0; index < blocks.size(); index++)
+        {
+            if (blocks[index].compressedOffset + 4 > frameStart ||
+                (index > 0 && blocks[index].decompressedOffset <= blocks[index - 1].decompressedOffset))
+            {
+                blocks.clear();
+                return 0;
+            }
+        }
+
+        return frameStart;
+    }
+
+    // Checks that the blocks start at the beginning of the content and cover it contiguously, in order.
+    // Each block covers the range up to the next block's offset, and the decompressor checks
+    // that it produces exactly that many bytes, so strictly increasing offsets leave no gaps.
+    bool validateBlocks(const std::vector<BlockIndexEntry>& blocks, size_t contentSize)
+    {
+        if (blocks.empty() || blocks[0].decompressedOffset != 0 || blocks.back().decompressedOffset >= contentSize)
+            return false;
+
+        for (size_t index = 1; index < blocks.size(); index++)
+        {
+            if (blocks[index].decompressedOffset <= blocks[index - 1].decompressedOffset)
+                return false;
+        }
+
+        return true;
+    }
+
+    // Finds the independent blocks of the frame, from the stored block index or by walking the block headers.
+    // Returns the size of the data frame, or 0 if the blocks can't be used for random access.
+    size_t findBlocks(const uint8_t* data, size_t size, size_t headerSize, const LZ4F_frameInfo_t& frameInfo,
+        size_t contentSize, std::vector<BlockIndexEntry>& blocks)
+    {
+        size_t frameSize = readBlockIndex(data, size, 0, blocks);
+        if (frameSize == 0)
+        {
+            blocks.clear();
+            frameSize = scanBlocks(data, size, headerSize, frameInfo, blocks);
+        }
+
+        if (frameSize == 0 || !validateBlocks(blocks, contentSize))
+        {
+            blocks.clear();
+            return 0;
+        }
+
+        return frameSize;
+    }
+
+    // Finds the blocks in [firstBlock, endBlock) that overlap 'size' bytes at 'offset', which must be within the content.
+    void findRangeBlocks(const std::vector<BlockIndexEntry>& blocks, uint64_t offset, size_t size,
+        size_t& firstBlock, size_t& endBlock)
+    {
+        auto compareOffset = [](uint64_t offset, const BlockIndexEntry& block) { return offset < block.decompressedOffset; };
+        firstBlock = std::upper_bound(blocks.begin(), blocks.end(), offset, compareOffset) - blocks.begin() - 1;
+        endBlock = std::upper_bound(blocks.begin(), blocks.end(), offset + size - 1, compareOffset) - blocks.begin();
+    }
+
+    // Decompresses the independent blocks of a frame into 'output', in parallel when there are enough of them.
+    // Returns false if any block is malformed or doesn't match its expected size or checksum.
+    bool decompressBlocks(const uint8_t* data, size_t frameSize, const LZ4F_frameInfo_t& frameInfo,
+        const std::vector<BlockIndexEntry>& blocks, uint8_t* output, size_t outputSize, uint32_t maxThreads)
+    {
+        const bool blockChecksums = frameInfo.blockChecksumFlag == LZ4F_blockChecksumEnabled;
+
+        return runParallel(blocks.size(), outputSize >= c_MinParallelDecompressionSize ? maxThreads : 1,
+            [&](size_t index)
+            {
+                const BlockIndexEntry& block = blocks[index];
+                const size_t blockEnd = index + 1 < blocks.size() ? size_t(blocks[index + 1].decompressedOffset) : outputSize;
+                if (block.decompressedOffset >= blockEnd || blockEnd > outputSize)
+                    return false;
+
+                const size_t expectedSize = blockEnd - size_t(block.decompressedOffset);
+                const uint32_t blockHeader = readLE32(data + block.compressedOffset);
+                const size_t blockSize = blockHeader & ~c_UncompressedBlockFlag;
+                const uint8_t* blockData = data + block.compressedOffset + 4;
+                uint8_t* destination = output + block.decompressedOffset;
+
+                if (block.compressedOffset + 4 + blockSize + (blockChecksums ? 4 : 0) > frameSize)
+                    return false;
+
+                if (blockChecksums && donut::hash::xxh32(blockData, blockSize) != readLE32(blockData + blockSize))
+                    return false;
+
+                if (blockHeader & c_UncompressedBlockFlag)
+                {
+                    if (blockSize != expectedSize)
+                        return false;
+
+                    memcpy(destination, blockData, blockSize);
+                    return true;
+                }
+
+                const int decompressedSize = LZ4_decompress_safe(reinterpret_cast<const char*>(blockData),
+                    reinterpret_cast<char*>(destination), int(blockSize), int(expectedSize));
+
+                return decompressedSize == int(expectedSize);
+            });
+    }
+
+    // Decompresses the blocks that overlap 'size' bytes at 'offset' of the content, which must be within the content.
+    // 'data' holds 'dataSize' bytes of the file starting at 'dataOffset', which must include all of these blocks,
+    // and 'frameSize' is the size of the data frame.
+    // Returns the decompressed blocks, allocated with malloc, and their position in the content,
+    // or nullptr if the blocks are malformed.
+    uint8_t* decompressBlockRange(const uint8_t* data, size_t dataOffset, size_t dataSize, size_t frameSize,
+        const LZ4F_frameInfo_t& frameInfo, const std::vector<BlockIndexEntry>& blocks, size_t contentSize,
+        uint64_t offset, size_t size, uint32_t maxThreads, size_t& rangeStart, size_t& rangeSize)
+    {
+        size_t firstBlock, endBlock;
+        findRangeBlocks(blocks, offset, size, firstBlock, endBlock);
+
+        // the blocks end where the next block or the data frame begins
+        const size_t dataEnd = std::min(dataOffset + dataSize, frameSize);
+
+        std::vector<BlockIndexEntry> rangeBlocks(blocks.begin() + firstBlock, blocks.begin() + endBlock);
+        rangeStart = size_t(rangeBlocks[0].decompressedOffset);
+        rangeSize = (endBlock < blocks.size() ? size_t(blocks[endBlock].decompressedOffset) : contentSize) - rangeStart;
+
+        for (BlockIndexEntry& block : rangeBlocks)
+        {
+            if (block.compressedOffset < dataOffset || block.compressedOffset + 4 > dataEnd)
+                return nullptr;
+
+            block.compressedOffset -= dataOffset;
+            block.decompressedOffset -= rangeStart;
+        }
+
+        uint8_t* rangeData = (uint8_t*)malloc(rangeSize);
+        if (rangeData && !decompressBlocks(data, dataEnd - dataOffset, frameInfo, rangeBlocks, rangeData, rangeSize, maxThreads))
+        {
+            free(rangeData);
+            return nullptr;
+        }
+
+        return rangeData;
+    }
+}
+#endif // DONUT_WITH_LZ4
+
+#ifdef DONUT_WITH_ZSTD
+namespace
+{
+    // Large files are split into independent frames of this size, so that they can be decompressed in parallel
+    constexpr size_t c_ZstdFrameSize = 4 * 1024 * 1024;
+
+    struct ZstdFrame
+    {
+        size_t compressedOffset;
+        size_t compressedSize;
+        size_t decompressedOffset;
+        size_t decompressedSize;
+    };
+
+    // Locates the frames and validates their dictionary requirements.
+    // Stops adding frames at the first frame without a content size, and sets 'unknownContentSize' in that case.
+    bool findZstdFrames(const uint8_t* data, size_t size, const std::filesystem::path& name, unsigned loadedDictID,
+        std::vector<ZstdFrame>& frames, size_t& decompressedSize, bool& unknownContentSize)
+    {
+        decompressedSize = 0;
+        unknownContentSize = false;
+
+        for (size_t readPtr = 0; readPtr < size; )
+        {
+            const size_t frameSize = ZSTD_findFrameCompressedSize(data + readPtr, size - readPtr);
+
+            if (ZSTD_isError(frameSize))
+            {
+                donut::log::warning("Failed to parse Zstandard frame for file '%s': %s",
+                    name.generic_string().c_str(), ZSTD_getErrorName(frameSize));
+                return false;
+            }
+
+            const unsigned dictID = ZSTD_getDictID_fromFrame(data + readPtr, frameSize);
+            if (dictID != 0 && dictID != loadedDictID)
+            {
+                donut::log::warning("Failed to decompress file '%s': it requires Zstandard dictionary %u which is not loaded",
+                    name.generic_string().c_str(), dictID);
+                return false;
+            }
+
+            const unsigned long long contentSize = ZSTD_getFrameContentSize(data + readPtr, frameSize);
+
+            if (contentSize == ZSTD_CONTENTSIZE_ERROR)
+            {
+                donut::log::warning("Failed to parse Zstandard frame header for file '%s'", name.generic_string().c_str());
+                return false;
+            }
+
+            if (contentSize == ZSTD_CONTENTSIZE_UNKNOWN)
+                unknownContentSize = true;
+            else if (!unknownContentSize)
+            {
+                frames.push_back({ readPtr, frameSize, decompressedSize, size_t(contentSize) });
+                decompressedSize += size_t(contentSize);
+            }
+
+            readPtr += frameSize;
+        }
+
+        return true;
+    }
+
+    // Decompresses the frames into 'output', which corresponds to the decompressed data starting at 'outputOffset'.
+    // Uses the provided context when running on one thread, and one context per frame otherwise.
+    bool decompressZstdFrames(const uint8_t* data, const ZstdFrame* frames, size_t numFrames, uint8_t* output, size_t outputOffset,
+        ZSTD_DCtx* context, const ZSTD_DDict* ddict, uint32_t maxThreads)
+    {
+        const unsigned loadedDictID = ddict ? ZSTD_getDictID_fromDDict(ddict) : 0;
+
+        // The dictionary is chosen for each frame below. Drop the one the caller may have referenced
+        // in the shared context, or ZSTD_decompressDCtx would apply it to the frames that don't use it.
+        if (maxThreads == 1)
+            ZSTD_DCtx_reset(context, ZSTD_reset_session_and_parameters);
+
+        return runParallel(numFrames, maxThreads, [&](size_t index)
+            {
+                const ZstdFrame& frame = frames[index];
+
+                ZSTD_DCtx* frameContext = maxThreads == 1 ? context : ZSTD_createDCtx();
+                if (!frameContext)
+                    return false;
+
+                const unsigned dictID = ZSTD_getDictID_fromFrame(data + frame.compressedOffset, frame.compressedSize);
+                const void* src = data + frame.compressedOffset;
+                void* dst = output + frame.decompressedOffset - outputOffset;
+
+                // frames without a dictionary ID can still use a raw content dictionary
+                const size_t result = (ddict && (dictID != 0 || loadedDictID == 0))
+                    ? ZSTD_decompress_usingDDict(frameContext, dst, frame.decompressedSize, src, frame.compressedSize, ddict)
+                    : ZSTD_decompressDCtx(frameContext, dst, frame.decompressedSize, src, frame.compressedSize);
+
+                if (frameContext != context)
+                    ZSTD_freeDCtx(frameContext);
+
+                return !ZSTD_isError(result) && result == frame.decompressedSize;
+            });
+    }
+}
+#endif // DONUT_WITH_ZSTD
+
+uint32_t CompressionLayer::getDecompressionThreadCount() const
+{
+    return m_MaxDecompressionThreads > 0
+        ? m_MaxDecompressionThreads
+        : std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+bool CompressionLayer::loadZstdDictionary(const std::filesystem::path& name)
+{
+#ifdef DONUT_WITH_ZSTD
+    auto dictionary = m_fs->readFile(name);
+
+    if (!dictionary || dictionary->size() == 0)
+    {
+        log::warning("Couldn't read Zstandard dictionary '%s'", name.generic_string().c_str());
+        return false;
+    }
+
+    ZSTD_DDict* ddict = ZSTD_createDDict(dictionary->data(), dictionary->size());
+
+    if (!ddict)
+    {
+        log::warning("Failed to create a Zstandard dictionary from file '%s'", name.generic_string().c_str());
+        return false;
+    }
+
+    m_ZstdDictionary = dictionary;
+    m_ZstdDDict = std::shared_ptr<ZSTD_DDict>(ddict, [](ZSTD_DDict* p) { ZSTD_freeDDict(p); });
+
+    return true;
+#else
+    log::warning("Couldn't load Zstandard dictionary '%s': Zstandard support is not enabled", name.generic_string().c_str());
+    return false;
+#endif
+}
+
 bool CompressionLayer::folderExists(const std::filesystem::path& name)
 {
     return m_fs->folderExists(name);
@@ -44,16 +462,228 @@ bool CompressionLayer::fileExists(const std::filesystem::path& name)
 std::shared_ptr<IBlob> CompressionLayer::readFile(const std::filesystem::path& name)
 {
 #ifdef DONUT_WITH_LZ4
-    std::filesystem::path nameWithExt = name;
-    nameWithExt += ".lz4";
-    auto compressedBlob = m_fs->readFile(nameWithExt);
+    {
+        std::filesystem::path nameWithExt = name;
+        nameWithExt += ".lz4";
+        auto compressedBlob = m_fs->readFile(nameWithExt);
+
+        if (compressedBlob)
+            return compressedBlob->size() ? decompressLZ4(compressedBlob, name) : compressedBlob;
+    }
+#endif
+
+#ifdef DONUT_WITH_ZSTD
+    {
+        std::filesystem::path nameWithExt = name;
+        nameWithExt += ".zst";
+        auto compressedBlob = m_fs->readFile(nameWithExt);
+
+        if (compressedBlob)
+            return compressedBlob->size() ? decompressZstd(compressedBlob, name) : compressedBlob;
+    }
+#endif
+
+    return m_fs->readFile(name);
+}
+
+std::shared_ptr<IBlob> CompressionLayer::mapFile(const std::filesystem::path& name)
+{
+    // compressed files have to be decompressed into the heap, uncompressed files can be mapped by the underlying FS
+    for (const char* extension : { ".lz4", ".zst" })
+    {
+        std::filesystem::path nameWithExt = name;
+        nameWithExt += extension;
+        if (m_fs->fileExists(nameWithExt))
+            return readFile(name);
+    }
+
+    return m_fs->mapFile(name);
+}
+
+std::shared_ptr<IBlob> CompressionLayer::readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size)
+{
+#ifdef DONUT_WITH_LZ4
+    {
+        std::filesystem::path nameWithExt = name;
+        nameWithExt += ".lz4";
+        uint64_t compressedSize = 0;
+
+        if (m_fs->getFileSize(nameWithExt, compressedSize))
+        {
+            if (compressedSize == 0)
+                return copyBlobRange(nullptr, 0, offset, size);
+
+            std::shared_ptr<IBlob> blob;
+            if (readIndexedRangeLZ4(nameWithExt, compressedSize, offset, size, blob))
+                return blob;
+
+            // there is no block index, the blocks can only be found in the entire file
+            auto compressedBlob = m_fs->readFile(nameWithExt);
+            return compressedBlob ? readRangeLZ4(compressedBlob, name, offset, size) : nullptr;
+        }
+    }
+#endif
+
+#ifdef DONUT_WITH_ZSTD
+    {
+        std::filesystem::path nameWithExt = name;
+        nameWithExt += ".zst";
+        auto compressedBlob = m_fs->readFile(nameWithExt);
+
+        if (compressedBlob)
+            return compressedBlob->size() ? readRangeZstd(compressedBlob, name, offset, size) : copyBlobRange(nullptr, 0, offset, size);
+    }
+#endif
+
+    return m_fs->readFileRange(name, offset, size);
+}
+
+#ifdef DONUT_WITH_LZ4
+bool CompressionLayer::readIndexedRangeLZ4(const std::filesystem::path& compressedName, uint64_t compressedSize,
+    uint64_t offset, size_t size, std::shared_ptr<IBlob>& result)
+{
+    if (compressedSize < 8 + sizeof(BlockIndexFooter) || compressedSize > std::numeric_limits<size_t>::max())
+        return false;
+
+    const size_t fileSize = size_t(compressedSize);
+
+    auto headerBlob = m_fs->readFileRange(compressedName, 0, LZ4F_HEADER_SIZE_MAX);
+    if (!headerBlob)
+        return false;
+
+    LZ4F_dctx* context = nullptr;
+    LZ4F_frameInfo_t frameInfo;
+    size_t headerSize = headerBlob->size();
+
+    const bool validHeader = !LZ4F_isError(LZ4F_createDecompressionContext(&context, LZ4F_VERSION)) &&
+        !LZ4F_isError(LZ4F_getFrameInfo(context, &frameInfo, headerBlob->data(), &headerSize));
+
+    if (context)
+        LZ4F_freeDecompressionContext(context);
+
+    if (!validHeader || frameInfo.blockMode != LZ4F_blockIndependent || frameInfo.contentSize == 0 ||
+        frameInfo.contentSize > static_cast<unsigned long long>(std::numeric_limits<size_t>::max()))
+        return false;
+
+    const size_t contentSize = size_t(frameInfo.contentSize);
+
+    // the index footer at the end of the file tells how large the index is
+    auto footerBlob = m_fs->readFileRange(compressedName, fileSize - sizeof(BlockIndexFooter), sizeof(BlockIndexFooter));
+    if (!footerBlob || footerBlob->size() != sizeof(BlockIndexFooter))
+        return false;
+
+    BlockIndexFooter footer;
+    memcpy(&footer, footerBlob->data(), sizeof(footer));
+
+    const size_t indexSize = 8 + size_t(footer.numBlocks) * sizeof(BlockIndexEntry) + sizeof(BlockIndexFooter);
+    if (footer.tag != c_BlockIndexTag || indexSize > fileSize)
+        return false;
+
+    auto indexBlob = m_fs->readFileRange(compressedName, fileSize - indexSize, indexSize);
+    if (!indexBlob || indexBlob->size() != indexSize)
+        return false;
+
+    std::vector<BlockIndexEntry> blocks;
+    const size_t frameSize = readBlockIndex((const uint8_t*)indexBlob->data(), indexSize, fileSize - indexSize, blocks);
+    if (frameSize == 0 || !validateBlocks(blocks, contentSize) || blocks[0].compressedOffset < headerSize)
+        return false;
+
+    if (offset > contentSize)
+    {
+        result = nullptr;
+        return true;
+    }
+
+    size = std::min(size, contentSize - size_t(offset));
+    if (size == 0)
+    {
+        result = copyBlobRange(nullptr, 0, 0, 0);
+        return true;
+    }
+
+    // read the compressed blocks that overlap the range
+    size_t firstBlock, endBlock;
+    findRangeBlocks(blocks, offset, size, firstBlock, endBlock);
+    const size_t blocksStart = size_t(blocks[firstBlock].compressedOffset);
+    const size_t blocksEnd = endBlock < blocks.size() ? size_t(blocks[endBlock].compressedOffset) : frameSize;
+
+    if (blocksEnd <= blocksStart)
+        return false;
+
+    auto compressedBlob = m_fs->readFileRange(compressedName, blocksStart, blocksEnd - blocksStart);
+    if (!compressedBlob || compressedBlob->size() != blocksEnd - blocksStart)
+        return false;
+
+    size_t rangeStart = 0;
+    size_t rangeSize = 0;
+    uint8_t* rangeData = decompressBlockRange((const uint8_t*)compressedBlob->data(), blocksStart, compressedBlob->size(), frameSize,
+        frameInfo, blocks, contentSize, offset, size, getDecompressionThreadCount(), rangeStart, rangeSize);
+
+    // the blocks don't match the index, let the caller read the entire file and report any errors
+    if (!rangeData)
+        return false;
+
+    result = copyBlobRange(rangeData, rangeSize, offset - rangeStart, size);
+    free(rangeData);
+    return true;
+}
+
+std::shared_ptr<IBlob> CompressionLayer::readRangeLZ4(const std::shared_ptr<IBlob>& compressedBlob, const std::filesystem::path& name,
+    uint64_t offset, size_t size)
+{
+    const uint8_t* const compressedData = (const uint8_t*)compressedBlob->data();
+    const size_t compressedSize = compressedBlob->size();
+
+    LZ4F_dctx* context = nullptr;
+    LZ4F_frameInfo_t frameInfo;
+    size_t headerSize = compressedSize;
+
+    const bool validHeader = !LZ4F_isError(LZ4F_createDecompressionContext(&context, LZ4F_VERSION)) &&
+        !LZ4F_isError(LZ4F_getFrameInfo(context, &frameInfo, compressedData, &headerSize));
 
-    if (!compressedBlob)
-        return m_fs->readFile(name);
-    
-    if (compressedBlob->size() == 0)
-        return compressedBlob;
+    if (context)
+        LZ4F_freeDecompressionContext(context);
+
+    // with independent blocks and a known size, only decompress the blocks that overlap the range
+    if (validHeader && frameInfo.blockMode == LZ4F_blockIndependent && frameInfo.contentSize != 0 &&
+        frameInfo.contentSize <= static_cast<unsigned long long>(std::numeric_limits<size_t>::max()))
+    {
+        const size_t contentSize = size_t(frameInfo.contentSize);
+        std::vector<BlockIndexEntry> blocks;
+        const size_t frameSize = findBlocks(compressedData, compressedSize, headerSize, frameInfo, contentSize, blocks);
+
+        if (frameSize != 0)
+        {
+            if (offset > contentSize)
+                return nullptr;
 
+            size = std::min(size, contentSize - size_t(offset));
+            if (size == 0)
+                return copyBlobRange(nullptr, 0, 0, 0);
+
+            size_t rangeStart = 0;
+            size_t rangeSize = 0;
+            uint8_t* rangeData = decompressBlockRange(compressedData, 0, compressedSize, frameSize, frameInfo, blocks,
+                contentSize, offset, size, getDecompressionThreadCount(), rangeStart, rangeSize);
+
+            if (rangeData)
+            {
+                auto blob = copyBlobRange(rangeData, rangeSize, offset - rangeStart, size);
+                free(rangeData);
+                return blob;
+            }
+
+            // the blocks don't match our expectations, use the regular decompressor which will report any errors
+        }
+    }
+
+    auto blob = decompressLZ4(compressedBlob, name);
+
+    return blob ? copyBlobRange(blob->data(), blob->size(), offset, size) : nullptr;
+}
+
+std::shared_ptr<IBlob> CompressionLayer::decompressLZ4(const std::shared_ptr<IBlob>& compressedBlob, const std::filesystem::path& name)
+{
     // initialize the decompression context
     LZ4F_dctx* context = nullptr;
     LZ4F_errorCode_t err = LZ4F_createDecompressionContext(&context, LZ4F_VERSION);
@@ -89,6 +719,39 @@ std::shared_ptr<IBlob> CompressionLayer::readFile(const std::filesystem::path& n
         readPtr += srcSize;
     }
 
+    // frames with independent blocks and a known size can be decompressed in parallel
+    if (frameInfo.blockMode == LZ4F_blockIndependent && frameInfo.contentSize != 0 &&
+        frameInfo.contentSize <= static_cast<unsigned long long>(std::numeric_limits<size_t>::max()))
+    {
+        const size_t decompressedSize = size_t(frameInfo.contentSize);
+        std::vector<BlockIndexEntry> blocks;
+        const size_t frameSize = findBlocks(compressedData, compressedSize, readPtr, frameInfo, decompressedSize, blocks);
+
+        if (frameSize != 0)
+        {
+            uint8_t* decompressedData = (uint8_t*)malloc(decompressedSize);
+
+            if (!decompressedData)
+            {
+                log::warning("Failed to decompress LZ4 frame for file '%s': couldn't allocate %llu bytes of memory",
+                    name.generic_string().c_str(), decompressedSize);
+
+                LZ4F_freeDecompressionContext(context);
+                return nullptr;
+            }
+
+            if (decompressBlocks(compressedData, frameSize, frameInfo, blocks, decompressedData, decompressedSize,
+                getDecompressionThreadCount()))
+            {
+                LZ4F_freeDecompressionContext(context);
+                return std::make_shared<Blob>(decompressedData, decompressedSize);
+            }
+
+            // the blocks don't match our expectations, use the regular decompressor which will report any errors
+            free(decompressedData);
+        }
+    }
+
     // get or guess the decompressed data size
     size_t decompressedSize = frameInfo.contentSize;
     size_t decompressionFactor;
@@ -164,22 +827,217 @@ std::shared_ptr<IBlob> CompressionLayer::readFile(const std::filesystem::path& n
     auto blob = std::make_shared<Blob>(decompressedData, writePtr);
 
     return std::static_pointer_cast<IBlob>(blob);
+}
+#endif // DONUT_WITH_LZ4
 
-#else // DONUT_WITH_LZ4
-    return m_fs->readFile(name);
-#endif
+#ifdef DONUT_WITH_ZSTD
+std::shared_ptr<IBlob> CompressionLayer::decompressZstd(const std::shared_ptr<IBlob>& compressedBlob, const std::filesystem::path& name)
+{
+    const uint8_t* const compressedData = (const uint8_t*)compressedBlob->data();
+    const size_t compressedSize = compressedBlob->size();
+    const ZSTD_DDict* ddict = m_ZstdDDict.get();
+    const unsigned loadedDictID = ddict ? ZSTD_getDictID_fromDDict(ddict) : 0;
+
+    std::vector<ZstdFrame> frames;
+    size_t decompressedSize = 0;
+    bool unknownContentSize = false;
+
+    if (!findZstdFrames(compressedData, compressedSize, name, loadedDictID, frames, decompressedSize, unknownContentSize))
+        return nullptr;
+
+    ZSTD_DCtx* context = ZSTD_createDCtx();
+
+    if (!context)
+    {
+        log::warning("Failed to create a Zstandard decompression context");
+        return nullptr;
+    }
+
+    if (ddict)
+        ZSTD_DCtx_refDDict(context, ddict);
+
+    size_t writePtr = 0;
+    uint8_t* decompressedData = nullptr;
+
+    if (unknownContentSize)
+    {
+        // the file was written by a streaming compressor, decompress it sequentially, growing the output buffer as necessary
+        decompressedSize = std::max(compressedSize * 3, ZSTD_DStreamOutSize());
+        decompressedData = (uint8_t*)malloc(decompressedSize);
+
+        ZSTD_inBuffer input = { compressedData, compressedSize, 0 };
+        size_t result = 1;
+
+        while (decompressedData && result != 0)
+        {
+            ZSTD_outBuffer output = { decompressedData, decompressedSize, writePtr };
+            result = ZSTD_decompressStream(context, &output, &input);
+            writePtr = output.pos;
+
+            if (ZSTD_isError(result))
+            {
+                log::warning("Failed to decompress Zstandard frame for file '%s': %s",
+                    name.generic_string().c_str(), ZSTD_getErrorName(result));
+
+                free(decompressedData);
+                ZSTD_freeDCtx(context);
+                return nullptr;
+            }
+
+            if (result != 0 && input.pos == input.size && writePtr < decompressedSize)
+            {
+                log::warning("Failed to decompress Zstandard frame for file '%s': the data is truncated",
+                    name.generic_string().c_str());
+
+                free(decompressedData);
+                ZSTD_freeDCtx(context);
+                return nullptr;
+            }
+
+            // the decompressor has filled the entire output buffer, there may be more data to process
+            if (writePtr == decompressedSize)
+            {
+                decompressedSize *= 2;
+                uint8_t* newData = (uint8_t*)realloc(decompressedData, decompressedSize);
+                if (!newData)
+                    free(decompressedData);
+                decompressedData = newData;
+                result = 1;
+            }
+            else if (result == 0 && input.pos < input.size)
+            {
+                // the next frame begins
+                result = 1;
+            }
+        }
+    }
+    else
+    {
+        // all frames have known sizes, decompress them directly into place
+        decompressedData = (uint8_t*)malloc(std::max(decompressedSize, size_t(1)));
+        writePtr = decompressedSize;
+    }
+
+    if (!decompressedData)
+    {
+        log::warning("Failed to decompress Zstandard frame for file '%s': couldn't allocate %llu bytes of memory",
+            name.generic_string().c_str(), decompressedSize);
+
+        ZSTD_freeDCtx(context);
+        return nullptr;
+    }
+
+    if (!unknownContentSize)
+    {
+        const uint32_t maxThreads = decompressedSize >= c_MinParallelDecompressionSize ? getDecompressionThreadCount() : 1;
+
+        const bool success = decompressZstdFrames(compressedData, frames.data(), frames.size(), decompressedData, 0,
+            context, ddict, maxThreads);
+
+        if (!success)
+        {
+            log::warning("Failed to decompress Zstandard frames for file '%s'", name.generic_string().c_str());
+
+            free(decompressedData);
+            ZSTD_freeDCtx(context);
+            return nullptr;
+        }
+    }
+
+    ZSTD_freeDCtx(context);
+
+    // shrink the output buffer if it's too large
+    if (writePtr < decompressedSize)
+    {
+        uint8_t* newData = (uint8_t*)realloc(decompressedData, std::max(writePtr, size_t(1)));
+
+        if (newData != nullptr)
+            decompressedData = newData;
+    }
+
+    return std::make_shared<Blob>(decompressedData, writePtr);
 }
 
-bool CompressionLayer::writeFile(const std::filesystem::path& name, const void* data, size_t size)
+std::shared_ptr<IBlob> CompressionLayer::readRangeZstd(const std::shared_ptr<IBlob>& compressedBlob, const std::filesystem::path& name,
+    uint64_t offset, size_t size)
 {
-#ifdef DONUT_WITH_LZ4
-    if (!string_utils::ends_with(name.generic_string(), ".lz4"))
-        return m_fs->writeFile(name, data, size);
+    const uint8_t* const compressedData = (const uint8_t*)compressedBlob->data();
+    const ZSTD_DDict* ddict = m_ZstdDDict.get();
+
+    std::vector<ZstdFrame> frames;
+    size_t decompressedSize = 0;
+    bool unknownContentSize = false;
+
+    if (!findZstdFrames(compressedData, compressedBlob->size(), name, ddict ? ZSTD_getDictID_fromDDict(ddict) : 0,
+        frames, decompressedSize, unknownContentSize))
+        return nullptr;
 
+    // frames without a content size can't be skipped
+    if (unknownContentSize || frames.empty())
+    {
+        auto blob = decompressZstd(compressedBlob, name);
+        return blob ? copyBlobRange(blob->data(), blob->size(), offset, size) : nullptr;
+    }
+
+    if (offset > decompressedSize)
+        return nullptr;
+
+    size = std::min(size, decompressedSize - size_t(offset));
+    if (size == 0)
+        return copyBlobRange(nullptr, 0, 0, 0);
+
+    // only decompress the frames that overlap the range
+    auto compareOffset = [](uint64_t offset, const ZstdFrame& frame) { return offset < frame.decompressedOffset; };
+    const size_t firstFrame = std::upper_bound(frames.begin(), frames.end(), offset, compareOffset) - frames.begin() - 1;
+    const size_t endFrame = std::upper_bound(frames.begin(), frames.end(), offset + size - 1, compareOffset) - frames.begin();
+
+    const size_t rangeStart = frames[firstFrame].decompressedOffset;
+    const size_t rangeEnd = frames[endFrame - 1].decompressedOffset + frames[endFrame - 1].decompressedSize;
+
+    ZSTD_DCtx* context = ZSTD_createDCtx();
+    uint8_t* rangeData = (uint8_t*)malloc(std::max(rangeEnd - rangeStart, size_t(1)));
+
+    const bool success = context && rangeData && decompressZstdFrames(compressedData, frames.data() + firstFrame, endFrame - firstFrame,
+        rangeData, rangeStart, context, ddict, rangeEnd - rangeStart >= c_MinParallelDecompressionSize ? getDecompressionThreadCount() : 1);
+
+    if (context)
+        ZSTD_freeDCtx(context);
+
+    if (!success)
+    {
+        log::warning("Failed to decompress Zstandard frames for file '%s'", name.generic_string().c_str());
+        free(rangeData);
+        return nullptr;
+    }
+
+    auto blob = copyBlobRange(rangeData, rangeEnd - rangeStart, offset - rangeStart, size);
+    free(rangeData);
+    return blob;
+}
+#endif // DONUT_WITH_ZSTD
+
+bool CompressionLayer::writeFile(const std::filesystem::path& name, const void* data, size_t size)
+{
     if (data == nullptr || size == 0)
         return m_fs->writeFile(name, data, size);
 
-    // initialize the decompression context
+#ifdef DONUT_WITH_LZ4
+    if (string_utils::ends_with(name.generic_string(), ".lz4"))
+        return compressLZ4(name, data, size);
+#endif
+
+#ifdef DONUT_WITH_ZSTD
+    if (string_utils::ends_with(name.generic_string(), ".zst"))
+        return compressZstd(name, data, size);
+#endif
+
+    return m_fs->writeFile(name, data, size);
+}
+
+#ifdef DONUT_WITH_LZ4
+bool CompressionLayer::compressLZ4(const std::filesystem::path& name, const void* data, size_t size)
+{
+    // initialize the compression context
     LZ4F_cctx* context = nullptr;
     LZ4F_errorCode_t err = LZ4F_createCompressionContext(&context, LZ4F_VERSION);
 
@@ -195,14 +1053,19 @@ bool CompressionLayer::writeFile(const std::filesystem::path& name, const void*
     const size_t uncompressedSize = size;
 
     // fill the preferences structure
+    // use independent blocks so that the file can be decompressed in parallel
     LZ4F_preferences_t preferences{};
     preferences.frameInfo.contentSize = uncompressedSize;
     preferences.frameInfo.blockChecksumFlag = LZ4F_blockChecksumEnabled;
+    preferences.frameInfo.blockMode = LZ4F_blockIndependent;
+    preferences.frameInfo.blockSizeID = LZ4F_max1MB;
     preferences.compressionLevel = m_CompressionLevel;
 
-    // get the maximum size 
+    // get the maximum size, including the block index
+    const size_t maxBlocks = (uncompressedSize + getBlockMaxSize(LZ4F_max1MB) - 1) / getBlockMaxSize(LZ4F_max1MB);
+    const size_t blockIndexSizeBound = 8 + maxBlocks * sizeof(BlockIndexEntry) + sizeof(BlockIndexFooter);
     size_t compressedSizeBound = LZ4F_compressFrameBound(uncompressedSize, &preferences);
-    uint8_t* compressedData = (uint8_t*)malloc(compressedSizeBound);
+    uint8_t* compressedData = (uint8_t*)malloc(compressedSizeBound + blockIndexSizeBound);
 
     if (!compressedData)
     {
@@ -230,6 +1093,34 @@ bool CompressionLayer::writeFile(const std::filesystem::path& name, const void*
         return false;
     }
 
+    // append the block index
+    {
+        LZ4F_dctx* dctx = nullptr;
+        LZ4F_frameInfo_t frameInfo;
+        size_t headerSize = compressedSize;
+        std::vector<BlockIndexEntry> blocks;
+
+        if (!LZ4F_isError(LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION)) &&
+            !LZ4F_isError(LZ4F_getFrameInfo(dctx, &frameInfo, compressedData, &headerSize)) &&
+            scanBlocks(compressedData, compressedSize, headerSize, frameInfo, blocks) == compressedSize &&
+            blocks.size() <= maxBlocks)
+        {
+            const uint32_t payloadSize = uint32_t(blocks.size() * sizeof(BlockIndexEntry) + sizeof(BlockIndexFooter));
+            BlockIndexFooter footer{ uint32_t(blocks.size()), c_BlockIndexTag };
+
+            uint8_t* writePtr = compressedData + compressedSize;
+            memcpy(writePtr, &c_SkippableFrameMagic, 4); writePtr += 4;
+            memcpy(writePtr, &payloadSize, 4); writePtr += 4;
+            memcpy(writePtr, blocks.data(), blocks.size() * sizeof(BlockIndexEntry)); writePtr += blocks.size() * sizeof(BlockIndexEntry);
+            memcpy(writePtr, &footer, sizeof(footer)); writePtr += sizeof(footer);
+
+            compressedSize = writePtr - compressedData;
+        }
+
+        if (dctx)
+            LZ4F_freeDecompressionContext(dctx);
+    }
+
     // write out the compressed file
     bool writeSuccessful = m_fs->writeFile(name, compressedData, compressedSize);
 
@@ -237,18 +1128,85 @@ bool CompressionLayer::writeFile(const std::filesystem::path& name, const void*
     compressedData = nullptr;
 
     return writeSuccessful;
-    
-#else // DONUT_WITH_LZ4
-    return m_fs->writeFile(name, data, size);
-#endif
 }
+#endif // DONUT_WITH_LZ4
+
+#ifdef DONUT_WITH_ZSTD
+bool CompressionLayer::compressZstd(const std::filesystem::path& name, const void* data, size_t size)
+{
+    ZSTD_CCtx* context = ZSTD_createCCtx();
+
+    if (!context)
+    {
+        log::warning("Failed to create a Zstandard compression context");
+        return false;
+    }
+
+    const uint8_t* uncompressedData = (const uint8_t*)data;
+    const size_t numFrames = (size + c_ZstdFrameSize - 1) / c_ZstdFrameSize;
+
+    // get the maximum size of all frames
+    size_t compressedSizeBound = 0;
+    for (size_t frame = 0; frame < numFrames; frame++)
+        compressedSizeBound += ZSTD_compressBound(std::min(c_ZstdFrameSize, size - frame * c_ZstdFrameSize));
+
+    uint8_t* compressedData = (uint8_t*)malloc(compressedSizeBound);
+
+    if (!compressedData)
+    {
+        log::warning("Failed to compress file '%s': couldn't allocate %llu bytes of memory",
+            name.generic_string().c_str(), compressedSizeBound);
+
+        ZSTD_freeCCtx(context);
+        return false;
+    }
+
+    // compress the data as a sequence of independent frames, each with its content size in the header
+    size_t compressedSize = 0;
+    for (size_t frame = 0; frame < numFrames; frame++)
+    {
+        const size_t offset = frame * c_ZstdFrameSize;
+        const size_t frameSize = std::min(c_ZstdFrameSize, size - offset);
+
+        const size_t result = m_ZstdDictionary
+            ? ZSTD_compress_usingDict(context, compressedData + compressedSize, compressedSizeBound - compressedSize,
+                uncompressedData + offset, frameSize, m_ZstdDictionary->data(), m_ZstdDictionary->size(), m_CompressionLevel)
+            : ZSTD_compressCCtx(context, compressedData + compressedSize, compressedSizeBound - compressedSize,
+                uncompressedData + offset, frameSize, m_CompressionLevel);
+
+        if (ZSTD_isError(result))
+        {
+            log::warning("Failed to compress file '%s': %s",
+                name.generic_string().c_str(), ZSTD_getErrorName(result));
+
+            free(compressedData);
+            ZSTD_freeCCtx(context);
+            return false;
+        }
+
+        compressedSize += result;
+    }
+
+    ZSTD_freeCCtx(context);
+
+    // write out the compressed file
+    bool writeSuccessful = m_fs->writeFile(name, compressedData, compressedSize);
+
+    free(compressedData);
+
+    return writeSuccessful;
+}
+#endif // DONUT_WITH_ZSTD
 
 int CompressionLayer::enumerateFiles(const std::filesystem::path& path,
     const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates)
 {
     std::vector<std::string> patchedExtensions = extensions;
     for (const auto& ext : extensions)
+    {
         patchedExtensions.push_back(ext + ".lz4");
+        patchedExtensions.push_back(ext + ".zst");
+    }
 
     // use a set to de-duplicate the names in case some file exists
     // in both compressed and uncompressed versions
@@ -257,7 +1215,7 @@ int CompressionLayer::enumerateFiles(const std::filesystem::path& path,
     int numRawResults = m_fs->enumerateFiles(path, patchedExtensions,
         [&resultSet, allowDuplicates, callback](std::string_view name)
         {
-            if (string_utils::ends_with(name, ".lz4"))
+            if (string_utils::ends_with(name, ".lz4") || string_utils::ends_with(name, ".zst"))
                 name.remove_suffix(4);
             
             if (allowDuplicates)
@@ -0,0 +1,551 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/core/vfs/PackFile.h>
+#include <donut/core/hash.h>
+#include <donut/core/log.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#ifdef DONUT_WITH_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+
+#ifdef DONUT_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace donut::vfs;
+
+namespace
+{
+    constexpr uint32_t c_PackMagic = 0x4B415044; // "DPAK"
+    constexpr uint32_t c_PackVersion = 1;
+    constexpr uint32_t c_EntryFlagDirectory = 1;
+
+    struct PackHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t alignment;
+        uint32_t reserved;
+    };
+
+    struct PackFooter
+    {
+        uint64_t tocOffset;  // offset of the entry array, followed by the names
+        uint32_t numEntries;
+        uint32_t namesSize;
+        uint32_t version;
+        uint32_t magic;
+    };
+
+    static_assert(sizeof(PackHeader) == 16);
+    static_assert(sizeof(PackFooter) == 24);
+
+    std::string normalizeName(const std::filesystem::path& name)
+    {
+        return name.lexically_normal().relative_path().generic_string();
+    }
+
+    uint64_t hashName(std::string_view name)
+    {
+        return donut::hash::xxh64(name.data(), name.size());
+    }
+}
+
+struct PackFile::Entry
+{
+    uint64_t nameHash;
+    uint64_t offset;
+    uint64_t storedSize;  // size of the data in the archive
+    uint64_t size;        // size of the file after decompression
+    uint32_t nameOffset;  // offset of the name in the string table
+    uint32_t nameLength;
+    uint32_t compression; // PackCompression
+    uint32_t flags;
+};
+
+static_assert(sizeof(PackFile::Entry) == 48);
+
+PackFile::PackFile(const std::filesystem::path& archivePath)
+{
+    m_ArchivePath = archivePath.lexically_normal().generic_string();
+
+    std::shared_ptr<MappedFileBlob> mapping = MappedFileBlob::create(archivePath);
+
+    if (!mapping)
+        return;
+
+    const uint8_t* data = static_cast<const uint8_t*>(mapping->data());
+    const size_t size = mapping->size();
+
+    PackHeader header;
+    PackFooter footer;
+    if (size < sizeof(header) + sizeof(footer))
+    {
+        log::warning("Malformed pack archive '%s': the file is too small", m_ArchivePath.c_str());
+        return;
+    }
+
+    memcpy(&header, data, sizeof(header));
+    memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+
+    if (header.magic != c_PackMagic || footer.magic != c_PackMagic)
+    {
+        log::warning("File '%s' is not a pack archive", m_ArchivePath.c_str());
+        return;
+    }
+
+    if (header.version != c_PackVersion || footer.version != c_PackVersion)
+    {
+        log::warning("Pack archive '%s' has unsupported version %u", m_ArchivePath.c_str(), footer.version);
+        return;
+    }
+
+    // The table of contents ends at the footer. Compare without overflowing on crafted offsets,
+    // the entries and names are checked against these bounds when they are accessed.
+    const uint64_t tocSize = uint64_t(footer.numEntries) * sizeof(Entry) + footer.namesSize;
+    if (tocSize > size - sizeof(header) - sizeof(footer) ||
+        footer.tocOffset != size - sizeof(footer) - tocSize ||
+        footer.tocOffset % alignof(Entry) != 0)
+    {
+        log::warning("Malformed pack archive '%s': invalid table of contents location", m_ArchivePath.c_str());
+        return;
+    }
+
+    m_Entries = reinterpret_cast<const Entry*>(data + footer.tocOffset);
+    m_Names = reinterpret_cast<const char*>(m_Entries + footer.numEntries);
+    m_NumEntries = footer.numEntries;
+    m_Mapping = mapping;
+}
+
+bool PackFile::isOpen() const
+{
+    return m_Mapping != nullptr;
+}
+
+std::string_view PackFile::getEntryName(const Entry& entry) const
+{
+    const size_t namesSize = m_Mapping->size() - sizeof(PackFooter) - size_t(m_Names - static_cast<const char*>(m_Mapping->data()));
+    
+    if (uint64_t(entry.nameOffset) + entry.nameLength > namesSize)
+        return std::string_view();
+
+    return std::string_view(m_Names + entry.nameOffset, entry.nameLength);
+}
+
+const PackFile::Entry* PackFile::findEntry(const std::filesystem::path& name) const
+{
+    if (!m_Mapping)
+        return nullptr;
+
+    const std::string normalizedName = normalizeName(name);
+    const uint64_t nameHash = hashName(normalizedName);
+
+    const Entry* end = m_Entries + m_NumEntries;
+    const Entry* entry = std::lower_bound(m_Entries, end, nameHash,
+        [](const Entry& entry, uint64_t hash) { return entry.nameHash < hash; });
+
+    // different names may have the same hash
+    for (; entry != end && entry->nameHash == nameHash; ++entry)
+    {
+        if (getEntryName(*entry) == normalizedName)
+            return entry;
+    }
+
+    return nullptr;
+}
+
+bool PackFile::folderExists(const std::filesystem::path& name)
+{
+    const Entry* entry = findEntry(name);
+    
+    return entry && (entry->flags & c_EntryFlagDirectory) != 0;
+}
+
+bool PackFile::fileExists(const std::filesystem::path& name)
+{
+    const Entry* entry = findEntry(name);
+
+    return entry && (entry->flags & c_EntryFlagDirectory) == 0;
+}
+
+std::shared_ptr<IBlob> PackFile::readEntry(const Entry& entry, uint64_t offset, size_t size) const
+{
+    const uint8_t* archiveData = static_cast<const uint8_t*>(m_Mapping->data());
+    const size_t dataEnd = size_t(reinterpret_cast<const uint8_t*>(m_Entries) - archiveData);
+
+    if (entry.offset > dataEnd || entry.storedSize > dataEnd - entry.offset ||
+        entry.size > static_cast<uint64_t>(std::numeric_limits<size_t>::max()))
+    {
+        log::warning("Malformed pack archive '%s': file '%s' exceeds the archive range",
+            m_ArchivePath.c_str(), std::string(getEntryName(entry)).c_str());
+        return nullptr;
+    }
+
+    if (offset > entry.size)
+        return nullptr;
+
+    const uint8_t* storedData = archiveData + entry.offset;
+    const size_t storedSize = size_t(entry.storedSize);
+    size = std::min(size, size_t(entry.size - offset));
+
+    if (entry.compression == uint32_t(PackCompression::None))
+    {
+        if (storedSize != entry.size)
+            return nullptr;
+
+        return std::make_shared<BlobView>(m_Mapping, storedData + offset, size);
+    }
+
+    // only decompress the data up to the end of the requested range
+    const size_t decompressedSize = size_t(offset) + size;
+    uint8_t* data = static_cast<uint8_t*>(malloc(std::max(decompressedSize, size_t(1))));
+
+    if (!data)
+        return nullptr;
+
+    bool success = false;
+    switch (PackCompression(entry.compression))
+    {
+#ifdef DONUT_WITH_LZ4
+    case PackCompression::LZ4:
+        success = decompressedSize <= size_t(LZ4_MAX_INPUT_SIZE) && storedSize <= size_t(LZ4_MAX_INPUT_SIZE) &&
+            LZ4_decompress_safe_partial(reinterpret_cast<const char*>(storedData), reinterpret_cast<char*>(data),
+                int(storedSize), int(decompressedSize), int(decompressedSize)) == int(decompressedSize);
+        break;
+#endif
+#ifdef DONUT_WITH_ZSTD
+    case PackCompression::Zstd: {
+        if (decompressedSize == entry.size)
+        {
+            const size_t result = ZSTD_decompress(data, decompressedSize, storedData, storedSize);
+            success = !ZSTD_isError(result) && result == decompressedSize;
+        }
+        else if (ZSTD_DStream* stream = ZSTD_createDStream())
+        {
+            ZSTD_inBuffer input = { storedData, storedSize, 0 };
+            ZSTD_outBuffer output = { data, decompressedSize, 0 };
+            size_t result = 1;
+            while (output.pos < output.size && input.pos < input.size && result != 0 && !ZSTD_isError(result))
+                result = ZSTD_decompressStream(stream, &output, &input);
+            success = !ZSTD_isError(result) && output.pos == decompressedSize;
+            ZSTD_freeDStream(stream);
+        }
+        break;
+    }
+#endif
+    default:
+        log::warning("Cannot read file '%s' from pack archive '%s': compression method %u is not supported",
+            std::string(getEntryName(entry)).c_str(), m_ArchivePath.c_str(), entry.compression);
+        free(data);
+        return nullptr;
+    }
+
+    if (!success)
+    {
+        log::warning("Failed to decompress file '%s' from pack archive '%s'",
+            std::string(getEntryName(entry)).c_str(), m_ArchivePath.c_str());
+        free(data);
+        return nullptr;
+    }
+
+    if (offset != 0)
+        memmove(data, data + offset, size);
+
+    return std::make_shared<Blob>(data, size);
+}
+
+std::shared_ptr<IBlob> PackFile::readFile(const std::filesystem::path& name)
+{
+    const Entry* entry = findEntry(name);
+
+    if (!entry || (entry->flags & c_EntryFlagDirectory) != 0)
+        return nullptr;
+
+    return readEntry(*entry, 0, std::numeric_limits<size_t>::max());
+}
+
+std::shared_ptr<IBlob> PackFile::readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size)
+{
+    const Entry* entry = findEntry(name);
+
+    if (!entry || (entry->flags & c_EntryFlagDirectory) != 0)
+        return nullptr;
+
+    return readEntry(*entry, offset, size);
+}
+
+bool PackFile::getFileSize(const std::filesystem::path& name, uint64_t& size)
+{
+    const Entry* entry = findEntry(name);
+
+    if (!entry || (entry->flags & c_EntryFlagDirectory) != 0)
+        return false;
+
+    size = entry->size;
+    return true;
+}
+
+bool PackFile::writeFile(const std::filesystem::path&, const void*, size_t)
+{
+    // pack files are mounted read-only, use PackWriter to create them
+    return false;
+}
+
+const DirectoryIndex& PackFile::getIndex()
+{
+    std::call_once(m_IndexCreated, [this]()
+    {
+        for (uint32_t index = 0; index < m_NumEntries; index++)
+        {
+            const Entry& entry = m_Entries[index];
+            if (entry.flags & c_EntryFlagDirectory)
+                m_Index.addDirectory(getEntryName(entry));
+            else
+                m_Index.addFile(getEntryName(entry));
+        }
+        m_Index.finalize();
+    });
+
+    return m_Index;
+}
+
+int PackFile::enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates)
+{
+    (void)allowDuplicates;
+    return getIndex().enumerateFiles(FileSearchPattern(path, extensions), callback);
+}
+
+int PackFile::enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback, bool allowDuplicates)
+{
+    (void)allowDuplicates;
+    return getIndex().enumerateDirectories(path, callback);
+}
+
+PackWriter::PackWriter(const std::filesystem::path& archivePath, uint32_t alignment)
+    : m_Alignment(std::max(alignment, uint32_t(sizeof(PackHeader))))
+{
+    m_ArchivePath = archivePath.lexically_normal().generic_string();
+
+    if ((m_Alignment & (m_Alignment - 1)) != 0)
+    {
+        log::warning("Cannot create pack archive '%s': alignment %u is not a power of 2", m_ArchivePath.c_str(), alignment);
+        return;
+    }
+
+    m_Stream.open(archivePath, std::ios::binary | std::ios::trunc);
+
+    if (!m_Stream.is_open())
+    {
+        log::warning("Cannot create pack archive '%s'", m_ArchivePath.c_str());
+        return;
+    }
+
+    const PackHeader header = { c_PackMagic, c_PackVersion, m_Alignment, 0 };
+    writeAligned(&header, sizeof(header));
+}
+
+PackWriter::~PackWriter()
+{
+    if (m_Stream.is_open())
+        finish();
+}
+
+bool PackWriter::isOpen() const
+{
+    return m_Stream.is_open() && !m_Errors;
+}
+
+bool PackWriter::writeAligned(const void* data, size_t size)
+{
+    m_Stream.write(static_cast<const char*>(data), std::streamsize(size));
+    m_Position += size;
+
+    const uint64_t padding = (m_Alignment - m_Position % m_Alignment) % m_Alignment;
+    if (padding)
+    {
+        const std::vector<char> zeros(padding);
+        m_Stream.write(zeros.data(), std::streamsize(padding));
+        m_Position += padding;
+    }
+
+    if (!m_Stream.good())
+        m_Errors = true;
+
+    return !m_Errors;
+}
+
+void PackWriter::addDirectories(const std::string& fileName)
+{
+    std::filesystem::path directory = std::filesystem::path(fileName).parent_path();
+    
+    while (!directory.empty())
+    {
+        std::string directoryName = directory.generic_string();
+        if (!m_Names.insert(directoryName).second)
+            break; // this directory and its parents are already added
+
+        PendingEntry entry;
+        entry.name = std::move(directoryName);
+        entry.directory = true;
+        m_Entries.push_back(std::move(entry));
+
+        directory = directory.parent_path();
+    }
+}
+
+bool PackWriter::addFile(const std::filesystem::path& name, const void* data, size_t size, PackCompression compression)
+{
+    if (!isOpen())
+        return false;
+
+    PendingEntry entry;
+    entry.name = normalizeName(name);
+    entry.offset = m_Position;
+    entry.size = size;
+
+    if (entry.name.empty() || m_Names.find(entry.name) != m_Names.end())
+    {
+        log::warning("Cannot add file '%s' to pack archive '%s': the name is empty or already used",
+            entry.name.c_str(), m_ArchivePath.c_str());
+        return false;
+    }
+
+    std::vector<char> compressedData;
+
+    switch (compression)
+    {
+    case PackCompression::None:
+        break;
+#ifdef DONUT_WITH_LZ4
+    case PackCompression::LZ4:
+        if (size <= size_t(LZ4_MAX_INPUT_SIZE))
+        {
+            compressedData.resize(LZ4_compressBound(int(size)));
+            const int compressedSize = LZ4_compress_HC(static_cast<const char*>(data), compressedData.data(),
+                int(size), int(compressedData.size()), m_CompressionLevel);
+            compressedData.resize(std::max(compressedSize, 0));
+        }
+        break;
+#endif
+#ifdef DONUT_WITH_ZSTD
+    case PackCompression::Zstd: {
+        compressedData.resize(ZSTD_compressBound(size));
+        const size_t compressedSize = ZSTD_compress(compressedData.data(), compressedData.size(), data, size, m_CompressionLevel);
+        compressedData.resize(ZSTD_isError(compressedSize) ? 0 : compressedSize);
+        break;
+    }
+#endif
+    default:
+        log::warning("Cannot add file '%s' to pack archive '%s': compression method %u is not supported",
+            entry.name.c_str(), m_ArchivePath.c_str(), uint32_t(compression));
+        return false;
+    }
+
+    // store the data uncompressed if compression has failed or didn't help
+    if (!compressedData.empty() && compressedData.size() < size)
+    {
+        entry.compression = compression;
+        entry.storedSize = compressedData.size();
+        data = compressedData.data();
+    }
+    else
+    {
+        entry.storedSize = size;
+    }
+
+    if (!writeAligned(data, size_t(entry.storedSize)))
+    {
+        log::warning("Error writing file '%s' to pack archive '%s'", entry.name.c_str(), m_ArchivePath.c_str());
+        return false;
+    }
+
+    addDirectories(entry.name);
+    m_Names.insert(entry.name);
+    m_Entries.push_back(std::move(entry));
+
+    return true;
+}
+
+bool PackWriter::finish()
+{
+    if (!m_Stream.is_open())
+        return false;
+
+    if (m_Errors)
+    {
+        m_Stream.close();
+        return false;
+    }
+
+    // build the table of contents sorted by name hash
+    std::vector<PackFile::Entry> entries;
+    entries.reserve(m_Entries.size());
+    std::string names;
+
+    for (const PendingEntry& pending : m_Entries)
+    {
+        PackFile::Entry entry{};
+        entry.nameHash = hashName(pending.name);
+        entry.offset = pending.offset;
+        entry.storedSize = pending.storedSize;
+        entry.size = pending.size;
+        entry.nameOffset = uint32_t(names.size());
+        entry.nameLength = uint32_t(pending.name.size());
+        entry.compression = uint32_t(pending.compression);
+        entry.flags = pending.directory ? c_EntryFlagDirectory : 0;
+        entries.push_back(entry);
+        names += pending.name;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const PackFile::Entry& a, const PackFile::Entry& b)
+        {
+            return a.nameHash < b.nameHash;
+        });
+
+    PackFooter footer{};
+    footer.tocOffset = m_Position;
+    footer.numEntries = uint32_t(entries.size());
+    footer.namesSize = uint32_t(names.size());
+    footer.version = c_PackVersion;
+    footer.magic = c_PackMagic;
+
+    m_Stream.write(reinterpret_cast<const char*>(entries.data()), std::streamsize(entries.size() * sizeof(PackFile::Entry)));
+    m_Stream.write(names.data(), std::streamsize(names.size()));
+    m_Stream.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+
+    const bool writeSuccessful = m_Stream.good();
+    m_Stream.close();
+
+    if (!writeSuccessful || m_Stream.fail())
+    {
+        log::warning("Error writing the table of contents to pack archive '%s'", m_ArchivePath.c_str());
+        m_Errors = true;
+        return false;
+    }
+
+    return true;
+}
@@ -23,16 +23,94 @@
 #include <donut/core/vfs/TarFile.h>
 #include <donut/core/log.h>
 #include <sstream>
-#include <regex>
 #include <cstring>
+#include <cerrno>
+#include <algorithm>
 
 #ifdef WIN32
-#define fseeko _fseeki64
-#define ftello _ftelli64
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 using namespace donut::vfs;
 
+#ifdef WIN32
+typedef HANDLE FileHandle;
+static const FileHandle InvalidFileHandle = INVALID_HANDLE_VALUE;
+#else
+typedef int FileHandle;
+static const FileHandle InvalidFileHandle = -1;
+#endif
+
+static FileHandle openFile(const std::string& path)
+{
+#ifdef WIN32
+    return CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+#else
+    return open(path.c_str(), O_RDONLY);
+#endif
+}
+
+static void closeFile(FileHandle file)
+{
+#ifdef WIN32
+    CloseHandle(file);
+#else
+    close(file);
+#endif
+}
+
+static bool getFileSize(FileHandle file, size_t& size)
+{
+#ifdef WIN32
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+        return false;
+    size = size_t(fileSize.QuadPart);
+#else
+    struct stat fileStat;
+    if (fstat(file, &fileStat) != 0)
+        return false;
+    size = size_t(fileStat.st_size);
+#endif
+    return true;
+}
+
+// Reads 'size' bytes at 'offset' without using the file position shared between threads.
+// Returns the number of bytes read, which is less than 'size' on errors or at the end of the file.
+static size_t readFileAt(FileHandle file, void* buffer, size_t size, size_t offset)
+{
+    size_t totalRead = 0;
+    while (totalRead < size)
+    {
+        char* destination = static_cast<char*>(buffer) + totalRead;
+        const size_t position = offset + totalRead;
+#ifdef WIN32
+        // Reads on a synchronous handle with an explicit offset don't depend on the current file position
+        OVERLAPPED overlapped{};
+        overlapped.Offset = DWORD(position);
+        overlapped.OffsetHigh = DWORD(uint64_t(position) >> 32);
+        
+        const DWORD bytesToRead = DWORD(std::min<size_t>(size - totalRead, 1u << 30));
+        DWORD bytesRead = 0;
+        if (!ReadFile(file, destination, bytesToRead, &bytesRead, &overlapped) || bytesRead == 0)
+            break;
+#else
+        const ssize_t bytesRead = pread(file, destination, size - totalRead, off_t(position));
+        if (bytesRead < 0 && errno == EINTR)
+            continue;
+        if (bytesRead <= 0)
+            break;
+#endif
+        totalRead += size_t(bytesRead);
+    }
+    return totalRead;
+}
+
 struct header_posix_ustar
 {
     char name[100];
@@ -59,29 +137,32 @@ static_assert(sizeof(header_posix_ustar) == 512);
 TarFile::TarFile(const std::filesystem::path& archivePath)
 {
     m_ArchivePath = archivePath.lexically_normal().generic_string();
-    m_ArchiveFile = fopen(m_ArchivePath.c_str(), "rb");
+    FileHandle archiveFile = openFile(m_ArchivePath);
 
-    if (m_ArchiveFile)
+    size_t archiveSize = 0;
+    if (archiveFile != InvalidFileHandle && !::getFileSize(archiveFile, archiveSize))
     {
-        bool errors = false;
+        closeFile(archiveFile);
+        archiveFile = InvalidFileHandle;
+    }
 
-        fseek(m_ArchiveFile, 0, SEEK_END);
-        size_t archiveSize = ftello(m_ArchiveFile);
+    if (archiveFile != InvalidFileHandle)
+    {
+        bool errors = false;
         
         size_t currentPosition = 0;
 
         while (currentPosition + sizeof(header_posix_ustar) <= archiveSize)
         {
-            fseeko(m_ArchiveFile, currentPosition, SEEK_SET);
-
             header_posix_ustar header{};
-            if (fread(&header, sizeof(header), 1, m_ArchiveFile) != 1)
+            if (readFileAt(archiveFile, &header, sizeof(header), currentPosition) != sizeof(header))
                 break;
 
             currentPosition += sizeof(header);
 
-            // check if this is a regular file
-            if (header.typeflag != '0' && header.typeflag != 0)
+            // check if this is a regular file or a directory
+            const bool isDirectory = header.typeflag == '5';
+            if (!isDirectory && header.typeflag != '0' && header.typeflag != 0)
                 continue;
 
             // combine the file name from prefix and name
@@ -103,6 +184,15 @@ TarFile::TarFile(const std::filesystem::path& archivePath)
             if (fileName[0] == 0)
                 continue;
 
+            if (isDirectory)
+            {
+                std::string_view directoryName = fileName;
+                while (!directoryName.empty() && directoryName.back() == '/')
+                    directoryName.remove_suffix(1);
+                m_Index.addDirectory(directoryName);
+                continue;
+            }
+
             // parse the octal size
             size_t fileSize = 0;
             for (char c : header.size)
@@ -119,8 +209,8 @@ TarFile::TarFile(const std::filesystem::path& archivePath)
             // validate the size
             if (currentPosition + fileSize > archiveSize)
             {
-                log::warning("Malformed tar archive '%s': file '%s' size (%ull bytes) exceeds the archive range",
-                    m_ArchivePath.c_str(), fileName, fileSize);
+                log::warning("Malformed tar archive '%s': file '%s' size (%llu bytes) exceeds the archive range",
+                    m_ArchivePath.c_str(), fileName, (unsigned long long)fileSize);
                 errors = true;
                 break;
             }
@@ -130,10 +220,7 @@ TarFile::TarFile(const std::filesystem::path& archivePath)
             entry.offset = currentPosition;
             entry.size = fileSize;
             m_Files[fileName] = entry;
-
-            std::filesystem::path filePath = fileName;
-            if (filePath.has_parent_path())
-                m_Directories.insert(filePath.parent_path().generic_string());
+            m_Index.addFile(fileName);
 
             // advance to the next file
             currentPosition += (fileSize + 511) & ~511;
@@ -141,36 +228,35 @@ TarFile::TarFile(const std::filesystem::path& archivePath)
 
         if (errors)
         {
-            fclose(m_ArchiveFile);
-            m_ArchiveFile = nullptr;
+            closeFile(archiveFile);
+            archiveFile = InvalidFileHandle;
             m_Files.clear();
-            m_Directories.clear();
+            m_Index.clear();
         }
+
+        m_Index.finalize();
     }
+
+    m_ArchiveFile = archiveFile;
 }
 
 TarFile::~TarFile()
 {
-    // make sure we're not closing the file while some other thread is reading from it
-    std::lock_guard<std::mutex> lockGuard(m_Mutex);
-
-    if (m_ArchiveFile)
+    if (m_ArchiveFile != InvalidFileHandle)
     {
-        fclose(m_ArchiveFile);
-        m_ArchiveFile = nullptr;
+        closeFile(m_ArchiveFile);
+        m_ArchiveFile = InvalidFileHandle;
     }
 }
 
 bool TarFile::isOpen() const
 {
-    return m_ArchiveFile != nullptr;
+    return m_ArchiveFile != InvalidFileHandle;
 }
 
 bool TarFile::folderExists(const std::filesystem::path& name)
 {
-    std::string normalizedName = name.lexically_normal().relative_path().generic_string();
-
-    return m_Directories.find(normalizedName) != m_Directories.end();
+    return m_Index.directoryExists(name);
 }
 
 bool TarFile::fileExists(const std::filesystem::path& name)
@@ -192,14 +278,10 @@ std::shared_ptr<IBlob> TarFile::readFile(const std::filesystem::path& name)
     if (entry == m_Files.end())
         return nullptr;
 
-    // prevent concurrent file operations from multiple threads from this point on
-    std::lock_guard<std::mutex> lockGuard(m_Mutex);
-    
-    if (fseeko(m_ArchiveFile, entry->second.offset, SEEK_SET) != 0)
+    if (m_MappingThreshold > 0 && entry->second.size >= m_MappingThreshold)
     {
-        log::warning("Error seeking to offset %ull for file '%s' in tar archive '%s'",
-            entry->second.offset, normalizedName.c_str(), m_ArchivePath.c_str());
-        return nullptr;
+        if (std::shared_ptr<IBlob> blob = mapEntry(entry->second))
+            return blob;
     }
 
     void* data = malloc(entry->second.size);
@@ -207,12 +289,12 @@ std::shared_ptr<IBlob> TarFile::readFile(const std::filesystem::path& name)
     if (!data)
         return nullptr;
 
-    size_t sizeRead = fread(data, 1, entry->second.size, m_ArchiveFile);
+    size_t sizeRead = readFileAt(m_ArchiveFile, data, entry->second.size, entry->second.offset);
 
     if (sizeRead != entry->second.size)
     {
-        log::warning("Error reading file '%s' (%ull bytes) from tar archive '%s'", 
-            entry->second.size, normalizedName.c_str(), m_ArchivePath.c_str());
+        log::warning("Error reading file '%s' (%llu bytes) from tar archive '%s'",
+            normalizedName.c_str(), (unsigned long long)entry->second.size, m_ArchivePath.c_str());
         free(data);
         return nullptr;
     }
@@ -222,6 +304,75 @@ std::shared_ptr<IBlob> TarFile::readFile(const std::filesystem::path& name)
     return std::static_pointer_cast<IBlob>(blob);
 }
 
+std::shared_ptr<IBlob> TarFile::mapEntry(const FileEntry& entry)
+{
+    // map the entire archive on first use, the mapping is shared by all views
+    std::call_once(m_MappingCreated, [this]()
+    {
+        m_Mapping = MappedFileBlob::create(m_ArchivePath);
+    });
+
+    if (!m_Mapping || entry.offset + entry.size > m_Mapping->size())
+        return nullptr;
+
+    return std::make_shared<BlobView>(m_Mapping, static_cast<const char*>(m_Mapping->data()) + entry.offset, entry.size);
+}
+
+std::shared_ptr<IBlob> TarFile::mapFile(const std::filesystem::path& name)
+{
+    std::string normalizedName = name.lexically_normal().relative_path().generic_string();
+
+    auto entry = m_Files.find(normalizedName);
+
+    if (entry == m_Files.end())
+        return nullptr;
+
+    std::shared_ptr<IBlob> blob = mapEntry(entry->second);
+
+    // fall back to reading if the archive can't be mapped
+    return blob ? blob : readFile(name);
+}
+
+bool TarFile::getFileSize(const std::filesystem::path& name, uint64_t& size)
+{
+    auto entry = m_Files.find(name.lexically_normal().relative_path().generic_string());
+
+    if (entry == m_Files.end())
+        return false;
+
+    size = entry->second.size;
+    return true;
+}
+
+std::shared_ptr<IBlob> TarFile::readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size)
+{
+    std::string normalizedName = name.lexically_normal().relative_path().generic_string();
+    
+    auto entry = m_Files.find(normalizedName);
+
+    if (entry == m_Files.end() || offset > entry->second.size)
+        return nullptr;
+
+    size = std::min(size, entry->second.size - size_t(offset));
+
+    void* data = malloc(std::max(size, size_t(1)));
+
+    if (!data)
+        return nullptr;
+
+    size_t sizeRead = readFileAt(m_ArchiveFile, data, size, entry->second.offset + size_t(offset));
+
+    if (sizeRead != size)
+    {
+        log::warning("Error reading file '%s' (%llu bytes at offset %llu) from tar archive '%s'", 
+            normalizedName.c_str(), (unsigned long long)size, (unsigned long long)offset, m_ArchivePath.c_str());
+        free(data);
+        return nullptr;
+    }
+
+    return std::make_shared<Blob>(data, size);
+}
+
 bool TarFile::writeFile(const std::filesystem::path&, const void*, size_t)
 {
     // tar files are mounted read-only
@@ -231,35 +382,11 @@ bool TarFile::writeFile(const std::filesystem::path&, const void*, size_t)
 int TarFile::enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates)
 {
     (void)allowDuplicates;
-    std::basic_regex<char> regex(getFileSearchRegex(path.relative_path(), extensions));
-
-    int numEntries = 0;
-    for (const auto& [name, record] : m_Files)
-    {
-        if (std::regex_match(name, regex))
-        {
-            std::filesystem::path filePath = name;
-            callback(filePath.filename().generic_string());
-            ++numEntries;
-        }
-    }
-
-    return numEntries;
+    return m_Index.enumerateFiles(FileSearchPattern(path, extensions), callback);
 }
 
 int TarFile::enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback, bool allowDuplicates)
 {
     (void)allowDuplicates;
-    std::filesystem::path normalizedPath = path.relative_path().lexically_normal();
-
-    int numEntries = 0;
-    for (const auto& name : m_Directories)
-    {
-        std::filesystem::path dirPath = name;
-        if (dirPath.parent_path() == normalizedPath)
-            callback(dirPath.filename().generic_string());
-        ++numEntries;
-    }
-    
-    return numEntries;
+    return m_Index.enumerateDirectories(path, callback);
 }
@@ -24,16 +24,26 @@
 #include <donut/core/log.h>
 #include <donut/core/string_utils.h>
 #include <fstream>
+#include <cstring>
 #include <cassert>
 #include <algorithm>
 #include <utility>
 #include <sstream>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #ifdef WIN32
+#include <Windows.h>
 #include <Shlwapi.h>
 #else
 extern "C" {
 #include <glob.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 }
 #endif // _WIN32
 
@@ -67,6 +77,289 @@ Blob::~Blob()
     m_size = 0;
 }
 
+std::shared_ptr<MappedFileBlob> MappedFileBlob::create(const std::filesystem::path& name)
+{
+    std::shared_ptr<MappedFileBlob> blob(new MappedFileBlob());
+
+#ifdef WIN32
+    HANDLE file = CreateFileW(name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 ||
+        uint64_t(size.QuadPart) > static_cast<uint64_t>(std::numeric_limits<size_t>::max()))
+    {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    // The mapping object keeps a reference to the file, so the file handle can be closed right away
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+
+    if (!mapping)
+        return nullptr;
+
+    blob->m_mappingHandle = mapping;
+    blob->m_data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    blob->m_size = size_t(size.QuadPart);
+#else
+    int file = open(name.c_str(), O_RDONLY);
+
+    if (file < 0)
+        return nullptr;
+
+    struct stat fileStat;
+    if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0 ||
+        uint64_t(fileStat.st_size) > static_cast<uint64_t>(std::numeric_limits<size_t>::max()))
+    {
+        close(file);
+        return nullptr;
+    }
+
+    // The mapping keeps a reference to the file, so the descriptor can be closed right away
+    void* data = mmap(nullptr, size_t(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+
+    if (data == MAP_FAILED)
+        return nullptr;
+
+    blob->m_data = data;
+    blob->m_size = size_t(fileStat.st_size);
+#endif
+
+    if (!blob->m_data)
+        return nullptr;
+
+    return blob;
+}
+
+MappedFileBlob::~MappedFileBlob()
+{
+#ifdef WIN32
+    if (m_data)
+        UnmapViewOfFile(m_data);
+
+    if (m_mappingHandle)
+        CloseHandle(m_mappingHandle);
+
+    m_mappingHandle = nullptr;
+#else
+    if (m_data)
+        munmap(m_data, m_size);
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+}
+
+const void* MappedFileBlob::data() const
+{
+    return m_data;
+}
+
+size_t MappedFileBlob::size() const
+{
+    return m_size;
+}
+
+BlobView::BlobView(std::shared_ptr<IBlob> parent, const void* data, size_t size)
+    : m_parent(std::move(parent))
+    , m_data(data)
+    , m_size(size)
+{
+}
+
+const void* BlobView::data() const
+{
+    return m_data;
+}
+
+size_t BlobView::size() const
+{
+    return m_size;
+}
+
+namespace
+{
+    class AsyncReadQueue : public IAsyncReadQueue
+    {
+    private:
+        struct Task
+        {
+            std::function<void()> function;
+            ReadPriority priority;
+            uint64_t sequence;
+        };
+
+        std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        std::vector<Task> m_Tasks; // binary heap
+        std::vector<std::thread> m_Threads;
+        uint64_t m_NextSequence = 0;
+        bool m_Stopping = false;
+
+        static bool compareTasks(const Task& a, const Task& b);
+        void workerThread();
+
+    public:
+        explicit AsyncReadQueue(uint32_t numThreads);
+        ~AsyncReadQueue() override;
+
+        void submit(std::function<void()> task, ReadPriority priority) override;
+        [[nodiscard]] uint32_t getNumThreads() const override { return uint32_t(m_Threads.size()); }
+    };
+
+    AsyncReadQueue::AsyncReadQueue(uint32_t numThreads)
+    {
+        // the threads mostly wait for I/O, so a few of them are enough even on small CPUs
+        if (numThreads == 0)
+            numThreads = std::clamp(std::thread::hardware_concurrency(), 2u, 8u);
+
+        for (uint32_t thread = 0; thread < numThreads; thread++)
+            m_Threads.emplace_back(&AsyncReadQueue::workerThread, this);
+    }
+
+    AsyncReadQueue::~AsyncReadQueue()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stopping = true;
+        }
+        m_Condition.notify_all();
+
+        for (std::thread& thread : m_Threads)
+            thread.join();
+    }
+
+    bool AsyncReadQueue::compareTasks(const Task& a, const Task& b)
+    {
+        // std::push_heap puts the largest element first: higher priority, then lower sequence number
+        if (a.priority != b.priority)
+            return a.priority < b.priority;
+
+        return a.sequence > b.sequence;
+    }
+
+    void AsyncReadQueue::submit(std::function<void()> task, ReadPriority priority)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Tasks.push_back(Task{ std::move(task), priority, m_NextSequence++ });
+            std::push_heap(m_Tasks.begin(), m_Tasks.end(), compareTasks);
+        }
+        m_Condition.notify_one();
+    }
+
+    void AsyncReadQueue::workerThread()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_Condition.wait(lock, [this]() { return m_Stopping || !m_Tasks.empty(); });
+
+                if (m_Tasks.empty())
+                    return; // stopping and no more work
+
+                std::pop_heap(m_Tasks.begin(), m_Tasks.end(), compareTasks);
+                task = std::move(m_Tasks.back().function);
+                m_Tasks.pop_back();
+            }
+
+            task();
+        }
+    }
+}
+
+std::unique_ptr<IAsyncReadQueue> IAsyncReadQueue::create(uint32_t numThreads)
+{
+    return std::make_unique<AsyncReadQueue>(numThreads);
+}
+
+IAsyncReadQueue& IAsyncReadQueue::getDefault()
+{
+    static AsyncReadQueue queue(0);
+    return queue;
+}
+
+std::shared_ptr<IBlob> IFileSystem::readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size)
+{
+    std::shared_ptr<IBlob> blob = readFile(name);
+
+    if (!blob)
+        return nullptr;
+
+    return copyBlobRange(blob->data(), blob->size(), offset, size);
+}
+
+bool IFileSystem::getFileSize(const std::filesystem::path& name, uint64_t& size)
+{
+    std::shared_ptr<IBlob> blob = readFile(name);
+
+    if (!blob)
+        return false;
+
+    size = blob->size();
+    return true;
+}
+
+std::shared_ptr<IBlob> IFileSystem::copyBlobRange(const void* data, size_t dataSize, uint64_t offset, size_t size)
+{
+    if (offset > dataSize)
+        return nullptr;
+
+    size = std::min(size, dataSize - size_t(offset));
+
+    void* rangeData = malloc(std::max(size, size_t(1)));
+
+    if (!rangeData)
+        return nullptr;
+
+    if (size)
+        memcpy(rangeData, static_cast<const char*>(data) + offset, size);
+
+    return std::make_shared<Blob>(rangeData, size);
+}
+
+void IFileSystem::readFilesAsync(std::vector<AsyncReadRequest> requests)
+{
+    IAsyncReadQueue& queue = IAsyncReadQueue::getDefault();
+
+    for (AsyncReadRequest& request : requests)
+    {
+        const ReadPriority priority = request.priority;
+        queue.submit([this, request = std::move(request)]()
+        {
+            request.callback(readFile(request.name));
+        }, priority);
+    }
+}
+
+void IFileSystem::readFileAsync(const std::filesystem::path& name, read_callback_t callback, ReadPriority priority)
+{
+    std::vector<AsyncReadRequest> requests;
+    requests.push_back(AsyncReadRequest{ name, std::move(callback), priority });
+    readFilesAsync(std::move(requests));
+}
+
+std::future<std::shared_ptr<IBlob>> IFileSystem::readFileAsync(const std::filesystem::path& name, ReadPriority priority)
+{
+    auto promise = std::make_shared<std::promise<std::shared_ptr<IBlob>>>();
+    std::future<std::shared_ptr<IBlob>> future = promise->get_future();
+
+    readFileAsync(name, [promise](std::shared_ptr<IBlob> blob)
+    {
+        promise->set_value(std::move(blob));
+    }, priority);
+
+    return future;
+}
+
 bool NativeFileSystem::folderExists(const std::filesystem::path& name)
 {
 	return std::filesystem::exists(name) && std::filesystem::is_directory(name);
@@ -79,6 +372,21 @@ bool NativeFileSystem::fileExists(const std::filesystem::path& name)
 
 std::shared_ptr<IBlob> NativeFileSystem::readFile(const std::filesystem::path& name)
 {
+    if (m_MappingThreshold > 0)
+    {
+        std::error_code ec;
+        const uintmax_t fileSize = std::filesystem::file_size(name, ec);
+
+        if (!ec && fileSize >= m_MappingThreshold)
+        {
+            std::shared_ptr<IBlob> blob = MappedFileBlob::create(name);
+
+            // fall back to reading if the file can't be mapped
+            if (blob)
+                return blob;
+        }
+    }
+
     // TODO: better error reporting
 
     std::ifstream file(name, std::ios::binary);
@@ -122,6 +430,69 @@ std::shared_ptr<IBlob> NativeFileSystem::readFile(const std::filesystem::path& n
     return std::make_shared<Blob>(data, size);
 }
 
+std::shared_ptr<IBlob> NativeFileSystem::readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size)
+{
+    std::ifstream file(name, std::ios::binary);
+
+    if (!file.is_open())
+    {
+        // file does not exist or is locked
+        return nullptr;
+    }
+
+    file.seekg(0, std::ios::end);
+    uint64_t fileSize = file.tellg();
+
+    if (offset > fileSize)
+        return nullptr;
+
+    size = size_t(std::min(uint64_t(size), fileSize - offset));
+
+    char* data = static_cast<char*>(malloc(std::max(size, size_t(1))));
+
+    if (data == nullptr)
+    {
+        // out of memory
+        assert(false);
+        return nullptr;
+    }
+
+    file.seekg(std::streamoff(offset), std::ios::beg);
+    file.read(data, std::streamsize(size));
+
+    if (!file.good())
+    {
+        // reading error
+        free(data);
+        return nullptr;
+    }
+
+    return std::make_shared<Blob>(data, size);
+}
+
+bool NativeFileSystem::getFileSize(const std::filesystem::path& name, uint64_t& size)
+{
+    std::error_code ec;
+    const uintmax_t fileSize = std::filesystem::file_size(name, ec);
+
+    if (ec)
+        return false;
+
+    size = uint64_t(fileSize);
+    return true;
+}
+
+std::shared_ptr<IBlob> NativeFileSystem::mapFile(const std::filesystem::path& name)
+{
+    std::shared_ptr<IBlob> blob = MappedFileBlob::create(name);
+
+    // Empty files can't be mapped, and some file systems might not support mapping
+    if (!blob)
+        return readFile(name);
+
+    return blob;
+}
+
 bool NativeFileSystem::writeFile(const std::filesystem::path& name, const void* data, size_t size)
 {
     // TODO: better error reporting
@@ -148,6 +519,42 @@ bool NativeFileSystem::writeFile(const std::filesystem::path& name, const void*
     return true;
 }
 
+bool NativeFileSystem::writeFileAtomic(const std::filesystem::path& name, const void* data, size_t size)
+{
+    // Write a temporary file next to the target and rename it over the target. Open and mapped
+    // handles keep the old file on POSIX systems; on Windows, the rename fails while the target is open.
+    // The temporary name is unique to the process, thread and call, so that concurrent writers
+    // of the same file never write into each other's temporary file.
+    static std::atomic<uint32_t> counter = 0;
+#ifdef WIN32
+    unsigned long processId = GetCurrentProcessId();
+#else
+    unsigned long processId = (unsigned long)getpid();
+#endif
+    std::ostringstream suffix;
+    suffix << "." << processId << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << "." << counter++ << ".tmp";
+
+    std::filesystem::path tempName = name;
+    tempName += suffix.str();
+
+    if (!writeFile(tempName, data, size))
+    {
+        std::error_code ec;
+        std::filesystem::remove(tempName, ec);
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempName, name, ec);
+    if (ec)
+    {
+        std::filesystem::remove(tempName, ec);
+        return false;
+    }
+
+    return true;
+}
+
 static int enumerateNativeFiles(const char* pattern, bool directories, enumerate_callback_t callback)
 {
 #ifdef WIN32
@@ -272,11 +679,39 @@ std::shared_ptr<IBlob> RelativeFileSystem::readFile(const std::filesystem::path&
     return m_UnderlyingFS->readFile(m_BasePath / name.relative_path());
 }
 
+std::shared_ptr<IBlob> RelativeFileSystem::mapFile(const std::filesystem::path& name)
+{
+    return m_UnderlyingFS->mapFile(m_BasePath / name.relative_path());
+}
+
+std::shared_ptr<IBlob> RelativeFileSystem::readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size)
+{
+    return m_UnderlyingFS->readFileRange(m_BasePath / name.relative_path(), offset, size);
+}
+
+bool RelativeFileSystem::getFileSize(const std::filesystem::path& name, uint64_t& size)
+{
+    return m_UnderlyingFS->getFileSize(m_BasePath / name.relative_path(), size);
+}
+
+void RelativeFileSystem::readFilesAsync(std::vector<AsyncReadRequest> requests)
+{
+    for (AsyncReadRequest& request : requests)
+        request.name = m_BasePath / request.name.relative_path();
+
+    m_UnderlyingFS->readFilesAsync(std::move(requests));
+}
+
 bool RelativeFileSystem::writeFile(const std::filesystem::path& name, const void* data, size_t size)
 {
     return m_UnderlyingFS->writeFile(m_BasePath / name.relative_path(), data, size);
 }
 
+bool RelativeFileSystem::writeFileAtomic(const std::filesystem::path& name, const void* data, size_t size)
+{
+    return m_UnderlyingFS->writeFileAtomic(m_BasePath / name.relative_path(), data, size);
+}
+
 int RelativeFileSystem::enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates)
 {
     return m_UnderlyingFS->enumerateFiles(m_BasePath / path.relative_path(), extensions, callback, allowDuplicates);
@@ -287,6 +722,32 @@ int RelativeFileSystem::enumerateDirectories(const std::filesystem::path& path,
     return m_UnderlyingFS->enumerateDirectories(m_BasePath / path.relative_path(), callback, allowDuplicates);
 }
 
+// Finds the next component of a normalized generic path, starting at 'position'.
+// A leading '/' is returned as a separate component, so that absolute and relative paths are different.
+static bool nextPathComponent(std::string_view path, size_t& position, std::string_view& component)
+{
+    if (position == 0 && !path.empty() && path[0] == '/')
+    {
+        component = path.substr(0, 1);
+        position = 1;
+        return true;
+    }
+
+    while (position < path.size() && path[position] == '/')
+        ++position;
+
+    if (position >= path.size())
+        return false;
+
+    size_t end = path.find('/', position);
+    if (end == std::string_view::npos)
+        end = path.size();
+
+    component = path.substr(position, end - position);
+    position = end;
+    return true;
+}
+
 void RootFileSystem::mount(const std::filesystem::path& path, std::shared_ptr<IFileSystem> fs)
 {
     if (findMountPoint(path, nullptr, nullptr))
@@ -295,7 +756,20 @@ void RootFileSystem::mount(const std::filesystem::path& path, std::shared_ptr<IF
         return;
     }
 
-    m_MountPoints.push_back(std::make_pair(path.lexically_normal().generic_string(), fs));
+    const std::string spath = path.lexically_normal().generic_string();
+
+    MountNode* node = &m_MountTree;
+    size_t position = 0;
+    std::string_view component;
+    while (nextPathComponent(spath, position, component))
+    {
+        std::unique_ptr<MountNode>& child = node->children[std::string(component)];
+        if (!child)
+            child = std::make_unique<MountNode>();
+        node = child.get();
+    }
+
+    node->fs = std::move(fs);
 }
 
 void donut::vfs::RootFileSystem::mount(const std::filesystem::path& path, const std::filesystem::path& nativePath)
@@ -305,44 +779,66 @@ void donut::vfs::RootFileSystem::mount(const std::filesystem::path& path, const
 
 bool RootFileSystem::unmount(const std::filesystem::path& path)
 {
-    std::string spath = path.lexically_normal().generic_string();
+    const std::string spath = path.lexically_normal().generic_string();
 
-    for (size_t index = 0; index < m_MountPoints.size(); index++)
+    MountNode* node = &m_MountTree;
+    size_t position = 0;
+    std::string_view component;
+    while (nextPathComponent(spath, position, component))
     {
-        if (m_MountPoints[index].first == spath)
-        {
-            m_MountPoints.erase(m_MountPoints.begin() + index);
-            return true;
-        }
+        auto child = node->children.find(std::string(component));
+        if (child == node->children.end())
+            return false;
+        node = child->second.get();
     }
 
-    return false;
+    if (!node->fs)
+        return false;
+
+    node->fs.reset();
+    return true;
 }
 
 bool RootFileSystem::findMountPoint(const std::filesystem::path& path, std::filesystem::path* pRelativePath, IFileSystem** ppFS)
 {
-    std::string spath = path.lexically_normal().generic_string();
-
-    for (auto it : m_MountPoints)
+    const std::string spath = path.lexically_normal().generic_string();
+
+    // Walk down the tree and remember the deepest node with a mounted file system
+    const MountNode* node = &m_MountTree;
+    const MountNode* mountNode = node->fs ? node : nullptr;
+    size_t mountEnd = 0;
+    size_t position = 0;
+    std::string_view component;
+    while (nextPathComponent(spath, position, component))
     {
-        if (spath.find(it.first, 0) == 0 && ((spath.length() == it.first.length()) || (spath[it.first.length()] == '/')))
+        auto child = node->children.find(std::string(component));
+        if (child == node->children.end())
+            break;
+
+        node = child->second.get();
+        if (node->fs)
         {
-            if (pRelativePath)
-            {
-                std::string relative = (spath.length() == it.first.length()) ? "" : spath.substr(it.first.size() + 1);
-                *pRelativePath = relative;
-            }
+            mountNode = node;
+            mountEnd = position;
+        }
+    }
 
-            if (ppFS)
-            {
-                *ppFS = it.second.get();
-            }
+    if (!mountNode)
+        return false;
 
-            return true;
-        }
+    if (pRelativePath)
+    {
+        while (mountEnd < spath.size() && spath[mountEnd] == '/')
+            ++mountEnd;
+        *pRelativePath = spath.substr(mountEnd);
     }
 
-    return false;
+    if (ppFS)
+    {
+        *ppFS = mountNode->fs.get();
+    }
+
+    return true;
 }
 
 bool RootFileSystem::folderExists(const std::filesystem::path& name)
@@ -384,6 +880,73 @@ std::shared_ptr<IBlob> RootFileSystem::readFile(const std::filesystem::path& nam
     return nullptr;
 }
 
+std::shared_ptr<IBlob> RootFileSystem::mapFile(const std::filesystem::path& name)
+{
+    std::filesystem::path relativePath;
+    IFileSystem* fs = nullptr;
+
+    if (findMountPoint(name, &relativePath, &fs))
+    {
+        return fs->mapFile(relativePath);
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<IBlob> RootFileSystem::readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size)
+{
+    std::filesystem::path relativePath;
+    IFileSystem* fs = nullptr;
+
+    if (findMountPoint(name, &relativePath, &fs))
+    {
+        return fs->readFileRange(relativePath, offset, size);
+    }
+
+    return nullptr;
+}
+
+bool RootFileSystem::getFileSize(const std::filesystem::path& name, uint64_t& size)
+{
+    std::filesystem::path relativePath;
+    IFileSystem* fs = nullptr;
+
+    if (findMountPoint(name, &relativePath, &fs))
+    {
+        return fs->getFileSize(relativePath, size);
+    }
+
+    return false;
+}
+
+void RootFileSystem::readFilesAsync(std::vector<AsyncReadRequest> requests)
+{
+    // forward the requests to the mounted file systems in batches
+    std::vector<std::pair<IFileSystem*, std::vector<AsyncReadRequest>>> batches;
+
+    for (AsyncReadRequest& request : requests)
+    {
+        std::filesystem::path relativePath;
+        IFileSystem* fs = nullptr;
+
+        if (!findMountPoint(request.name, &relativePath, &fs))
+        {
+            request.callback(nullptr);
+            continue;
+        }
+
+        auto batch = std::find_if(batches.begin(), batches.end(), [fs](const auto& batch) { return batch.first == fs; });
+        if (batch == batches.end())
+            batch = batches.insert(batches.end(), { fs, {} });
+
+        request.name = relativePath;
+        batch->second.push_back(std::move(request));
+    }
+
+    for (auto& [fs, batch] : batches)
+        fs->readFilesAsync(std::move(batch));
+}
+
 bool RootFileSystem::writeFile(const std::filesystem::path& name, const void* data, size_t size)
 {
     std::filesystem::path relativePath;
@@ -397,6 +960,19 @@ bool RootFileSystem::writeFile(const std::filesystem::path& name, const void* da
     return false;
 }
 
+bool RootFileSystem::writeFileAtomic(const std::filesystem::path& name, const void* data, size_t size)
+{
+    std::filesystem::path relativePath;
+    IFileSystem* fs = nullptr;
+
+    if (findMountPoint(name, &relativePath, &fs))
+    {
+        return fs->writeFileAtomic(relativePath, data, size);
+    }
+
+    return false;
+}
+
 int RootFileSystem::enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates)
 {
     std::filesystem::path relativePath;
@@ -423,6 +999,283 @@ int RootFileSystem::enumerateDirectories(const std::filesystem::path& path, enum
     return status::PathNotFound;
 }
 
+// Returns the path relative to the archive root, without leading or trailing slashes.
+static std::string normalizeArchivePath(const std::filesystem::path& path)
+{
+    std::string result = path.relative_path().lexically_normal().generic_string();
+
+    const size_t start = result.find_first_not_of('/');
+    if (start == std::string::npos)
+        return std::string();
+    result.erase(0, start);
+
+    while (!result.empty() && result.back() == '/')
+        result.pop_back();
+
+    if (result == ".")
+        result.clear();
+
+    return result;
+}
+
+FileSearchPattern::FileSearchPattern(const std::filesystem::path& path, const std::vector<std::string>& extensions)
+{
+    m_Path = normalizeArchivePath(path);
+    m_PathHasWildcards = m_Path.find_first_of("?*") != std::string::npos;
+    if (m_PathHasWildcards)
+        m_PathGlob = compileGlob(m_Path);
+
+    if (extensions.empty())
+        m_FileNameGlobs.push_back(compileGlob("*"));
+
+    for (const std::string& extension : extensions)
+        m_FileNameGlobs.push_back(compileGlob("*" + extension));
+}
+
+FileSearchPattern::Glob FileSearchPattern::compileGlob(std::string_view pattern)
+{
+    Glob glob;
+
+    for (char c : pattern)
+    {
+        switch (c)
+        {
+        case '?':
+            glob.tokens.push_back({ GlobToken::Type::Optional, 0 });
+            break;
+        case '*':
+            glob.tokens.push_back({ GlobToken::Type::One, 0 });
+            glob.tokens.push_back({ GlobToken::Type::Star, 0 });
+            break;
+        default:
+            glob.tokens.push_back({ GlobToken::Type::Literal, c });
+        }
+    }
+
+    // Most patterns look like '*.ext', match those with a simple suffix comparison
+    if (glob.tokens.size() >= 2 && glob.tokens[0].type == GlobToken::Type::One && glob.tokens[1].type == GlobToken::Type::Star)
+    {
+        glob.isSuffixGlob = std::all_of(glob.tokens.begin() + 2, glob.tokens.end(),
+            [](const GlobToken& token) { return token.type == GlobToken::Type::Literal; });
+
+        if (glob.isSuffixGlob)
+            glob.literalSuffix = pattern.substr(1);
+    }
+
+    return glob;
+}
+
+bool FileSearchPattern::matchGlob(const Glob& glob, std::string_view text)
+{
+    if (glob.isSuffixGlob)
+    {
+        const size_t prefixLength = text.size() - glob.literalSuffix.size();
+        return text.size() > glob.literalSuffix.size()
+            && text.compare(prefixLength, std::string_view::npos, glob.literalSuffix) == 0
+            && text.substr(0, prefixLength).find('/') == std::string_view::npos;
+    }
+
+    // Simulate a nondeterministic automaton whose states are the positions in the token list.
+    // Optional and Star tokens can be skipped without consuming a character, which only moves forward,
+    // so one pass over the states in order computes the closure.
+    const std::vector<GlobToken>& tokens = glob.tokens;
+    std::vector<uint8_t> current(tokens.size() + 1, 0);
+    std::vector<uint8_t> next(tokens.size() + 1, 0);
+
+    auto addSkippedTokens = [&tokens](std::vector<uint8_t>& states)
+    {
+        for (size_t i = 0; i < tokens.size(); i++)
+        {
+            if (states[i] && (tokens[i].type == GlobToken::Type::Optional || tokens[i].type == GlobToken::Type::Star))
+                states[i + 1] = 1;
+        }
+    };
+
+    current[0] = 1;
+    addSkippedTokens(current);
+
+    for (char c : text)
+    {
+        std::fill(next.begin(), next.end(), 0);
+        bool anyState = false;
+
+        for (size_t i = 0; i < tokens.size(); i++)
+        {
+            if (!current[i])
+                continue;
+
+            const GlobToken& token = tokens[i];
+            switch (token.type)
+            {
+            case GlobToken::Type::Literal:
+                if (c == token.character)
+                    next[i + 1] = anyState = true;
+                break;
+            case GlobToken::Type::Optional:
+            case GlobToken::Type::One:
+                if (c != '/')
+                    next[i + 1] = anyState = true;
+                break;
+            case GlobToken::Type::Star:
+                if (c != '/')
+                    next[i] = anyState = true;
+                break;
+            }
+        }
+
+        if (!anyState)
+            return false;
+
+        addSkippedTokens(next);
+        std::swap(current, next);
+    }
+
+    return current[tokens.size()] != 0;
+}
+
+bool FileSearchPattern::match(std::string_view name) const
+{
+    const size_t slash = name.rfind('/');
+    if (slash == std::string_view::npos)
+        return matchDirectory(std::string_view()) && matchFileName(name);
+
+    return matchDirectory(name.substr(0, slash)) && matchFileName(name.substr(slash + 1));
+}
+
+bool FileSearchPattern::matchDirectory(std::string_view path) const
+{
+    if (!m_PathHasWildcards)
+        return path == m_Path;
+
+    return matchGlob(m_PathGlob, path);
+}
+
+bool FileSearchPattern::matchFileName(std::string_view fileName) const
+{
+    for (const Glob& glob : m_FileNameGlobs)
+    {
+        if (matchGlob(glob, fileName))
+            return true;
+    }
+
+    return false;
+}
+
+DirectoryIndex::Directory& DirectoryIndex::addDirectoryAndParents(std::string_view path)
+{
+    // Adding the parents can rehash the map, which keeps the references valid but not the iterators
+    auto [it, inserted] = m_Directories.try_emplace(std::string(path));
+    Directory& directory = it->second;
+
+    if (inserted && !path.empty())
+    {
+        const size_t slash = path.rfind('/');
+        if (slash == std::string_view::npos)
+            addDirectoryAndParents(std::string_view()).subdirectories.emplace_back(path);
+        else
+            addDirectoryAndParents(path.substr(0, slash)).subdirectories.emplace_back(path.substr(slash + 1));
+    }
+
+    return directory;
+}
+
+DirectoryIndex::Directory& DirectoryIndex::findOrAddDirectory(std::string_view path)
+{
+    if (!m_LastDirectory || path != m_LastDirectoryPath)
+    {
+        m_LastDirectory = &addDirectoryAndParents(path);
+        m_LastDirectoryPath = path;
+    }
+
+    return *m_LastDirectory;
+}
+
+void DirectoryIndex::addFile(std::string_view path)
+{
+    const size_t slash = path.rfind('/');
+    if (slash == std::string_view::npos)
+        findOrAddDirectory(std::string_view()).files.emplace_back(path);
+    else if (slash + 1 < path.size())
+        findOrAddDirectory(path.substr(0, slash)).files.emplace_back(path.substr(slash + 1));
+}
+
+void DirectoryIndex::addDirectory(std::string_view path)
+{
+    addDirectoryAndParents(path);
+}
+
+void DirectoryIndex::finalize()
+{
+    for (auto& [path, directory] : m_Directories)
+    {
+        for (std::vector<std::string>* names : { &directory.files, &directory.subdirectories })
+        {
+            // archives are often created from sorted lists of files
+            if (!std::is_sorted(names->begin(), names->end()))
+                std::sort(names->begin(), names->end());
+            names->erase(std::unique(names->begin(), names->end()), names->end());
+        }
+    }
+}
+
+void DirectoryIndex::clear()
+{
+    m_Directories.clear();
+    m_LastDirectoryPath.clear();
+    m_LastDirectory = nullptr;
+}
+
+bool DirectoryIndex::directoryExists(const std::filesystem::path& path) const
+{
+    return m_Directories.find(normalizeArchivePath(path)) != m_Directories.end();
+}
+
+int DirectoryIndex::enumerateFiles(const FileSearchPattern& pattern, enumerate_callback_t callback) const
+{
+    int numEntries = 0;
+
+    auto enumerateDirectory = [&pattern, &callback, &numEntries](const Directory& directory)
+    {
+        for (const std::string& name : directory.files)
+        {
+            if (pattern.matchFileName(name))
+            {
+                callback(name);
+                ++numEntries;
+            }
+        }
+    };
+
+    if (!pattern.pathHasWildcards())
+    {
+        auto directory = m_Directories.find(pattern.getPath());
+        if (directory != m_Directories.end())
+            enumerateDirectory(directory->second);
+
+        return numEntries;
+    }
+
+    for (const auto& [path, directory] : m_Directories)
+    {
+        if (pattern.matchDirectory(path))
+            enumerateDirectory(directory);
+    }
+
+    return numEntries;
+}
+
+int DirectoryIndex::enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback) const
+{
+    auto directory = m_Directories.find(normalizeArchivePath(path));
+    if (directory == m_Directories.end())
+        return status::PathNotFound;
+
+    for (const std::string& name : directory->second.subdirectories)
+        callback(name);
+
+    return int(directory->second.subdirectories.size());
+}
+
 static void appendPatternToRegex(const std::string& pattern, std::stringstream& regex)
 {
     for (char c : pattern)
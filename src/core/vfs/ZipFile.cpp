@@ -25,85 +25,110 @@
 #include <donut/core/string_utils.h>
 #include <miniz.h> // declares mz_alloc_func etc. used in miniz_zip.h
 #include <miniz_zip.h>
-#include <regex>
+#include <algorithm>
+#include <cstring>
 
 using namespace donut::vfs;
 
+namespace
+{
+    constexpr uint32_t c_LocalHeaderSignature = 0x04034b50;
+    constexpr size_t c_LocalHeaderSize = 30;
+
+    uint16_t readLE16(const uint8_t* p)
+    {
+        return uint16_t(p[0] | (p[1] << 8));
+    }
+
+    uint32_t readLE32(const uint8_t* p)
+    {
+        return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+    }
+}
+
 ZipFile::ZipFile(const std::filesystem::path& archivePath)
 {
     m_ArchivePath = archivePath.lexically_normal().generic_string();
 
-    m_ZipArchive = malloc(sizeof(mz_zip_archive));
-    memset(m_ZipArchive, 0, sizeof(mz_zip_archive));
+    std::shared_ptr<MappedFileBlob> mapping = MappedFileBlob::create(archivePath);
+    if (!mapping)
+    {
+        log::warning("Cannot open zip archive '%s'", m_ArchivePath.c_str());
+        return;
+    }
+
+    // Parse the central directory with miniz and copy the file information into our own table,
+    // the archive object is not needed after that because the files are read from the mapping directly.
+    mz_zip_archive zipArchive;
+    memset(&zipArchive, 0, sizeof(zipArchive));
 
-    if (!mz_zip_reader_init_file((mz_zip_archive*)m_ZipArchive, m_ArchivePath.c_str(), 
+    if (!mz_zip_reader_init_mem(&zipArchive, mapping->data(), mapping->size(),
         MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY | MZ_ZIP_FLAG_VALIDATE_HEADERS_ONLY))
     {
-        const char* errorString = mz_zip_get_error_string(mz_zip_get_last_error((mz_zip_archive*)m_ZipArchive));
-        log::warning("Cannot open zip archive '%s': ", m_ArchivePath.c_str(), errorString);
-
-        close();
+        const char* errorString = mz_zip_get_error_string(mz_zip_get_last_error(&zipArchive));
+        log::warning("Cannot open zip archive '%s': %s", m_ArchivePath.c_str(), errorString);
+        return;
     }
 
-    mz_uint numFiles = mz_zip_reader_get_num_files((mz_zip_archive*)m_ZipArchive);
+    mz_uint numFiles = mz_zip_reader_get_num_files(&zipArchive);
+    m_Files.reserve(numFiles);
     for (mz_uint i = 0; i < numFiles; i++)
     {
-        mz_uint nameLength = mz_zip_reader_get_filename((mz_zip_archive*)m_ZipArchive, i, nullptr, 0);
-        std::string name;
-        name.resize(nameLength - 1); // exclude the trailing zero
-        mz_zip_reader_get_filename((mz_zip_archive*)m_ZipArchive, i, name.data(), nameLength);
+        mz_zip_archive_file_stat stat;
+        if (!mz_zip_reader_file_stat(&zipArchive, i, &stat))
+            continue;
+
+        std::string name = stat.m_filename;
 
         if (string_utils::ends_with(name, "/"))
             name.erase(name.size() - 1);
 
-        if (mz_zip_reader_is_file_a_directory((mz_zip_archive*)m_ZipArchive, i))
-            m_Directories.insert(name);
-        else
-            m_Files[name] = i;
-    }
-;}
+        if (stat.m_is_directory)
+        {
+            m_Index.addDirectory(name);
+            continue;
+        }
 
-ZipFile::~ZipFile()
-{
-    close();
-}
+        if (stat.m_is_encrypted || (stat.m_method != 0 && stat.m_method != MZ_DEFLATED))
+        {
+            log::warning("File '%s' in zip archive '%s' is encrypted or uses an unsupported compression method",
+                name.c_str(), m_ArchivePath.c_str());
+            continue;
+        }
 
-void ZipFile::close()
-{
-    // make sure we're not closing the file while some other thread is reading from it
-    std::lock_guard<std::mutex> lockGuard(m_Mutex);
+        m_Index.addFile(name);
 
-    if (m_ZipArchive)
-    {
-        mz_zip_reader_end((mz_zip_archive*)m_ZipArchive);
-        free(m_ZipArchive);
-        m_ZipArchive = nullptr;
+        FileEntry& entry = m_Files[name];
+        entry.localHeaderOffset = stat.m_local_header_ofs;
+        entry.compressedSize = stat.m_comp_size;
+        entry.uncompressedSize = stat.m_uncomp_size;
+        entry.method = stat.m_method;
+        entry.crc = stat.m_crc32;
     }
+
+    mz_zip_reader_end(&zipArchive);
+
+    m_Index.finalize();
+
+    m_Mapping = std::move(mapping);
 }
 
 bool ZipFile::isOpen() const
 {
-    return m_ZipArchive != nullptr;
+    return m_Mapping != nullptr;
 }
 
 bool ZipFile::folderExists(const std::filesystem::path& name)
 {
-    std::string normalizedName = name.lexically_normal().relative_path().generic_string();
-
-    return m_Directories.find(normalizedName) != m_Directories.end();
+    return m_Index.directoryExists(name);
 }
 
 bool ZipFile::fileExists(const std::filesystem::path& name)
 {
-    if (!isOpen())
-        return false;
-
-    std::string normalizedName = name.lexically_normal().relative_path().generic_string();
-
-    return m_Files.find(normalizedName) != m_Files.end();
+    return findFile(name) != nullptr;
 }
 
-std::shared_ptr<IBlob> ZipFile::readFile(const std::filesystem::path& name)
+const ZipFile::FileEntry* ZipFile::findFile(const std::filesystem::path& name) const
 {
     if (!isOpen())
         return nullptr;
@@ -118,42 +143,113 @@ std::shared_ptr<IBlob> ZipFile::readFile(const std::filesystem::path& name)
     if (entry == m_Files.end())
         return nullptr;
 
-    uint32_t fileIndex = entry->second;
+    return &entry->second;
+}
 
-    // working with the archive from now on, requires synchronous access
-    std::lock_guard<std::mutex> lockGuard(m_Mutex);
+const uint8_t* ZipFile::getFileData(const FileEntry& entry, const std::string& name) const
+{
+    // The file data follows the local header, which has its own copies of the name and extra fields
+    const uint8_t* archiveData = static_cast<const uint8_t*>(m_Mapping->data());
+    const uint64_t archiveSize = m_Mapping->size();
 
-    // get information about the file, including its uncompressed size
-    mz_zip_archive_file_stat stat;
-    if (!mz_zip_reader_file_stat((mz_zip_archive*)m_ZipArchive, fileIndex , &stat))
-    {
-        const char* errorString = mz_zip_get_error_string(mz_zip_get_last_error((mz_zip_archive*)m_ZipArchive));
-        log::warning("Cannot stat file '%s' in zip archive '%s': %s",
-            normalizedName.c_str(), m_ArchivePath.c_str(), errorString);
+    if (entry.localHeaderOffset + c_LocalHeaderSize > archiveSize)
+        return nullptr;
 
+    const uint8_t* header = archiveData + entry.localHeaderOffset;
+    const uint32_t signature = readLE32(header);
+    const uint16_t nameLength = readLE16(header + 26);
+    const uint16_t extraLength = readLE16(header + 28);
+
+    const uint64_t dataOffset = entry.localHeaderOffset + c_LocalHeaderSize + nameLength + extraLength;
+
+    if (signature != c_LocalHeaderSignature || dataOffset + entry.compressedSize > archiveSize)
+    {
+        log::warning("Cannot read file '%s' from zip archive '%s': invalid local header",
+            name.c_str(), m_ArchivePath.c_str());
         return nullptr;
     }
 
-    if (stat.m_uncomp_size == 0)
+    return archiveData + dataOffset;
+}
+
+std::shared_ptr<IBlob> ZipFile::inflateFile(const FileEntry& entry, const uint8_t* data, const std::string& name) const
+{
+    void* uncompressedData = malloc(entry.uncompressedSize);
+    if (!uncompressedData)
         return nullptr;
 
-    // extract the file
-    void* uncompressedData = malloc(stat.m_uncomp_size);
-    if (!mz_zip_reader_extract_to_mem((mz_zip_archive*)m_ZipArchive, fileIndex, uncompressedData, stat.m_uncomp_size, 0))
+    // tinfl_decompress_mem_to_mem keeps the decompressor state on the stack, so any number of threads can inflate at once
+    const size_t uncompressedSize = tinfl_decompress_mem_to_mem(uncompressedData, entry.uncompressedSize,
+        data, entry.compressedSize, 0);
+
+    if (uncompressedSize != entry.uncompressedSize ||
+        mz_crc32(MZ_CRC32_INIT, static_cast<const uint8_t*>(uncompressedData), uncompressedSize) != entry.crc)
     {
         free(uncompressedData);
 
-        const char* errorString = mz_zip_get_error_string(mz_zip_get_last_error((mz_zip_archive*)m_ZipArchive));
-        log::warning("Cannot extract file '%s' from zip archive '%s': %s",
-            normalizedName.c_str(), m_ArchivePath.c_str(), errorString);
+        log::warning("Cannot extract file '%s' from zip archive '%s': the data is corrupted",
+            name.c_str(), m_ArchivePath.c_str());
 
         return nullptr;
     }
 
-    // package the extracted data into a blob and return
-    std::shared_ptr<Blob> blob = std::make_shared<Blob>(uncompressedData, stat.m_uncomp_size);
+    return std::make_shared<Blob>(uncompressedData, entry.uncompressedSize);
+}
+
+std::shared_ptr<IBlob> ZipFile::readFile(const std::filesystem::path& name)
+{
+    const FileEntry* entry = findFile(name);
+
+    if (!entry || entry->uncompressedSize == 0)
+        return nullptr;
+
+    const std::string normalizedName = name.lexically_normal().relative_path().generic_string();
+    const uint8_t* data = getFileData(*entry, normalizedName);
+
+    if (!data)
+        return nullptr;
+
+    // stored files are returned directly from the mapping
+    if (entry->method == 0)
+    {
+        if (entry->compressedSize != entry->uncompressedSize)
+            return nullptr;
+
+        return std::make_shared<BlobView>(m_Mapping, data, entry->uncompressedSize);
+    }
+
+    return inflateFile(*entry, data, normalizedName);
+}
+
+std::shared_ptr<IBlob> ZipFile::readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size)
+{
+    const FileEntry* entry = findFile(name);
+
+    if (!entry || entry->method != 0)
+        return IFileSystem::readFileRange(name, offset, size);
+
+    if (offset > entry->uncompressedSize || entry->compressedSize != entry->uncompressedSize)
+        return nullptr;
+
+    const uint8_t* data = getFileData(*entry, name.lexically_normal().relative_path().generic_string());
+
+    if (!data)
+        return nullptr;
+
+    size = size_t(std::min(uint64_t(size), entry->uncompressedSize - offset));
+
+    return std::make_shared<BlobView>(m_Mapping, data + offset, size);
+}
+
+bool ZipFile::getFileSize(const std::filesystem::path& name, uint64_t& size)
+{
+    const FileEntry* entry = findFile(name);
+
+    if (!entry)
+        return false;
 
-    return std::static_pointer_cast<IBlob>(blob);
+    size = entry->uncompressedSize;
+    return true;
 }
 
 bool ZipFile::writeFile(const std::filesystem::path&, const void*, size_t)
@@ -165,35 +261,11 @@ bool ZipFile::writeFile(const std::filesystem::path&, const void*, size_t)
 int ZipFile::enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates)
 {
     (void)allowDuplicates;
-    std::basic_regex<char> regex(getFileSearchRegex(path.relative_path(), extensions));
-
-    int numEntries = 0;
-    for (const auto& [name, record] : m_Files)
-    {
-        if (std::regex_match(name, regex))
-        {
-            std::filesystem::path filePath = name;
-            callback(filePath.filename().generic_string());
-            ++numEntries;
-        }
-    }
-
-    return numEntries;
+    return m_Index.enumerateFiles(FileSearchPattern(path, extensions), callback);
 }
 
 int ZipFile::enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback, bool allowDuplicates)
 {
     (void)allowDuplicates;
-    std::filesystem::path normalizedPath = path.relative_path().lexically_normal();
-
-    int numEntries = 0;
-    for (const auto& name : m_Directories)
-    {
-        std::filesystem::path dirPath = name;
-        if (dirPath.parent_path() == normalizedPath)
-            callback(dirPath.filename().generic_string());
-        ++numEntries;
-    }
-    
-    return numEntries;
+    return m_Index.enumerateDirectories(path, callback);
 }
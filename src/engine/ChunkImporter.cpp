@@ -0,0 +1,703 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/ChunkImporter.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/TextureCache.h>
+#include <donut/core/chunk/chunk.h>
+#include <donut/core/vfs/VFS.h>
+#include <donut/core/json.h>
+#include <donut/core/log.h>
+
+#include <json/reader.h>
+#include <json/writer.h>
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+using namespace donut::math;
+using namespace donut::vfs;
+using namespace donut::engine;
+
+static constexpr uint32_t c_InvalidChunkIndex = ~0u;
+
+ChunkImporter::ChunkImporter(std::shared_ptr<vfs::IFileSystem> fs, std::shared_ptr<SceneTypeFactory> sceneTypeFactory)
+    : m_fs(std::move(fs))
+    , m_SceneTypeFactory(std::move(sceneTypeFactory))
+{
+}
+
+template<typename T>
+static void CopyStream(std::vector<T>& dst, const T* src, uint32_t count)
+{
+    if (src)
+        dst.assign(src, src + count);
+}
+
+template<typename T>
+static void AppendStream(std::vector<T>& dst, const std::vector<T>& src, uint32_t offset, uint32_t count)
+{
+    if (size_t(offset) + count <= src.size())
+        dst.insert(dst.end(), src.begin() + offset, src.begin() + offset + count);
+    else
+        dst.resize(dst.size() + count);
+}
+
+static daffine3 GetLocalTransform(const SceneGraphNode& node)
+{
+    daffine3 transform = scaling(node.GetScaling());
+    transform *= node.GetRotation().toAffine();
+    transform *= translation(node.GetTranslation());
+    return transform;
+}
+
+// Calls f(key, value) for each material parameter that is stored in the materials chunk.
+// Works on const materials when saving and on mutable ones when loading.
+template<typename M, typename F>
+static void ForEachMaterialParameter(M& material, F&& f)
+{
+    f("baseOrDiffuseColor", material.baseOrDiffuseColor);
+    f("specularColor", material.specularColor);
+    f("emissiveColor", material.emissiveColor);
+    f("emissiveIntensity", material.emissiveIntensity);
+    f("metalness", material.metalness);
+    f("roughness", material.roughness);
+    f("opacity", material.opacity);
+    f("alphaCutoff", material.alphaCutoff);
+    f("transmissionFactor", material.transmissionFactor);
+    f("normalTextureScale", material.normalTextureScale);
+    f("occlusionStrength", material.occlusionStrength);
+    f("normalTextureTransformScale", material.normalTextureTransformScale);
+    f("useSpecularGlossModel", material.useSpecularGlossModel);
+    f("enableSubsurfaceScattering", material.enableSubsurfaceScattering);
+    f("subsurface.transmissionColor", material.subsurface.transmissionColor);
+    f("subsurface.scatteringColor", material.subsurface.scatteringColor);
+    f("subsurface.scale", material.subsurface.scale);
+    f("subsurface.anisotropy", material.subsurface.anisotropy);
+    f("enableHair", material.enableHair);
+    f("hair.baseColor", material.hair.baseColor);
+    f("hair.melanin", material.hair.melanin);
+    f("hair.melaninRedness", material.hair.melaninRedness);
+    f("hair.longitudinalRoughness", material.hair.longitudinalRoughness);
+    f("hair.azimuthalRoughness", material.hair.azimuthalRoughness);
+    f("hair.diffuseReflectionWeight", material.hair.diffuseReflectionWeight);
+    f("hair.diffuseReflectionTint", material.hair.diffuseReflectionTint);
+    f("hair.ior", material.hair.ior);
+    f("hair.cuticleAngle", material.hair.cuticleAngle);
+    f("enableBaseOrDiffuseTexture", material.enableBaseOrDiffuseTexture);
+    f("enableMetalRoughOrSpecularTexture", material.enableMetalRoughOrSpecularTexture);
+    f("enableNormalTexture", material.enableNormalTexture);
+    f("enableEmissiveTexture", material.enableEmissiveTexture);
+    f("enableOcclusionTexture", material.enableOcclusionTexture);
+    f("enableTransmissionTexture", material.enableTransmissionTexture);
+    f("enableOpacityTexture", material.enableOpacityTexture);
+    f("doubleSided", material.doubleSided);
+    f("metalnessInRedChannel", material.metalnessInRedChannel);
+}
+
+struct MaterialTextureSlot
+{
+    const char* key;
+    std::shared_ptr<LoadedTexture> Material::* texture;
+};
+
+static const MaterialTextureSlot c_MaterialTextureSlots[] = {
+    { "baseOrDiffuseTexture", &Material::baseOrDiffuseTexture },
+    { "metalRoughOrSpecularTexture", &Material::metalRoughOrSpecularTexture },
+    { "normalTexture", &Material::normalTexture },
+    { "emissiveTexture", &Material::emissiveTexture },
+    { "occlusionTexture", &Material::occlusionTexture },
+    { "transmissionTexture", &Material::transmissionTexture },
+    { "opacityTexture", &Material::opacityTexture },
+};
+
+// Color textures are loaded as sRGB, like GltfImporter does
+static bool IsMaterialTextureSRGB(const Material& material, std::shared_ptr<LoadedTexture> Material::* texture)
+{
+    return texture == &Material::baseOrDiffuseTexture
+        || texture == &Material::emissiveTexture
+        || (texture == &Material::metalRoughOrSpecularTexture && material.useSpecularGlossModel);
+}
+
+// Texture files are referenced relative to the chunk file when possible, so that
+// the model and its textures can be moved together
+static bool SaveMaterial(const Material& material, const std::filesystem::path& modelPath, Json::Value& node)
+{
+    node["name"] << material.name;
+    node["domain"] << MaterialDomainToString(material.domain);
+
+    ForEachMaterialParameter(material, [&node](const char* key, const auto& value) { node[key] << value; });
+
+    for (const auto& slot : c_MaterialTextureSlots)
+    {
+        const std::shared_ptr<LoadedTexture>& texture = material.*slot.texture;
+        if (!texture)
+            continue;
+
+        // Textures decoded from memory (e.g. embedded in a .glb file) have no file to reference
+        if (texture->path.empty() || !texture->mimeType.empty())
+        {
+            donut::log::error("Material '%s' uses texture '%s' which is not a file, it cannot be referenced from a chunk file",
+                material.name.c_str(), texture->path.c_str());
+            return false;
+        }
+
+        std::filesystem::path texturePath = std::filesystem::path(texture->path).lexically_relative(modelPath.parent_path());
+        if (texturePath.empty())
+            texturePath = texture->path;
+
+        node["textures"][slot.key] << texturePath.generic_string();
+    }
+
+    return true;
+}
+
+static void LoadMaterial(
+    const Json::Value& node,
+    const std::filesystem::path& modelPath,
+    TextureCache& textureCache,
+    tf::Executor* executor,
+    Material& material)
+{
+    node["name"] >> material.name;
+
+    std::string domain;
+    node["domain"] >> domain;
+    for (int index = 0; index < int(MaterialDomain::Count); index++)
+    {
+        if (domain == MaterialDomainToString(MaterialDomain(index)))
+            material.domain = MaterialDomain(index);
+    }
+
+    ForEachMaterialParameter(material, [&node](const char* key, auto& value) { node[key] >> value; });
+
+    const Json::Value& textures = node["textures"];
+    for (const auto& slot : c_MaterialTextureSlots)
+    {
+        std::string texturePath;
+        textures[slot.key] >> texturePath;
+        if (texturePath.empty())
+            continue;
+
+        std::filesystem::path filePath = modelPath.parent_path() / texturePath;
+        bool sRGB = IsMaterialTextureSRGB(material, slot.texture);
+
+#ifdef DONUT_WITH_TASKFLOW
+        if (executor)
+            material.*slot.texture = textureCache.LoadTextureFromFileAsync(filePath, sRGB, *executor);
+        else
+#endif
+            material.*slot.texture = textureCache.LoadTextureFromFileDeferred(filePath, sRGB);
+    }
+}
+
+bool ChunkImporter::Load(
+    const std::filesystem::path& fileName,
+    TextureCache& textureCache,
+    tf::Executor* executor,
+    SceneImportResult& result) const
+{
+    result.rootNode.reset();
+
+    std::string normalizedFileName = fileName.lexically_normal().generic_string();
+
+    // Only the chunks of the mesh set are read from the file, and they are released with the mesh set
+    // once the buffers are filled. Files written with older chunk layouts are upgraded in memory,
+    // loading a scene never writes to the asset file system.
+    std::shared_ptr<chunk::ChunkFile const> chunkFile = chunk::ChunkFile::open(m_fs, fileName);
+    if (!chunkFile)
+    {
+        log::error("Couldn't read chunk file '%s'", normalizedFileName.c_str());
+        return false;
+    }
+
+    std::shared_ptr<chunk::MeshSetBase const> meshSetBase = chunk::deserialize(chunkFile);
+    if (!meshSetBase)
+        return false;
+
+    if (meshSetBase->type != chunk::MeshSetBase::MESH)
+    {
+        log::error("Chunk file '%s' contains a meshlet set, which cannot be imported into a scene", normalizedFileName.c_str());
+        return false;
+    }
+
+    const chunk::MeshSet& mset = static_cast<const chunk::MeshSet&>(*meshSetBase);
+
+    // Files written by Save describe their materials, and the mesh infos reference them by index
+    std::vector<std::shared_ptr<Material>> fileMaterials;
+    if (mset.materials)
+    {
+        Json::Value documentRoot;
+        Json::CharReaderBuilder builder;
+        std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+        std::string errors;
+        size_t length = strlen(mset.materials);
+
+        if (!reader->parse(mset.materials, mset.materials + length, &documentRoot, &errors) || !documentRoot["materials"].isArray())
+        {
+            log::error("Couldn't parse the materials of chunk file '%s':\n%s", normalizedFileName.c_str(), errors.c_str());
+            return false;
+        }
+
+        for (const Json::Value& node : documentRoot["materials"])
+        {
+            auto material = m_SceneTypeFactory->CreateMaterial();
+            material->modelFileName = normalizedFileName;
+            material->materialIndexInModel = int(fileMaterials.size());
+            LoadMaterial(node, fileName, textureCache, executor, *material);
+            fileMaterials.push_back(material);
+        }
+    }
+
+    for (uint32_t minfo_idx = 0; minfo_idx < mset.nmeshInfos; minfo_idx++)
+    {
+        const chunk::MeshInfo& minfo = mset.meshInfos[minfo_idx];
+        if (uint64_t(minfo.firstVertex) + minfo.numVertices > mset.nverts ||
+            uint64_t(minfo.firstIndex) + minfo.numIndices > mset.nindices)
+        {
+            log::error("Mesh info %d in chunk file '%s' references data outside of the vertex or index streams",
+                minfo_idx, normalizedFileName.c_str());
+            return false;
+        }
+
+        if (mset.materials && minfo.materialId != c_InvalidChunkIndex && minfo.materialId >= fileMaterials.size())
+        {
+            log::error("Mesh info %d in chunk file '%s' references an invalid material",
+                minfo_idx, normalizedFileName.c_str());
+            return false;
+        }
+    }
+
+    // The streams have the same layout as the BufferGroup arrays, no per-vertex conversion is needed.
+    auto buffers = std::make_shared<BufferGroup>();
+    CopyStream(buffers->indexData, mset.indices, mset.nindices);
+    CopyStream(buffers->positionData, mset.streams.position, mset.nverts);
+    CopyStream(buffers->normalData, mset.streams.normal, mset.nverts);
+    CopyStream(buffers->tangentData, mset.streams.tangent, mset.nverts);
+    CopyStream(buffers->texcoord1Data, mset.streams.texcoord0, mset.nverts);
+    CopyStream(buffers->texcoord2Data, mset.streams.texcoord1, mset.nverts);
+
+    std::unordered_map<std::string, std::shared_ptr<Material>> materials;
+
+    auto getMaterial = [this, &materials, &fileMaterials, &normalizedFileName](const chunk::MeshInfo& minfo)
+    {
+        if (minfo.materialId < fileMaterials.size())
+            return fileMaterials[minfo.materialId];
+
+        // Files without a materials description only have the material names
+        std::shared_ptr<Material>& material = materials[minfo.materialName ? minfo.materialName : "(empty)"];
+        if (!material)
+        {
+            material = m_SceneTypeFactory->CreateMaterial();
+            material->name = minfo.materialName ? minfo.materialName : "(empty)";
+            material->modelFileName = normalizedFileName;
+            material->materialIndexInModel = int(minfo.materialId);
+        }
+        return material;
+    };
+
+    // Meshes are identified by the range of chunk mesh infos that their instances reference
+    std::unordered_map<uint64_t, std::shared_ptr<MeshInfo>> meshes;
+
+    auto getMesh = [this, &mset, &meshes, &buffers, &getMaterial](uint32_t firstMeshInfo, uint32_t numMeshInfos)
+    {
+        std::shared_ptr<MeshInfo>& mesh = meshes[(uint64_t(firstMeshInfo) << 32) | numMeshInfos];
+        if (mesh)
+            return mesh;
+
+        const chunk::MeshInfo& first = mset.meshInfos[firstMeshInfo];
+
+        mesh = m_SceneTypeFactory->CreateMesh();
+        if (first.name) mesh->name = first.name;
+        mesh->buffers = buffers;
+        mesh->indexOffset = first.firstIndex;
+        mesh->vertexOffset = first.firstVertex;
+        mesh->objectSpaceBounds = box3::empty();
+
+        for (uint32_t minfo_idx = firstMeshInfo; minfo_idx < firstMeshInfo + numMeshInfos; minfo_idx++)
+        {
+            const chunk::MeshInfo& minfo = mset.meshInfos[minfo_idx];
+
+            auto geometry = m_SceneTypeFactory->CreateMeshGeometry();
+            geometry->material = getMaterial(minfo);
+            geometry->indexOffsetInMesh = minfo.firstIndex - mesh->indexOffset;
+            geometry->vertexOffsetInMesh = minfo.firstVertex - mesh->vertexOffset;
+            geometry->numIndices = minfo.numIndices;
+            geometry->numVertices = minfo.numVertices;
+            geometry->objectSpaceBounds = minfo.bbox;
+
+            mesh->objectSpaceBounds |= minfo.bbox;
+            mesh->totalIndices = geometry->indexOffsetInMesh + geometry->numIndices;
+            mesh->totalVertices = geometry->vertexOffsetInMesh + geometry->numVertices;
+            mesh->geometries.push_back(geometry);
+        }
+
+        return mesh;
+    };
+
+    std::shared_ptr<SceneGraph> graph = std::make_shared<SceneGraph>();
+    std::shared_ptr<SceneGraphNode> root = std::make_shared<SceneGraphNode>();
+    root->SetName(fileName.filename().generic_string());
+
+    // build the node hierarchy, parents before children
+    std::vector<std::shared_ptr<SceneGraphNode>> nodes(mset.nnodes);
+    std::vector<std::vector<uint32_t>> children(mset.nnodes);
+    std::vector<uint32_t> stack;
+
+    for (uint32_t node_idx = 0; node_idx < mset.nnodes; node_idx++)
+    {
+        uint32_t parentId = mset.nodes[node_idx].parentId;
+        if (parentId < mset.nnodes && parentId != node_idx)
+            children[parentId].push_back(node_idx);
+        else
+            stack.push_back(node_idx);
+    }
+    std::reverse(stack.begin(), stack.end());
+
+    // Files written by Save have a single top-level node for the saved root, which takes the place of the new root
+    // so that its children are attached directly and a Save and Load round trip doesn't add a level to the graph
+    const uint32_t savedRootId = stack.size() == 1 ? stack[0] : c_InvalidChunkIndex;
+
+    while (!stack.empty())
+    {
+        uint32_t node_idx = stack.back();
+        stack.pop_back();
+
+        const chunk::MeshNode& src = mset.nodes[node_idx];
+        auto dst = node_idx == savedRootId ? root : std::make_shared<SceneGraphNode>();
+        nodes[node_idx] = dst;
+
+        if (src.name)
+            dst->SetName(src.name);
+
+        if (src.transform != affine3::identity())
+        {
+            double3 translation;
+            double3 scaling;
+            dquat rotation;
+
+            decomposeAffine(daffine3(src.transform), &translation, &rotation, &scaling);
+
+            dst->SetTransform(&translation, &rotation, &scaling);
+        }
+
+        uint32_t parentId = src.parentId;
+        if (dst != root)
+            graph->Attach(parentId < mset.nnodes && nodes[parentId] ? nodes[parentId] : root, dst);
+
+        for (auto it = children[node_idx].rbegin(); it != children[node_idx].rend(); ++it)
+            stack.push_back(*it);
+    }
+
+    // Consecutive instances on the same node that reference consecutive mesh infos make up one mesh
+    for (uint32_t first = 0; first < mset.ninstances; )
+    {
+        const chunk::MeshInstance& instance = mset.instances[first];
+
+        if (instance.minfoId >= mset.nmeshInfos)
+        {
+            log::warning("Mesh instance %d in chunk file '%s' references an invalid mesh info", first, normalizedFileName.c_str());
+            ++first;
+            continue;
+        }
+
+        uint32_t last = first + 1;
+        while (last < mset.ninstances &&
+            mset.instances[last].nodeId == instance.nodeId &&
+            mset.instances[last].minfoId == mset.instances[last - 1].minfoId + 1 &&
+            mset.instances[last].minfoId < mset.nmeshInfos &&
+            mset.meshInfos[mset.instances[last].minfoId].firstVertex >= mset.meshInfos[instance.minfoId].firstVertex &&
+            mset.meshInfos[mset.instances[last].minfoId].firstIndex >= mset.meshInfos[instance.minfoId].firstIndex)
+        {
+            ++last;
+        }
+
+        auto leaf = m_SceneTypeFactory->CreateMeshInstance(getMesh(instance.minfoId, last - first));
+
+        std::shared_ptr<SceneGraphNode> node = instance.nodeId < mset.nnodes ? nodes[instance.nodeId] : nullptr;
+        if (!node)
+        {
+            // instances without a node are placed with their own transform
+            node = std::make_shared<SceneGraphNode>();
+            if (instance.name)
+                node->SetName(instance.name);
+
+            double3 translation;
+            double3 scaling;
+            dquat rotation;
+
+            decomposeAffine(daffine3(instance.transform), &translation, &rotation, &scaling);
+
+            node->SetTransform(&translation, &rotation, &scaling);
+            graph->Attach(root, node);
+        }
+        else if (node->GetLeaf())
+        {
+            // the node already has a leaf, attach another one as a child like the glTF importer does for cameras
+            auto child = std::make_shared<SceneGraphNode>();
+            graph->Attach(node, child);
+            node = child;
+        }
+
+        node->SetLeaf(leaf);
+
+        first = last;
+    }
+
+    result.rootNode = root;
+
+    return true;
+}
+
+bool ChunkImporter::Save(
+    const std::filesystem::path& fileName,
+    const SceneImportResult& model,
+    chunk::ChunkCodec codec,
+    int compressionLevel) const
+{
+    if (!model.rootNode)
+        return false;
+
+    std::vector<float3> positions;
+    std::vector<uint32_t> normals;
+    std::vector<uint32_t> tangents;
+    std::vector<float2> texcoords0;
+    std::vector<float2> texcoords1;
+    std::vector<uint32_t> indices;
+    bool hasNormals = false;
+    bool hasTangents = false;
+    bool hasTexcoords0 = false;
+    bool hasTexcoords1 = false;
+
+    std::vector<chunk::MeshInfo> meshInfos;
+    std::vector<chunk::MeshInstance> instances;
+    std::vector<chunk::MeshNode> nodes;
+    box3 modelBounds = box3::empty();
+
+    struct SavedMesh
+    {
+        uint32_t firstMeshInfo = 0;
+        uint32_t numMeshInfos = 0;
+    };
+    std::unordered_map<const MeshInfo*, SavedMesh> savedMeshes;
+
+    // Materials are stored in the order of their first use, mesh infos reference them by index
+    std::vector<const Material*> materials;
+    std::unordered_map<const Material*, uint32_t> materialIndices;
+
+    auto saveMaterial = [&materials, &materialIndices](const Material* material)
+    {
+        if (!material)
+            return c_InvalidChunkIndex;
+
+        auto found = materialIndices.find(material);
+        if (found != materialIndices.end())
+            return found->second;
+
+        uint32_t index = uint32_t(materials.size());
+        materialIndices[material] = index;
+        materials.push_back(material);
+        return index;
+    };
+
+    auto saveMesh = [&](const MeshInfo& mesh)
+    {
+        auto found = savedMeshes.find(&mesh);
+        if (found != savedMeshes.end())
+            return found->second;
+
+        SavedMesh& saved = savedMeshes[&mesh];
+
+        const BufferGroup* buffers = mesh.buffers.get();
+        bool supported = buffers && !mesh.IsCurve() && !mesh.isMorphTargetAnimationMesh && !mesh.isSkinPrototype;
+        for (const auto& geometry : mesh.geometries)
+            supported = supported && geometry->type == MeshGeometryPrimitiveType::Triangles;
+
+        if (!supported)
+        {
+            log::warning("Mesh '%s' cannot be stored in a chunk file, skipping it.", mesh.name.c_str());
+            return saved;
+        }
+
+        if (size_t(mesh.vertexOffset) + mesh.totalVertices > buffers->positionData.size() ||
+            size_t(mesh.indexOffset) + mesh.totalIndices > buffers->indexData.size())
+        {
+            log::warning("Mesh '%s' has no CPU-side vertex data, skipping it.", mesh.name.c_str());
+            return saved;
+        }
+
+        uint32_t baseVertex = uint32_t(positions.size());
+        uint32_t baseIndex = uint32_t(indices.size());
+
+        AppendStream(positions, buffers->positionData, mesh.vertexOffset, mesh.totalVertices);
+        AppendStream(normals, buffers->normalData, mesh.vertexOffset, mesh.totalVertices);
+        AppendStream(tangents, buffers->tangentData, mesh.vertexOffset, mesh.totalVertices);
+        AppendStream(texcoords0, buffers->texcoord1Data, mesh.vertexOffset, mesh.totalVertices);
+        AppendStream(texcoords1, buffers->texcoord2Data, mesh.vertexOffset, mesh.totalVertices);
+        AppendStream(indices, buffers->indexData, mesh.indexOffset, mesh.totalIndices);
+        hasNormals = hasNormals || !buffers->normalData.empty();
+        hasTangents = hasTangents || !buffers->tangentData.empty();
+        hasTexcoords0 = hasTexcoords0 || !buffers->texcoord1Data.empty();
+        hasTexcoords1 = hasTexcoords1 || !buffers->texcoord2Data.empty();
+
+        saved.firstMeshInfo = uint32_t(meshInfos.size());
+        saved.numMeshInfos = uint32_t(mesh.geometries.size());
+
+        for (const auto& geometry : mesh.geometries)
+        {
+            chunk::MeshInfo minfo{};
+            minfo.name = mesh.name.c_str();
+            minfo.materialName = geometry->material ? geometry->material->name.c_str() : nullptr;
+            minfo.materialId = saveMaterial(geometry->material.get());
+            minfo.bbox = geometry->objectSpaceBounds;
+            minfo.firstVertex = baseVertex + geometry->vertexOffsetInMesh;
+            minfo.numVertices = geometry->numVertices;
+            minfo.firstIndex = baseIndex + geometry->indexOffsetInMesh;
+            minfo.numIndices = geometry->numIndices;
+            meshInfos.push_back(minfo);
+        }
+
+        return saved;
+    };
+
+    struct StackItem
+    {
+        const SceneGraphNode* node;
+        uint32_t parentId;
+        daffine3 parentTransform;
+    };
+    std::vector<StackItem> stack;
+    std::vector<uint32_t> lastChild;
+
+    stack.push_back({ model.rootNode.get(), c_InvalidChunkIndex, daffine3::identity() });
+
+    while (!stack.empty())
+    {
+        StackItem item = stack.back();
+        stack.pop_back();
+
+        const SceneGraphNode* src = item.node;
+        uint32_t nodeId = uint32_t(nodes.size());
+
+        daffine3 localTransform = GetLocalTransform(*src);
+        daffine3 globalTransform = localTransform * item.parentTransform;
+
+        chunk::MeshNode dst{};
+        dst.name = src->GetName().c_str();
+        dst.parentId = item.parentId;
+        dst.siblingId = c_InvalidChunkIndex;
+        dst.instanceId = c_InvalidChunkIndex;
+        dst.transform = affine3(localTransform);
+        dst.ctm = affine3(globalTransform);
+        dst.bbox = box3::empty();
+
+        if (item.parentId != c_InvalidChunkIndex)
+        {
+            if (lastChild[item.parentId] != c_InvalidChunkIndex)
+                nodes[lastChild[item.parentId]].siblingId = nodeId;
+            lastChild[item.parentId] = nodeId;
+        }
+
+        if (auto meshInstance = std::dynamic_pointer_cast<MeshInstance>(src->GetLeaf()))
+        {
+            if (std::dynamic_pointer_cast<SkinnedMeshInstance>(meshInstance))
+            {
+                log::warning("Skinned mesh instance '%s' cannot be stored in a chunk file, skipping it.", src->GetName().c_str());
+            }
+            else if (meshInstance->GetMesh())
+            {
+                SavedMesh saved = saveMesh(*meshInstance->GetMesh());
+
+                for (uint32_t minfo_idx = saved.firstMeshInfo; minfo_idx < saved.firstMeshInfo + saved.numMeshInfos; minfo_idx++)
+                {
+                    chunk::MeshInstance instance{};
+                    instance.name = src->GetName().c_str();
+                    instance.minfoId = minfo_idx;
+                    instance.nodeId = nodeId;
+                    instance.transform = dst.ctm;
+                    instance.bbox = meshInfos[minfo_idx].bbox * dst.ctm;
+                    instance.center = instance.bbox.center();
+
+                    if (dst.instanceId == c_InvalidChunkIndex)
+                        dst.instanceId = uint32_t(instances.size());
+                    dst.bbox |= instance.bbox;
+                    instances.push_back(instance);
+                }
+            }
+        }
+
+        dst.center = dst.bbox.center();
+        modelBounds |= dst.bbox;
+
+        nodes.push_back(dst);
+        lastChild.push_back(c_InvalidChunkIndex);
+
+        for (size_t child = src->GetNumChildren(); child > 0; child--)
+            stack.push_back({ src->GetChild(child - 1), nodeId, globalTransform });
+    }
+
+    if (instances.empty())
+    {
+        log::error("Model '%s' has no meshes that can be stored in a chunk file", model.rootNode->GetName().c_str());
+        return false;
+    }
+
+    Json::Value materialsRoot;
+    materialsRoot["materials"] = Json::Value(Json::arrayValue);
+    for (const Material* material : materials)
+    {
+        if (!SaveMaterial(*material, fileName, materialsRoot["materials"].append(Json::Value())))
+            return false;
+    }
+
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    std::string materialsText = Json::writeString(builder, materialsRoot);
+
+    chunk::MeshSet mset;
+    mset.type = chunk::MeshSetBase::MESH;
+    mset.name = model.rootNode->GetName().c_str();
+    mset.streams.position = positions.data();
+    mset.streams.normal = hasNormals ? normals.data() : nullptr;
+    mset.streams.tangent = hasTangents ? tangents.data() : nullptr;
+    mset.streams.texcoord0 = hasTexcoords0 ? texcoords0.data() : nullptr;
+    mset.streams.texcoord1 = hasTexcoords1 ? texcoords1.data() : nullptr;
+    mset.nverts = uint32_t(positions.size());
+    mset.indices = indices.data();
+    mset.nindices = uint32_t(indices.size());
+    mset.meshInfos = meshInfos.data();
+    mset.nmeshInfos = uint32_t(meshInfos.size());
+    mset.instances = instances.data();
+    mset.ninstances = uint32_t(instances.size());
+    mset.nodes = nodes.data();
+    mset.nnodes = uint32_t(nodes.size());
+    mset.rootId = 0;
+    mset.bbox = modelBounds;
+    mset.materials = materialsText.c_str();
+
+    std::shared_ptr<IBlob const> blob = chunk::serialize(mset, codec, compressionLevel);
+    if (!blob)
+        return false;
+
+    return m_fs->writeFile(fileName, blob->data(), blob->size());
+}
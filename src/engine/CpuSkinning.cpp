@@ -0,0 +1,290 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/CpuSkinning.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/SceneTypes.h>
+#include <donut/core/math/simd.h>
+#include <donut/core/log.h>
+#include <donut/core/parallel.h>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+// Number of vertices skinned by one task in SkinVertices
+static constexpr uint32_t c_SkinningVerticesPerTask = 4096;
+
+// Keeps zero normals at zero where the shader would normalize them into NaNs
+static constexpr float c_MinNormalLengthSquared = 1e-30f;
+
+namespace
+{
+    // Stream pointers for one SkinVertices call, the input pointers are offset by firstVertex
+    struct SkinningStreams
+    {
+        const float3* inputPositions = nullptr;
+        const uint32_t* inputNormals = nullptr;
+        const uint32_t* inputTangents = nullptr;
+        const vector<uint16_t, 4>* inputJoints = nullptr;
+        const float4* inputWeights = nullptr;
+        const float4x4* jointMatrices = nullptr;
+        size_t jointCount = 0;
+
+        float3* outputPositions = nullptr;
+        uint32_t* outputNormals = nullptr;
+        uint32_t* outputTangents = nullptr;
+    };
+
+#if DM_SIMD
+    using simd::float4_t;
+
+    // Unpack_RGBA8_SNORM from packing.hlsli
+    float4_t UnpackSnorm8(uint32_t value)
+    {
+        // Replicate each byte into the top of a 32-bit lane and shift it back down to sign-extend it
+        __m128i v = _mm_cvtsi32_si128(int(value));
+        v = _mm_unpacklo_epi8(v, v);
+        v = _mm_unpacklo_epi16(v, v);
+        v = _mm_srai_epi32(v, 24);
+        return simd::max(simd::div(_mm_cvtepi32_ps(v), simd::splat(127.f)), simd::splat(-1.f));
+    }
+
+    // Pack_RGBA8_SNORM from packing.hlsli, which truncates towards zero
+    uint32_t PackSnorm8(float4_t v)
+    {
+        v = simd::mul(simd::min(simd::max(v, simd::splat(-1.f)), simd::splat(1.f)), simd::splat(127.f));
+        __m128i i = _mm_cvttps_epi32(v);
+        i = _mm_packs_epi32(i, i);
+        i = _mm_packs_epi16(i, i);
+        return uint32_t(_mm_cvtsi128_si32(i));
+    }
+
+    // Transforms and normalizes the xyz of a packed normal or tangent, and keeps its w
+    uint32_t SkinDirection(uint32_t packed, float4_t r0, float4_t r1, float4_t r2)
+    {
+        const float4_t xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+
+        float4_t v = UnpackSnorm8(packed);
+        float4_t d = simd::transform3(v, r0, r1, r2);
+        float4_t lengthSquared = simd::mul(d, d);
+        lengthSquared = simd::add(simd::add(lengthSquared, simd::splat<1>(lengthSquared)), simd::splat<2>(lengthSquared));
+        lengthSquared = simd::max(simd::splat<0>(lengthSquared), simd::splat(c_MinNormalLengthSquared));
+        d = simd::div(d, _mm_sqrt_ps(lengthSquared));
+        return PackSnorm8(_mm_or_ps(_mm_and_ps(xyzMask, d), _mm_andnot_ps(xyzMask, v)));
+    }
+
+    void SkinRange(const SkinningStreams& streams, size_t begin, size_t end)
+    {
+        for (size_t index = begin; index < end; index++)
+        {
+            const vector<uint16_t, 4>& joints = streams.inputJoints[index];
+            const float4& weights = streams.inputWeights[index];
+
+            // Blend the joint matrices, only the weights > 0 contribute like in the shader
+            float4_t r0 = _mm_setzero_ps();
+            float4_t r1 = r0, r2 = r0, r3 = r0;
+            for (int i = 0; i < 4; i++)
+            {
+                if (weights[i] > 0.f && joints[i] < streams.jointCount)
+                {
+                    const float* m = streams.jointMatrices[joints[i]].m_data;
+                    float4_t w = simd::splat(weights[i]);
+                    r0 = simd::add(r0, simd::mul(simd::load4(m + 0), w));
+                    r1 = simd::add(r1, simd::mul(simd::load4(m + 4), w));
+                    r2 = simd::add(r2, simd::mul(simd::load4(m + 8), w));
+                    r3 = simd::add(r3, simd::mul(simd::load4(m + 12), w));
+                }
+            }
+
+            float4_t position = simd::add(simd::transform3(simd::load3(&streams.inputPositions[index].x), r0, r1, r2), r3);
+            float* outputPosition = &streams.outputPositions[index].x;
+            simd::storeLow2(outputPosition, position);
+            _mm_store_ss(outputPosition + 2, _mm_movehl_ps(position, position));
+
+            if (streams.outputNormals)
+                streams.outputNormals[index] = SkinDirection(streams.inputNormals[index], r0, r1, r2);
+
+            if (streams.outputTangents)
+                streams.outputTangents[index] = SkinDirection(streams.inputTangents[index], r0, r1, r2);
+        }
+    }
+#else
+    float4 UnpackSnorm8(uint32_t value)
+    {
+        float4 result;
+        for (int i = 0; i < 4; i++)
+            result[i] = max(float(int8_t(value >> (i * 8))) / 127.f, -1.f);
+        return result;
+    }
+
+    uint32_t PackSnorm8(const float4& v)
+    {
+        uint32_t result = 0;
+        for (int i = 0; i < 4; i++)
+            result |= (uint32_t(int(clamp(v[i], -1.f, 1.f) * 127.f)) & 0xff) << (i * 8);
+        return result;
+    }
+
+    uint32_t SkinDirection(uint32_t packed, const float4x4& m)
+    {
+        float4 v = UnpackSnorm8(packed);
+        float3 d = (float4(v.xyz(), 0.f) * m).xyz();
+        d /= sqrtf(max(dot(d, d), c_MinNormalLengthSquared));
+        return PackSnorm8(float4(d, v.w));
+    }
+
+    void SkinRange(const SkinningStreams& streams, size_t begin, size_t end)
+    {
+        for (size_t index = begin; index < end; index++)
+        {
+            const vector<uint16_t, 4>& joints = streams.inputJoints[index];
+            const float4& weights = streams.inputWeights[index];
+
+            float4x4 m = float4x4::zero();
+            for (int i = 0; i < 4; i++)
+            {
+                if (weights[i] > 0.f && joints[i] < streams.jointCount)
+                    m += streams.jointMatrices[joints[i]] * weights[i];
+            }
+
+            streams.outputPositions[index] = (float4(streams.inputPositions[index], 1.f) * m).xyz();
+
+            if (streams.outputNormals)
+                streams.outputNormals[index] = SkinDirection(streams.inputNormals[index], m);
+
+            if (streams.outputTangents)
+                streams.outputTangents[index] = SkinDirection(streams.inputTangents[index], m);
+        }
+    }
+#endif
+
+    template<typename T>
+    bool CheckStream(const std::vector<T>& stream, size_t requiredSize, const char* name, bool optional)
+    {
+        if ((optional && stream.empty()) || stream.size() >= requiredSize)
+            return true;
+
+        log::error("SkinVertices: the input %s stream has %zu elements, %zu are required",
+            name, stream.size(), requiredSize);
+        return false;
+    }
+
+    template<typename T>
+    void CopyStream(const std::vector<T>& input, uint32_t firstVertex, uint32_t vertexCount, std::vector<T>& output)
+    {
+        if (input.empty())
+            return;
+
+        output.assign(input.begin() + firstVertex, input.begin() + firstVertex + vertexCount);
+    }
+}
+
+bool donut::engine::SkinVertices(const BufferGroup& input, uint32_t firstVertex, uint32_t vertexCount,
+    const float4x4* jointMatrices, size_t jointCount, BufferGroup& output, tf::Executor* executor)
+{
+    if (&input == &output)
+    {
+        log::error("SkinVertices: the input and output buffer groups must be different");
+        return false;
+    }
+
+    const size_t requiredSize = size_t(firstVertex) + size_t(vertexCount);
+    if (!CheckStream(input.positionData, requiredSize, "position", false) ||
+        !CheckStream(input.jointData, requiredSize, "joint index", false) ||
+        !CheckStream(input.weightData, requiredSize, "joint weight", false) ||
+        !CheckStream(input.normalData, requiredSize, "normal", true) ||
+        !CheckStream(input.tangentData, requiredSize, "tangent", true) ||
+        !CheckStream(input.texcoord1Data, requiredSize, "texcoord1", true) ||
+        !CheckStream(input.texcoord2Data, requiredSize, "texcoord2", true))
+        return false;
+
+    // The previous frame positions are the current output positions, unless there are none yet
+    const bool firstFrame = output.positionData.size() != vertexCount || output.prevPositionData.size() != vertexCount;
+    if (firstFrame)
+        output.positionData.resize(vertexCount);
+    else
+        output.positionData.swap(output.prevPositionData);
+
+    SkinningStreams streams;
+    streams.inputPositions = input.positionData.data() + firstVertex;
+    streams.inputJoints = input.jointData.data() + firstVertex;
+    streams.inputWeights = input.weightData.data() + firstVertex;
+    streams.jointMatrices = jointMatrices;
+    streams.jointCount = jointMatrices ? jointCount : 0;
+    streams.outputPositions = output.positionData.data();
+
+    if (!input.normalData.empty())
+    {
+        output.normalData.resize(vertexCount);
+        streams.inputNormals = input.normalData.data() + firstVertex;
+        streams.outputNormals = output.normalData.data();
+    }
+
+    if (!input.tangentData.empty())
+    {
+        output.tangentData.resize(vertexCount);
+        streams.inputTangents = input.tangentData.data() + firstVertex;
+        streams.outputTangents = output.tangentData.data();
+    }
+
+    const size_t maxTasks = (size_t(vertexCount) + c_SkinningVerticesPerTask - 1) / c_SkinningVerticesPerTask;
+    parallel::forEachRange(executor, vertexCount, maxTasks, 1, [&streams](size_t begin, size_t end)
+        {
+            SkinRange(streams, begin, end);
+        });
+
+    if (firstFrame)
+        output.prevPositionData = output.positionData;
+
+    // The texture coordinates are not transformed, copy them once
+    if (output.texcoord1Data.size() != vertexCount)
+        CopyStream(input.texcoord1Data, firstVertex, vertexCount, output.texcoord1Data);
+    if (output.texcoord2Data.size() != vertexCount)
+        CopyStream(input.texcoord2Data, firstVertex, vertexCount, output.texcoord2Data);
+
+    return true;
+}
+
+bool donut::engine::SkinVertices(const SkinnedMeshInstance& instance, BufferGroup& output, tf::Executor* executor)
+{
+    const auto& prototypeMesh = instance.GetPrototypeMesh();
+    if (!prototypeMesh || !prototypeMesh->buffers)
+    {
+        log::error("SkinVertices: the skinned mesh instance has no prototype mesh buffers");
+        return false;
+    }
+
+    const BufferGroup& prototypeBuffers = *prototypeMesh->buffers;
+    if (prototypeMesh->totalVertices != 0 && prototypeBuffers.positionData.empty())
+    {
+        log::error("SkinVertices: the vertex data of mesh '%s' is not available on the CPU, "
+            "it is released when the mesh buffers are created", prototypeMesh->name.c_str());
+        return false;
+    }
+
+    std::vector<float4x4> jointMatrices(instance.joints.size());
+    instance.ComputeJointMatrices(jointMatrices.data());
+
+    return SkinVertices(prototypeBuffers, prototypeMesh->vertexOffset, prototypeMesh->totalVertices,
+        jointMatrices.data(), jointMatrices.size(), output, executor);
+}
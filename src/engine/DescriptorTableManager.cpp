@@ -64,6 +64,7 @@ donut::engine::DescriptorTableManager::DescriptorTableManager(nvrhi::IDevice* de
 
     size_t capacity = m_DescriptorTable->getCapacity();
     m_AllocatedDescriptors.resize(capacity);
+    m_DescriptorRefCounts.resize(capacity);
     m_Descriptors.resize(capacity);
     memset(m_Descriptors.data(), 0, sizeof(nvrhi::BindingSetItem) * capacity);
 }
@@ -72,7 +73,10 @@ donut::engine::DescriptorIndex donut::engine::DescriptorTableManager::CreateDesc
 {
     const auto& found = m_DescriptorIndexMap.find(item);
     if (found != m_DescriptorIndexMap.end())
+    {
+        ++m_DescriptorRefCounts[found->second];
         return found->second;
+    }
 
     uint32_t capacity = m_DescriptorTable->getCapacity();
     bool foundFreeSlot = false;
@@ -91,6 +95,7 @@ donut::engine::DescriptorIndex donut::engine::DescriptorTableManager::CreateDesc
         uint32_t newCapacity = std::max(64u, capacity * 2); // handle the initial case when capacity == 0
         m_Device->resizeDescriptorTable(m_DescriptorTable, newCapacity);
         m_AllocatedDescriptors.resize(newCapacity);
+        m_DescriptorRefCounts.resize(newCapacity);
         m_Descriptors.resize(newCapacity);
 
         // zero-fill the new descriptors
@@ -103,6 +108,7 @@ donut::engine::DescriptorIndex donut::engine::DescriptorTableManager::CreateDesc
     item.slot = index;
     m_SearchStart = index + 1;
     m_AllocatedDescriptors[index] = true;
+    m_DescriptorRefCounts[index] = 1;
     m_Descriptors[index] = item;
     m_DescriptorIndexMap[item] = index;
     m_Device->writeDescriptorTable(m_DescriptorTable, item);
@@ -129,6 +135,13 @@ nvrhi::BindingSetItem donut::engine::DescriptorTableManager::GetDescriptor(Descr
 
 void donut::engine::DescriptorTableManager::ReleaseDescriptor(DescriptorIndex index)
 {
+    // Keep the descriptor if it's still referenced by other handles
+    if (m_DescriptorRefCounts[index] > 1)
+    {
+        --m_DescriptorRefCounts[index];
+        return;
+    }
+
     nvrhi::BindingSetItem& descriptor = m_Descriptors[index];
 
     if (descriptor.resourceHandle)
@@ -144,6 +157,7 @@ void donut::engine::DescriptorTableManager::ReleaseDescriptor(DescriptorIndex in
     m_Device->writeDescriptorTable(m_DescriptorTable, descriptor);
 
     m_AllocatedDescriptors[index] = false;
+    m_DescriptorRefCounts[index] = 0;
     m_SearchStart = std::min(m_SearchStart, index);
 }
 
@@ -31,6 +31,8 @@
 
 #include "nvrhi/common/misc.h"
 
+#include <algorithm>
+
 using namespace donut::math;
 using namespace donut::vfs;
 using namespace donut::engine;
@@ -100,10 +102,12 @@ void cgltf_release_file_vfs(const struct cgltf_memory_options*, const struct cgl
     // do nothing
 }
 
-// glTF only support DDS images through the MSFT_texture_dds extension.
-// Since cgltf does not support this extension, we parse the custom extension string as json here.
+// glTF only support DDS images through the MSFT_texture_dds extension, and KTX2 images through KHR_texture_basisu.
+// Both extensions have the same structure: { "source": <image index> }.
+// Since cgltf does not support these extensions, we parse the custom extension string as json here.
 // See https://github.com/KhronosGroup/glTF/tree/master/extensions/2.0/Vendor/MSFT_texture_dds 
-static const cgltf_image* ParseDdsImage(const cgltf_texture* texture, const cgltf_data* objects)
+// and https://github.com/KhronosGroup/glTF/tree/master/extensions/2.0/Khronos/KHR_texture_basisu
+static const cgltf_image* ParseImageSourceExtension(const cgltf_texture* texture, const cgltf_data* objects, const char* extensionName)
 {
     for (size_t i = 0; i < texture->extensions_count; i++)
     {
@@ -112,7 +116,7 @@ static const cgltf_image* ParseDdsImage(const cgltf_texture* texture, const cglt
         if (!ext.name || !ext.data)
             continue;
 
-        if (strcmp(ext.name, "MSFT_texture_dds") != 0)
+        if (strcmp(ext.name, extensionName) != 0)
             continue;
 
         size_t extensionLength = strlen(ext.data);
@@ -163,13 +167,23 @@ static const cgltf_image* ParseDdsImage(const cgltf_texture* texture, const cglt
         }
 
     fail:
-        donut::log::warning("Failed to parse the DDS glTF extension: %s", ext.data);
+        donut::log::warning("Failed to parse the %s glTF extension: %s", extensionName, ext.data);
         return nullptr;
     }
 
     return nullptr;
 }
 
+static const cgltf_image* ParseDdsImage(const cgltf_texture* texture, const cgltf_data* objects)
+{
+    return ParseImageSourceExtension(texture, objects, "MSFT_texture_dds");
+}
+
+static const cgltf_image* ParseKtx2Image(const cgltf_texture* texture, const cgltf_data* objects)
+{
+    return ParseImageSourceExtension(texture, objects, "KHR_texture_basisu");
+}
+
 namespace
 {
     typedef struct cgltf_subsurface
@@ -533,15 +547,26 @@ bool GltfImporter::Load(
         if (!texture)
             return std::shared_ptr<LoadedTexture>(nullptr);
 
-        // See if the extensions include a DDS image
-        const cgltf_image* ddsImage = ParseDdsImage(texture, objects);
+        auto is_valid_image = [](const cgltf_image* image)
+        {
+            return image && (image->uri || image->buffer_view);
+        };
 
-        if ((!texture->image || (!texture->image->uri && !texture->image->buffer_view)) && (!ddsImage || (!ddsImage->uri && !ddsImage->buffer_view)))
+        // See if the extensions include a DDS or KTX2 image
+        const cgltf_image* ddsImage = ParseDdsImage(texture, objects);
+        const cgltf_image* ktx2Image = ParseKtx2Image(texture, objects);
+
+        // Pick either DDS, KTX2 or standard image, prefer DDS because it doesn't need transcoding
+        const cgltf_image* activeImage = nullptr;
+        if (is_valid_image(ddsImage))
+            activeImage = ddsImage;
+        else if (is_valid_image(ktx2Image))
+            activeImage = ktx2Image;
+        else if (is_valid_image(texture->image))
+            activeImage = texture->image;
+        else
             return std::shared_ptr<LoadedTexture>(nullptr);
 
-        // Pick either DDS or standard image, prefer DDS
-        const cgltf_image* activeImage = (ddsImage && (ddsImage->uri || ddsImage->buffer_view)) ? ddsImage : texture->image;
-
         auto it = textures.find(activeImage);
         if (it != textures.end())
             return it->second;
@@ -603,7 +628,7 @@ bool GltfImporter::Load(
             std::filesystem::path filePath = fileName.parent_path() / uri;
 
             // Try to replace the texture with DDS, if enabled.
-            if (c_SearchForDds && !ddsImage)
+            if (c_SearchForDds && activeImage == texture->image)
             {
                 std::filesystem::path filePathDDS = filePath;
 
@@ -963,11 +988,11 @@ bool GltfImporter::Load(
                 {
                     *positionDst = (const float*)positionSrc;
 
-                    bounds |= *positionDst;
-
                     positionSrc += positionStride;
                     ++positionDst;
                 }
+
+                bounds |= dm::batch::bounds(buffers->positionData.data() + totalVertices, positions->count);
             }
 
             if (radius)
@@ -1294,14 +1319,14 @@ bool GltfImporter::Load(
                         {
                             *morphTargetCurrentData = *(const float3*)morphTargetPositionSrc;
 
-                            bounds |= *morphTargetCurrentData;
-
                             morphTargetPositionSrc += morphTargetPositionStride;
                             ++morphTargetCurrentData;
 
                             positionSrc += positionStride;
                         }
 
+                        bounds |= dm::batch::bounds(morphTargetCurrentFrameData.data() + totalVertices, positions->count);
+
                         morphTargetDataCount += positions->count;
                     }
                 }
@@ -1629,6 +1654,8 @@ bool GltfImporter::Load(
     }
 
     std::unordered_map<const cgltf_animation_sampler*, std::shared_ptr<animation::Sampler>> animationSamplers;
+    size_t uncompressedAnimationSize = 0;
+    size_t compressedAnimationSize = 0;
     
     for (size_t a_idx = 0; a_idx < objects->animations_count; a_idx++)
     {
@@ -1640,13 +1667,41 @@ bool GltfImporter::Load(
         for (size_t s_idx = 0; s_idx < srcAnim->samplers_count; s_idx++)
         {
             const cgltf_animation_sampler* srcSampler = &srcAnim->samplers[s_idx];
-            const cgltf_animation_channel* srcChannel = &srcAnim->channels[s_idx];
             auto dstSampler = std::make_shared<animation::Sampler>();
 
+            // Samplers and channels are not 1:1: a sampler can be used by several channels, or by none.
+            // Compress with the tightest tolerance of the channels that use the sampler.
+            const cgltf_animation_channel* srcChannel = nullptr;
+            float tolerance = -1.f;
+            for (size_t channel_idx = 0; channel_idx < srcAnim->channels_count; channel_idx++)
+            {
+                const cgltf_animation_channel* channel = &srcAnim->channels[channel_idx];
+                if (channel->sampler != srcSampler)
+                    continue;
+
+                float channelTolerance = -1.f;
+                switch (channel->target_path)
+                {
+                case cgltf_animation_path_type_translation: channelTolerance = m_AnimationCompression.translationTolerance; break;
+                case cgltf_animation_path_type_rotation: channelTolerance = m_AnimationCompression.rotationTolerance; break;
+                case cgltf_animation_path_type_scale: channelTolerance = m_AnimationCompression.scalingTolerance; break;
+                default: break;
+                }
+
+                // channels without a tolerance, such as morph target weights, are not compressed
+                if (!srcChannel)
+                {
+                    srcChannel = channel;
+                    tolerance = channelTolerance;
+                }
+                else if (tolerance >= 0.f)
+                    tolerance = channelTolerance >= 0.f ? std::min(tolerance, channelTolerance) : -1.f;
+            }
+
             switch (srcSampler->interpolation)
             {
             case cgltf_interpolation_type_linear:
-                if (srcChannel->target_path == cgltf_animation_path_type_rotation)
+                if (srcChannel && srcChannel->target_path == cgltf_animation_path_type_rotation)
                     dstSampler->SetInterpolationMode(animation::InterpolationMode::Slerp);
                 else
                     dstSampler->SetInterpolationMode(animation::InterpolationMode::Linear);
@@ -1687,10 +1742,20 @@ bool GltfImporter::Load(
                     dstSampler->AddKeyframe(keyframe);
             }
 
-            if (!dstSampler->GetKeyframes().empty())
-                animationSamplers[srcSampler] = dstSampler;
-            else
+            if (dstSampler->GetKeyframes().empty())
+            {
                 log::warning("Animation channel imported with no keyframes, ignoring.");
+                continue;
+            }
+
+            if (m_AnimationCompression.enabled && tolerance >= 0.f)
+            {
+                uncompressedAnimationSize += dstSampler->GetMemoryUsage();
+                dstSampler->Compress(tolerance);
+                compressedAnimationSize += dstSampler->GetMemoryUsage();
+            }
+
+            animationSamplers[srcSampler] = dstSampler;
         }
 
         for (size_t channel_idx = 0; channel_idx < srcAnim->channels_count; channel_idx++)
@@ -1743,6 +1808,12 @@ bool GltfImporter::Load(
         }
     }
 
+    if (compressedAnimationSize != 0)
+    {
+        log::info("Compressed animations in '%s' from %zu to %zu bytes.", normalizedFileName.c_str(),
+            uncompressedAnimationSize, compressedAnimationSize);
+    }
+
     if (c_ForceRebuildTangents)
     {
         for (size_t buffer_idx = 0; buffer_idx < objects->buffers_count; buffer_idx++)
@@ -0,0 +1,518 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+// KTX 2.0 container reader.
+// See https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+
+#include <donut/engine/KTX2File.h>
+#include <donut/engine/TextureCache.h>
+#include <donut/core/vfs/VFS.h>
+#include <donut/core/log.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#ifdef DONUT_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef DONUT_WITH_MINIZ
+#include <miniz.h>
+#endif
+
+#ifdef DONUT_WITH_BASISU
+#include <basisu_transcoder.h>
+#include <mutex>
+#endif
+
+using namespace donut::vfs;
+
+namespace donut::engine
+{
+    namespace ktx2
+    {
+        static const uint8_t c_Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+        struct Header
+        {
+            uint8_t identifier[12];
+            uint32_t vkFormat;
+            uint32_t typeSize;
+            uint32_t pixelWidth;
+            uint32_t pixelHeight;
+            uint32_t pixelDepth;
+            uint32_t layerCount;
+            uint32_t faceCount;
+            uint32_t levelCount;
+            uint32_t supercompressionScheme;
+            uint32_t dfdByteOffset;
+            uint32_t dfdByteLength;
+            uint32_t kvdByteOffset;
+            uint32_t kvdByteLength;
+            uint64_t sgdByteOffset;
+            uint64_t sgdByteLength;
+        };
+
+        static_assert(sizeof(Header) == 80);
+
+        struct LevelIndex
+        {
+            uint64_t byteOffset;
+            uint64_t byteLength;
+            uint64_t uncompressedByteLength;
+        };
+
+        enum SupercompressionScheme : uint32_t
+        {
+            SUPERCOMPRESSION_NONE = 0,
+            SUPERCOMPRESSION_BASISLZ = 1,
+            SUPERCOMPRESSION_ZSTD = 2,
+            SUPERCOMPRESSION_ZLIB = 3
+        };
+
+        // Values from the Khronos Data Format Specification, basic descriptor block
+        constexpr uint32_t KHR_DF_MODEL_ETC1S = 163;
+        constexpr uint32_t KHR_DF_MODEL_UASTC = 166;
+        constexpr uint32_t KHR_DF_TRANSFER_SRGB = 2;
+        constexpr uint32_t KHR_DF_FLAG_ALPHA_PREMULTIPLIED = 1;
+
+        constexpr uint32_t VK_FORMAT_UNDEFINED = 0;
+
+        // Texture size limits of the graphics APIs supported by NVRHI (D3D12 feature level 11 and Vulkan implementations
+        // that support it), which also keep the size computations below from overflowing
+        constexpr uint32_t c_MaxTextureDimension = 16384;
+        constexpr uint32_t c_MaxTexture3DDimension = 2048;
+        constexpr uint32_t c_MaxTextureArraySize = 2048;
+        constexpr uint32_t c_MaxMipLevels = 15;
+
+        struct FormatMapping
+        {
+            uint32_t vkFormat;
+            nvrhi::Format nvrhiFormat;
+        };
+
+        const FormatMapping g_FormatMappings[] = {
+            { 9,   nvrhi::Format::R8_UNORM },             // VK_FORMAT_R8_UNORM
+            { 10,  nvrhi::Format::R8_SNORM },             // VK_FORMAT_R8_SNORM
+            { 13,  nvrhi::Format::R8_UINT },              // VK_FORMAT_R8_UINT
+            { 14,  nvrhi::Format::R8_SINT },              // VK_FORMAT_R8_SINT
+            { 16,  nvrhi::Format::RG8_UNORM },            // VK_FORMAT_R8G8_UNORM
+            { 17,  nvrhi::Format::RG8_SNORM },            // VK_FORMAT_R8G8_SNORM
+            { 20,  nvrhi::Format::RG8_UINT },             // VK_FORMAT_R8G8_UINT
+            { 21,  nvrhi::Format::RG8_SINT },             // VK_FORMAT_R8G8_SINT
+            { 37,  nvrhi::Format::RGBA8_UNORM },          // VK_FORMAT_R8G8B8A8_UNORM
+            { 38,  nvrhi::Format::RGBA8_SNORM },          // VK_FORMAT_R8G8B8A8_SNORM
+            { 41,  nvrhi::Format::RGBA8_UINT },           // VK_FORMAT_R8G8B8A8_UINT
+            { 42,  nvrhi::Format::RGBA8_SINT },           // VK_FORMAT_R8G8B8A8_SINT
+            { 43,  nvrhi::Format::SRGBA8_UNORM },         // VK_FORMAT_R8G8B8A8_SRGB
+            { 44,  nvrhi::Format::BGRA8_UNORM },          // VK_FORMAT_B8G8R8A8_UNORM
+            { 50,  nvrhi::Format::SBGRA8_UNORM },         // VK_FORMAT_B8G8R8A8_SRGB
+            { 64,  nvrhi::Format::R10G10B10A2_UNORM },    // VK_FORMAT_A2B10G10R10_UNORM_PACK32
+            { 70,  nvrhi::Format::R16_UNORM },            // VK_FORMAT_R16_UNORM
+            { 71,  nvrhi::Format::R16_SNORM },            // VK_FORMAT_R16_SNORM
+            { 74,  nvrhi::Format::R16_UINT },             // VK_FORMAT_R16_UINT
+            { 75,  nvrhi::Format::R16_SINT },             // VK_FORMAT_R16_SINT
+            { 76,  nvrhi::Format::R16_FLOAT },            // VK_FORMAT_R16_SFLOAT
+            { 77,  nvrhi::Format::RG16_UNORM },           // VK_FORMAT_R16G16_UNORM
+            { 78,  nvrhi::Format::RG16_SNORM },           // VK_FORMAT_R16G16_SNORM
+            { 81,  nvrhi::Format::RG16_UINT },            // VK_FORMAT_R16G16_UINT
+            { 82,  nvrhi::Format::RG16_SINT },            // VK_FORMAT_R16G16_SINT
+            { 83,  nvrhi::Format::RG16_FLOAT },           // VK_FORMAT_R16G16_SFLOAT
+            { 91,  nvrhi::Format::RGBA16_UNORM },         // VK_FORMAT_R16G16B16A16_UNORM
+            { 92,  nvrhi::Format::RGBA16_SNORM },         // VK_FORMAT_R16G16B16A16_SNORM
+            { 95,  nvrhi::Format::RGBA16_UINT },          // VK_FORMAT_R16G16B16A16_UINT
+            { 96,  nvrhi::Format::RGBA16_SINT },          // VK_FORMAT_R16G16B16A16_SINT
+            { 97,  nvrhi::Format::RGBA16_FLOAT },         // VK_FORMAT_R16G16B16A16_SFLOAT
+            { 98,  nvrhi::Format::R32_UINT },             // VK_FORMAT_R32_UINT
+            { 99,  nvrhi::Format::R32_SINT },             // VK_FORMAT_R32_SINT
+            { 100, nvrhi::Format::R32_FLOAT },            // VK_FORMAT_R32_SFLOAT
+            { 101, nvrhi::Format::RG32_UINT },            // VK_FORMAT_R32G32_UINT
+            { 102, nvrhi::Format::RG32_SINT },            // VK_FORMAT_R32G32_SINT
+            { 103, nvrhi::Format::RG32_FLOAT },           // VK_FORMAT_R32G32_SFLOAT
+            { 104, nvrhi::Format::RGB32_UINT },           // VK_FORMAT_R32G32B32_UINT
+            { 105, nvrhi::Format::RGB32_SINT },           // VK_FORMAT_R32G32B32_SINT
+            { 106, nvrhi::Format::RGB32_FLOAT },          // VK_FORMAT_R32G32B32_SFLOAT
+            { 107, nvrhi::Format::RGBA32_UINT },          // VK_FORMAT_R32G32B32A32_UINT
+            { 108, nvrhi::Format::RGBA32_SINT },          // VK_FORMAT_R32G32B32A32_SINT
+            { 109, nvrhi::Format::RGBA32_FLOAT },         // VK_FORMAT_R32G32B32A32_SFLOAT
+            { 122, nvrhi::Format::R11G11B10_FLOAT },      // VK_FORMAT_B10G11R11_UFLOAT_PACK32
+            { 131, nvrhi::Format::BC1_UNORM },            // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+            { 132, nvrhi::Format::BC1_UNORM_SRGB },       // VK_FORMAT_BC1_RGB_SRGB_BLOCK
+            { 133, nvrhi::Format::BC1_UNORM },            // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+            { 134, nvrhi::Format::BC1_UNORM_SRGB },       // VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+            { 135, nvrhi::Format::BC2_UNORM },            // VK_FORMAT_BC2_UNORM_BLOCK
+            { 136, nvrhi::Format::BC2_UNORM_SRGB },       // VK_FORMAT_BC2_SRGB_BLOCK
+            { 137, nvrhi::Format::BC3_UNORM },            // VK_FORMAT_BC3_UNORM_BLOCK
+            { 138, nvrhi::Format::BC3_UNORM_SRGB },       // VK_FORMAT_BC3_SRGB_BLOCK
+            { 139, nvrhi::Format::BC4_UNORM },            // VK_FORMAT_BC4_UNORM_BLOCK
+            { 140, nvrhi::Format::BC4_SNORM },            // VK_FORMAT_BC4_SNORM_BLOCK
+            { 141, nvrhi::Format::BC5_UNORM },            // VK_FORMAT_BC5_UNORM_BLOCK
+            { 142, nvrhi::Format::BC5_SNORM },            // VK_FORMAT_BC5_SNORM_BLOCK
+            { 143, nvrhi::Format::BC6H_UFLOAT },          // VK_FORMAT_BC6H_UFLOAT_BLOCK
+            { 144, nvrhi::Format::BC6H_SFLOAT },          // VK_FORMAT_BC6H_SFLOAT_BLOCK
+            { 145, nvrhi::Format::BC7_UNORM },            // VK_FORMAT_BC7_UNORM_BLOCK
+            { 146, nvrhi::Format::BC7_UNORM_SRGB },       // VK_FORMAT_BC7_SRGB_BLOCK
+        };
+    }
+
+    using namespace ktx2;
+
+    static nvrhi::Format ConvertVkFormat(uint32_t vkFormat)
+    {
+        for (const FormatMapping& mapping : g_FormatMappings)
+        {
+            if (mapping.vkFormat == vkFormat)
+                return mapping.nvrhiFormat;
+        }
+
+        return nvrhi::Format::UNKNOWN;
+    }
+
+    static nvrhi::Format PromoteToSRGB(nvrhi::Format format)
+    {
+        switch (format)  // NOLINT(clang-diagnostic-switch-enum)
+        {
+        case nvrhi::Format::RGBA8_UNORM: return nvrhi::Format::SRGBA8_UNORM;
+        case nvrhi::Format::BGRA8_UNORM: return nvrhi::Format::SBGRA8_UNORM;
+        case nvrhi::Format::BC1_UNORM:   return nvrhi::Format::BC1_UNORM_SRGB;
+        case nvrhi::Format::BC2_UNORM:   return nvrhi::Format::BC2_UNORM_SRGB;
+        case nvrhi::Format::BC3_UNORM:   return nvrhi::Format::BC3_UNORM_SRGB;
+        case nvrhi::Format::BC7_UNORM:   return nvrhi::Format::BC7_UNORM_SRGB;
+        default:                         return format;
+        }
+    }
+
+    // Computes the size of one image (one layer, face and depth slice) of a mip level
+    static void GetImageSize(nvrhi::Format format, uint32_t width, uint32_t height, size_t& rowPitch, size_t& numRows)
+    {
+        const nvrhi::FormatInfo& formatInfo = nvrhi::getFormatInfo(format);
+        const size_t blockSize = formatInfo.blockSize;
+
+        rowPitch = ((size_t(width) + blockSize - 1) / blockSize) * formatInfo.bytesPerBlock;
+        numRows = (size_t(height) + blockSize - 1) / blockSize;
+    }
+
+    // Returns false if a * b doesn't fit into size_t
+    static bool MultiplySizes(size_t a, size_t b, size_t& result)
+    {
+        if (b != 0 && a > SIZE_MAX / b)
+            return false;
+
+        result = a * b;
+        return true;
+    }
+
+    // Fills the dataLayout array for a texture whose levels are stored at 'levelOffsets' in the data blob,
+    // each level containing all layers, faces and depth slices in that order, like in the KTX2 container.
+    // Returns false if any level doesn't fit into its 'levelSizes' range.
+    static bool FillTextureInfoOffsets(TextureData& textureInfo,
+        const std::vector<size_t>& levelOffsets, const std::vector<size_t>& levelSizes)
+    {
+        const nvrhi::FormatInfo& formatInfo = nvrhi::getFormatInfo(textureInfo.format);
+        textureInfo.originalBitsPerPixel = formatInfo.bytesPerBlock * 8 / (formatInfo.blockSize * formatInfo.blockSize);
+
+        textureInfo.dataLayout.resize(textureInfo.arraySize);
+        for (auto& sliceData : textureInfo.dataLayout)
+            sliceData.resize(textureInfo.mipLevels);
+
+        for (uint32_t mipLevel = 0; mipLevel < textureInfo.mipLevels; mipLevel++)
+        {
+            uint32_t width = std::max(textureInfo.width >> mipLevel, 1u);
+            uint32_t height = std::max(textureInfo.height >> mipLevel, 1u);
+            uint32_t depth = std::max(textureInfo.depth >> mipLevel, 1u);
+
+            size_t rowPitch = 0;
+            size_t numRows = 0;
+            GetImageSize(textureInfo.format, width, height, rowPitch, numRows);
+
+            size_t depthPitch = 0;
+            size_t imageSize = 0;
+            size_t levelSize = 0;
+            if (!MultiplySizes(rowPitch, numRows, depthPitch) ||
+                !MultiplySizes(depthPitch, depth, imageSize) ||
+                !MultiplySizes(imageSize, textureInfo.arraySize, levelSize) ||
+                levelSize > levelSizes[mipLevel])
+                return false;
+
+            // KTX2 orders images within a level as layer -> face, which matches the NVRHI array slice order for cube arrays
+            for (uint32_t arraySlice = 0; arraySlice < textureInfo.arraySize; arraySlice++)
+            {
+                TextureSubresourceData& levelData = textureInfo.dataLayout[arraySlice][mipLevel];
+                levelData.dataOffset = ptrdiff_t(levelOffsets[mipLevel] + imageSize * arraySlice);
+                levelData.dataSize = imageSize;
+                levelData.rowPitch = rowPitch;
+                levelData.depthPitch = depthPitch;
+            }
+        }
+
+        return true;
+    }
+
+#ifdef DONUT_WITH_BASISU
+    static bool TranscodeBasisTexture(TextureData& textureInfo, uint32_t numLayers, uint32_t numFaces, bool sRGB)
+    {
+        static std::once_flag s_TranscoderInitialized;
+        std::call_once(s_TranscoderInitialized, []() { basist::basisu_transcoder_init(); });
+
+        basist::ktx2_transcoder transcoder;
+        if (!transcoder.init(textureInfo.data->data(), uint32_t(textureInfo.data->size())))
+            return false;
+
+        if (!transcoder.start_transcoding())
+            return false;
+
+        // UASTC and ETC1S with alpha would lose too much quality in BC1, use BC7 for those.
+        const bool useBC7 = transcoder.is_uastc() || transcoder.get_has_alpha();
+        const basist::transcoder_texture_format targetFormat = useBC7
+            ? basist::transcoder_texture_format::cTFBC7_RGBA
+            : basist::transcoder_texture_format::cTFBC1_RGB;
+
+        textureInfo.format = useBC7 ? nvrhi::Format::BC7_UNORM : nvrhi::Format::BC1_UNORM;
+        if (sRGB)
+            textureInfo.format = PromoteToSRGB(textureInfo.format);
+
+        const uint32_t bytesPerBlock = useBC7 ? 16 : 8;
+
+        // Compute the level offsets in the transcoded blob, using the same level -> layer -> face order as KTX2
+        std::vector<size_t> levelOffsets(textureInfo.mipLevels);
+        std::vector<size_t> levelSizes(textureInfo.mipLevels);
+        size_t totalSize = 0;
+        for (uint32_t mipLevel = 0; mipLevel < textureInfo.mipLevels; mipLevel++)
+        {
+            uint32_t blocksX = std::max((textureInfo.width >> mipLevel) + 3, 4u) / 4;
+            uint32_t blocksY = std::max((textureInfo.height >> mipLevel) + 3, 4u) / 4;
+
+            size_t levelSize = 0;
+            if (!MultiplySizes(size_t(blocksX) * blocksY * bytesPerBlock, textureInfo.arraySize, levelSize) ||
+                levelSize > SIZE_MAX - totalSize)
+                return false;
+
+            levelOffsets[mipLevel] = totalSize;
+            levelSizes[mipLevel] = levelSize;
+            totalSize += levelSize;
+        }
+
+        uint8_t* transcodedData = static_cast<uint8_t*>(malloc(totalSize));
+        if (!transcodedData)
+            return false;
+
+        for (uint32_t mipLevel = 0; mipLevel < textureInfo.mipLevels; mipLevel++)
+        {
+            uint32_t blocksX = std::max((textureInfo.width >> mipLevel) + 3, 4u) / 4;
+            uint32_t blocksY = std::max((textureInfo.height >> mipLevel) + 3, 4u) / 4;
+            size_t imageSize = size_t(blocksX) * blocksY * bytesPerBlock;
+
+            for (uint32_t layer = 0; layer < numLayers; layer++)
+            {
+                for (uint32_t face = 0; face < numFaces; face++)
+                {
+                    uint8_t* dest = transcodedData + levelOffsets[mipLevel] + imageSize * (size_t(layer) * numFaces + face);
+
+                    if (!transcoder.transcode_image_level(mipLevel, layer, face, dest, blocksX * blocksY, targetFormat))
+                    {
+                        free(transcodedData);
+                        return false;
+                    }
+                }
+            }
+        }
+
+        textureInfo.data = std::make_shared<Blob>(transcodedData, totalSize);
+
+        return FillTextureInfoOffsets(textureInfo, levelOffsets, levelSizes);
+    }
+#endif
+
+    static bool DecompressLevel(uint32_t scheme, const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+    {
+        switch (scheme)
+        {
+#ifdef DONUT_WITH_ZSTD
+        case SUPERCOMPRESSION_ZSTD: {
+            size_t result = ZSTD_decompress(dst, dstSize, src, srcSize);
+            return !ZSTD_isError(result) && result == dstSize;
+        }
+#endif
+#ifdef DONUT_WITH_MINIZ
+        case SUPERCOMPRESSION_ZLIB: {
+            mz_ulong destLength = mz_ulong(dstSize);
+            int result = mz_uncompress(dst, &destLength, src, mz_ulong(srcSize));
+            return result == MZ_OK && destLength == dstSize;
+        }
+#endif
+        default:
+            return false;
+        }
+    }
+
+    bool LoadKTX2TextureFromMemory(TextureData& textureInfo)
+    {
+        const uint8_t* fileData = static_cast<const uint8_t*>(textureInfo.data->data());
+        const size_t fileSize = textureInfo.data->size();
+
+        if (fileSize < sizeof(Header))
+            return false;
+
+        const Header* header = reinterpret_cast<const Header*>(fileData);
+        if (memcmp(header->identifier, c_Identifier, sizeof(c_Identifier)) != 0)
+            return false;
+
+        if (header->pixelWidth == 0)
+            return false;
+
+        const uint32_t numLevels = std::max(header->levelCount, 1u);
+        const uint32_t numLayers = std::max(header->layerCount, 1u);
+        const uint32_t numFaces = header->faceCount;
+
+        if (numFaces != 1 && numFaces != 6)
+            return false;
+
+        // Reject dimensions that no texture can have, before using them in size computations
+        const uint32_t maxDimension = header->pixelDepth > 1 ? c_MaxTexture3DDimension : c_MaxTextureDimension;
+        if (header->pixelWidth > maxDimension || header->pixelHeight > maxDimension || header->pixelDepth > c_MaxTexture3DDimension ||
+            numLayers > c_MaxTextureArraySize || numLayers * numFaces > c_MaxTextureArraySize || numLevels > c_MaxMipLevels)
+        {
+            log::warning("KTX2 texture '%s' has unsupported dimensions %ux%ux%u, %u layers, %u faces, %u levels",
+                textureInfo.path.c_str(), header->pixelWidth, header->pixelHeight, header->pixelDepth, numLayers, numFaces, numLevels);
+            return false;
+        }
+
+        if (sizeof(Header) + sizeof(LevelIndex) * numLevels > fileSize)
+            return false;
+
+        const LevelIndex* levels = reinterpret_cast<const LevelIndex*>(fileData + sizeof(Header));
+
+        for (uint32_t level = 0; level < numLevels; level++)
+        {
+            if (levels[level].byteOffset > fileSize || levels[level].byteLength > fileSize - levels[level].byteOffset)
+                return false;
+        }
+
+        // Read the interesting fields from the basic data format descriptor block
+        uint32_t colorModel = 0;
+        uint32_t transferFunction = 0;
+        uint32_t dfdFlags = 0;
+        if (header->dfdByteLength >= 16 && size_t(header->dfdByteOffset) + header->dfdByteLength <= fileSize)
+        {
+            // Skip the dfdTotalSize field and the first two words of the descriptor block
+            const uint8_t* descriptor = fileData + header->dfdByteOffset + 4 + 8;
+            colorModel = descriptor[0];
+            transferFunction = descriptor[2];
+            dfdFlags = descriptor[3];
+        }
+
+        textureInfo.width = header->pixelWidth;
+        textureInfo.height = std::max(header->pixelHeight, 1u);
+        textureInfo.depth = std::max(header->pixelDepth, 1u);
+        textureInfo.mipLevels = numLevels;
+        textureInfo.arraySize = numLayers * numFaces;
+        textureInfo.alphaMode = (dfdFlags & KHR_DF_FLAG_ALPHA_PREMULTIPLIED) ? TextureAlphaMode::PREMULTIPLIED : TextureAlphaMode::UNKNOWN;
+
+        if (header->pixelDepth > 1)
+        {
+            if (numLayers > 1 || numFaces > 1)
+                return false; // 3D texture arrays are not supported
+
+            textureInfo.dimension = nvrhi::TextureDimension::Texture3D;
+        }
+        else if (numFaces == 6)
+            textureInfo.dimension = header->layerCount > 0 ? nvrhi::TextureDimension::TextureCubeArray : nvrhi::TextureDimension::TextureCube;
+        else if (header->pixelHeight == 0)
+            textureInfo.dimension = header->layerCount > 0 ? nvrhi::TextureDimension::Texture1DArray : nvrhi::TextureDimension::Texture1D;
+        else
+            textureInfo.dimension = header->layerCount > 0 ? nvrhi::TextureDimension::Texture2DArray : nvrhi::TextureDimension::Texture2D;
+
+        const bool sRGB = textureInfo.forceSRGB || transferFunction == KHR_DF_TRANSFER_SRGB;
+
+        // Basis Universal payloads: ETC1S is always BasisLZ-supercompressed, UASTC may be Zstandard-supercompressed
+        if (header->supercompressionScheme == SUPERCOMPRESSION_BASISLZ ||
+            (header->vkFormat == VK_FORMAT_UNDEFINED && (colorModel == KHR_DF_MODEL_ETC1S || colorModel == KHR_DF_MODEL_UASTC)))
+        {
+#ifdef DONUT_WITH_BASISU
+            if (textureInfo.dimension == nvrhi::TextureDimension::Texture3D)
+                return false;
+
+            return TranscodeBasisTexture(textureInfo, numLayers, numFaces, sRGB);
+#else
+            log::warning("Cannot load Basis Universal KTX2 texture '%s': Donut was built without Basis Universal support",
+                textureInfo.path.c_str());
+            return false;
+#endif
+        }
+
+        textureInfo.format = ConvertVkFormat(header->vkFormat);
+        if (textureInfo.format == nvrhi::Format::UNKNOWN)
+            return false;
+
+        if (sRGB)
+            textureInfo.format = PromoteToSRGB(textureInfo.format);
+
+        std::vector<size_t> levelOffsets(numLevels);
+        std::vector<size_t> levelSizes(numLevels);
+
+        if (header->supercompressionScheme == SUPERCOMPRESSION_NONE)
+        {
+            // Use the file data directly, no copies
+            for (uint32_t level = 0; level < numLevels; level++)
+            {
+                levelOffsets[level] = size_t(levels[level].byteOffset);
+                levelSizes[level] = size_t(levels[level].byteLength);
+            }
+
+            return FillTextureInfoOffsets(textureInfo, levelOffsets, levelSizes);
+        }
+
+        // Supercompressed levels: decompress them all into one new blob
+        size_t totalSize = 0;
+        for (uint32_t level = 0; level < numLevels; level++)
+        {
+            levelOffsets[level] = totalSize;
+            if (levels[level].uncompressedByteLength > SIZE_MAX - totalSize)
+                return false;
+
+            levelSizes[level] = size_t(levels[level].uncompressedByteLength);
+            totalSize += levelSizes[level];
+        }
+
+        uint8_t* decompressedData = static_cast<uint8_t*>(malloc(totalSize));
+        if (!decompressedData)
+            return false;
+
+        for (uint32_t level = 0; level < numLevels; level++)
+        {
+            if (!DecompressLevel(header->supercompressionScheme, fileData + levels[level].byteOffset, size_t(levels[level].byteLength),
+                decompressedData + levelOffsets[level], levelSizes[level]))
+            {
+                log::warning("Cannot decompress level %d of KTX2 texture '%s' (supercompression scheme %d)",
+                    level, textureInfo.path.c_str(), header->supercompressionScheme);
+
+                free(decompressedData);
+                return false;
+            }
+        }
+
+        textureInfo.data = std::make_shared<Blob>(decompressedData, totalSize);
+
+        return FillTextureInfoOffsets(textureInfo, levelOffsets, levelSizes);
+    }
+}
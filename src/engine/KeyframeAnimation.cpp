@@ -38,26 +38,32 @@ this software is released into the Public Domain.
 #include <donut/core/json.h>
 #include <donut/core/log.h>
 #include <json/value.h>
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <limits>
 
 using namespace donut::math;
 using namespace donut::engine;
 using namespace donut::engine::animation;
 
-float4 donut::engine::animation::Interpolate(const InterpolationMode mode,
-    const Keyframe& a, const Keyframe& b, const Keyframe& c, const Keyframe& d, const float t, const float dt)
+// Interpolates between the values b and c, the outside values a and d and the tangents are only
+// used by the spline modes.
+static float4 interpolateValues(const InterpolationMode mode,
+    const float4& a, const float4& b, const float4& c, const float4& d,
+    const float4& bOutTangent, const float4& cInTangent, const float t, const float dt)
 {
     switch (mode)
     {
     case InterpolationMode::Step:
-        return b.value;
+        return b;
 
     case InterpolationMode::Linear:
-        return lerp(b.value, c.value, t);
+        return lerp(b, c, t);
 
     case InterpolationMode::Slerp: {
-        quat qb = quat::fromXYZW(b.value);
-        quat qc = quat::fromXYZW(c.value);
+        quat qb = quat::fromXYZW(b);
+        quat qc = quat::fromXYZW(c);
         quat qr = slerp(qb, qc, t);
         return float4(qr.x, qr.y, qr.z, qr.w);
     }
@@ -65,73 +71,118 @@ float4 donut::engine::animation::Interpolate(const InterpolationMode mode,
     case InterpolationMode::CatmullRomSpline: {
         // https://en.wikipedia.org/wiki/Cubic_Hermite_spline#Interpolation_on_the_unit_interval_with_matched_derivatives_at_endpoints
         // a = p[n-1], b = p[n], c = p[n+1], d = p[n+2]
-        float4 i = -a.value + 3.f * b.value - 3.f * c.value + d.value;
-        float4 j = 2.f * a.value - 5.f * b.value + 4.f * c.value - d.value;
-        float4 k = -a.value + c.value;
-        return 0.5f * ((i * t + j) * t + k) * t + b.value;
+        float4 i = -a + 3.f * b - 3.f * c + d;
+        float4 j = 2.f * a - 5.f * b + 4.f * c - d;
+        float4 k = -a + c;
+        return 0.5f * ((i * t + j) * t + k) * t + b;
     }
 
     case InterpolationMode::HermiteSpline: {
         // https://github.com/KhronosGroup/glTF/tree/master/specification/2.0#appendix-c-spline-interpolation
         const float t2 = t * t;
         const float t3 = t2 * t;
-        return (2.f * t3 - 3.f * t2 + 1.f) * b.value
-             + (t3 - 2.f * t2 + t) * b.outTangent * dt
-             + (-2.f * t3 + 3.f * t2) * c.value
-             + (t3 - t2) * c.inTangent * dt;
+        return (2.f * t3 - 3.f * t2 + 1.f) * b
+             + (t3 - 2.f * t2 + t) * bOutTangent * dt
+             + (-2.f * t3 + 3.f * t2) * c
+             + (t3 - t2) * cInTangent * dt;
     }
 
     default:
         assert(!"Unknown interpolation mode");
-        return b.value;
+        return b;
     }
 }
 
-std::optional<dm::float4> Sampler::Evaluate(float time, bool extrapolateLastValues) const
+float4 donut::engine::animation::Interpolate(const InterpolationMode mode,
+    const Keyframe& a, const Keyframe& b, const Keyframe& c, const Keyframe& d, const float t, const float dt)
 {
-    const size_t count = m_Keyframes.size();
+    return interpolateValues(mode, a.value, b.value, c.value, d.value, b.outTangent, c.inTangent, t, dt);
+}
 
-    if (count == 0)
-        return std::optional<float4>();
+// Returns the index i of the pair of keyframes (i, i + 1) such that (getTime(i) <= time < getTime(i + 1)),
+// assuming that the keyframes are sorted by time and (getTime(0) <= time < getTime(count - 1)).
+// When the time is after the 'hint' keyframe, the search gallops forward from there, which keeps
+// playback that skips a few keyframes per evaluation local; other times use binary search.
+template <typename GetTime>
+static size_t findKeyframeInterval(GetTime const& getTime, size_t count, float time, size_t hint)
+{
+    // Find the first keyframe with (time < getTime(i)), which is in [left, right] = [1, count - 1].
+    size_t left = 1;
+    size_t right = count - 1;
 
-    if (time <= m_Keyframes[0].time)
-        return std::optional(m_Keyframes[0].value);
+    if (hint + 1 < count && getTime(hint) <= time)
+    {
+        size_t step = 1;
+        for (size_t probe = hint + 1; probe < right; probe = left + step, step *= 2)
+        {
+            if (time < getTime(probe))
+            {
+                right = probe;
+                break;
+            }
+            left = probe + 1;
+        }
+    }
 
-    if (count == 1 || time >= m_Keyframes[count - 1].time)
+    while (left < right)
     {
-        if (extrapolateLastValues)
-            return std::optional(m_Keyframes[count - 1].value);
+        size_t const middle = (left + right) / 2;
+        if (time < getTime(middle))
+            right = middle;
         else
-            return std::optional<float4>();
+            left = middle + 1;
     }
-    
-    // Use binary search to locate the pair of keyframes (b, c) so that (b.time <= time < c.time).
-    // Assume that the keyframe vector is sorted by time.
-    // Right limit starts at (count - 2) because we're always looking at consecutive pairs of items, not single items.
-    size_t left = 0;
-    size_t right = count - 2;
-    while (left <= right)
+
+    return left - 1;
+}
+
+// Returns true if the pair of keyframes (i, i + 1) contains the time and the time is after the first keyframe,
+// i.e. if evaluating the sampler at that time interpolates these keyframes.
+template <typename GetTime>
+static bool isInInterval(GetTime const& getTime, size_t count, float time, size_t i)
+{
+    return i + 1 < count
+        && (i > 0 ? getTime(i) <= time : getTime(0) < time)
+        && time < getTime(i + 1);
+}
+
+std::optional<dm::float4> Sampler::Evaluate(float time, bool extrapolateLastValues) const
+{
+    SamplerCursor cursor;
+    return Evaluate(time, cursor, extrapolateLastValues);
+}
+
+std::optional<dm::float4> Sampler::Evaluate(float time, SamplerCursor& cursor, bool extrapolateLastValues) const
+{
+    if (m_Compressed)
+        return EvaluateCompressed(time, cursor, extrapolateLastValues);
+
+    const size_t count = m_Keyframes.size();
+    size_t offset = cursor.interval;
+
+    // Skip the range checks and the search when the time is still in the last used interval.
+    if (!isInInterval([this](size_t i) { return m_Keyframes[i].time; }, count, time, offset))
     {
-        size_t const middle = (left + right) / 2;
+        if (count == 0)
+            return std::optional<float4>();
 
-        const float tb = m_Keyframes[middle].time;
-        const float tc = m_Keyframes[middle + 1].time;
+        if (time <= m_Keyframes[0].time)
+            return std::optional(m_Keyframes[0].value);
 
-        if (time < tb)
-            right = middle - 1;
-        else if (time >= tc)
-            left = middle + 1;
-        else
+        if (count == 1 || time >= m_Keyframes[count - 1].time)
         {
-            // Found the pair containing the required time, stop.
-            left = right = middle;
-            break;
+            if (extrapolateLastValues)
+                return std::optional(m_Keyframes[count - 1].value);
+            else
+                return std::optional<float4>();
         }
+
+        offset = findKeyframeInterval([this](size_t i) { return m_Keyframes[i].time; }, count, time, offset);
+        cursor.interval = offset;
     }
 
     // Load 4 keyframes around the required time.
     // The outside keyframes (a) and (d) are needed for higher-order interpolation.
-    size_t const offset = left;
     const Keyframe& b = m_Keyframes[offset];
     const Keyframe& c = m_Keyframes[offset + 1];
     const Keyframe& a = (offset > 0) ? m_Keyframes[offset - 1] : b;
@@ -152,13 +203,172 @@ std::optional<dm::float4> Sampler::Evaluate(float time, bool extrapolateLastValu
     return std::optional(y);
 }
 
+std::optional<dm::float4> Sampler::EvaluateCompressed(float time, SamplerCursor& cursor, bool extrapolateLastValues) const
+{
+    const CompressedKeyframes& keyframes = *m_Compressed;
+    const size_t count = keyframes.GetKeyframeCount();
+    auto getTime = [&keyframes](size_t i) { return keyframes.GetTime(i); };
+    size_t offset = cursor.interval;
+
+    if (!isInInterval(getTime, count, time, offset))
+    {
+        if (count == 0)
+            return std::optional<float4>();
+
+        if (time <= getTime(0))
+            return std::optional(keyframes.GetValue(0));
+
+        if (count == 1 || time >= getTime(count - 1))
+        {
+            if (extrapolateLastValues)
+                return std::optional(keyframes.GetValue(count - 1));
+            else
+                return std::optional<float4>();
+        }
+
+        offset = findKeyframeInterval(getTime, count, time, offset);
+        cursor.interval = offset;
+    }
+
+    // Compressed samplers only use the modes that interpolate between the (b, c) keyframes.
+    const float tb = getTime(offset);
+    const float tc = getTime(offset + 1);
+    const float dt = tc - tb;
+    const float u = (time - tb) / dt;
+    const float4 b = keyframes.GetValue(offset);
+    const float4 c = keyframes.GetValue(offset + 1);
+
+    return std::optional(interpolateValues(m_Mode, b, b, c, c, b, c, u, dt));
+}
+
+size_t SamplerBatch::AddSampler(const Sampler& sampler)
+{
+    std::vector<Keyframe> decodedKeyframes;
+    if (sampler.IsCompressed())
+        decodedKeyframes = sampler.DecodeKeyframes();
+
+    const std::vector<Keyframe>& keyframes = sampler.IsCompressed() ? decodedKeyframes : sampler.GetKeyframes();
+
+    Track track;
+    track.firstKeyframe = uint32_t(m_Times.size());
+    track.keyframeCount = uint32_t(keyframes.size());
+    track.firstTangent = uint32_t(m_InTangents.size());
+    track.mode = sampler.GetMode();
+
+    for (const Keyframe& keyframe : keyframes)
+    {
+        m_Times.push_back(keyframe.time);
+        m_Values.push_back(keyframe.value);
+
+        if (track.mode == InterpolationMode::HermiteSpline)
+        {
+            m_InTangents.push_back(keyframe.inTangent);
+            m_OutTangents.push_back(keyframe.outTangent);
+        }
+    }
+
+    m_Tracks.push_back(track);
+
+    return m_Tracks.size() - 1;
+}
+
+void SamplerBatch::Evaluate(float time, size_t first, size_t count, std::optional<dm::float4>* results, bool extrapolateLastValues)
+{
+    assert(first + count <= m_Tracks.size());
+
+    for (size_t index = 0; index < count; ++index)
+    {
+        Track& track = m_Tracks[first + index];
+        std::optional<dm::float4>& result = results[index];
+
+        const float* times = m_Times.data() + track.firstKeyframe;
+        const float4* values = m_Values.data() + track.firstKeyframe;
+        const size_t keyframeCount = track.keyframeCount;
+        size_t offset = track.cursor.interval;
+        auto getTime = [times](size_t i) { return times[i]; };
+
+        if (!isInInterval(getTime, keyframeCount, time, offset))
+        {
+            if (keyframeCount == 0)
+            {
+                result.reset();
+                continue;
+            }
+
+            if (time <= times[0])
+            {
+                result = values[0];
+                continue;
+            }
+
+            if (keyframeCount == 1 || time >= times[keyframeCount - 1])
+            {
+                if (extrapolateLastValues)
+                    result = values[keyframeCount - 1];
+                else
+                    result.reset();
+                continue;
+            }
+
+            offset = findKeyframeInterval(getTime, keyframeCount, time, offset);
+            track.cursor.interval = offset;
+        }
+
+        const float tb = times[offset];
+        const float tc = times[offset + 1];
+        if (time < tb || time >= tc)
+        {
+            assert(!"Incorrect keyframe search result! Array not sorted?");
+            result.reset();
+            continue;
+        }
+
+        const float dt = tc - tb;
+        const float u = (time - tb) / dt;
+
+        const float4& b = values[offset];
+        const float4& c = values[offset + 1];
+
+        switch (track.mode)
+        {
+        case InterpolationMode::Step:
+            result = b;
+            break;
+
+        case InterpolationMode::Linear:
+            result = lerp(b, c, u);
+            break;
+
+        case InterpolationMode::HermiteSpline: {
+            const float4* outTangents = m_OutTangents.data() + track.firstTangent;
+            const float4* inTangents = m_InTangents.data() + track.firstTangent;
+            result = interpolateValues(track.mode, b, b, c, c, outTangents[offset], inTangents[offset + 1], u, dt);
+            break;
+        }
+
+        default: {
+            const float4& a = (offset > 0) ? values[offset - 1] : b;
+            const float4& d = (offset < keyframeCount - 2) ? values[offset + 2] : c;
+            result = interpolateValues(track.mode, a, b, c, d, b, c, u, dt);
+            break;
+        }
+        }
+    }
+}
+
 void Sampler::AddKeyframe(const Keyframe keyframe)
 {
+    if (m_Compressed)
+        Decompress();
+
     m_Keyframes.push_back(keyframe);
 }
 
 float Sampler::GetStartTime() const
 {
+    if (m_Compressed)
+        return m_Compressed->GetTime(0);
+
     if (!m_Keyframes.empty())
         return m_Keyframes[0].time;
 
@@ -167,12 +377,446 @@ float Sampler::GetStartTime() const
 
 float Sampler::GetEndTime() const
 {
+    if (m_Compressed)
+        return m_Compressed->GetTime(m_Compressed->GetKeyframeCount() - 1);
+
     if (!m_Keyframes.empty())
         return m_Keyframes[m_Keyframes.size() - 1].time;
 
     return 0.f;
 }
 
+// The smallest 3 components of a normalized quaternion are within +/- 1/sqrt(2).
+static constexpr float c_QuaternionComponentRange = 0.70710678f;
+static constexpr uint32_t c_QuaternionComponentMax = 0x7fff;
+
+// Stores the 3 smallest components of a normalized quaternion in 15 bits each, and the index of
+// the largest component in the top bits of the first two words. The largest component is made
+// positive by negating the quaternion, which represents the same rotation.
+static void encodeQuaternion(float4 q, uint16_t* result)
+{
+    int largest = 0;
+    for (int i = 1; i < 4; i++)
+    {
+        if (std::abs(q[i]) > std::abs(q[largest]))
+            largest = i;
+    }
+
+    if (q[largest] < 0.f)
+        q = -q;
+
+    int word = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        if (i == largest)
+            continue;
+
+        float normalized = (q[i] + c_QuaternionComponentRange) / (2.f * c_QuaternionComponentRange);
+        uint32_t quantized = uint32_t(std::clamp(normalized, 0.f, 1.f) * float(c_QuaternionComponentMax) + 0.5f);
+        result[word++] = uint16_t(quantized);
+    }
+
+    result[0] |= uint16_t((largest & 1) << 15);
+    result[1] |= uint16_t((largest >> 1) << 15);
+}
+
+static float4 decodeQuaternion(const uint16_t* data)
+{
+    int largest = (data[0] >> 15) | ((data[1] >> 15) << 1);
+
+    float4 q;
+    float sumOfSquares = 0.f;
+    int word = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        if (i == largest)
+            continue;
+
+        float normalized = float(data[word++] & c_QuaternionComponentMax) / float(c_QuaternionComponentMax);
+        q[i] = normalized * (2.f * c_QuaternionComponentRange) - c_QuaternionComponentRange;
+        sumOfSquares += q[i] * q[i];
+    }
+
+    q[largest] = std::sqrt(std::max(0.f, 1.f - sumOfSquares));
+    return q;
+}
+
+float4 CompressedKeyframes::GetValue(size_t index) const
+{
+    if (componentCount == 0)
+        return offset;
+
+    switch (encoding)
+    {
+    case Encoding::Quaternion:
+        return decodeQuaternion(values.data() + index * 3);
+
+    case Encoding::Float: {
+        float4 value = offset;
+        const float* data = floatValues.data() + index * componentCount;
+        for (int i = 0; i < 4; i++)
+        {
+            if (componentMask & (1 << i))
+                value[i] = *data++;
+        }
+        return value;
+    }
+
+    case Encoding::Quantized:
+    default: {
+        float4 value = offset;
+        const uint16_t* data = values.data() + index * componentCount;
+        for (int i = 0; i < 4; i++)
+        {
+            if (componentMask & (1 << i))
+                value[i] = offset[i] + float(*data++) * scale[i];
+        }
+        return value;
+    }
+    }
+}
+
+size_t CompressedKeyframes::GetMemoryUsage() const
+{
+    return sizeof(CompressedKeyframes)
+        + times.capacity() * sizeof(uint16_t)
+        + values.capacity() * sizeof(uint16_t)
+        + floatValues.capacity() * sizeof(float);
+}
+
+// Returns the rotation angle between two quaternions, which don't have to be normalized.
+// The angle is computed from the chord length, which is more precise for small angles than acos(dot(a, b)).
+static float quaternionAngle(const float4& a, const float4& b)
+{
+    double4 na = normalize(double4(a));
+    double4 nb = normalize(double4(b));
+    if (dot(na, nb) < 0.0)
+        nb = -nb;
+
+    return float(4.0 * std::asin(std::min(1.0, length(na - nb) * 0.5)));
+}
+
+static float maxComponentDifference(const float4& a, const float4& b)
+{
+    float4 difference = abs(a - b);
+    return std::max(std::max(difference.x, difference.y), std::max(difference.z, difference.w));
+}
+
+// Limits the length of a segment of removed keyframes, which bounds the cost of compressing long, slowly changing tracks.
+static constexpr size_t c_MaxCompressedSegmentLength = 1024;
+
+bool Sampler::Compress(float tolerance)
+{
+    if (m_Compressed)
+        return true;
+
+    if (m_Mode != InterpolationMode::Step && m_Mode != InterpolationMode::Linear && m_Mode != InterpolationMode::Slerp)
+        return false;
+
+    const size_t count = m_Keyframes.size();
+    if (count == 0 || !(tolerance >= 0.f))
+        return false;
+
+    const bool isRotation = m_Mode == InterpolationMode::Slerp;
+    auto getError = [isRotation](const float4& a, const float4& b)
+    {
+        return isRotation ? quaternionAngle(a, b) : maxComponentDifference(a, b);
+    };
+
+    // Quantize the times. Uniformly sampled keyframes, like captured motion, are stored as frame indices,
+    // which keeps their times exact; other keyframes use 1/65535 of the duration as the time step.
+    // The quantized times are never later than the original ones, so that evaluating the compressed sampler
+    // at an original keyframe time, such as a Step transition, finds the same keyframe.
+    const float startTime = m_Keyframes[0].time;
+    const float endTime = m_Keyframes[count - 1].time;
+    const float duration = endTime - startTime;
+
+    // Times that differ by less than this are equal up to float rounding
+    const float timeEpsilon = 4.f * std::numeric_limits<float>::epsilon() * std::max(std::abs(startTime), std::abs(endTime));
+
+    float timeStep = duration / 65535.f;
+    bool isUniform = false;
+    if (count > 1 && count - 1 <= 65535 && duration > 0.f)
+    {
+        float frameStep = duration / float(count - 1);
+
+        // Compensate for rounding in the decoding
+        for (int attempt = 0; attempt < 16; attempt++)
+        {
+            bool isEarlier = true;
+            for (size_t i = 1; i < count && isEarlier; i++)
+                isEarlier = startTime + float(i) * frameStep <= m_Keyframes[i].time;
+            if (isEarlier)
+                break;
+            frameStep = std::nextafter(frameStep, 0.f);
+        }
+
+        // Only keyframes that are on the frame grid up to float rounding are uniform, jittered times are quantized
+        isUniform = true;
+        for (size_t i = 1; i < count && isUniform; i++)
+        {
+            float difference = m_Keyframes[i].time - (startTime + float(i) * frameStep);
+            isUniform = difference >= 0.f && difference <= timeEpsilon;
+        }
+
+        if (isUniform)
+            timeStep = frameStep;
+    }
+
+    std::vector<uint16_t> times(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t quantized = uint32_t(i);
+        if (!isUniform && timeStep > 0.f)
+            quantized = uint32_t(std::clamp(std::floor((m_Keyframes[i].time - startTime) / timeStep), 0.f, 65535.f));
+
+        while (quantized > 0 && startTime + float(quantized) * timeStep > m_Keyframes[i].time)
+            --quantized;
+        times[i] = uint16_t(quantized);
+
+        // Keyframes closer than the time resolution, including discontinuities, cannot be represented
+        if (i > 0 && times[i] <= times[i - 1])
+            return false;
+    }
+
+    auto compressed = std::make_shared<CompressedKeyframes>();
+    compressed->startTime = startTime;
+    compressed->timeStep = timeStep;
+    auto getTime = [&compressed, &times](size_t i) { return compressed->startTime + float(times[i]) * compressed->timeStep; };
+    auto quantizeComponent = [&compressed](float value, int c)
+    {
+        float quantized = std::round((value - compressed->offset[c]) / compressed->scale[c]);
+        return uint16_t(std::clamp(quantized, 0.f, 65535.f));
+    };
+
+    // Try the compact encoding first, and fall back to floats if quantization alone exceeds the tolerance.
+    const CompressedKeyframes::Encoding encodings[] = {
+        isRotation ? CompressedKeyframes::Encoding::Quaternion : CompressedKeyframes::Encoding::Quantized,
+        CompressedKeyframes::Encoding::Float
+    };
+
+    std::vector<float4> decoded(count);
+    std::vector<uint16_t> encoded(count * 3);
+    std::vector<size_t> keptKeyframes;
+
+    for (CompressedKeyframes::Encoding encoding : encodings)
+    {
+        compressed->encoding = encoding;
+        compressed->componentMask = 0;
+        compressed->offset = m_Keyframes[0].value;
+        compressed->scale = 0.f;
+
+        // Find the components that don't change within the tolerance
+        if (isRotation)
+        {
+            bool constant = true;
+            for (size_t i = 1; i < count && constant; i++)
+                constant = quaternionAngle(m_Keyframes[i].value, m_Keyframes[0].value) <= tolerance;
+
+            compressed->offset = normalize(m_Keyframes[0].value);
+            if (!constant)
+                compressed->componentMask = 0xf;
+        }
+        else
+        {
+            float4 minValue = m_Keyframes[0].value;
+            float4 maxValue = m_Keyframes[0].value;
+            for (const Keyframe& keyframe : m_Keyframes)
+            {
+                minValue = min(minValue, keyframe.value);
+                maxValue = max(maxValue, keyframe.value);
+            }
+
+            for (int c = 0; c < 4; c++)
+            {
+                if (maxValue[c] - minValue[c] <= 2.f * tolerance)
+                {
+                    compressed->offset[c] = (minValue[c] + maxValue[c]) * 0.5f;
+                }
+                else
+                {
+                    compressed->componentMask |= uint8_t(1 << c);
+                    compressed->offset[c] = minValue[c];
+                    compressed->scale[c] = (maxValue[c] - minValue[c]) / 65535.f;
+                }
+            }
+        }
+
+        compressed->componentCount = 0;
+        for (int c = 0; c < 4; c++)
+        {
+            if (compressed->componentMask & (1 << c))
+                ++compressed->componentCount;
+        }
+        if (encoding == CompressedKeyframes::Encoding::Quaternion && compressed->componentCount != 0)
+            compressed->componentCount = 3;
+
+        if (compressed->componentCount == 0)
+        {
+            // Constant track, only the first and last keyframe times are needed
+            keptKeyframes = { 0 };
+            if (count > 1)
+                keptKeyframes.push_back(count - 1);
+            break;
+        }
+
+        // Encode every keyframe and decode it like the sampler will
+        for (size_t i = 0; i < count; i++)
+        {
+            const float4& value = m_Keyframes[i].value;
+            float4& result = decoded[i];
+            result = compressed->offset;
+
+            switch (encoding)
+            {
+            case CompressedKeyframes::Encoding::Quaternion:
+                encodeQuaternion(normalize(value), &encoded[i * 3]);
+                result = decodeQuaternion(&encoded[i * 3]);
+                break;
+
+            case CompressedKeyframes::Encoding::Float:
+                for (int c = 0; c < 4; c++)
+                {
+                    if (compressed->componentMask & (1 << c))
+                        result[c] = value[c];
+                }
+                break;
+
+            case CompressedKeyframes::Encoding::Quantized:
+            default:
+                for (int c = 0; c < 4; c++)
+                {
+                    if (compressed->componentMask & (1 << c))
+                        result[c] = compressed->offset[c] + float(quantizeComponent(value[c], c)) * compressed->scale[c];
+                }
+                break;
+            }
+        }
+
+        // Returns true if the segment between keyframes 'first' and 'last' reproduces the original
+        // keyframes [first, last) within the tolerance, when evaluated at their original times.
+        // Quantized times that only differ from the original ones by float rounding count as exact.
+        auto isSegmentWithinTolerance = [&](size_t first, size_t last)
+        {
+            const float tb = getTime(first);
+            const float dt = getTime(last) - tb;
+            for (size_t i = first; i < last; i++)
+            {
+                const float time = m_Keyframes[i].time - getTime(i) <= timeEpsilon ? getTime(i) : m_Keyframes[i].time;
+                const float u = std::clamp((time - tb) / dt, 0.f, 1.f);
+                float4 value = interpolateValues(m_Mode, decoded[first], decoded[first], decoded[last], decoded[last],
+                    decoded[first], decoded[last], u, dt);
+                if (getError(m_Keyframes[i].value, value) > tolerance)
+                    return false;
+            }
+            return true;
+        };
+
+        // Every keyframe has to be within the tolerance on its own, otherwise use the next encoding
+        bool encodingValid = getError(m_Keyframes[count - 1].value, decoded[count - 1]) <= tolerance;
+        for (size_t i = 0; i + 1 < count && encodingValid; i++)
+            encodingValid = isSegmentWithinTolerance(i, i + 1);
+
+        if (!encodingValid)
+        {
+            keptKeyframes.clear();
+            continue;
+        }
+
+        // Greedily extend every segment for as long as the removed keyframes stay within the tolerance
+        keptKeyframes = { 0 };
+        size_t first = 0;
+        while (first + 1 < count)
+        {
+            size_t last = first + 1;
+            while (last + 1 < count && last + 1 - first <= c_MaxCompressedSegmentLength && isSegmentWithinTolerance(first, last + 1))
+                ++last;
+
+            keptKeyframes.push_back(last);
+            first = last;
+        }
+        break;
+    }
+
+    if (keptKeyframes.empty())
+        return false;
+
+    // Store the kept keyframes
+    compressed->times.reserve(keptKeyframes.size());
+    for (size_t index : keptKeyframes)
+    {
+        compressed->times.push_back(times[index]);
+
+        if (compressed->componentCount == 0)
+            continue;
+
+        const float4& value = m_Keyframes[index].value;
+        switch (compressed->encoding)
+        {
+        case CompressedKeyframes::Encoding::Quaternion:
+            compressed->values.insert(compressed->values.end(), &encoded[index * 3], &encoded[index * 3 + 3]);
+            break;
+
+        case CompressedKeyframes::Encoding::Float:
+            for (int c = 0; c < 4; c++)
+            {
+                if (compressed->componentMask & (1 << c))
+                    compressed->floatValues.push_back(value[c]);
+            }
+            break;
+
+        case CompressedKeyframes::Encoding::Quantized:
+        default:
+            for (int c = 0; c < 4; c++)
+            {
+                if (compressed->componentMask & (1 << c))
+                    compressed->values.push_back(quantizeComponent(value[c], c));
+            }
+            break;
+        }
+    }
+
+    compressed->times.shrink_to_fit();
+    compressed->values.shrink_to_fit();
+    compressed->floatValues.shrink_to_fit();
+
+    m_Compressed = std::move(compressed);
+    std::vector<Keyframe>().swap(m_Keyframes);
+
+    return true;
+}
+
+void Sampler::Decompress()
+{
+    if (!m_Compressed)
+        return;
+
+    m_Keyframes = DecodeKeyframes();
+    m_Compressed.reset();
+}
+
+std::vector<Keyframe> Sampler::DecodeKeyframes() const
+{
+    if (!m_Compressed)
+        return m_Keyframes;
+
+    std::vector<Keyframe> keyframes(m_Compressed->GetKeyframeCount());
+    for (size_t i = 0; i < keyframes.size(); i++)
+    {
+        keyframes[i].time = m_Compressed->GetTime(i);
+        keyframes[i].value = m_Compressed->GetValue(i);
+    }
+    return keyframes;
+}
+
+size_t Sampler::GetMemoryUsage() const
+{
+    if (m_Compressed)
+        return m_Compressed->GetMemoryUsage();
+
+    return m_Keyframes.capacity() * sizeof(Keyframe);
+}
+
 void Sampler::Load(Json::Value& node)
 {
     if (node["mode"].isString())
@@ -36,6 +36,7 @@ this software is released into the Public Domain.
 
 #include <donut/engine/Scene.h>
 #include <donut/engine/GltfImporter.h>
+#include <donut/engine/ChunkImporter.h>
 #include <donut/core/json.h>
 #include <donut/core/log.h>
 #include <donut/core/string_utils.h>
@@ -102,6 +103,7 @@ Scene::Scene(
         m_SceneTypeFactory = std::make_shared<SceneTypeFactory>();
 
     m_GltfImporter = std::make_shared<GltfImporter>(m_fs, m_SceneTypeFactory);
+    m_ChunkImporter = std::make_shared<ChunkImporter>(m_fs, m_SceneTypeFactory);
 
     m_EnableBindlessResources = !!m_DescriptorTable;
     m_RayTracingSupported = m_Device->queryFeatureSupport(nvrhi::Feature::RayTracingAccelStruct);
@@ -150,7 +152,7 @@ bool Scene::LoadWithExecutor(const std::filesystem::path& sceneFileName, tf::Exe
     
     m_SceneGraph = std::make_shared<SceneGraph>();
 
-    if (sceneFileName.extension() == ".gltf" || sceneFileName.extension() == ".glb")
+    if (sceneFileName.extension() == ".gltf" || sceneFileName.extension() == ".glb" || sceneFileName.extension() == ".donutmesh")
     {
         ++g_LoadingStats.ObjectsTotal;
         m_Models.resize(1);
@@ -204,13 +206,22 @@ void Scene::LoadModelAsync(
     const std::filesystem::path& fileName,
     tf::Executor* executor)
 {   
+    auto loadModel = [this, executor](const std::filesystem::path& fileName, SceneImportResult& result)
+    {
+        // Chunk files are already in the BufferGroup layout and need no parsing or vertex conversion
+        if (fileName.extension() == ".donutmesh")
+            m_ChunkImporter->Load(fileName, *m_TextureCache, executor, result);
+        else
+            m_GltfImporter->Load(fileName, *m_TextureCache, g_LoadingStats, executor, result);
+    };
+
 #ifdef DONUT_WITH_TASKFLOW
     if (executor)
     {
-        executor->async([this, index, executor, fileName]()
+        executor->async([this, index, fileName, loadModel]()
             {
                 SceneImportResult result;
-                m_GltfImporter->Load(fileName, *m_TextureCache, g_LoadingStats, executor, result);
+                loadModel(fileName, result);
                 ++g_LoadingStats.ObjectsLoaded;
                 m_Models[index] = result;
             });
@@ -219,7 +230,7 @@ void Scene::LoadModelAsync(
 #endif // DONUT_WITH_TASKFLOW
     {
         SceneImportResult result;
-        m_GltfImporter->Load(fileName, *m_TextureCache, g_LoadingStats, executor, result);
+        loadModel(fileName, result);
         ++g_LoadingStats.ObjectsLoaded;
         m_Models[index] = result;
     }
@@ -639,7 +650,7 @@ void Scene::RefreshSceneGraph(uint32_t frameIndex)
     m_SceneGraph->Refresh(frameIndex);
 }
 
-void Scene::RefreshBuffers(nvrhi::ICommandList* commandList, uint32_t frameIndex)
+void Scene::RefreshBuffers(nvrhi::ICommandList* commandList, uint32_t frameIndex, tf::Executor* executor)
 {
     bool materialsChanged = false;
 
@@ -736,6 +747,8 @@ void Scene::RefreshBuffers(nvrhi::ICommandList* commandList, uint32_t frameIndex
             UpdateInstance(instance);
         }
 
+        UpdateInstanceTransforms(executor);
+
         WriteInstanceBuffer(commandList);
     }
 
@@ -770,16 +783,7 @@ void Scene::UpdateSkinnedMeshes(nvrhi::ICommandList* commandList, uint32_t frame
             commandList->beginMarker(groupName.c_str());
 
         jointMatrices.resize(skinnedInstance->joints.size());
-        dm::daffine3 worldToRoot = inverse(skinnedInstance->GetNode()->GetLocalToWorldTransform());
-
-        for (size_t i = 0; i < skinnedInstance->joints.size(); i++)
-        {
-            auto jointNode = skinnedInstance->joints[i].node.lock();
-
-            dm::float4x4 jointMatrix = dm::affineToHomogeneous(dm::affine3(jointNode->GetLocalToWorldTransform() * worldToRoot));
-            jointMatrix = skinnedInstance->joints[i].inverseBindMatrix * jointMatrix;
-            jointMatrices[i] = jointMatrix;
-        }
+        skinnedInstance->ComputeJointMatrices(jointMatrices.data());
 
         commandList->writeBuffer(skinnedInstance->jointBuffer, jointMatrices.data(), jointMatrices.size() * sizeof(float4x4));
 
@@ -830,10 +834,10 @@ void Scene::UpdateSkinnedMeshes(nvrhi::ICommandList* commandList, uint32_t frame
     }
 }
 
-void Scene::Refresh(nvrhi::ICommandList* commandList, uint32_t frameIndex)
+void Scene::Refresh(nvrhi::ICommandList* commandList, uint32_t frameIndex, tf::Executor* executor)
 {
     RefreshSceneGraph(frameIndex);
-    RefreshBuffers(commandList, frameIndex);
+    RefreshBuffers(commandList, frameIndex, executor);
 }
 
 
@@ -1258,9 +1262,8 @@ void Scene::UpdateInstance(const std::shared_ptr<MeshInstance>& instance)
     if (!node)
         return;
 
+    // the transforms are written by UpdateInstanceTransforms
     InstanceData& idata = m_Resources->instanceData[instance->GetInstanceIndex()];
-    affineToColumnMajor(node->GetLocalToWorldTransformFloat(), idata.transform);
-    affineToColumnMajor(node->GetPrevLocalToWorldTransformFloat(), idata.prevTransform);
 
     const auto& mesh = instance->GetMesh();
     idata.firstGeometryInstanceIndex = instance->GetGeometryInstanceIndex();
@@ -1273,3 +1276,46 @@ void Scene::UpdateInstance(const std::shared_ptr<MeshInstance>& instance)
         idata.flags |= InstanceFlags_CurveDisjointOrthogonalTriangleStrips;
     }
 }
+
+void Scene::UpdateInstanceTransforms(tf::Executor* executor)
+{
+    const auto& instances = m_SceneGraph->GetMeshInstances();
+    const size_t numInstances = instances.size();
+    if (numInstances == 0)
+        return;
+
+    // gather the current and previous transforms, then convert them to the buffer layout in one batch
+    m_InstanceTransforms.resize(numInstances * 2);
+    for (size_t i = 0; i < numInstances; i++)
+    {
+        if (SceneGraphNode* node = instances[i]->GetNode())
+        {
+            m_InstanceTransforms[i] = node->GetLocalToWorldTransformFloat();
+            m_InstanceTransforms[numInstances + i] = node->GetPrevLocalToWorldTransformFloat();
+        }
+    }
+
+    // instance indices are the positions in the mesh instance list, see SceneGraph::Refresh.
+    // Instances without a node keep their previous transforms, like in UpdateInstance.
+    InstanceData* instanceData = m_Resources->instanceData.data();
+    size_t begin = 0;
+    while (begin < numInstances)
+    {
+        if (!instances[begin]->GetNode())
+        {
+            ++begin;
+            continue;
+        }
+
+        size_t end = begin + 1;
+        while (end < numInstances && instances[end]->GetNode())
+            ++end;
+
+        dm::batch::affineToColumnMajor(m_InstanceTransforms.data() + begin, instanceData[begin].transform.m_data,
+            sizeof(InstanceData), end - begin, executor);
+        dm::batch::affineToColumnMajor(m_InstanceTransforms.data() + numInstances + begin, instanceData[begin].prevTransform.m_data,
+            sizeof(InstanceData), end - begin, executor);
+
+        begin = end;
+    }
+}
@@ -22,6 +22,7 @@
 
 #include <donut/engine/SceneGraph.h>
 #include <donut/core/log.h>
+#include <donut/core/parallel.h>
 #include <donut/core/json.h>
 #include <sstream>
 
@@ -83,6 +84,27 @@ std::shared_ptr<SceneGraphLeaf> SkinnedMeshInstance::Clone()
     return std::static_pointer_cast<SceneGraphLeaf>(copy);
 }
 
+void SkinnedMeshInstance::ComputeJointMatrices(dm::float4x4* jointMatrices) const
+{
+    auto node = GetNode();
+    dm::daffine3 worldToRoot = node ? inverse(node->GetLocalToWorldTransform()) : dm::daffine3::identity();
+
+    const size_t numJoints = joints.size();
+    std::vector<dm::daffine3> jointToRoot(numJoints);
+    std::vector<dm::affine3> jointToRootFloat(numJoints);
+
+    for (size_t i = 0; i < numJoints; i++)
+    {
+        auto jointNode = joints[i].node.lock();
+
+        jointToRoot[i] = jointNode ? jointNode->GetLocalToWorldTransform() * worldToRoot : dm::daffine3::identity();
+        jointMatrices[i] = joints[i].inverseBindMatrix;
+    }
+
+    dm::batch::convert(jointToRoot.data(), jointToRootFloat.data(), numJoints);
+    dm::batch::multiply(jointMatrices, jointToRootFloat.data(), jointMatrices, numJoints);
+}
+
 std::shared_ptr<SceneGraphLeaf> SkinnedMeshReference::Clone()
 {
     return std::make_shared<SkinnedMeshReference>(m_Instance.lock());
@@ -402,7 +424,7 @@ bool SceneGraphAnimationChannel::Apply(float time) const
         (!material && !node && m_Attribute == AnimationAttribute::LeafProperty))
         return false;
 
-    auto valueOption = m_Sampler->Evaluate(time, true);
+    auto valueOption = m_Sampler->Evaluate(time, m_Cursor, true);
     if (!valueOption.has_value())
         return false;
 
@@ -517,6 +539,159 @@ bool SceneGraphAnimation::IsVald() const
     return true;
 }
 
+// Number of transform channels evaluated by one task in SceneGraphAnimator::Apply
+static constexpr uint32_t c_AnimatorChannelsPerTask = 1024;
+
+size_t SceneGraphAnimator::AddAnimation(const std::shared_ptr<SceneGraphAnimation>& animation)
+{
+    uint32_t const animationIndex = uint32_t(m_PropertyChannels.size());
+    auto& propertyChannels = m_PropertyChannels.emplace_back();
+
+    Range range;
+    range.animationIndex = animationIndex;
+    range.firstChannel = uint32_t(m_Channels.size());
+
+    for (const auto& channel : animation->GetChannels())
+    {
+        AnimationAttribute const attribute = channel->GetAttribute();
+        auto node = channel->GetTargetNode();
+
+        // Everything other than a transform of a live node goes through the regular channel path,
+        // which also takes care of reporting the errors.
+        if (!node || (attribute != AnimationAttribute::Translation
+            && attribute != AnimationAttribute::Rotation
+            && attribute != AnimationAttribute::Scaling))
+        {
+            propertyChannels.push_back(channel);
+            continue;
+        }
+
+        auto [it, inserted] = m_TargetIndices.try_emplace(node.get(), uint32_t(m_Targets.size()));
+        if (inserted)
+        {
+            Target& target = m_Targets.emplace_back();
+            target.node = node.get();
+            target.ref = node;
+        }
+        else if (m_Targets[it->second].ref.expired())
+        {
+            // The node at this address was destroyed and a new one was allocated in its place
+            m_Targets[it->second].node = node.get();
+            m_Targets[it->second].ref = node;
+        }
+
+        TransformChannel transformChannel;
+        transformChannel.targetIndex = it->second;
+        transformChannel.attribute = attribute;
+        m_Channels.push_back(transformChannel);
+        m_Samplers.AddSampler(*channel->GetSampler());
+
+        if (++range.channelCount == c_AnimatorChannelsPerTask)
+        {
+            m_Ranges.push_back(range);
+            range.firstChannel += range.channelCount;
+            range.channelCount = 0;
+        }
+    }
+
+    if (range.channelCount > 0)
+        m_Ranges.push_back(range);
+
+    m_Values.resize(m_Channels.size());
+    m_TargetAlive.resize(m_Targets.size());
+    m_Times.resize(m_PropertyChannels.size());
+
+    return animationIndex;
+}
+
+void SceneGraphAnimator::EvaluateRange(const Range& range, const float* times)
+{
+    m_Samplers.Evaluate(times[range.animationIndex], range.firstChannel, range.channelCount,
+        m_Values.data() + range.firstChannel, true);
+}
+
+bool SceneGraphAnimator::Apply(float time, tf::Executor* executor)
+{
+    std::fill(m_Times.begin(), m_Times.end(), time);
+    return Apply(m_Times.data(), executor);
+}
+
+bool SceneGraphAnimator::Apply(const float* times, tf::Executor* executor)
+{
+    // Evaluate all transform channels
+    donut::parallel::forEachRange(executor, m_Ranges.size(), m_Ranges.size(), 1, [this, times](size_t begin, size_t end)
+        {
+            for (size_t index = begin; index < end; index++)
+                EvaluateRange(m_Ranges[index], times);
+        });
+
+    // Check the target lifetimes once per node instead of locking them for every channel
+    for (size_t index = 0; index < m_Targets.size(); index++)
+        m_TargetAlive[index] = !m_Targets[index].ref.expired();
+
+    // Write the results into the nodes in channel order, same as applying the animations one by one
+    bool success = true;
+    for (size_t index = 0; index < m_Channels.size(); index++)
+    {
+        const TransformChannel& channel = m_Channels[index];
+        const std::optional<dm::float4>& value = m_Values[index];
+        if (!m_TargetAlive[channel.targetIndex] || !value.has_value())
+        {
+            success = false;
+            continue;
+        }
+
+        SceneGraphNode* node = m_Targets[channel.targetIndex].node;
+
+        switch (channel.attribute)
+        {
+        case AnimationAttribute::Scaling:
+            node->m_Scaling = dm::double3(value->xyz());
+            break;
+
+        case AnimationAttribute::Rotation: {
+            dm::dquat quat = dm::dquat::fromXYZW(dm::double4(*value));
+            double len = length(quat);
+            if (len == 0.0)
+            {
+                log::warning("Rotation quaternion interpolated to zero, ignoring.");
+                continue;
+            }
+            quat /= len;
+            node->m_Rotation = quat;
+            break;
+        }
+
+        case AnimationAttribute::Translation:
+        default:
+            node->m_Translation = dm::double3(value->xyz());
+            break;
+        }
+
+        node->m_Dirty |= SceneGraphNode::DirtyFlags::LocalTransform;
+        node->m_HasLocalTransform = true;
+
+        // Same as PropagateDirtyFlags, but stop at the first node that already has the flag:
+        // the flags are always propagated to the root, so all of its ancestors have it too.
+        for (SceneGraphNode* current = node; current && (current->m_Dirty & SceneGraphNode::DirtyFlags::SubgraphTransforms) == 0;
+            current = current->m_Parent)
+        {
+            current->m_Dirty |= SceneGraphNode::DirtyFlags::SubgraphTransforms;
+        }
+    }
+
+    for (size_t animationIndex = 0; animationIndex < m_PropertyChannels.size(); animationIndex++)
+    {
+        for (const auto& channel : m_PropertyChannels[animationIndex])
+        {
+            if (!channel->Apply(times[animationIndex]))
+                success = false;
+        }
+    }
+
+    return success;
+}
+
 void SceneGraph::RegisterLeaf(const std::shared_ptr<SceneGraphLeaf>& leaf)
 {
     if (!leaf)
@@ -1266,11 +1441,15 @@ void donut::engine::PrintSceneGraph(const std::shared_ptr<SceneGraphNode>& root)
                         ss << "Unknown Attribute";
                     }
                     ss << "): ";
-                    auto keyframes = channel->GetSampler()->GetKeyframes();
-                    ss << keyframes.size() << " keyframes";
-                    if (!keyframes.empty())
+                    const auto& sampler = channel->GetSampler();
+                    ss << sampler->GetKeyframeCount() << " keyframes";
+                    if (sampler->GetKeyframeCount() != 0)
+                    {
+                        ss << ", " << sampler->GetStartTime() << "s - " << sampler->GetEndTime() << "s";
+                    }
+                    if (sampler->IsCompressed())
                     {
-                        ss << ", " << keyframes[0].time << "s - " << keyframes[keyframes.size() - 1].time << "s";
+                        ss << ", compressed";
                     }
 
                     log::info("%s", ss.str().c_str());
@@ -50,8 +50,11 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <donut/engine/CommonRenderPasses.h>
 #include <donut/engine/ConsoleObjects.h>
 #include <donut/engine/DDSFile.h>
+#include <donut/engine/KTX2File.h>
 #include <donut/core/vfs/VFS.h>
+#include <donut/core/hash.h>
 #include <donut/core/log.h>
+#include <donut/core/parallel.h>
 
 #ifdef DONUT_WITH_TASKFLOW
 #include <taskflow/taskflow.hpp>
@@ -79,6 +82,11 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
         #pragma warning(disable:4018) // Silence warning from tinyEXR
     #endif
 
+    // Decode the scanline blocks or tiles on multiple threads in builds without taskflow.
+    // With taskflow, DecodeEXRBlocks runs them as tasks on the shared executor instead.
+    #ifndef DONUT_WITH_TASKFLOW
+        #define TINYEXR_USE_THREAD 1
+    #endif
     #define TINYEXR_IMPLEMENTATION
     #include <tinyexr.h>
 
@@ -89,6 +97,7 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #endif // DONUT_WITH_TINYEXR
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <regex>
 
@@ -150,6 +159,14 @@ void TextureCache::Reset()
 
     m_TexturesRequested = 0;
     m_TexturesLoaded = 0;
+
+    std::lock_guard<std::mutex> contentGuard(m_TexturesByContentMutex);
+
+    m_TexturesByContent.clear();
+    m_TexturesDeduplicated = 0;
+    m_DeduplicatedBytes = 0;
+
+    m_CurrentUpload = TextureUpload();
 }
 
 void TextureCache::SetGenerateMipmaps(bool generateMipmaps)
@@ -181,9 +198,82 @@ bool TextureCache::FindTextureInCache(const std::filesystem::path& path, std::sh
     return false;
 }
 
+static size_t GetSubresourceDataSize(const TextureData& texture, uint32_t mipLevel, const TextureSubresourceData& layout)
+{
+    // Some loaders only store the size of one depth slice in dataSize
+    const size_t mipDepth = std::max(texture.depth >> mipLevel, 1u);
+    return std::max(layout.dataSize, layout.depthPitch * mipDepth);
+}
+
+void TextureCache::FindTextureContentOwner(const std::shared_ptr<TextureData>& texture)
+{
+    if (!m_DeduplicateByContent || !texture->data)
+        return;
+
+    // Hash the texture description and the decoded subresources, but not the container headers,
+    // so that the same image stored in different files or GLB buffers produces the same hash.
+    const uint32_t desc[] = {
+        uint32_t(texture->format),
+        texture->width,
+        texture->height,
+        texture->depth,
+        texture->arraySize,
+        texture->mipLevels,
+        uint32_t(texture->dimension),
+        texture->isRenderTarget ? 1u : 0u
+    };
+
+    uint64_t contentHash = hash::xxh64(desc, sizeof(desc));
+    size_t contentSize = 0;
+
+    const uint8_t* data = static_cast<const uint8_t*>(texture->data->data());
+    for (const auto& sliceData : texture->dataLayout)
+    {
+        for (uint32_t mipLevel = 0; mipLevel < uint32_t(sliceData.size()); mipLevel++)
+        {
+            const TextureSubresourceData& layout = sliceData[mipLevel];
+            const size_t size = GetSubresourceDataSize(*texture, mipLevel, layout);
+
+            contentHash = hash::xxh64(data + layout.dataOffset, size, contentHash);
+            contentSize += size;
+        }
+    }
+
+    texture->contentHash = contentHash;
+
+    // Note: 64-bit hash collisions are considered impossible in practice, the contents are not compared.
+    std::lock_guard<std::mutex> guard(m_TexturesByContentMutex);
+
+    std::weak_ptr<TextureData>& entry = m_TexturesByContent[contentHash];
+    std::shared_ptr<TextureData> owner = entry.lock();
+
+    if (owner && owner != texture)
+    {
+        texture->contentOwner = owner;
+
+        ++m_TexturesDeduplicated;
+        m_DeduplicatedBytes += contentSize;
+
+        log::message(m_InfoLogSeverity, "Texture '%s' is identical to '%s', sharing the GPU resources",
+            texture->path.c_str(), owner->path.c_str());
+    }
+    else
+    {
+        entry = texture;
+    }
+}
+
+bool TextureCache::IsMappedTextureFile(const std::filesystem::path& path)
+{
+    // DDS and uncompressed KTX2 textures are uploaded directly from the file data,
+    // so map them instead of reading into the heap. The mapping is released when the texture is finalized.
+    std::string extension = path.extension().generic_string();
+    return extension == ".dds" || extension == ".DDS" || extension == ".ktx2" || extension == ".KTX2";
+}
+
 std::shared_ptr<IBlob> TextureCache::ReadTextureFile(const std::filesystem::path& path) const
 {
-    auto fileData = m_fs->readFile(path);
+    auto fileData = IsMappedTextureFile(path) ? m_fs->mapFile(path) : m_fs->readFile(path);
 
     if (!fileData)
         log::message(m_ErrorLogSeverity, "Couldn't read texture file '%s'", path.generic_string().c_str());
@@ -191,6 +281,404 @@ std::shared_ptr<IBlob> TextureCache::ReadTextureFile(const std::filesystem::path
     return fileData;
 }
 
+#ifdef DONUT_WITH_TINYEXR
+// Finds the channel with the given name, either alone or as the last component of a layer name, like "diffuse.R".
+// Channels without a layer name take priority.
+static int FindEXRChannel(const EXRHeader& header, const char* name)
+{
+    int layerChannel = -1;
+    for (int channel = 0; channel < header.num_channels; channel++)
+    {
+        const char* channelName = header.channels[channel].name;
+        if (strcmp(channelName, name) == 0)
+            return channel;
+
+        const char* dot = strrchr(channelName, '.');
+        if (layerChannel < 0 && dot && strcmp(dot + 1, name) == 0)
+            layerChannel = channel;
+    }
+    return layerChannel;
+}
+
+#ifdef DONUT_WITH_TASKFLOW
+// Decodes the pixel blocks of a single-part EXR image like LoadEXRImageFromMemory, using the block decoders
+// of tinyexr, but runs the blocks as tasks on the shared executor instead of starting new threads.
+// When the texture is loaded asynchronously on an executor worker already, the blocks are decoded serially.
+static bool DecodeEXRBlocks(EXRImage& image, EXRHeader& header, const uint8_t* fileBytes, size_t fileSize, std::string& error)
+{
+    const int dataWidth = header.data_window[2] - header.data_window[0] + 1;
+    const int dataHeight = header.data_window[3] - header.data_window[1] + 1;
+    constexpr int maxSize = 1024 * 8192; // Same limit as tinyexr
+    if (dataWidth <= 0 || dataHeight <= 0 || dataWidth > maxSize || dataHeight > maxSize)
+    {
+        error = "invalid data window";
+        return false;
+    }
+
+    if (header.tiled && (header.tile_size_x <= 0 || header.tile_size_y <= 0))
+    {
+        error = "invalid tile size";
+        return false;
+    }
+
+    int scanlinesPerBlock = 1;
+    if (header.compression_type == TINYEXR_COMPRESSIONTYPE_ZIP || header.compression_type == TINYEXR_COMPRESSIONTYPE_ZFP)
+        scanlinesPerBlock = 16;
+    else if (header.compression_type == TINYEXR_COMPRESSIONTYPE_PIZ)
+        scanlinesPerBlock = 32;
+
+    size_t numBlocks;
+    if (header.chunk_count > 0)
+        numBlocks = size_t(header.chunk_count);
+    else if (header.tiled)
+        numBlocks = size_t((dataWidth + header.tile_size_x - 1) / header.tile_size_x)
+            * size_t((dataHeight + header.tile_size_y - 1) / header.tile_size_y);
+    else
+        numBlocks = size_t((dataHeight + scanlinesPerBlock - 1) / scanlinesPerBlock);
+
+    // The offset table follows the magic number, version and header
+    const uint8_t* offsetTable = fileBytes + 8 + header.header_len;
+    if (8 + size_t(header.header_len) + numBlocks * sizeof(uint64_t) >= fileSize)
+    {
+        error = "insufficient data size in the offset table";
+        return false;
+    }
+
+    std::vector<tinyexr::tinyexr_uint64> offsets(numBlocks);
+    bool missingOffsets = false;
+    for (size_t block = 0; block < numBlocks; block++)
+    {
+        memcpy(&offsets[block], offsetTable + block * sizeof(uint64_t), sizeof(uint64_t));
+        tinyexr::swap8(&offsets[block]);
+        if (offsets[block] >= fileSize)
+        {
+            error = "invalid block offset";
+            return false;
+        }
+        missingOffsets = missingOffsets || offsets[block] == 0;
+    }
+
+    if (missingOffsets && !tinyexr::ReconstructLineOffsets(&offsets, numBlocks, fileBytes,
+        offsetTable + numBlocks * sizeof(uint64_t), fileSize))
+    {
+        error = "cannot reconstruct the offset table";
+        return false;
+    }
+
+    std::vector<size_t> channelOffsets;
+    int pixelDataSize = 0;
+    size_t channelOffset = 0;
+    if (!tinyexr::ComputeChannelLayout(&channelOffsets, &pixelDataSize, &channelOffset, header.num_channels, header.channels))
+    {
+        error = "invalid channel layout";
+        return false;
+    }
+
+    // Set up the image first so that FreeEXRImage releases whatever has been allocated if decoding fails
+    image.num_channels = header.num_channels;
+    image.width = dataWidth;
+    image.height = dataHeight;
+    if (header.tiled)
+    {
+        image.tiles = static_cast<EXRTile*>(calloc(numBlocks, sizeof(EXRTile)));
+        image.num_tiles = int(numBlocks);
+        for (size_t tile = 0; tile < numBlocks; tile++)
+        {
+            image.tiles[tile].images = tinyexr::AllocateImage(header.num_channels, header.channels,
+                header.requested_pixel_types, header.tile_size_x, header.tile_size_y);
+        }
+    }
+    else
+    {
+        image.images = tinyexr::AllocateImage(header.num_channels, header.channels,
+            header.requested_pixel_types, dataWidth, dataHeight);
+    }
+
+    std::atomic<bool> invalidData = false;
+
+    auto decodeBlock = [&](size_t block)
+    {
+        const uint8_t* blockData = fileBytes + offsets[block];
+        const size_t headerSize = header.tiled ? sizeof(int) * 5 : sizeof(int) * 2;
+        if (offsets[block] + headerSize > fileSize)
+        {
+            invalidData = true;
+            return;
+        }
+
+        // Tiles start with the tile x, y and level coordinates, scanline blocks with the first line number,
+        // followed by the size of the block data
+        int coordinates[4] = {};
+        int dataSize = 0;
+        memcpy(coordinates, blockData, headerSize - sizeof(int));
+        memcpy(&dataSize, blockData + headerSize - sizeof(int), sizeof(int));
+        for (int& value : coordinates)
+            tinyexr::swap4(reinterpret_cast<unsigned int*>(&value));
+        tinyexr::swap4(reinterpret_cast<unsigned int*>(&dataSize));
+
+        if (dataSize <= 0 || size_t(dataSize) > fileSize - offsets[block] - headerSize)
+        {
+            invalidData = true;
+            return;
+        }
+
+        bool decoded;
+        if (header.tiled)
+        {
+            EXRTile& tile = image.tiles[block];
+
+            // Mip and ripmap levels are not supported, same as in tinyexr
+            if (coordinates[2] != 0 || coordinates[3] != 0 || coordinates[0] < 0 || coordinates[1] < 0 ||
+                int64_t(coordinates[0]) * header.tile_size_x >= dataWidth ||
+                int64_t(coordinates[1]) * header.tile_size_y >= dataHeight)
+            {
+                invalidData = true;
+                return;
+            }
+
+            decoded = tinyexr::DecodeTiledPixelData(tile.images, &tile.width, &tile.height,
+                header.requested_pixel_types, blockData + headerSize, size_t(dataSize), header.compression_type,
+                header.line_order, dataWidth, dataHeight, coordinates[0], coordinates[1],
+                header.tile_size_x, header.tile_size_y, size_t(pixelDataSize), size_t(header.num_custom_attributes),
+                header.custom_attributes, size_t(header.num_channels), header.channels, channelOffsets);
+
+            tile.offset_x = coordinates[0];
+            tile.offset_y = coordinates[1];
+        }
+        else
+        {
+            const int64_t lineNumber = int64_t(coordinates[0]) - header.data_window[1];
+            const int numLines = int(std::min(lineNumber + scanlinesPerBlock, int64_t(dataHeight)) - lineNumber);
+            if (lineNumber < 0 || numLines <= 0)
+            {
+                invalidData = true;
+                return;
+            }
+
+            decoded = tinyexr::DecodePixelData(image.images, header.requested_pixel_types,
+                blockData + headerSize, size_t(dataSize), header.compression_type, header.line_order,
+                dataWidth, dataHeight, dataWidth, int(block), int(lineNumber), numLines, size_t(pixelDataSize),
+                size_t(header.num_custom_attributes), header.custom_attributes, size_t(header.num_channels),
+                header.channels, channelOffsets);
+        }
+
+        if (!decoded)
+            invalidData = true;
+    };
+
+    donut::parallel::forEachIndex(donut::parallel::getSharedExecutor(), numBlocks,
+        std::max(std::thread::hardware_concurrency(), 1u), decodeBlock);
+
+    if (invalidData)
+    {
+        error = "invalid pixel data";
+        return false;
+    }
+
+    for (int channel = 0; channel < header.num_channels; channel++)
+        header.pixel_types[channel] = header.requested_pixel_types[channel];
+
+    return true;
+}
+#endif // DONUT_WITH_TASKFLOW
+
+// Loads a single-part EXR image into an RGBA16_FLOAT texture if all the channels used are half precision,
+// or RGBA32_FLOAT otherwise. Supports RGB(A), luminance (Y) and single-channel images, scanline or tiled.
+// The pixel blocks are decoded in parallel: on the shared executor with taskflow, by tinyexr's threads otherwise.
+static bool LoadEXRTextureFromMemory(const IBlob& fileData, TextureData& texture, std::string& error)
+{
+    const uint8_t* fileBytes = static_cast<const uint8_t*>(fileData.data());
+    const char* err = nullptr;
+
+    EXRVersion version;
+    if (ParseEXRVersionFromMemory(&version, fileBytes, fileData.size()) != TINYEXR_SUCCESS)
+    {
+        error = "invalid EXR header";
+        return false;
+    }
+
+    if (version.multipart || version.non_image)
+    {
+        error = "multipart and deep EXR images are not supported";
+        return false;
+    }
+
+    EXRHeader header;
+    InitEXRHeader(&header);
+    if (ParseEXRHeaderFromMemory(&header, &version, fileBytes, fileData.size(), &err) != TINYEXR_SUCCESS)
+    {
+        error = err ? err : "invalid EXR header";
+        FreeEXRErrorMessage(err);
+        return false;
+    }
+
+    // R, G, B, A source channel indices, -1 means a constant
+    int channels[4] = {
+        FindEXRChannel(header, "R"),
+        FindEXRChannel(header, "G"),
+        FindEXRChannel(header, "B"),
+        FindEXRChannel(header, "A")
+    };
+
+    if (channels[0] < 0 && channels[1] < 0 && channels[2] < 0)
+    {
+        int luminance = FindEXRChannel(header, "Y");
+        if (luminance < 0 && header.num_channels == 1)
+            luminance = 0;
+
+        if (luminance < 0)
+        {
+            error = "no RGB or luminance channels found";
+            FreeEXRHeader(&header);
+            return false;
+        }
+
+        channels[0] = channels[1] = channels[2] = luminance;
+    }
+
+    bool allHalf = true;
+    uint32_t bitsPerPixel = 0;
+    for (int channel = 0; channel < header.num_channels; channel++)
+    {
+        if (std::find(channels, channels + 4, channel) == channels + 4)
+            continue;
+
+        allHalf = allHalf && header.pixel_types[channel] == TINYEXR_PIXELTYPE_HALF;
+        bitsPerPixel += header.pixel_types[channel] == TINYEXR_PIXELTYPE_HALF ? 16 : 32;
+    }
+
+    // Keep the half precision data as-is when possible, otherwise convert everything to float
+    if (!allHalf)
+    {
+        for (int channel = 0; channel < header.num_channels; channel++)
+        {
+            if (header.pixel_types[channel] == TINYEXR_PIXELTYPE_HALF)
+                header.requested_pixel_types[channel] = TINYEXR_PIXELTYPE_FLOAT;
+        }
+    }
+
+    EXRImage image;
+    InitEXRImage(&image);
+#ifdef DONUT_WITH_TASKFLOW
+    if (!DecodeEXRBlocks(image, header, fileBytes, fileData.size(), error))
+    {
+        FreeEXRImage(&image);
+        FreeEXRHeader(&header);
+        return false;
+    }
+#else
+    if (LoadEXRImageFromMemory(&image, &header, fileBytes, fileData.size(), &err) != TINYEXR_SUCCESS)
+    {
+        error = err ? err : "failed to decode the image";
+        FreeEXRErrorMessage(err);
+        FreeEXRHeader(&header);
+        return false;
+    }
+#endif
+
+    const size_t width = size_t(image.width);
+    const size_t height = size_t(image.height);
+    const size_t bytesPerChannel = allHalf ? sizeof(uint16_t) : sizeof(float);
+    const size_t bytesPerPixel = bytesPerChannel * 4;
+    const size_t dataSize = width * height * bytesPerPixel;
+    uint8_t* data = static_cast<uint8_t*>(malloc(dataSize));
+    if (!data)
+    {
+        FreeEXRImage(&image);
+        FreeEXRHeader(&header);
+        error = "out of memory";
+        return false;
+    }
+
+    // Copies a run of pixels from the planar tinyexr images into the interleaved RGBA destination
+    auto copyPixels = [&](unsigned char** sourceImages, size_t sourceOffset, size_t destOffset, size_t count)
+    {
+        for (int component = 0; component < 4; component++)
+        {
+            const int channel = channels[component];
+
+            if (allHalf)
+            {
+                uint16_t* dest = reinterpret_cast<uint16_t*>(data) + destOffset * 4 + component;
+                const uint16_t* source = channel >= 0
+                    ? reinterpret_cast<const uint16_t*>(sourceImages[channel]) + sourceOffset
+                    : nullptr;
+                const uint16_t constant = component == 3 ? 0x3c00 : 0; // 1.0 for alpha, 0.0 otherwise
+
+                for (size_t i = 0; i < count; i++)
+                    dest[i * 4] = source ? source[i] : constant;
+            }
+            else
+            {
+                float* dest = reinterpret_cast<float*>(data) + destOffset * 4 + component;
+                const float constant = component == 3 ? 1.f : 0.f;
+
+                if (channel < 0)
+                {
+                    for (size_t i = 0; i < count; i++)
+                        dest[i * 4] = constant;
+                }
+                else if (header.requested_pixel_types[channel] == TINYEXR_PIXELTYPE_UINT)
+                {
+                    const uint32_t* source = reinterpret_cast<const uint32_t*>(sourceImages[channel]) + sourceOffset;
+                    for (size_t i = 0; i < count; i++)
+                        dest[i * 4] = float(source[i]);
+                }
+                else
+                {
+                    const float* source = reinterpret_cast<const float*>(sourceImages[channel]) + sourceOffset;
+                    for (size_t i = 0; i < count; i++)
+                        dest[i * 4] = source[i];
+                }
+            }
+        }
+    };
+
+    if (image.tiles)
+    {
+        for (int tileIndex = 0; tileIndex < image.num_tiles; tileIndex++)
+        {
+            const EXRTile& tile = image.tiles[tileIndex];
+            if (tile.level_x != 0 || tile.level_y != 0)
+                continue;
+
+            const size_t tileX = size_t(tile.offset_x) * size_t(header.tile_size_x);
+            const size_t tileY = size_t(tile.offset_y) * size_t(header.tile_size_y);
+            const size_t tileWidth = std::min(size_t(tile.width), width - std::min(tileX, width));
+            const size_t tileHeight = std::min(size_t(tile.height), height - std::min(tileY, height));
+
+            for (size_t row = 0; row < tileHeight; row++)
+                copyPixels(tile.images, row * size_t(header.tile_size_x), (tileY + row) * width + tileX, tileWidth);
+        }
+    }
+    else
+    {
+        copyPixels(image.images, 0, 0, width * height);
+    }
+
+    FreeEXRImage(&image);
+    FreeEXRHeader(&header);
+
+    texture.data = std::make_shared<Blob>(data, dataSize);
+    texture.width = static_cast<uint32_t>(width);
+    texture.height = static_cast<uint32_t>(height);
+    texture.format = allHalf ? nvrhi::Format::RGBA16_FLOAT : nvrhi::Format::RGBA32_FLOAT;
+
+    texture.originalBitsPerPixel = bitsPerPixel;
+    texture.isRenderTarget = true;
+    texture.mipLevels = 1;
+    texture.dimension = nvrhi::TextureDimension::Texture2D;
+
+    texture.dataLayout.resize(1);
+    texture.dataLayout[0].resize(1);
+    texture.dataLayout[0][0].dataOffset = 0;
+    texture.dataLayout[0][0].rowPitch = width * bytesPerPixel;
+    texture.dataLayout[0][0].dataSize = dataSize;
+
+    return true;
+}
+#endif // DONUT_WITH_TINYEXR
+
 std::shared_ptr<TextureData> TextureCache::CreateTextureData()
 {
     return std::make_shared<TextureData>();
@@ -212,41 +700,23 @@ bool TextureCache::FillTextureData(
             return false;
         }
     }
-#ifdef DONUT_WITH_TINYEXR
-    else if (extension == ".exr" || extension == ".EXR" || mimeType == "image/aces")
+    else if (extension == ".ktx2" || extension == ".KTX2" || mimeType == "image/ktx2")
     {
-        float* data = nullptr;
-        int width = 0, height = 0;
-        char const* err = nullptr;
-
-        // This reads only 1 or 4 channel images and duplicates channels
-        // Should rewrite w/ lower level EXR functions
-        if (LoadEXRFromMemory(&data, &width, &height, (uint8_t*)fileData->data(), fileData->size(), &err) == TINYEXR_SUCCESS)
+        texture->data = fileData;
+        if (!LoadKTX2TextureFromMemory(*texture))
         {
-            uint32_t channels = 4;
-            uint32_t bytesPerPixel = channels * 4;
-
-            texture->data = std::make_shared<Blob>(data, bytesPerPixel * width * height);
-            texture->width = static_cast<uint32_t>(width);
-            texture->height = static_cast<uint32_t>(height);
-            texture->format = nvrhi::Format::RGBA32_FLOAT;
-
-            texture->originalBitsPerPixel = channels * 32;
-            texture->isRenderTarget = true;
-            texture->mipLevels = 1;
-            texture->dimension = nvrhi::TextureDimension::Texture2D;
-
-            texture->dataLayout.resize(1);
-            texture->dataLayout[0].resize(1);
-            texture->dataLayout[0][0].dataOffset = 0;
-            texture->dataLayout[0][0].rowPitch = static_cast<size_t>(width * bytesPerPixel);
-            texture->dataLayout[0][0].dataSize = static_cast<size_t>(width * height * bytesPerPixel);
-
-            return true;
+            texture->data = nullptr;
+            log::message(m_ErrorLogSeverity, "Couldn't load KTX2 texture '%s'", texture->path.c_str());
+            return false;
         }
-        else
+    }
+#ifdef DONUT_WITH_TINYEXR
+    else if (extension == ".exr" || extension == ".EXR" || mimeType == "image/aces")
+    {
+        std::string error;
+        if (!LoadEXRTextureFromMemory(*fileData, *texture, error))
         {
-            log::warning("Couldn't load EXR texture '%s'", texture->path.c_str());
+            log::message(m_ErrorLogSeverity, "Couldn't load EXR texture '%s': %s", texture->path.c_str(), error.c_str());
             return false;
         }
     }
@@ -357,6 +827,112 @@ void TextureCache::FinalizeTexture(
     assert(texture->data);
     assert(commandList);
 
+    if (texture->contentOwner)
+    {
+        // The owner may be waiting in the finalization queue or be partially uploaded, which is state that
+        // only the rendering thread can touch. Let ProcessRenderingThreadCommands finalize the duplicate then.
+        if (!ShareContentOwnerTexture(texture))
+        {
+            std::lock_guard<std::mutex> guard(m_TexturesToFinalizeMutex);
+            m_TexturesToFinalize.push(texture);
+        }
+        return;
+    }
+
+    // The texture may be the content owner of a duplicate that ProcessRenderingThreadCommands has finalized already
+    if (!ClaimTextureUpload(*texture))
+        return;
+
+    TextureUpload upload = BeginTextureUpload(texture, passes, commandList);
+
+    while (upload.nextSubresource < upload.numSubresources)
+        UploadNextSubresource(upload, commandList);
+
+    EndTextureUpload(upload, passes, commandList);
+}
+
+bool TextureCache::ClaimTextureUpload(TextureData& texture)
+{
+    std::lock_guard<std::mutex> guard(m_TextureUploadMutex);
+
+    if (texture.uploadStarted)
+        return false;
+
+    texture.uploadStarted = true;
+    return true;
+}
+
+bool TextureCache::ShareContentOwnerTexture(const std::shared_ptr<TextureData>& texture)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_TextureUploadMutex);
+
+        if (!texture->contentOwner->texture)
+            return false;
+
+        texture->texture = texture->contentOwner->texture;
+        texture->uploadStarted = true;
+    }
+
+    texture->contentOwner.reset();
+
+    // The descriptor table manager returns the same, reference counted descriptor for the same texture
+    if (m_DescriptorTable)
+        texture->bindlessDescriptor = m_DescriptorTable->CreateDescriptorHandle(nvrhi::BindingSetItem::Texture_SRV(0, texture->texture));
+
+    texture->data.reset();
+
+    ++m_TexturesFinalized;
+    return true;
+}
+
+bool TextureCache::FinalizeDuplicateTexture(
+    const std::shared_ptr<TextureData>& texture,
+    CommonRenderPasses* passes,
+    nvrhi::ICommandList* commandList)
+{
+    if (ShareContentOwnerTexture(texture))
+        return true;
+
+    const std::shared_ptr<TextureData> owner = texture->contentOwner;
+
+    if (owner == m_CurrentUpload.texture)
+    {
+        // The owner is partially uploaded by ProcessRenderingThreadCommands, finish its upload now.
+        commandList->beginTrackingTextureState(m_CurrentUpload.destination, nvrhi::AllSubresources,
+            m_CurrentUpload.destinationState);
+
+        while (m_CurrentUpload.nextSubresource < m_CurrentUpload.numSubresources)
+            UploadNextSubresource(m_CurrentUpload, commandList);
+
+        EndTextureUpload(m_CurrentUpload, passes, commandList);
+        m_CurrentUpload = TextureUpload();
+    }
+    else if (ClaimTextureUpload(*owner))
+    {
+        // The owner may still be waiting in the finalization queue, finalize it now.
+        // It will be skipped when taken out of the queue because its data will be released.
+        TextureUpload upload = BeginTextureUpload(owner, passes, commandList);
+
+        while (upload.nextSubresource < upload.numSubresources)
+            UploadNextSubresource(upload, commandList);
+
+        EndTextureUpload(upload, passes, commandList);
+    }
+    else
+    {
+        // A synchronous Load* call on another thread is uploading the owner
+        return false;
+    }
+
+    return ShareContentOwnerTexture(texture);
+}
+
+TextureUpload TextureCache::BeginTextureUpload(
+    const std::shared_ptr<TextureData>& texture,
+    CommonRenderPasses* passes,
+    nvrhi::ICommandList* commandList)
+{
     uint originalWidth = texture->width;
     uint originalHeight = texture->height;
 
@@ -400,8 +976,6 @@ void TextureCache::FinalizeTexture(
         }
     }
 
-    const char* dataPointer = static_cast<const char*>(texture->data->data());
-
     nvrhi::TextureDesc textureDesc;
     textureDesc.format = texture->format;
     textureDesc.width = scaledWidth;
@@ -414,13 +988,13 @@ void TextureCache::FinalizeTexture(
         : texture->mipLevels;
     textureDesc.debugName = texture->path;
     textureDesc.isRenderTarget = texture->isRenderTarget;
-    texture->texture = m_Device->createTexture(textureDesc);
 
-    commandList->beginTrackingTextureState(texture->texture, nvrhi::AllSubresources, nvrhi::ResourceStates::Common);
+    TextureUpload upload;
+    upload.texture = texture;
+    upload.finalTexture = m_Device->createTexture(textureDesc);
+    upload.destination = upload.finalTexture;
+    upload.mipLevels = texture->mipLevels;
 
-    if (m_DescriptorTable)
-        texture->bindlessDescriptor = m_DescriptorTable->CreateDescriptorHandle(nvrhi::BindingSetItem::Texture_SRV(0, texture->texture));
-    
     if (scaledWidth != originalWidth || scaledHeight != originalHeight)
     {
         nvrhi::TextureDesc tempTextureDesc;
@@ -432,57 +1006,156 @@ void TextureCache::FinalizeTexture(
         tempTextureDesc.mipLevels = 1;
         tempTextureDesc.dimension = textureDesc.dimension;
 
-        nvrhi::TextureHandle tempTexture = m_Device->createTexture(tempTextureDesc);
-        assert(tempTexture);
-        commandList->beginTrackingTextureState(tempTexture, nvrhi::AllSubresources, nvrhi::ResourceStates::Common);
+        upload.destination = m_Device->createTexture(tempTextureDesc);
+        assert(upload.destination);
 
-        for (uint32_t arraySlice = 0; arraySlice < texture->arraySize; arraySlice++)
-        {
-            const TextureSubresourceData& layout = texture->dataLayout[arraySlice][0];
+        // Only the top mip level is uploaded, the rest is produced by the blit and mip generation
+        upload.mipLevels = 1;
+    }
 
-            commandList->writeTexture(tempTexture, arraySlice, 0, dataPointer + layout.dataOffset,
-                layout.rowPitch, layout.depthPitch);
-        }
+    upload.numSubresources = texture->arraySize * upload.mipLevels;
 
-        nvrhi::FramebufferHandle framebuffer = m_Device->createFramebuffer(nvrhi::FramebufferDesc()
-            .addColorAttachment(texture->texture));
-        
-        passes->BlitTexture(commandList, framebuffer, tempTexture);
+    commandList->beginTrackingTextureState(upload.destination, nvrhi::AllSubresources, nvrhi::ResourceStates::Common);
+
+    return upload;
+}
+
+size_t TextureCache::UploadNextSubresource(TextureUpload& upload, nvrhi::ICommandList* commandList, size_t maxBytes)
+{
+    assert(upload.nextSubresource < upload.numSubresources);
+
+    const uint32_t arraySlice = upload.nextSubresource / upload.mipLevels;
+    const uint32_t mipLevel = upload.nextSubresource % upload.mipLevels;
+
+    const TextureData& texture = *upload.texture;
+    const TextureSubresourceData& layout = texture.dataLayout[arraySlice][mipLevel];
+    const char* dataPointer = static_cast<const char*>(texture.data->data()) + layout.dataOffset;
+
+    const nvrhi::TextureDesc& destDesc = upload.destination->getDesc();
+    const nvrhi::FormatInfo& formatInfo = nvrhi::getFormatInfo(destDesc.format);
+    const uint32_t mipWidth = std::max(destDesc.width >> mipLevel, 1u);
+    const uint32_t mipHeight = std::max(destDesc.height >> mipLevel, 1u);
+    const uint32_t mipDepth = destDesc.dimension == nvrhi::TextureDimension::Texture3D
+        ? std::max(destDesc.depth >> mipLevel, 1u) : 1u;
+    const uint32_t numRows = (mipHeight + formatInfo.blockSize - 1) / formatInfo.blockSize;
+    const size_t rowSize = size_t((mipWidth + formatInfo.blockSize - 1) / formatInfo.blockSize) * formatInfo.bytesPerBlock;
+
+    size_t size = GetSubresourceDataSize(texture, mipLevel, layout);
+
+    if (upload.nextRow == 0 && (maxBytes == 0 || size <= maxBytes || mipDepth > 1 || numRows <= 1))
+    {
+        commandList->writeTexture(upload.destination, arraySlice, mipLevel, dataPointer,
+            layout.rowPitch, layout.depthPitch);
+
+        ++upload.nextSubresource;
     }
     else
     {
-        for (uint32_t arraySlice = 0; arraySlice < texture->arraySize; arraySlice++)
+        // writeTexture has no region parameter, so copy a range of block rows through a staging texture.
+        // The ranges start and end on block row boundaries, only the last one may end at a partial block
+        // row at the edge of the mip level. The staging textures always cover whole blocks.
+        const uint32_t firstRow = upload.nextRow;
+        const size_t maxRows = maxBytes > 0 ? std::max(maxBytes / rowSize, size_t(1)) : size_t(numRows);
+        const uint32_t rowCount = uint32_t(std::min(maxRows, size_t(numRows - firstRow)));
+        const uint32_t firstPixelRow = firstRow * formatInfo.blockSize;
+        const uint32_t pixelRowCount = std::min(rowCount * formatInfo.blockSize, mipHeight - firstPixelRow);
+
+        // Size the staging textures for the whole budget, so that the following ranges can reuse them
+        const size_t budgetRows = std::max(m_UploadBudgetBytes / rowSize, size_t(rowCount));
+        nvrhi::IStagingTexture* stagingTexture = AcquireStagingTexture(destDesc.format,
+            (mipWidth + formatInfo.blockSize - 1) / formatInfo.blockSize * formatInfo.blockSize,
+            uint32_t(std::min(budgetRows, size_t(numRows))) * formatInfo.blockSize);
+
+        size_t stagingRowPitch = 0;
+        char* mappedData = static_cast<char*>(m_Device->mapStagingTexture(stagingTexture, nvrhi::TextureSlice(),
+            nvrhi::CpuAccessMode::Write, &stagingRowPitch));
+        assert(mappedData);
+
+        for (uint32_t row = 0; row < rowCount; row++)
+            memcpy(mappedData + row * stagingRowPitch, dataPointer + size_t(firstRow + row) * layout.rowPitch, rowSize);
+
+        m_Device->unmapStagingTexture(stagingTexture);
+
+        commandList->copyTexture(upload.destination, nvrhi::TextureSlice()
+                .setOrigin(0, firstPixelRow)
+                .setWidth(mipWidth)
+                .setHeight(pixelRowCount)
+                .setMipLevel(mipLevel)
+                .setArraySlice(arraySlice),
+            stagingTexture, nvrhi::TextureSlice()
+                .setWidth(mipWidth)
+                .setHeight(pixelRowCount));
+
+        size = rowSize * rowCount;
+        upload.nextRow += rowCount;
+
+        if (upload.nextRow == numRows)
         {
-            for (uint32_t mipLevel = 0; mipLevel < texture->mipLevels; mipLevel++)
-            {
-                const TextureSubresourceData& layout = texture->dataLayout[arraySlice][mipLevel];
-
-                commandList->writeTexture(texture->texture, arraySlice, mipLevel, dataPointer + layout.dataOffset,
-                    layout.rowPitch, layout.depthPitch);
-            }
+            upload.nextRow = 0;
+            ++upload.nextSubresource;
         }
     }
 
+    upload.destinationState = nvrhi::ResourceStates::CopyDest;
+
+    m_BytesUploaded += size;
+    return size;
+}
+
+void TextureCache::EndTextureUpload(
+    TextureUpload& upload,
+    CommonRenderPasses* passes,
+    nvrhi::ICommandList* commandList)
+{
+    assert(upload.nextSubresource == upload.numSubresources);
+
+    const std::shared_ptr<TextureData>& texture = upload.texture;
+    nvrhi::ITexture* finalTexture = upload.finalTexture;
+    const nvrhi::TextureDesc& textureDesc = finalTexture->getDesc();
+
+    // The upload may have been recorded into other command lists, restore the state tracking.
+    // This is a no-op when the whole texture is finalized in one command list.
+    commandList->beginTrackingTextureState(upload.destination, nvrhi::AllSubresources, upload.destinationState);
+    if (upload.destination != finalTexture)
+        commandList->beginTrackingTextureState(finalTexture, nvrhi::AllSubresources, nvrhi::ResourceStates::Common);
+
+    if (upload.destination != finalTexture)
+    {
+        nvrhi::FramebufferHandle framebuffer = m_Device->createFramebuffer(nvrhi::FramebufferDesc()
+            .addColorAttachment(finalTexture));
+        
+        passes->BlitTexture(commandList, framebuffer, upload.destination);
+    }
+
     texture->data.reset();
 
     for (uint mipLevel = texture->mipLevels; mipLevel < textureDesc.mipLevels; mipLevel++)
     {
         nvrhi::FramebufferHandle framebuffer = m_Device->createFramebuffer(nvrhi::FramebufferDesc()
             .addColorAttachment(nvrhi::FramebufferAttachment()
-                .setTexture(texture->texture)
+                .setTexture(finalTexture)
                 .setArraySlice(0)
                 .setMipLevel(mipLevel)));
         
         BlitParameters blitParams;
-        blitParams.sourceTexture = texture->texture;
+        blitParams.sourceTexture = finalTexture;
         blitParams.sourceMip = mipLevel - 1;
         blitParams.targetFramebuffer = framebuffer;
         passes->BlitTexture(commandList, blitParams);
     }
 
-    commandList->setPermanentTextureState(texture->texture, nvrhi::ResourceStates::ShaderResource);
+    commandList->setPermanentTextureState(finalTexture, nvrhi::ResourceStates::ShaderResource);
     commandList->commitBarriers();
 
+    // Publish the texture only now that all of its copies and the final transition have been recorded
+    {
+        std::lock_guard<std::mutex> guard(m_TextureUploadMutex);
+        texture->texture = upload.finalTexture;
+    }
+
+    if (m_DescriptorTable)
+        texture->bindlessDescriptor = m_DescriptorTable->CreateDescriptorHandle(nvrhi::BindingSetItem::Texture_SRV(0, texture->texture));
+
     ++m_TexturesFinalized;
 }
 
@@ -517,6 +1190,7 @@ std::shared_ptr<LoadedTexture> TextureCache::LoadTextureFromFile(
     {
         if (FillTextureData(fileData, texture, path.extension().generic_string(), ""))
         {
+            FindTextureContentOwner(texture);
             TextureLoaded(texture);
 
             FinalizeTexture(texture, passes, commandList);
@@ -545,6 +1219,7 @@ std::shared_ptr<LoadedTexture> TextureCache::LoadTextureFromFileDeferred(
     {
         if (FillTextureData(fileData, texture, path.extension().generic_string(), ""))
         {
+            FindTextureContentOwner(texture);
             TextureLoaded(texture);
 
             std::lock_guard<std::mutex> guard(m_TexturesToFinalizeMutex);
@@ -572,13 +1247,13 @@ std::shared_ptr<LoadedTexture> TextureCache::LoadTextureFromFileAsync(
     texture->forceSRGB = sRGB;
     texture->path = path.generic_string();
 
-    executor.async([this, texture, path]()
+    auto decodeTexture = [this, texture, path](const std::shared_ptr<IBlob>& fileData)
     {
-        auto fileData = ReadTextureFile(path);
         if (fileData)
         {
             if (FillTextureData(fileData, texture, path.extension().generic_string(), ""))
             {
+                FindTextureContentOwner(texture);
                 TextureLoaded(texture);
 
                 std::lock_guard<std::mutex> guard(m_TexturesToFinalizeMutex);
@@ -588,7 +1263,30 @@ std::shared_ptr<LoadedTexture> TextureCache::LoadTextureFromFileAsync(
         }
 
         ++m_TexturesLoaded;
-    });
+    };
+
+    if (IsMappedTextureFile(path))
+    {
+        // mapping doesn't wait for the file contents, the pages are read when the data is accessed
+        executor.async([this, path, decodeTexture]()
+        {
+            decodeTexture(ReadTextureFile(path));
+        });
+    }
+    else
+    {
+        // read the file on an I/O thread and only occupy the executor with decoding
+        m_fs->readFileAsync(path, [this, path, decodeTexture, &executor](std::shared_ptr<IBlob> fileData)
+        {
+            if (!fileData)
+                log::message(m_ErrorLogSeverity, "Couldn't read texture file '%s'", path.generic_string().c_str());
+
+            executor.async([decodeTexture, fileData]()
+            {
+                decodeTexture(fileData);
+            });
+        });
+    }
 
     return texture;
 }
@@ -610,6 +1308,7 @@ std::shared_ptr<LoadedTexture> TextureCache::LoadTextureFromMemoryAsync(
         {
             if (FillTextureData(data, texture, "", mimeType))
             {
+                FindTextureContentOwner(texture);
                 TextureLoaded(texture);
 
                 std::lock_guard<std::mutex> guard(m_TexturesToFinalizeMutex);
@@ -640,6 +1339,7 @@ std::shared_ptr<LoadedTexture> TextureCache::LoadTextureFromMemory(
 
     if (FillTextureData(data, texture, "", mimeType))
     {
+        FindTextureContentOwner(texture);
         TextureLoaded(texture);
 
         FinalizeTexture(texture, passes, commandList);
@@ -664,6 +1364,7 @@ std::shared_ptr<LoadedTexture> TextureCache::LoadTextureFromMemoryDeferred(
 
     if (FillTextureData(data, texture, "", mimeType))
     {
+        FindTextureContentOwner(texture);
         TextureLoaded(texture);
 
         std::lock_guard<std::mutex> guard(m_TexturesToFinalizeMutex);
@@ -683,60 +1384,230 @@ std::shared_ptr<TextureData> TextureCache::GetLoadedTexture(std::filesystem::pat
 	return m_LoadedTextures[path.generic_string()];
 }
 
+nvrhi::ICommandList* TextureCache::GetUploadCommandList(bool copyQueue)
+{
+    nvrhi::CommandListHandle& commandList = copyQueue ? m_CopyCommandList : m_CommandList;
+
+    if (!commandList)
+    {
+        nvrhi::CommandListParameters params;
+        params.setQueueType(copyQueue ? nvrhi::CommandQueue::Copy : nvrhi::CommandQueue::Graphics);
+        if (m_UploadChunkSize)
+            params.setUploadChunkSize(m_UploadChunkSize);
+
+        commandList = m_Device->createCommandList(params);
+    }
+
+    return commandList;
+}
+
+nvrhi::IStagingTexture* TextureCache::AcquireStagingTexture(nvrhi::Format format, uint32_t width, uint32_t height)
+{
+    // Keep a few staging textures so that mapping one rarely waits for the copies of the previous frames.
+    // The ones that the command list being recorded copies from are never reused, grow the ring instead.
+    constexpr size_t c_MinStagingTextures = 3;
+
+    if (m_StagingTexturesRecorded == m_StagingTextures.size() || m_StagingTextures.size() < c_MinStagingTextures)
+        m_StagingTextures.insert(m_StagingTextures.begin() + m_NextStagingTexture, nullptr);
+
+    nvrhi::StagingTextureHandle& stagingTexture = m_StagingTextures[m_NextStagingTexture];
+    m_NextStagingTexture = (m_NextStagingTexture + 1) % m_StagingTextures.size();
+    ++m_StagingTexturesRecorded;
+
+    if (stagingTexture)
+    {
+        const nvrhi::TextureDesc& desc = stagingTexture->getDesc();
+
+        if (desc.format == format && desc.width >= width && desc.height >= height)
+            return stagingTexture;
+
+        if (desc.format == format)
+        {
+            width = std::max(width, desc.width);
+            height = std::max(height, desc.height);
+        }
+    }
+
+    nvrhi::TextureDesc stagingDesc;
+    stagingDesc.format = format;
+    stagingDesc.width = width;
+    stagingDesc.height = height;
+    stagingDesc.dimension = nvrhi::TextureDimension::Texture2D;
+    stagingDesc.debugName = "TextureCache staging";
+    stagingTexture = m_Device->createStagingTexture(stagingDesc, nvrhi::CpuAccessMode::Write);
+
+    return stagingTexture;
+}
+
 bool TextureCache::ProcessRenderingThreadCommands(CommonRenderPasses& passes, float timeLimitMilliseconds)
 {
     using namespace std::chrono;
 
     time_point<high_resolution_clock> startTime = high_resolution_clock::now();
 
+    const bool useCopyQueue = m_UseCopyQueue && m_Device->queryFeatureSupport(nvrhi::Feature::CopyQueue);
+
+    // Subresources are uploaded on the copy queue if enabled, or on the graphics queue otherwise
+    nvrhi::ICommandList* uploadCommandList = nullptr;
+
+    // Textures whose subresources have all been uploaded on the copy queue,
+    // to be finished on the graphics queue after the copies complete
+    std::vector<TextureUpload> uploadsToEnd;
+    std::vector<std::shared_ptr<TextureData>> duplicatesToFinalize;
+
+    // None of the staging textures is used by the command list that is about to be recorded
+    m_StagingTexturesRecorded = 0;
+
+    size_t bytesUploaded = 0;
     uint commandsExecuted = 0;
     while (true)
     {
-        std::shared_ptr<TextureData> pTexture;
-
-        if (timeLimitMilliseconds > 0 && commandsExecuted > 0)
+        if (commandsExecuted > 0)
         {
-            time_point<high_resolution_clock> now = high_resolution_clock::now();
-
-            if (float(duration_cast<microseconds>(now - startTime).count()) > timeLimitMilliseconds * 1e3f)
+            if (m_UploadBudgetBytes > 0 && bytesUploaded >= m_UploadBudgetBytes)
                 break;
+
+            if (timeLimitMilliseconds > 0)
+            {
+                time_point<high_resolution_clock> now = high_resolution_clock::now();
+
+                if (float(duration_cast<microseconds>(now - startTime).count()) > timeLimitMilliseconds * 1e3f)
+                    break;
+            }
         }
 
+        if (!m_CurrentUpload.texture)
         {
-            std::lock_guard<std::mutex> guard(m_TexturesToFinalizeMutex);
+            std::shared_ptr<TextureData> pTexture;
 
-            if (m_TexturesToFinalize.empty())
-                break;
+            {
+                std::lock_guard<std::mutex> guard(m_TexturesToFinalizeMutex);
+
+                if (m_TexturesToFinalize.empty())
+                    break;
+
+                pTexture = m_TexturesToFinalize.front();
+                m_TexturesToFinalize.pop();
+            }
 
-            pTexture = m_TexturesToFinalize.front();
-            m_TexturesToFinalize.pop();
+            if (!pTexture->data)
+                continue;
+
+            if (pTexture->contentOwner)
+            {
+                // Duplicates don't upload anything, but their owners might need to be finalized on the graphics queue
+                duplicatesToFinalize.push_back(pTexture);
+                commandsExecuted += 1;
+                continue;
+            }
+
+            // Skip the content owners that have been uploaded for their duplicates already
+            if (!ClaimTextureUpload(*pTexture))
+                continue;
+
+            commandsExecuted += 1;
+
+            if (!uploadCommandList)
+            {
+                uploadCommandList = GetUploadCommandList(useCopyQueue);
+                uploadCommandList->open();
+            }
+
+            m_CurrentUpload = BeginTextureUpload(pTexture, &passes, uploadCommandList);
+        }
+        else if (!uploadCommandList)
+        {
+            // Continue the upload started by a previous call, in a new command list
+            uploadCommandList = GetUploadCommandList(useCopyQueue);
+            uploadCommandList->open();
+            uploadCommandList->beginTrackingTextureState(m_CurrentUpload.destination, nvrhi::AllSubresources,
+                m_CurrentUpload.destinationState);
         }
 
-        if (pTexture->data)
+        if (m_CurrentUpload.nextSubresource < m_CurrentUpload.numSubresources)
         {
+            // Split the subresources larger than the budget into row ranges that fit into what's left of it
+            size_t maxBytes = 0;
+            if (m_UploadBudgetBytes > 0)
+                maxBytes = std::max(m_UploadBudgetBytes - std::min(bytesUploaded, m_UploadBudgetBytes), size_t(1));
+
+            bytesUploaded += UploadNextSubresource(m_CurrentUpload, uploadCommandList, maxBytes);
             commandsExecuted += 1;
+        }
+
+        if (m_CurrentUpload.nextSubresource == m_CurrentUpload.numSubresources)
+        {
+            if (useCopyQueue)
+                uploadsToEnd.push_back(std::move(m_CurrentUpload));
+            else
+                EndTextureUpload(m_CurrentUpload, &passes, uploadCommandList);
+
+            m_CurrentUpload = TextureUpload();
+        }
+    }
+
+    if (uploadCommandList)
+    {
+        uploadCommandList->close();
 
-            if (!m_CommandList)
+        if (useCopyQueue)
+        {
+            uint64_t instance = m_Device->executeCommandList(uploadCommandList, nvrhi::CommandQueue::Copy);
+            m_Device->queueWaitForCommandList(nvrhi::CommandQueue::Graphics, nvrhi::CommandQueue::Copy, instance);
+
+            // On DX12, resources used on the copy queue decay to the common state when the command list completes.
+            // Vulkan keeps the image layouts, so the textures are still in the copy destination state.
+            if (m_Device->getGraphicsAPI() == nvrhi::GraphicsAPI::D3D12)
             {
-                m_CommandList = m_Device->createCommandList();
+                for (TextureUpload& upload : uploadsToEnd)
+                    upload.destinationState = nvrhi::ResourceStates::Common;
+                
+                if (m_CurrentUpload.texture)
+                    m_CurrentUpload.destinationState = nvrhi::ResourceStates::Common;
             }
+        }
+        else
+        {
+            m_Device->executeCommandList(uploadCommandList);
+        }
+    }
 
-            m_CommandList->open();
+    if (!uploadsToEnd.empty() || !duplicatesToFinalize.empty())
+    {
+        nvrhi::ICommandList* graphicsCommandList = GetUploadCommandList(false);
+        graphicsCommandList->open();
 
-            FinalizeTexture(pTexture, &passes, m_CommandList);
+        for (TextureUpload& upload : uploadsToEnd)
+            EndTextureUpload(upload, &passes, graphicsCommandList);
 
-            m_CommandList->close();
-            m_Device->executeCommandList(m_CommandList);
-            m_Device->runGarbageCollection();
+        std::vector<std::shared_ptr<TextureData>> duplicatesToRetry;
+        for (const std::shared_ptr<TextureData>& texture : duplicatesToFinalize)
+        {
+            if (!FinalizeDuplicateTexture(texture, &passes, graphicsCommandList))
+                duplicatesToRetry.push_back(texture);
         }
+
+        graphicsCommandList->close();
+        m_Device->executeCommandList(graphicsCommandList);
+
+        // Try again in the next call, after the other thread has uploaded the owners
+        std::lock_guard<std::mutex> guard(m_TexturesToFinalizeMutex);
+        for (const std::shared_ptr<TextureData>& texture : duplicatesToRetry)
+            m_TexturesToFinalize.push(texture);
     }
 
+    if (commandsExecuted > 0)
+        m_Device->runGarbageCollection();
+
     return (commandsExecuted > 0);
 }
 
 void TextureCache::LoadingFinished()
 {
     m_CommandList = nullptr;
+    m_CopyCommandList = nullptr;
+    m_StagingTextures.clear();
+    m_NextStagingTexture = 0;
 }
 
 void TextureCache::SetMaxTextureSize(uint32_t size)
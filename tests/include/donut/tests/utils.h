@@ -34,5 +34,10 @@
 #define CHECK(condition) \
 	if (!(condition)) { throw std::runtime_error(std::string(__FILE__) + ':' + std::to_string(__LINE__) + ':' + __PRETTY_FUNCTION__); }
 
-
-
+namespace donut::test
+{
+	// Returns true if the DONUT_TEST_BENCHMARKS environment variable is set to anything but 0.
+	// The tests only run their timed benchmarks and print the results when it is,
+	// by default they only check correctness.
+	bool benchmarksEnabled();
+}
@@ -0,0 +1,721 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/core/chunk/chunk.h>
+#include <donut/core/chunk/chunkFile.h>
+#include <donut/core/log.h>
+#include <donut/core/vfs/VFS.h>
+
+#include <donut/tests/utils.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+using namespace donut;
+using namespace donut::math;
+
+// Procedural mesh set resembling a mesh cache: a displaced grid, split into several meshes
+struct TestMeshSet
+{
+	std::vector<float3> positions;
+	std::vector<uint32_t> normals;
+	std::vector<float2> texcoords;
+	std::vector<uint32_t> indices;
+	std::vector<chunk::MeshInfo> meshInfos;
+	std::vector<chunk::MeshInstance> instances;
+	std::vector<chunk::MeshNode> nodes;
+	chunk::MeshSet mset;
+
+	explicit TestMeshSet(uint32_t gridSize, uint32_t numMeshes = 4)
+	{
+		const uint32_t rowsPerMesh = gridSize / numMeshes;
+
+		nodes.resize(1);
+		nodes[0].name = "root";
+		nodes[0].parentId = ~0u;
+		nodes[0].siblingId = ~0u;
+		nodes[0].instanceId = 0;
+		nodes[0].transform = affine3::identity();
+		nodes[0].ctm = affine3::identity();
+
+		for (uint32_t mesh = 0; mesh < numMeshes; mesh++)
+		{
+			chunk::MeshInfo minfo{};
+			minfo.name = "grid";
+			minfo.materialName = (mesh & 1) ? "odd" : "even";
+			minfo.firstVertex = uint32_t(positions.size());
+			minfo.firstIndex = uint32_t(indices.size());
+			minfo.bbox = box3::empty();
+
+			for (uint32_t y = 0; y <= rowsPerMesh; y++)
+			{
+				for (uint32_t x = 0; x <= gridSize; x++)
+				{
+					float u = float(x) / float(gridSize);
+					float v = float(y + mesh * rowsPerMesh) / float(gridSize);
+					float3 position = float3(u, 0.1f * sinf(u * 20.f) * cosf(v * 13.f), v);
+					positions.push_back(position);
+					normals.push_back(vectorToSnorm8(normalize(float3(-cosf(u * 20.f), 1.f, sinf(v * 13.f)))));
+					texcoords.push_back(float2(u, v));
+					minfo.bbox |= position;
+				}
+			}
+
+			for (uint32_t y = 0; y < rowsPerMesh; y++)
+			{
+				for (uint32_t x = 0; x < gridSize; x++)
+				{
+					uint32_t i = y * (gridSize + 1) + x;
+					uint32_t quad[6] = { i, i + 1, i + gridSize + 1, i + 1, i + gridSize + 2, i + gridSize + 1 };
+					indices.insert(indices.end(), quad, quad + 6);
+				}
+			}
+
+			minfo.numVertices = uint32_t(positions.size()) - minfo.firstVertex;
+			minfo.numIndices = uint32_t(indices.size()) - minfo.firstIndex;
+			meshInfos.push_back(minfo);
+
+			chunk::MeshInstance instance{};
+			instance.name = "root";
+			instance.minfoId = mesh;
+			instance.nodeId = 0;
+			instance.transform = affine3::identity();
+			instance.bbox = minfo.bbox;
+			instances.push_back(instance);
+		}
+
+		mset.type = chunk::MeshSetBase::MESH;
+		mset.name = "test";
+		mset.streams.position = positions.data();
+		mset.streams.normal = normals.data();
+		mset.streams.texcoord0 = texcoords.data();
+		mset.nverts = uint32_t(positions.size());
+		mset.indices = indices.data();
+		mset.nindices = uint32_t(indices.size());
+		mset.meshInfos = meshInfos.data();
+		mset.nmeshInfos = uint32_t(meshInfos.size());
+		mset.instances = instances.data();
+		mset.ninstances = uint32_t(instances.size());
+		mset.nodes = nodes.data();
+		mset.nnodes = uint32_t(nodes.size());
+		mset.rootId = 0;
+	}
+
+	bool matches(const chunk::MeshSet& other) const
+	{
+		return other.nverts == mset.nverts
+			&& other.nindices == mset.nindices
+			&& other.nmeshInfos == mset.nmeshInfos
+			&& other.ninstances == mset.ninstances
+			&& other.nnodes == mset.nnodes
+			&& memcmp(other.streams.position, positions.data(), positions.size() * sizeof(float3)) == 0
+			&& memcmp(other.streams.normal, normals.data(), normals.size() * sizeof(uint32_t)) == 0
+			&& memcmp(other.streams.texcoord0, texcoords.data(), texcoords.size() * sizeof(float2)) == 0
+			&& memcmp(other.indices, indices.data(), indices.size() * sizeof(uint32_t)) == 0
+			&& other.meshInfos[1].numIndices == meshInfos[1].numIndices
+			&& strcmp(other.meshInfos[1].materialName, "odd") == 0
+			&& strcmp(other.nodes[0].name, "root") == 0;
+	}
+};
+
+// Serialized blobs are read-only: the corruption tests modify copies
+static std::shared_ptr<vfs::IBlob const> copy_blob(const vfs::IBlob& blob)
+{
+	void* data = malloc(blob.size());
+	memcpy(data, blob.data(), blob.size());
+	return std::make_shared<vfs::Blob>(data, blob.size());
+}
+
+static std::shared_ptr<chunk::MeshSet const> deserialize_mesh_set(const std::shared_ptr<vfs::IBlob const>& blob)
+{
+	return std::static_pointer_cast<chunk::MeshSet const>(chunk::deserialize(blob, "test"));
+}
+
+void test_chunk_compression()
+{
+	TestMeshSet meshSet(64);
+
+	std::vector<chunk::ChunkCodec> codecs = { chunk::ChunkCodec::None };
+#ifdef DONUT_WITH_LZ4
+	codecs.push_back(chunk::ChunkCodec::LZ4);
+#endif
+#ifdef DONUT_WITH_ZSTD
+	codecs.push_back(chunk::ChunkCodec::Zstd);
+#endif
+
+	size_t rawSize = 0;
+	for (chunk::ChunkCodec codec : codecs)
+	{
+		auto serialized = chunk::serialize(meshSet.mset, codec);
+		CHECK(serialized);
+
+		if (codec == chunk::ChunkCodec::None)
+			rawSize = serialized->size();
+		else
+			CHECK(serialized->size() < rawSize);
+
+		auto blob = copy_blob(*serialized);
+		auto loaded = deserialize_mesh_set(blob);
+		CHECK(loaded);
+		CHECK(meshSet.matches(*loaded));
+	}
+}
+
+void test_chunk_corruption()
+{
+	TestMeshSet meshSet(32);
+
+	int errors = 0;
+	log::SetCallback([&errors](log::Severity severity, char const*) { if (severity == log::Severity::Error) ++errors; });
+
+	for (chunk::ChunkCodec codec : { chunk::ChunkCodec::None, chunk::ChunkCodec::LZ4, chunk::ChunkCodec::Zstd })
+	{
+		auto serialized = chunk::serialize(meshSet.mset, codec);
+		CHECK(serialized);
+
+		// flip one byte in the middle of every chunk, which must be detected by the checksums
+		auto cfile = chunk::ChunkFile::deserialize(copy_blob(*serialized), "test");
+		CHECK(cfile);
+
+		std::vector<size_t> offsets;
+		for (auto const& chunk : cfile->getChunks())
+			offsets.push_back(chunk->offset);
+
+		for (size_t offset : offsets)
+		{
+			auto corrupt = copy_blob(*serialized);
+			((uint8_t*)corrupt->data())[offset + 1] ^= 0x40;
+
+			errors = 0;
+			CHECK(!deserialize_mesh_set(corrupt));
+			CHECK(errors > 0);
+		}
+
+		// truncated files must be rejected before any chunk is accessed
+		for (size_t size : { size_t(0), size_t(10), serialized->size() / 2, serialized->size() - 1 })
+		{
+			void* data = malloc(std::max(size, size_t(1)));
+			memcpy(data, serialized->data(), size);
+			auto truncated = std::make_shared<vfs::Blob>(data, size);
+			errors = 0;
+			CHECK(!deserialize_mesh_set(truncated));
+			CHECK(errors > 0);
+		}
+	}
+
+	log::ResetCallback();
+}
+
+void test_chunk_file_version_0x100()
+{
+	// header, one table entry and the payload, laid out like files written before chunk compression
+	const char payload[] = "version 0x100 chunk";
+
+	struct Entry
+	{
+		uint32_t chunkId, chunkType, chunkVersion;
+		size_t offset, size;
+	};
+
+	std::vector<uint8_t> file(20 + sizeof(Entry) + sizeof(payload));
+	uint32_t header[3] = { 0x100, 1, 20 };
+	memcpy(file.data(), "NVDACHNK", 8);
+	memcpy(file.data() + 8, header, sizeof(header));
+	Entry entry = { 1, 0x1234, 0x100, 20 + sizeof(Entry), sizeof(payload) };
+	memcpy(file.data() + 20, &entry, sizeof(entry));
+	memcpy(file.data() + 20 + sizeof(Entry), payload, sizeof(payload));
+
+	void* data = malloc(file.size());
+	memcpy(data, file.data(), file.size());
+	std::shared_ptr<vfs::IBlob const> blob = std::make_shared<vfs::Blob>(data, file.size());
+
+	auto cfile = chunk::ChunkFile::deserialize(blob, "test");
+	CHECK(cfile);
+
+	std::vector<chunk::Chunk const*> chunks;
+	cfile->getChunks(0x1234, chunks);
+	CHECK(chunks.size() == 1);
+	CHECK(chunks[0]->size == sizeof(payload));
+	CHECK(strcmp((char const*)chunks[0]->data, payload) == 0);
+	CHECK(cfile->getChunk(chunks[0]->chunkId) == chunks[0]);
+}
+
+std::filesystem::path bpath(DONUT_TEST_BINARY_DIR);
+
+static std::vector<chunk::ChunkCodec> get_supported_codecs()
+{
+	std::vector<chunk::ChunkCodec> codecs = { chunk::ChunkCodec::None };
+#ifdef DONUT_WITH_LZ4
+	codecs.push_back(chunk::ChunkCodec::LZ4);
+#endif
+#ifdef DONUT_WITH_ZSTD
+	codecs.push_back(chunk::ChunkCodec::Zstd);
+#endif
+	return codecs;
+}
+
+void test_chunk_materials()
+{
+	TestMeshSet meshSet(16);
+
+	// sets without a materials description have no materials chunk
+	auto loaded = deserialize_mesh_set(chunk::serialize(meshSet.mset));
+	CHECK(loaded);
+	CHECK(loaded->materials == nullptr);
+
+	const char* materials = "{ \"materials\": [ { \"name\": \"odd\" }, { \"name\": \"even\" } ] }";
+	meshSet.mset.materials = materials;
+
+	for (chunk::ChunkCodec codec : get_supported_codecs())
+	{
+		auto serialized = chunk::serialize(meshSet.mset, codec);
+		CHECK(serialized);
+
+		loaded = deserialize_mesh_set(copy_blob(*serialized));
+		CHECK(loaded);
+		CHECK(meshSet.matches(*loaded));
+		CHECK(loaded->materials && strcmp(loaded->materials, materials) == 0);
+	}
+}
+
+// Native file system that counts the bytes read from it.
+class CountingFileSystem : public vfs::NativeFileSystem
+{
+public:
+	std::atomic<int> numFileReads = 0;
+	std::atomic<size_t> bytesRead = 0;
+
+	std::shared_ptr<vfs::IBlob> readFile(const std::filesystem::path& name) override
+	{
+		++numFileReads;
+		return vfs::NativeFileSystem::readFile(name);
+	}
+
+	std::shared_ptr<vfs::IBlob> readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size) override
+	{
+		std::shared_ptr<vfs::IBlob> blob = vfs::NativeFileSystem::readFileRange(name, offset, size);
+		if (blob)
+			bytesRead += blob->size();
+		return blob;
+	}
+};
+
+void test_chunk_streaming()
+{
+	TestMeshSet meshSet(64);
+
+	auto fs = std::make_shared<CountingFileSystem>();
+	const std::filesystem::path filePath = bpath / "test_chunk_streaming.donutmesh";
+
+	for (chunk::ChunkCodec codec : get_supported_codecs())
+	{
+		auto serialized = chunk::serialize(meshSet.mset, codec);
+		CHECK(serialized);
+		CHECK(fs->writeFile(filePath, serialized->data(), serialized->size()));
+		fs->bytesRead = 0;
+
+		// opening the file only reads the header and the chunk table
+		std::shared_ptr<chunk::ChunkFile const> cfile = chunk::ChunkFile::open(fs, filePath);
+		CHECK(cfile);
+		CHECK(cfile->isStreaming());
+		CHECK(cfile->getResidentSize() == 0);
+		CHECK(fs->bytesRead < 1024);
+		CHECK(cfile->getChunks().size() > 1);
+
+		// the chunks of a mesh set are resident while the set is alive, and shared by all its users
+		auto loaded = std::static_pointer_cast<chunk::MeshSet const>(chunk::deserialize(cfile));
+		CHECK(loaded);
+		CHECK(meshSet.matches(*loaded));
+		size_t residentSize = cfile->getResidentSize();
+		CHECK(residentSize >= sizeof(float3) * meshSet.positions.size() + sizeof(uint32_t) * meshSet.indices.size());
+
+		size_t bytesRead = fs->bytesRead;
+		auto shared = std::static_pointer_cast<chunk::MeshSet const>(chunk::deserialize(cfile));
+		CHECK(shared);
+		CHECK(meshSet.matches(*shared));
+		CHECK(shared->streams.position == loaded->streams.position);
+		CHECK(cfile->getResidentSize() == residentSize);
+		CHECK(fs->bytesRead == bytesRead);
+
+		loaded.reset();
+		CHECK(cfile->getResidentSize() == residentSize);
+		shared.reset();
+		CHECK(cfile->getResidentSize() == 0);
+
+		// chunks are paged in again on demand, and their handles keep the file alive
+		chunk::ChunkId chunkId = cfile->getChunks()[0]->chunkId;
+		std::shared_ptr<chunk::Chunk const> chunk = cfile->acquireChunk(chunkId);
+		CHECK(chunk && chunk->data);
+		CHECK(cfile->acquireChunk(chunkId) == chunk);
+		CHECK(cfile->getResidentSize() == chunk->size);
+
+		std::weak_ptr<chunk::ChunkFile const> weakFile = cfile;
+		cfile.reset();
+		CHECK(!weakFile.expired());
+		chunk.reset();
+		CHECK(weakFile.expired());
+
+		CHECK(fs->numFileReads == 0);
+	}
+
+	// corrupt and truncated files are detected when the chunks are read
+	int errors = 0;
+	log::SetCallback([&errors](log::Severity severity, char const*) { if (severity == log::Severity::Error) ++errors; });
+
+	for (chunk::ChunkCodec codec : get_supported_codecs())
+	{
+		auto serialized = chunk::serialize(meshSet.mset, codec);
+		CHECK(serialized);
+
+		std::vector<uint8_t> data((uint8_t const*)serialized->data(), (uint8_t const*)serialized->data() + serialized->size());
+		size_t offset = chunk::ChunkFile::deserialize(serialized, "test")->getChunks().back()->offset;
+		data[offset + 1] ^= 0x40;
+		CHECK(fs->writeFile(filePath, data.data(), data.size()));
+
+		errors = 0;
+		auto cfile = chunk::ChunkFile::open(fs, filePath);
+		CHECK(cfile);
+		CHECK(!chunk::deserialize(cfile));
+		CHECK(errors > 0);
+		CHECK(cfile->getResidentSize() == 0);
+
+		CHECK(fs->writeFile(filePath, serialized->data(), offset));
+
+		errors = 0;
+		cfile = chunk::ChunkFile::open(fs, filePath);
+		CHECK(cfile);
+		CHECK(!chunk::deserialize(cfile));
+		CHECK(errors > 0);
+	}
+
+	errors = 0;
+	CHECK(!chunk::ChunkFile::open(fs, bpath / "test_chunk_missing.donutmesh"));
+	CHECK(errors > 0);
+
+	log::ResetCallback();
+
+	std::filesystem::remove(filePath);
+}
+
+// Rewrites a serialized mesh set with the instances chunk in its original 0x100 layout,
+// which has no padding between the chunk descriptor and the instances
+static std::shared_ptr<vfs::IBlob const> make_outdated_file(std::shared_ptr<vfs::IBlob const> const& serialized, chunk::ChunkCodec codec)
+{
+	const uint32_t instancesChunkType = 0x202; // CHUNKTYPE_MESH_INSTANCES
+
+	auto cfile = chunk::ChunkFile::deserialize(serialized, "test");
+	CHECK(cfile);
+
+	std::vector<std::vector<uint8_t>> payloads;
+	payloads.reserve(cfile->getChunks().size());
+
+	chunk::ChunkFile outdated;
+	outdated.setCompression(codec);
+	for (auto const& record : cfile->getChunks())
+	{
+		chunk::Chunk const* chunk = cfile->getChunk(record->chunkId);
+		CHECK(chunk);
+		uint8_t const* data = (uint8_t const*)chunk->data;
+
+		if (chunk->chunkType == instancesChunkType)
+		{
+			CHECK(chunk->chunkVersion == 0x101);
+			payloads.emplace_back(data, data + 4);
+			payloads.back().insert(payloads.back().end(), data + 8, data + chunk->size);
+			outdated.addChunk(chunk->chunkType, 0x100, payloads.back().data(), payloads.back().size());
+		}
+		else
+			outdated.addChunk(chunk->chunkType, chunk->chunkVersion, chunk->data, chunk->size);
+	}
+
+	return outdated.serialize();
+}
+
+void test_chunk_upgrade()
+{
+	TestMeshSet meshSet(64);
+
+	auto fs = std::make_shared<CountingFileSystem>();
+	const std::filesystem::path filePath = bpath / "test_chunk_upgrade.donutmesh";
+
+	for (chunk::ChunkCodec codec : get_supported_codecs())
+	{
+		auto outdated = make_outdated_file(chunk::serialize(meshSet.mset, codec), codec);
+		CHECK(outdated);
+
+		// outdated chunks are upgraded in memory when a blob is deserialized
+		auto loaded = std::static_pointer_cast<chunk::MeshSet const>(chunk::deserialize(outdated, "test"));
+		CHECK(loaded);
+		CHECK(meshSet.matches(*loaded));
+		CHECK(loaded->ninstances == meshSet.instances.size());
+		CHECK(loaded->instances[1].minfoId == 1);
+		CHECK(strcmp(loaded->instances[1].name, "root") == 0);
+		loaded.reset();
+
+		// and in the file when it is opened for streaming ; mappings of the old file stay valid
+		CHECK(fs->writeFile(filePath, outdated->data(), outdated->size()));
+		fs->setMappingThreshold(1);
+		std::shared_ptr<vfs::IBlob> mapped = fs->mapFile(filePath);
+		CHECK(mapped && mapped->size() == outdated->size());
+
+		auto cfile = chunk::open(fs, filePath);
+		CHECK(cfile);
+		CHECK(cfile->isStreaming());
+		CHECK(cfile->getOutdatedChunkCount() == 0);
+		CHECK(memcmp(mapped->data(), outdated->data(), outdated->size()) == 0);
+
+		auto reopened = chunk::ChunkFile::open(fs, filePath);
+		CHECK(reopened);
+		CHECK(reopened->getOutdatedChunkCount() == 0);
+		CHECK(reopened->getChunks().size() == cfile->getChunks().size());
+
+		loaded = std::static_pointer_cast<chunk::MeshSet const>(chunk::deserialize(cfile));
+		CHECK(loaded);
+		CHECK(meshSet.matches(*loaded));
+		CHECK(loaded->instances[1].minfoId == 1);
+
+		// up-to-date files are left untouched
+		auto mtime = std::filesystem::last_write_time(filePath);
+		CHECK(chunk::open(fs, filePath));
+		CHECK(std::filesystem::last_write_time(filePath) == mtime);
+		CHECK(!std::filesystem::exists(filePath.string() + ".tmp"));
+	}
+
+	std::filesystem::remove(filePath);
+
+	// upgrades are chained, and failures reject the file
+	int errors = 0;
+	log::SetCallback([&errors](log::Severity severity, char const*) { if (severity == log::Severity::Error) ++errors; });
+
+	chunk::ChunkFile::registerUpgrade(0x7000, 1, 2, [](chunk::Chunk const& chunk, std::vector<uint8_t>& result) {
+		result.assign((uint8_t const*)chunk.data, (uint8_t const*)chunk.data + chunk.size);
+		result.push_back(2);
+		return true;
+	});
+	chunk::ChunkFile::registerUpgrade(0x7000, 2, 3, [](chunk::Chunk const& chunk, std::vector<uint8_t>& result) {
+		result.assign((uint8_t const*)chunk.data, (uint8_t const*)chunk.data + chunk.size);
+		result.push_back(3);
+		return true;
+	});
+	chunk::ChunkFile::registerUpgrade(0x7001, 1, 2, [](chunk::Chunk const&, std::vector<uint8_t>&) { return false; });
+
+	errors = 0;
+	chunk::ChunkFile::registerUpgrade(0x7002, 2, 2, [](chunk::Chunk const&, std::vector<uint8_t>&) { return true; });
+	CHECK(errors == 1);
+
+	const uint8_t payload[] = { 1 };
+	{
+		chunk::ChunkFile file;
+		file.addChunk(0x7000, 1, payload, sizeof(payload));
+		file.addChunk(0x7003, 1, payload, sizeof(payload));
+		CHECK(file.getOutdatedChunkCount() == 1);
+
+		auto upgraded = file.upgrade();
+		CHECK(upgraded);
+		CHECK(upgraded->getOutdatedChunkCount() == 0);
+
+		chunk::Chunk const* chunk = upgraded->getChunks()[0].get();
+		CHECK(chunk->chunkVersion == 3);
+		CHECK(chunk->size == 3);
+		CHECK(memcmp(chunk->data, "\x01\x02\x03", 3) == 0);
+		CHECK(upgraded->getChunks()[1]->chunkVersion == 1);
+		CHECK(upgraded->getChunks()[1]->data == payload);
+	}
+	{
+		chunk::ChunkFile file;
+		file.addChunk(0x7000, 1, payload, sizeof(payload));
+		file.addChunk(0x7001, 1, payload, sizeof(payload));
+
+		errors = 0;
+		CHECK(!file.upgrade());
+		CHECK(errors > 0);
+	}
+
+	log::ResetCallback();
+}
+
+// Streams a set of mesh caches through a small working set: only the files in use are resident.
+// The benchmark uses larger mesh caches and prints the peak resident size and the time.
+void test_chunk_streaming_working_set()
+{
+	const bool benchmark = donut::test::benchmarksEnabled();
+	const int numFiles = 8;
+	const int workingSet = 2;
+
+	TestMeshSet meshSet(benchmark ? 256 : 32);
+	chunk::ChunkCodec codec = get_supported_codecs().back();
+	auto serialized = chunk::serialize(meshSet.mset, codec);
+	CHECK(serialized);
+
+	auto fs = std::make_shared<CountingFileSystem>();
+	std::vector<std::shared_ptr<chunk::ChunkFile const>> files;
+	for (int index = 0; index < numFiles; index++)
+	{
+		std::filesystem::path filePath = bpath / ("test_chunk_streaming" + std::to_string(index) + ".donutmesh");
+		CHECK(fs->writeFile(filePath, serialized->data(), serialized->size()));
+		files.push_back(chunk::ChunkFile::open(fs, filePath));
+		CHECK(files.back());
+	}
+
+	auto get_resident_size = [&files]() {
+		size_t size = 0;
+		for (auto const& file : files)
+			size += file->getResidentSize();
+		return size;
+	};
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	size_t peakSize = 0;
+	size_t totalSize = 0;
+	std::vector<std::shared_ptr<chunk::MeshSetBase const>> loaded(numFiles);
+	for (int index = 0; index < numFiles; index++)
+	{
+		if (index >= workingSet)
+			loaded[index - workingSet].reset();
+		loaded[index] = chunk::deserialize(files[index]);
+		CHECK(loaded[index]);
+		totalSize += files[index]->getResidentSize();
+		peakSize = std::max(peakSize, get_resident_size());
+	}
+	loaded.clear();
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	CHECK(get_resident_size() == 0);
+	CHECK(peakSize <= totalSize * workingSet / numFiles);
+
+	if (benchmark)
+	{
+		printf("Streamed %d mesh sets (%.1f MB): peak resident size %.1f MB, %.1f ms\n", numFiles,
+			double(totalSize) / (1024.0 * 1024.0), double(peakSize) / (1024.0 * 1024.0),
+			std::chrono::duration<double, std::milli>(endTime - startTime).count());
+	}
+
+	for (int index = 0; index < numFiles; index++)
+		std::filesystem::remove(bpath / ("test_chunk_streaming" + std::to_string(index) + ".donutmesh"));
+}
+
+void benchmark_chunk_compression()
+{
+	TestMeshSet meshSet(1024, 16);
+
+	std::vector<chunk::ChunkCodec> codecs = { chunk::ChunkCodec::None };
+#ifdef DONUT_WITH_LZ4
+	codecs.push_back(chunk::ChunkCodec::LZ4);
+#endif
+#ifdef DONUT_WITH_ZSTD
+	codecs.push_back(chunk::ChunkCodec::Zstd);
+#endif
+
+	char const* names[] = { "none", "LZ4", "Zstd" };
+
+	for (chunk::ChunkCodec codec : codecs)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		auto serialized = chunk::serialize(meshSet.mset, codec);
+		auto midTime = std::chrono::high_resolution_clock::now();
+
+		auto blob = copy_blob(*serialized);
+		auto copyTime = std::chrono::high_resolution_clock::now();
+		auto loaded = deserialize_mesh_set(blob);
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		CHECK(loaded);
+		CHECK(meshSet.matches(*loaded));
+
+		printf("MeshSet with %s compression: %6.1f MB, serialize %7.1f ms, deserialize %6.1f ms\n",
+			names[int(codec)], double(serialized->size()) / (1024.0 * 1024.0),
+			std::chrono::duration<double, std::milli>(midTime - startTime).count(),
+			std::chrono::duration<double, std::milli>(endTime - copyTime).count());
+	}
+}
+
+// Upgrades large mesh caches written with an outdated chunk layout: the files are read,
+// upgraded, compressed again and written back.
+void benchmark_chunk_upgrade()
+{
+	TestMeshSet meshSet(1024, 16);
+
+	auto fs = std::make_shared<CountingFileSystem>();
+	const std::filesystem::path filePath = bpath / "test_chunk_upgrade.donutmesh";
+
+	char const* names[] = { "none", "LZ4", "Zstd" };
+
+	for (chunk::ChunkCodec codec : get_supported_codecs())
+	{
+		auto outdated = make_outdated_file(chunk::serialize(meshSet.mset, codec), codec);
+		CHECK(outdated);
+		CHECK(fs->writeFile(filePath, outdated->data(), outdated->size()));
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		auto cfile = chunk::open(fs, filePath);
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		CHECK(cfile);
+		CHECK(cfile->getOutdatedChunkCount() == 0);
+
+		size_t size = 0;
+		for (auto const& chunk : cfile->getChunks())
+			size += chunk->size;
+
+		double seconds = std::chrono::duration<double>(endTime - startTime).count();
+		printf("Upgraded a %.1f MB mesh cache with %s compression: %7.1f ms, %7.1f MB/s\n",
+			double(size) / (1024.0 * 1024.0), names[int(codec)], seconds * 1000.0,
+			double(size) / (1024.0 * 1024.0) / seconds);
+
+		cfile.reset();
+		auto loaded = std::static_pointer_cast<chunk::MeshSet const>(chunk::deserialize(chunk::ChunkFile::open(fs, filePath)));
+		CHECK(loaded);
+		CHECK(meshSet.matches(*loaded));
+	}
+
+	std::filesystem::remove(filePath);
+}
+
+int main(int, char** argv)
+{
+	try
+	{
+		test_chunk_compression();
+		test_chunk_corruption();
+		test_chunk_file_version_0x100();
+		test_chunk_materials();
+		test_chunk_streaming();
+		test_chunk_streaming_working_set();
+		test_chunk_upgrade();
+
+		if (donut::test::benchmarksEnabled())
+		{
+			benchmark_chunk_compression();
+			benchmark_chunk_upgrade();
+		}
+	}
+	catch (const std::runtime_error & err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
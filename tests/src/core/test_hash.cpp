@@ -0,0 +1,76 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/core/hash.h>
+
+#include <donut/tests/utils.h>
+#include <cstring>
+#include <vector>
+
+using namespace donut;
+
+void test_xxh64()
+{
+	// reference values from the xxHash test suite
+	CHECK(hash::xxh64("", 0) == 0xEF46DB3751D8E999ull);
+	CHECK(hash::xxh64("a", 1) == 0xD24EC4F1A98C6E5Bull);
+	CHECK(hash::xxh64("abc", 3) == 0x44BC2CF5AD770999ull);
+	CHECK(hash::xxh64("Nobody inspects the spammish repetition", 39) == 0xFBCEA83C8A378BF1ull);
+
+	// long inputs go through the 4-lane loop and all tail paths
+	std::vector<uint8_t> data(1000);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = uint8_t(i * 31 + 7);
+
+	uint64_t h1 = hash::xxh64(data.data(), data.size());
+	uint64_t h2 = hash::xxh64(data.data(), data.size());
+	CHECK(h1 == h2);
+	CHECK(hash::xxh64(data.data(), data.size(), 1) != h1);
+	CHECK(hash::xxh64(data.data(), data.size() - 1) != h1);
+
+	data[517] ^= 1;
+	CHECK(hash::xxh64(data.data(), data.size()) != h1);
+}
+
+void test_xxh32()
+{
+	// reference values from the xxHash test suite
+	CHECK(hash::xxh32("", 0) == 0x02CC5D05u);
+	CHECK(hash::xxh32("a", 1) == 0x550D7456u);
+	CHECK(hash::xxh32("abc", 3) == 0x32D153FFu);
+	CHECK(hash::xxh32("Nobody inspects the spammish repetition", 39) == 0xE2293B2Fu);
+}
+
+int main(int, char** argv)
+{
+	try
+	{
+		test_xxh64();
+		test_xxh32();
+	}
+	catch (const std::runtime_error & err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
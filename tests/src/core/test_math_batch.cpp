@@ -0,0 +1,308 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/core/math/math.h>
+
+#include <donut/tests/utils.h>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace donut::math;
+
+// the batches are only split into tasks when they get an executor
+#ifdef DONUT_WITH_TASKFLOW
+static tf::Executor g_executor;
+static tf::Executor* const c_parallelExecutor = &g_executor;
+#else
+static tf::Executor* const c_parallelExecutor = nullptr;
+#endif
+
+// FMA contraction changes the rounding of the scalar code, which the SIMD code doesn't follow
+#if defined(__FMA__) || defined(__AVX2__)
+static constexpr float c_tolerance = 1e-5f;
+#else
+static constexpr float c_tolerance = 0.f;
+#endif
+
+static bool matches(const float* a, const float* b, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		if (c_tolerance == 0.f ? !(a[i] == b[i]) : !(std::abs(a[i] - b[i]) <= c_tolerance * std::max(1.f, std::abs(b[i]))))
+			return false;
+	}
+	return true;
+}
+
+static bool matches(const float3& a, const float3& b) { return matches(a.data(), b.data(), 3); }
+static bool matches(const box3& a, const box3& b) { return matches(a.m_mins, b.m_mins) && matches(a.m_maxs, b.m_maxs); }
+static bool matches(const affine3& a, const affine3& b) { return matches(a.m_linear.m_data, b.m_linear.m_data, 12); }
+static bool matches(const float4x4& a, const float4x4& b) { return matches(a.m_data, b.m_data, 16); }
+
+struct TestData
+{
+	std::vector<daffine3> daffines;
+	std::vector<affine3> affines;
+	std::vector<float4x4> matrices;
+	std::vector<float3> points;
+	std::vector<box3> boxes;
+
+	explicit TestData(size_t count)
+	{
+		std::mt19937 rng(11);
+		std::uniform_real_distribution<float> coord(-100.f, 100.f);
+		std::uniform_real_distribution<float> scale(0.5f, 2.f);
+		std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			quat q = normalize(quat(unit(rng), unit(rng), unit(rng), unit(rng)));
+			dquat dq = dquat(q);
+			double3 t = double3(coord(rng), coord(rng), coord(rng)) * 1000.0;
+			daffines.push_back(dq.toAffine() * translation(t));
+			affines.push_back(scaling(float3(scale(rng), scale(rng), scale(rng))) * q.toAffine() * translation(float3(t) * 0.001f));
+			matrices.push_back(affineToHomogeneous(affines.back()) * float4x4(
+				1.f, 0.f, 0.f, unit(rng),
+				0.f, 1.f, 0.f, unit(rng),
+				0.f, 0.f, 1.f, unit(rng),
+				0.f, 0.f, 0.f, 1.f));
+
+			float3 p = float3(coord(rng), coord(rng), coord(rng));
+			points.push_back(p);
+			boxes.push_back(box3(p, p + float3(scale(rng), scale(rng), scale(rng)) * 10.f));
+		}
+	}
+};
+
+void test_math_batch()
+{
+	// cover the SIMD groups and the scalar tails, and the parallel split for the largest size
+	for (size_t count : { size_t(0), size_t(1), size_t(3), size_t(4), size_t(7), size_t(64), size_t(100003) })
+	{
+		tf::Executor* executor = count > 1000 ? c_parallelExecutor : nullptr;
+		TestData data(count + 1);
+		const affine3& transform = data.affines[count];
+
+		std::vector<float3> points(count);
+		batch::transformPoints(transform, data.points.data(), points.data(), count, executor);
+		for (size_t i = 0; i < count; i++)
+			CHECK(matches(points[i], transform.transformPoint(data.points[i])));
+
+		std::vector<box3> boxes(count);
+		batch::transformBoxes(transform, data.boxes.data(), boxes.data(), count, executor);
+		for (size_t i = 0; i < count; i++)
+			CHECK(matches(boxes[i], data.boxes[i] * transform));
+
+		batch::transformBoxes(data.affines.data(), data.boxes.data(), boxes.data(), count, executor);
+		for (size_t i = 0; i < count; i++)
+			CHECK(matches(boxes[i], data.boxes[i] * data.affines[i]));
+
+		std::vector<affine3> affines(count);
+		batch::multiply(data.affines.data(), data.affines.data() + 1, affines.data(), count, executor);
+		for (size_t i = 0; i < count; i++)
+			CHECK(matches(affines[i], data.affines[i] * data.affines[i + 1]));
+
+		batch::multiply(data.affines.data(), transform, affines.data(), count, executor);
+		for (size_t i = 0; i < count; i++)
+			CHECK(matches(affines[i], data.affines[i] * transform));
+
+		std::vector<float4x4> matrices(count);
+		batch::multiply(data.matrices.data(), data.affines.data(), matrices.data(), count, executor);
+		for (size_t i = 0; i < count; i++)
+			CHECK(matches(matrices[i], data.matrices[i] * affineToHomogeneous(data.affines[i])));
+
+		batch::convert(data.daffines.data(), affines.data(), count, executor);
+		for (size_t i = 0; i < count; i++)
+		{
+			affine3 expected = affine3(data.daffines[i]);
+			CHECK(memcmp(&affines[i], &expected, sizeof(affine3)) == 0);
+		}
+
+		// write into every other float3x4 of a strided array
+		std::vector<float> columnMajor(count * 24, -1.f);
+		batch::affineToColumnMajor(data.affines.data(), columnMajor.data(), sizeof(float) * 24, count, executor);
+		for (size_t i = 0; i < count; i++)
+		{
+			float expected[12];
+			affineToColumnMajor(data.affines[i], expected);
+			CHECK(memcmp(&columnMajor[i * 24], expected, sizeof(expected)) == 0);
+			CHECK(columnMajor[i * 24 + 12] == -1.f && columnMajor[i * 24 + 23] == -1.f);
+		}
+
+		box3 expectedBounds = box3::empty();
+		for (size_t i = 0; i < count; i++)
+			expectedBounds |= data.points[i];
+		box3 bounds = batch::bounds(data.points.data(), count);
+		CHECK(all(bounds.m_mins == expectedBounds.m_mins) && all(bounds.m_maxs == expectedBounds.m_maxs));
+	}
+
+	// results may replace the inputs
+	{
+		TestData data(37);
+		const affine3& transform = data.affines[36];
+
+		std::vector<float3> points = data.points;
+		batch::transformPoints(transform, points.data(), points.data(), points.size());
+		for (size_t i = 0; i < points.size(); i++)
+			CHECK(matches(points[i], transform.transformPoint(data.points[i])));
+
+		std::vector<box3> boxes = data.boxes;
+		batch::transformBoxes(transform, boxes.data(), boxes.data(), boxes.size());
+		for (size_t i = 0; i < boxes.size(); i++)
+			CHECK(matches(boxes[i], data.boxes[i] * transform));
+
+		std::vector<affine3> affines = data.affines;
+		batch::multiply(affines.data(), affines.data(), affines.data(), affines.size());
+		for (size_t i = 0; i < affines.size(); i++)
+			CHECK(matches(affines[i], data.affines[i] * data.affines[i]));
+
+		std::vector<float4x4> matrices = data.matrices;
+		batch::multiply(matrices.data(), data.affines.data(), matrices.data(), matrices.size());
+		for (size_t i = 0; i < matrices.size(); i++)
+			CHECK(matches(matrices[i], data.matrices[i] * affineToHomogeneous(data.affines[i])));
+	}
+
+#ifdef DONUT_WITH_TASKFLOW
+	// calls from tasks that occupy every worker of the executor don't wait for nested tasks that cannot start
+	{
+		TestData data(100000);
+		const affine3& transform = data.affines[0];
+
+		tf::Executor executor(2);
+		std::vector<float3> points[2];
+		tf::Taskflow taskflow;
+		for (std::vector<float3>& result : points)
+		{
+			result.resize(data.points.size());
+			taskflow.emplace([&]() { batch::transformPoints(transform, data.points.data(), result.data(), result.size(), &executor); });
+		}
+		executor.run(taskflow).wait();
+
+		for (const std::vector<float3>& result : points)
+		{
+			for (size_t i = 0; i < result.size(); i++)
+				CHECK(matches(result[i], transform.transformPoint(data.points[i])));
+		}
+	}
+#endif
+}
+
+// best of several runs, in milliseconds
+template <typename F>
+static double measure_ms(F const& f)
+{
+	double best = 0.0;
+	for (int run = 0; run < 5; run++)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		f();
+		auto endTime = std::chrono::high_resolution_clock::now();
+		double time = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+		best = run == 0 ? time : std::min(best, time);
+	}
+	return best;
+}
+
+void benchmark_math_batch()
+{
+	// large enough to be split across threads, small enough to stay in the caches
+	const size_t count = 1 << 16;
+	TestData data(count);
+	const affine3 transform = data.affines[0];
+
+	std::vector<float3> points(count);
+	std::vector<box3> boxes(count);
+	std::vector<affine3> affines(count);
+	std::vector<float4x4> matrices(count);
+
+	auto report = [count](char const* name, double loop, double serial, double parallel) {
+		printf("%-34s per element: loop %5.2f ns, batch %5.2f ns (%4.1fx), parallel %5.2f ns (%4.1fx)\n", name,
+			loop * 1e6 / double(count), serial * 1e6 / double(count), loop / serial,
+			parallel * 1e6 / double(count), loop / parallel);
+	};
+
+	report("transformPoints (64K points)",
+		measure_ms([&]() { for (size_t i = 0; i < count; i++) points[i] = transform.transformPoint(data.points[i]); }),
+		measure_ms([&]() { batch::transformPoints(transform, data.points.data(), points.data(), count); }),
+		measure_ms([&]() { batch::transformPoints(transform, data.points.data(), points.data(), count, c_parallelExecutor); }));
+
+	report("transformBoxes (64K boxes)",
+		measure_ms([&]() { for (size_t i = 0; i < count; i++) boxes[i] = data.boxes[i] * transform; }),
+		measure_ms([&]() { batch::transformBoxes(transform, data.boxes.data(), boxes.data(), count); }),
+		measure_ms([&]() { batch::transformBoxes(transform, data.boxes.data(), boxes.data(), count, c_parallelExecutor); }));
+
+	report("multiply (64K affine pairs)",
+		measure_ms([&]() { for (size_t i = 0; i + 1 < count; i++) affines[i] = data.affines[i] * data.affines[i + 1]; }),
+		measure_ms([&]() { batch::multiply(data.affines.data(), data.affines.data() + 1, affines.data(), count - 1); }),
+		measure_ms([&]() { batch::multiply(data.affines.data(), data.affines.data() + 1, affines.data(), count - 1, c_parallelExecutor); }));
+
+	report("multiply (64K joint matrices)",
+		measure_ms([&]() { for (size_t i = 0; i < count; i++) matrices[i] = data.matrices[i] * affineToHomogeneous(data.affines[i]); }),
+		measure_ms([&]() { batch::multiply(data.matrices.data(), data.affines.data(), matrices.data(), count); }),
+		measure_ms([&]() { batch::multiply(data.matrices.data(), data.affines.data(), matrices.data(), count, c_parallelExecutor); }));
+
+	report("convert (64K double affines)",
+		measure_ms([&]() { for (size_t i = 0; i < count; i++) affines[i] = affine3(data.daffines[i]); }),
+		measure_ms([&]() { batch::convert(data.daffines.data(), affines.data(), count); }),
+		measure_ms([&]() { batch::convert(data.daffines.data(), affines.data(), count, c_parallelExecutor); }));
+
+	std::vector<float> columnMajor(count * 12);
+	report("affineToColumnMajor (64K affines)",
+		measure_ms([&]() { for (size_t i = 0; i < count; i++) affineToColumnMajor(data.affines[i], &columnMajor[i * 12]); }),
+		measure_ms([&]() { batch::affineToColumnMajor(data.affines.data(), columnMajor.data(), sizeof(float) * 12, count); }),
+		measure_ms([&]() { batch::affineToColumnMajor(data.affines.data(), columnMajor.data(), sizeof(float) * 12, count, c_parallelExecutor); }));
+
+	box3 scalarBounds = box3::empty();
+	box3 batchBounds = box3::empty();
+	double scalarTime = measure_ms([&]() { for (size_t i = 0; i < count; i++) scalarBounds |= data.points[i]; });
+	double batchTime = measure_ms([&]() { batchBounds = batch::bounds(data.points.data(), count); });
+	report("bounds (64K points)", scalarTime, batchTime, batchTime);
+
+	CHECK(all(scalarBounds.m_mins == batchBounds.m_mins) && all(scalarBounds.m_maxs == batchBounds.m_maxs));
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_math_batch();
+
+		if (donut::test::benchmarksEnabled())
+		{
+			benchmark_math_batch();
+		}
+	}
+	catch (const std::runtime_error & err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,277 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/core/math/math.h>
+
+#include <donut/tests/utils.h>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace donut::math;
+
+// Scalar reference implementations, evaluating the same operations as the generic templates
+
+static float4x4 reference_mul(const float4x4& a, const float4x4& b)
+{
+	float4x4 result = float4x4::zero();
+	for (int i = 0; i < 4; ++i)
+		for (int j = 0; j < 4; ++j)
+			for (int k = 0; k < 4; ++k)
+				result[i][j] += a[i][k] * b[k][j];
+	return result;
+}
+
+static affine3 reference_mul(const affine3& a, const affine3& b)
+{
+	affine3 result;
+	result.m_linear = float3x3::zero();
+	for (int i = 0; i < 3; ++i)
+		for (int j = 0; j < 3; ++j)
+			for (int k = 0; k < 3; ++k)
+				result.m_linear[i][j] += a.m_linear[i][k] * b.m_linear[k][j];
+	for (int j = 0; j < 3; ++j)
+		result.m_translation[j] = a.m_translation.x * b.m_linear[0][j] + a.m_translation.y * b.m_linear[1][j]
+			+ a.m_translation.z * b.m_linear[2][j] + b.m_translation[j];
+	return result;
+}
+
+static daffine3 reference_inverse(const daffine3& a)
+{
+	// the double path of the generic template
+	return inverse(a);
+}
+
+static float3x3 reference_to_matrix(const quat& q)
+{
+	float w = q.w, x = q.x, y = q.y, z = q.z;
+	return float3x3(
+		1 - 2*(y*y + z*z), 2*(x*y + z*w), 2*(x*z - y*w),
+		2*(x*y - z*w), 1 - 2*(x*x + z*z), 2*(y*z + x*w),
+		2*(x*z + y*w), 2*(y*z - x*w), 1 - 2*(x*x + y*y));
+}
+
+static box3 reference_transform(const box3& b, const affine3& transform)
+{
+	box3 result;
+	result.m_mins = transform.m_translation;
+	result.m_maxs = transform.m_translation;
+	for (int i = 0; i < 3; i++)
+	{
+		float3 e = b.m_mins[i] * transform.m_linear[i];
+		float3 f = b.m_maxs[i] * transform.m_linear[i];
+		result.m_mins += min(e, f);
+		result.m_maxs += max(e, f);
+	}
+	return result;
+}
+
+// FMA contraction changes the rounding of the scalar code, which the SIMD code doesn't follow
+#if defined(__FMA__) || defined(__AVX2__)
+static constexpr float c_exactTolerance = 1e-5f;
+#else
+static constexpr float c_exactTolerance = 0.f;
+#endif
+
+template <typename T>
+static bool matches(const T* a, const T* b, int count, float tolerance)
+{
+	for (int i = 0; i < count; i++)
+	{
+		if (tolerance == 0.f ? !(a[i] == b[i]) : !(std::abs(a[i] - b[i]) <= tolerance * std::max(1.f, std::abs(b[i]))))
+			return false;
+	}
+	return true;
+}
+
+static bool matches(const affine3& a, const affine3& b, float tolerance)
+{
+	return matches(a.m_linear.m_data, b.m_linear.m_data, 9, tolerance)
+		&& matches(a.m_translation.data(), b.m_translation.data(), 3, tolerance);
+}
+
+struct TestData
+{
+	std::vector<affine3> affines;
+	std::vector<float4x4> matrices;
+	std::vector<quat> rotations;
+	std::vector<box3> boxes;
+
+	explicit TestData(size_t count)
+	{
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> coord(-100.f, 100.f);
+		std::uniform_real_distribution<float> scale(0.5f, 2.f);
+		std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			quat q = normalize(quat(unit(rng), unit(rng), unit(rng), unit(rng)));
+			float3 s = float3(scale(rng), scale(rng), scale(rng));
+			float3 t = float3(coord(rng), coord(rng), coord(rng));
+			affines.push_back(scaling(s) * q.toAffine() * translation(t));
+			matrices.push_back(affineToHomogeneous(affines.back()) * perspProjD3DStyle(1.f, 1.5f, 0.1f, 1000.f));
+			rotations.push_back(q);
+
+			float3 mins = float3(coord(rng), coord(rng), coord(rng));
+			boxes.push_back(box3(mins, mins + float3(scale(rng), scale(rng), scale(rng)) * 10.f));
+		}
+	}
+};
+
+void test_math_simd()
+{
+#if DM_SIMD
+	printf("SIMD math enabled (%s)\n",
+#if defined(__AVX__)
+		"AVX"
+#else
+		"SSE2"
+#endif
+	);
+#else
+	printf("SIMD math disabled\n");
+#endif
+
+	TestData data(1000);
+
+	for (size_t i = 0; i + 1 < data.affines.size(); i++)
+	{
+		const affine3& a = data.affines[i];
+		const affine3& b = data.affines[i + 1];
+
+		float4x4 m = data.matrices[i] * data.matrices[i + 1];
+		float4x4 mref = reference_mul(data.matrices[i], data.matrices[i + 1]);
+		CHECK(matches(m.m_data, mref.m_data, 16, c_exactTolerance));
+
+		CHECK(matches(a * b, reference_mul(a, b), c_exactTolerance));
+
+		affine3 c = a;
+		c *= b;
+		CHECK(matches(c, reference_mul(a, b), c_exactTolerance));
+
+		float3x3 r = data.rotations[i].toMatrix();
+		float3x3 rref = reference_to_matrix(data.rotations[i]);
+		CHECK(matches(r.m_data, rref.m_data, 9, c_exactTolerance));
+
+		box3 bb = data.boxes[i] * a;
+		box3 bbref = reference_transform(data.boxes[i], a);
+		CHECK(matches(bb.m_mins.data(), bbref.m_mins.data(), 3, c_exactTolerance));
+		CHECK(matches(bb.m_maxs.data(), bbref.m_maxs.data(), 3, c_exactTolerance));
+
+		// the inverse is within 1e-5 of the double precision inverse, relative to its largest element
+		affine3 inv = inverse(a);
+		affine3 invref = affine3(reference_inverse(daffine3(a)));
+		float largest = 0.f;
+		for (float e : invref.m_linear.m_data)
+			largest = std::max(largest, std::abs(e));
+		for (int j = 0; j < 9; j++)
+			CHECK(std::abs(inv.m_linear.m_data[j] - invref.m_linear.m_data[j]) <= 1e-5f * largest);
+		float translationScale = largest * length(a.m_translation);
+		for (int j = 0; j < 3; j++)
+			CHECK(std::abs(inv.m_translation[j] - invref.m_translation[j]) <= 1e-5f * translationScale);
+
+		CHECK(isnear(a * inv, affine3::identity(), 1e-3f));
+	}
+
+	// in-place products read both operands before writing
+	affine3 a = data.affines[0];
+	a = a * a;
+	CHECK(matches(a, reference_mul(data.affines[0], data.affines[0]), c_exactTolerance));
+
+	// singular transforms still produce NaNs
+	affine3 singular = scaling(float3(1.f, 0.f, 1.f)) * data.affines[0];
+	CHECK(!isfinite(inverse(singular)));
+
+	// degenerate boxes transform to points
+	box3 point = box3(float3(1.f, 2.f, 3.f), float3(1.f, 2.f, 3.f)) * data.affines[0];
+	CHECK(matches(point.m_mins.data(), point.m_maxs.data(), 3, 0.f));
+}
+
+template <typename F>
+static double measure_ns(size_t count, int repeats, F const& f)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeats; r++)
+		for (size_t i = 0; i + 1 < count; i++)
+			f(i);
+	auto endTime = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::nano>(endTime - startTime).count() / double(repeats * (count - 1));
+}
+
+void benchmark_math_simd()
+{
+	const size_t count = 4096;
+	const int repeats = 200;
+	TestData data(count);
+
+	float sink = 0.f;
+
+	auto report = [](char const* name, double scalar, double simd) {
+		printf("%-24s scalar %6.2f ns, simd %6.2f ns, %4.1fx\n", name, scalar, simd, scalar / simd);
+	};
+
+	report("float4x4 * float4x4",
+		measure_ns(count, repeats, [&](size_t i) { sink += reference_mul(data.matrices[i], data.matrices[i + 1]).m33; }),
+		measure_ns(count, repeats, [&](size_t i) { sink += (data.matrices[i] * data.matrices[i + 1]).m33; }));
+
+	report("affine3 * affine3",
+		measure_ns(count, repeats, [&](size_t i) { sink += reference_mul(data.affines[i], data.affines[i + 1]).m_translation.z; }),
+		measure_ns(count, repeats, [&](size_t i) { sink += (data.affines[i] * data.affines[i + 1]).m_translation.z; }));
+
+	report("inverse(affine3)",
+		measure_ns(count, repeats, [&](size_t i) {
+			affine3 const& a = data.affines[i];
+			float3x3 m = inverse(float3x3(a.m_linear));
+			sink += (-a.m_translation * m).z; }),
+		measure_ns(count, repeats, [&](size_t i) { sink += inverse(data.affines[i]).m_translation.z; }));
+
+	report("quat::toMatrix",
+		measure_ns(count, repeats, [&](size_t i) { sink += reference_to_matrix(data.rotations[i]).m22; }),
+		measure_ns(count, repeats, [&](size_t i) { sink += data.rotations[i].toMatrix().m22; }));
+
+	report("box3 * affine3",
+		measure_ns(count, repeats, [&](size_t i) { sink += reference_transform(data.boxes[i], data.affines[i]).m_maxs.z; }),
+		measure_ns(count, repeats, [&](size_t i) { sink += (data.boxes[i] * data.affines[i]).m_maxs.z; }));
+
+	CHECK(std::isfinite(sink));
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_math_simd();
+
+		if (donut::test::benchmarksEnabled())
+		{
+			benchmark_math_simd();
+		}
+	}
+	catch (const std::runtime_error & err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -21,13 +21,44 @@
 */
 
 #include <donut/core/vfs/VFS.h>
+#include <donut/core/vfs/CachingFileSystem.h>
+#include <donut/core/vfs/TarFile.h>
+#include <donut/core/vfs/Compression.h>
+#include <donut/core/vfs/PackFile.h>
+#ifdef DONUT_WITH_MINIZ
+#include <donut/core/vfs/ZipFile.h>
+#endif
 
 #include <donut/tests/utils.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <regex>
+#include <thread>
+
+#ifdef DONUT_WITH_LZ4
+#include <lz4frame.h>
+#endif
+
+#ifdef DONUT_WITH_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+#ifdef DONUT_WITH_MINIZ
+#include <miniz.h>
+#include <miniz_zip.h>
+#endif
 
 using namespace donut;
 
 std::filesystem::path rpath(DONUT_TEST_SOURCE_DIR);
+std::filesystem::path bpath(DONUT_TEST_BINARY_DIR);
 
 void test_native_filesystem()
 {
@@ -74,6 +105,61 @@ void test_native_filesystem()
 		std::string data = (char const*)blob->data();
 		CHECK(data.find("***HELLO WORLD***")!=std::string::npos);
 	}
+
+	// mapFile
+	{
+		std::shared_ptr<vfs::IBlob> blob = fs.readFile(rpath / "src/core/test_vfs.cpp");
+		std::shared_ptr<vfs::IBlob> mapped = fs.mapFile(rpath / "src/core/test_vfs.cpp");
+		CHECK(mapped != nullptr);
+		CHECK(std::dynamic_pointer_cast<vfs::MappedFileBlob>(mapped) != nullptr);
+		CHECK(mapped->size() == blob->size());
+		CHECK(memcmp(mapped->data(), blob->data(), blob->size()) == 0);
+
+		CHECK(fs.mapFile(rpath / "dummy") == nullptr);
+	}
+
+	// writeFileAtomic : concurrent writers of the same file use their own temporary files
+	{
+		const std::filesystem::path filePath = bpath / "test_vfs_atomic.bin";
+		const size_t fileSize = 64 * 1024;
+		std::atomic<int> numWritten = 0;
+
+		std::vector<std::thread> threads;
+		for (int thread = 0; thread < 8; thread++)
+		{
+			threads.emplace_back([&fs, &filePath, &numWritten, thread]()
+			{
+				std::vector<uint8_t> data(fileSize, uint8_t(thread + 1));
+				for (int write = 0; write < 16; write++)
+				{
+					if (fs.writeFileAtomic(filePath, data.data(), data.size()))
+						++numWritten;
+				}
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+
+		// renaming over an open file can fail on Windows, but some writes must succeed
+#ifdef WIN32
+		CHECK(numWritten > 0);
+#else
+		CHECK(numWritten == 8 * 16);
+#endif
+
+		std::shared_ptr<vfs::IBlob> blob = fs.readFile(filePath);
+		CHECK(blob && blob->size() == fileSize);
+		const uint8_t* data = (const uint8_t*)blob->data();
+		CHECK(std::all_of(data, data + fileSize, [data](uint8_t value) { return value == data[0]; }));
+
+		for (const auto& entry : std::filesystem::directory_iterator(bpath))
+		{
+			std::string name = entry.path().filename().string();
+			CHECK(name == "test_vfs_atomic.bin" || name.find("test_vfs_atomic.bin") == std::string::npos);
+		}
+
+		std::filesystem::remove(filePath);
+	}
 }
 
 void test_relative_filesystem()
@@ -171,12 +257,1295 @@ void test_root_filesystem()
 		CHECK(data.find("***HELLO WORLD***") != std::string::npos);
 	}
 
+	// nested mount points: the deepest one is used
+	{
+		rootFS.mount("/nested/src", rpath / "src");
+		rootFS.mount("/nested", rpath);
+		rootFS.mount("/nested/include", rpath / "include"); // already covered by /nested
+		CHECK(rootFS.fileExists("/nested/src/core/test_vfs.cpp") == true);
+		CHECK(rootFS.fileExists("/nested/CMakeLists.txt") == true);
+		CHECK(rootFS.fileExists("/nested/src/src/core/test_vfs.cpp") == false);
+		CHECK(rootFS.fileExists("nested/CMakeLists.txt") == false);
+		CHECK(rootFS.fileExists("/nest/CMakeLists.txt") == false);
+		CHECK(rootFS.unmount("/nested/include") == false);
+		CHECK(rootFS.unmount("/nested/src") == true);
+		CHECK(rootFS.fileExists("/nested/src/core/test_vfs.cpp") == true);
+		CHECK(rootFS.unmount("/nested/") == true);
+		CHECK(rootFS.fileExists("/nested/CMakeLists.txt") == false);
+	}
+
 	// unmount
 	CHECK(rootFS.unmount("/foo") == false);
 	CHECK(rootFS.unmount("/tests") == true);
 	CHECK(rootFS.unmount("/foo") == false);
 }
 
+void test_file_search_pattern()
+{
+	// the matcher gives the same results as the regular expression
+	const std::vector<std::pair<std::string, std::vector<std::string>>> patterns = {
+		{ "", { ".txt" } },
+		{ "data", { } },
+		{ "data/", { ".txt", ".bin" } },
+		{ "/data/sub", { ".txt" } },
+		{ "data/*", { ".txt" } },
+		{ "*/sub", { ".t?t" } },
+		{ "d?ta", { ".*" } },
+		{ "data", { "s.txt" } },
+	};
+	const std::vector<std::string> names = {
+		"a.txt", ".txt", "b.bin", "data/a.txt", "data/.txt", "data/b.bin", "data/c", "data/sub/a.txt",
+		"data/sub/b.tat", "data/sub/c.tt", "data/sub/deep/d.txt", "dta/a.b", "daata/a.b", "dta/a.", "data/s.txt", "data/xs.txt"
+	};
+	for (const auto& [path, extensions] : patterns)
+	{
+		vfs::FileSearchPattern pattern(path, extensions);
+		std::regex regex(vfs::getFileSearchRegex(std::filesystem::path(path).relative_path(), extensions));
+		for (const std::string& name : names)
+			CHECK(pattern.match(name) == std::regex_match(name, regex));
+	}
+
+	// directory index
+	vfs::DirectoryIndex index;
+	for (const std::string& name : names)
+		index.addFile(name);
+	index.addFile("data/a.txt");
+	index.addDirectory("empty/folder");
+	index.finalize();
+
+	CHECK(index.directoryExists(""));
+	CHECK(index.directoryExists("data/sub/deep"));
+	CHECK(index.directoryExists("/data/sub/"));
+	CHECK(index.directoryExists("empty"));
+	CHECK(!index.directoryExists("data/a.txt"));
+	CHECK(!index.directoryExists("dummy"));
+
+	std::vector<std::string> result;
+	CHECK(index.enumerateDirectories("", vfs::enumerate_to_vector(result)) == 4);
+	CHECK((result == std::vector<std::string>{ "daata", "data", "dta", "empty" }));
+
+	result.clear();
+	CHECK(index.enumerateDirectories("data", vfs::enumerate_to_vector(result)) == 1);
+	CHECK((result == std::vector<std::string>{ "sub" }));
+	CHECK(index.enumerateDirectories("dummy", vfs::enumerate_to_vector(result)) == vfs::status::PathNotFound);
+
+	result.clear();
+	CHECK(index.enumerateFiles(vfs::FileSearchPattern("data", { ".txt" }), vfs::enumerate_to_vector(result)) == 3);
+	CHECK((result == std::vector<std::string>{ "a.txt", "s.txt", "xs.txt" }));
+
+	result.clear();
+	CHECK(index.enumerateFiles(vfs::FileSearchPattern("*", { ".b" }), vfs::enumerate_to_vector(result)) == 2);
+	CHECK((result == std::vector<std::string>{ "a.b", "a.b" }));
+}
+
+void test_async_reads()
+{
+	// requests are started in the order of priority, then submission
+	{
+		std::unique_ptr<vfs::IAsyncReadQueue> queue = vfs::IAsyncReadQueue::create(1);
+		CHECK(queue->getNumThreads() == 1);
+
+		std::promise<void> blocker;
+		std::shared_future<void> blocked = blocker.get_future().share();
+		std::mutex mutex;
+		std::vector<int> order;
+
+		queue->submit([blocked]() { blocked.wait(); });
+		for (int index = 0; index < 6; index++)
+		{
+			const vfs::ReadPriority priority = vfs::ReadPriority(index % 3);
+			queue->submit([&mutex, &order, index]()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				order.push_back(index);
+			}, priority);
+		}
+		blocker.set_value();
+
+		while (true)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (order.size() == 6)
+				break;
+		}
+		CHECK((order == std::vector<int>{ 2, 5, 1, 4, 0, 3 }));
+	}
+
+	// reads through the mount points
+	{
+		std::shared_ptr<vfs::NativeFileSystem> nativeFS = std::make_shared<vfs::NativeFileSystem>();
+		vfs::RootFileSystem rootFS;
+		rootFS.mount("/tests", std::make_shared<vfs::RelativeFileSystem>(nativeFS, rpath));
+
+		std::future<std::shared_ptr<vfs::IBlob>> future = rootFS.readFileAsync("/tests/src/core/test_vfs.cpp", vfs::ReadPriority::High);
+		std::shared_ptr<vfs::IBlob> expected = nativeFS->readFile(rpath / "src/core/test_vfs.cpp");
+		std::shared_ptr<vfs::IBlob> blob = future.get();
+		CHECK(blob != nullptr);
+		CHECK(expected != nullptr);
+		CHECK(blob->size() == expected->size());
+		CHECK(memcmp(blob->data(), expected->data(), blob->size()) == 0);
+
+		CHECK(rootFS.readFileAsync("/tests/dummy.txt").get() == nullptr);
+		CHECK(rootFS.readFileAsync("/foo/test_vfs.cpp").get() == nullptr);
+
+		std::atomic<int> numCompleted = 0;
+		std::atomic<int> numFound = 0;
+		std::vector<vfs::AsyncReadRequest> requests;
+		for (const char* name : { "/tests/src/core/test_vfs.cpp", "/tests/src/utils.cpp", "/tests/dummy.txt", "/foo/bar" })
+		{
+			requests.push_back(vfs::AsyncReadRequest{ name, [&](std::shared_ptr<vfs::IBlob> blob)
+			{
+				if (blob)
+					++numFound;
+				++numCompleted;
+			}});
+		}
+		rootFS.readFilesAsync(std::move(requests));
+
+		while (numCompleted < 4)
+			std::this_thread::yield();
+		CHECK(numFound == 2);
+	}
+}
+
+// Writes a ustar header and the data of one file into the archive.
+static void write_tar_entry(std::ofstream& archive, const std::string& name, const void* data, size_t size)
+{
+	char header[512] = {};
+	snprintf(header, 100, "%s", name.c_str());
+	snprintf(header + 100, 8, "0000644");
+	snprintf(header + 124, 12, "%011llo", (unsigned long long)size);
+	header[156] = '0';
+	memcpy(header + 257, "ustar", 6);
+	archive.write(header, sizeof(header));
+
+	archive.write(static_cast<const char*>(data), std::streamsize(size));
+
+	std::vector<char> padding(((size + 511) & ~size_t(511)) - size);
+	archive.write(padding.data(), std::streamsize(padding.size()));
+}
+
+static void write_tar_trailer(std::ofstream& archive)
+{
+	char trailer[1024] = {};
+	archive.write(trailer, sizeof(trailer));
+}
+
+// Writes a minimal ustar archive with 'numFiles' files of 'fileSize' bytes each, named "data/file<N>.bin".
+// Every byte of file N is equal to (N & 0xff).
+static void write_test_tar_archive(const std::filesystem::path& archivePath, int numFiles, size_t fileSize)
+{
+	std::ofstream archive(archivePath, std::ios::binary);
+	CHECK(archive.is_open());
+
+	std::vector<char> fileData(fileSize);
+	for (int index = 0; index < numFiles; index++)
+	{
+		memset(fileData.data(), index & 0xff, fileSize);
+		write_tar_entry(archive, "data/file" + std::to_string(index) + ".bin", fileData.data(), fileSize);
+	}
+
+	write_tar_trailer(archive);
+}
+
+void test_tar_file()
+{
+	const bool benchmark = donut::test::benchmarksEnabled();
+	const int numFiles = 64;
+	const size_t fileSize = benchmark ? 1024 * 1024 : 64 * 1024;
+	const std::filesystem::path archivePath = bpath / "test_vfs_archive.tar";
+
+	write_test_tar_archive(archivePath, numFiles, fileSize);
+
+	{
+		vfs::TarFile tarFile(archivePath);
+		CHECK(tarFile.isOpen());
+		CHECK(tarFile.folderExists("data") == true);
+		CHECK(tarFile.fileExists("data/file0.bin") == true);
+		CHECK(tarFile.fileExists("data/dummy.bin") == false);
+		CHECK(tarFile.readFile("data/dummy.bin") == nullptr);
+
+		std::shared_ptr<vfs::IBlob> blob = tarFile.readFile("data/file3.bin");
+		CHECK(blob != nullptr);
+		CHECK(blob->size() == fileSize);
+		CHECK(static_cast<const char*>(blob->data())[0] == 3);
+		CHECK(static_cast<const char*>(blob->data())[fileSize - 1] == 3);
+
+		// Read every file in the archive from several threads at once, the reads don't take a lock.
+		// The benchmark reads them several times from a varying number of threads and prints the throughput,
+		// which should scale with the thread count.
+		const int numPasses = benchmark ? 4 : 1;
+		const uint32_t maxThreads = std::min(std::max(std::thread::hardware_concurrency(), 1u), 16u);
+		for (uint32_t numThreads = benchmark ? 1 : maxThreads; numThreads <= maxThreads; numThreads *= 2)
+		{
+			std::atomic<int> nextRead = 0;
+			std::atomic<bool> errors = false;
+
+			auto startTime = std::chrono::high_resolution_clock::now();
+
+			std::vector<std::thread> threads;
+			for (uint32_t thread = 0; thread < numThreads; thread++)
+			{
+				threads.emplace_back([&]()
+				{
+					int read;
+					while ((read = nextRead++) < numFiles * numPasses)
+					{
+						const int index = read % numFiles;
+						std::shared_ptr<vfs::IBlob> data = tarFile.readFile("data/file" + std::to_string(index) + ".bin");
+						if (!data || data->size() != fileSize || static_cast<const char*>(data->data())[fileSize / 2] != char(index & 0xff))
+							errors = true;
+					}
+				});
+			}
+
+			for (std::thread& thread : threads)
+				thread.join();
+
+			CHECK(!errors);
+
+			if (benchmark)
+			{
+				auto endTime = std::chrono::high_resolution_clock::now();
+				const double seconds = std::chrono::duration<double>(endTime - startTime).count();
+				const double megabytes = double(fileSize * numFiles * numPasses) / (1024.0 * 1024.0);
+
+				printf("TarFile::readFile with %2u thread(s): %8.1f MB/s\n", numThreads, megabytes / seconds);
+			}
+		}
+	}
+
+	std::filesystem::remove(archivePath);
+}
+
+static bool check_range(const std::shared_ptr<vfs::IBlob>& blob, const void* expected, size_t size)
+{
+	return blob != nullptr && blob->size() == size && (size == 0 || memcmp(blob->data(), expected, size) == 0);
+}
+
+void test_read_file_range()
+{
+	std::shared_ptr<vfs::NativeFileSystem> nativeFS = std::make_shared<vfs::NativeFileSystem>();
+	std::shared_ptr<vfs::IBlob> file = nativeFS->readFile(rpath / "src/core/test_vfs.cpp");
+	CHECK(file != nullptr);
+	const char* fileData = static_cast<const char*>(file->data());
+	const size_t fileSize = file->size();
+
+	vfs::RootFileSystem rootFS;
+	rootFS.mount("/tests", std::make_shared<vfs::RelativeFileSystem>(nativeFS, rpath));
+
+	for (vfs::IFileSystem* fs : { static_cast<vfs::IFileSystem*>(nativeFS.get()), static_cast<vfs::IFileSystem*>(&rootFS) })
+	{
+		const std::filesystem::path name = (fs == &rootFS) ? "/tests/src/core/test_vfs.cpp" : rpath / "src/core/test_vfs.cpp";
+
+		CHECK(check_range(fs->readFileRange(name, 0, 16), fileData, 16));
+		CHECK(check_range(fs->readFileRange(name, 100, 1000), fileData + 100, 1000));
+		CHECK(check_range(fs->readFileRange(name, fileSize - 10, 1000), fileData + fileSize - 10, 10));
+		CHECK(check_range(fs->readFileRange(name, fileSize, 1000), nullptr, 0));
+		CHECK(fs->readFileRange(name, fileSize + 1, 1000) == nullptr);
+
+		uint64_t size = 0;
+		CHECK(fs->getFileSize(name, size));
+		CHECK(size == fileSize);
+	}
+	CHECK(rootFS.readFileRange("/tests/dummy.txt", 0, 16) == nullptr);
+	uint64_t missingSize = 0;
+	CHECK(!rootFS.getFileSize("/tests/dummy.txt", missingSize));
+	CHECK(!rootFS.getFileSize("/tests/src", missingSize));
+
+	const std::filesystem::path archivePath = bpath / "test_vfs_archive.tar";
+	write_test_tar_archive(archivePath, 4, 10000);
+	{
+		vfs::TarFile tarFile(archivePath);
+		std::vector<char> expected(10000, 3);
+		CHECK(check_range(tarFile.readFileRange("data/file3.bin", 9000, 5000), expected.data(), 1000));
+		CHECK(check_range(tarFile.readFileRange("data/file3.bin", 0, 10), expected.data(), 10));
+		CHECK(tarFile.readFileRange("data/file3.bin", 10001, 10) == nullptr);
+		CHECK(tarFile.readFileRange("data/dummy.bin", 0, 10) == nullptr);
+
+		uint64_t size = 0;
+		CHECK(tarFile.getFileSize("data/file3.bin", size));
+		CHECK(size == 10000);
+		CHECK(!tarFile.getFileSize("data/dummy.bin", size));
+	}
+	std::filesystem::remove(archivePath);
+}
+
+// Native file system that counts the calls that reach it.
+class CountingFileSystem : public vfs::NativeFileSystem
+{
+public:
+	std::atomic<int> numReads = 0;
+	std::atomic<int> numExistenceChecks = 0;
+	std::atomic<uint64_t> numRangeBytes = 0;
+	int readDelayMilliseconds = 0;
+
+	bool fileExists(const std::filesystem::path& name) override
+	{
+		++numExistenceChecks;
+		return vfs::NativeFileSystem::fileExists(name);
+	}
+
+	std::shared_ptr<vfs::IBlob> readFile(const std::filesystem::path& name) override
+	{
+		++numReads;
+		if (readDelayMilliseconds)
+			std::this_thread::sleep_for(std::chrono::milliseconds(readDelayMilliseconds));
+		return vfs::NativeFileSystem::readFile(name);
+	}
+
+	std::shared_ptr<vfs::IBlob> readFileRange(const std::filesystem::path& name, uint64_t offset, size_t size) override
+	{
+		std::shared_ptr<vfs::IBlob> blob = vfs::NativeFileSystem::readFileRange(name, offset, size);
+		if (blob)
+			numRangeBytes += blob->size();
+		return blob;
+	}
+};
+
+void test_caching_filesystem()
+{
+	const std::filesystem::path folder = bpath / "test_vfs_cache";
+	std::filesystem::create_directories(folder);
+
+	const size_t fileSize = 1000;
+	for (int index = 0; index < 4; index++)
+	{
+		std::vector<char> data(fileSize, char(index));
+		std::ofstream file(folder / ("file" + std::to_string(index) + ".bin"), std::ios::binary);
+		file.write(data.data(), std::streamsize(data.size()));
+	}
+
+	auto countingFS = std::make_shared<CountingFileSystem>();
+	auto cachingFS = std::make_shared<vfs::CachingFileSystem>(std::make_shared<vfs::RelativeFileSystem>(countingFS, folder), 3 * fileSize);
+
+	// read-through and hits
+	{
+		std::shared_ptr<vfs::IBlob> blob = cachingFS->readFile("file0.bin");
+		std::vector<char> expected(fileSize, 0);
+		CHECK(check_range(blob, expected.data(), expected.size()));
+		CHECK(cachingFS->readFile("./file0.bin") == blob);
+		CHECK(cachingFS->fileExists("file0.bin"));
+		CHECK(countingFS->numReads == 1);
+		CHECK(countingFS->numExistenceChecks == 0);
+
+		std::shared_ptr<vfs::IBlob> range = cachingFS->readFileRange("file0.bin", 10, 20);
+		CHECK(check_range(range, expected.data(), 20));
+		CHECK(countingFS->numReads == 1);
+
+		vfs::CachingFileSystem::Statistics statistics = cachingFS->getStatistics();
+		CHECK(statistics.hits == 2);
+		CHECK(statistics.misses == 1);
+		CHECK(statistics.cachedFiles == 1);
+		CHECK(statistics.cachedBytes == fileSize);
+	}
+
+	// negative caching
+	{
+		CHECK(cachingFS->fileExists("file0.bin.lz4") == false);
+		CHECK(cachingFS->fileExists("file0.bin.lz4") == false);
+		CHECK(cachingFS->readFile("file0.bin.lz4") == nullptr);
+		CHECK(countingFS->numExistenceChecks == 1);
+		CHECK(countingFS->numReads == 1);
+		CHECK(cachingFS->getStatistics().negativeHits == 2);
+
+		// writes through the cache invalidate the missing status
+		const char text[] = "hello";
+		CHECK(cachingFS->writeFile("file0.bin.lz4", text, sizeof(text)));
+		CHECK(cachingFS->fileExists("file0.bin.lz4") == true);
+		CHECK(check_range(cachingFS->readFile("file0.bin.lz4"), text, sizeof(text)));
+		std::filesystem::remove(folder / "file0.bin.lz4");
+		cachingFS->invalidate("file0.bin.lz4");
+	}
+
+	// LRU eviction
+	{
+		cachingFS->resetStatistics();
+		const int readsBefore = countingFS->numReads;
+		CHECK(cachingFS->readFile("file1.bin") != nullptr);
+		CHECK(cachingFS->readFile("file2.bin") != nullptr);
+		CHECK(cachingFS->readFile("file0.bin") != nullptr); // file0 becomes the most recent
+		CHECK(cachingFS->readFile("file3.bin") != nullptr); // evicts file1
+		CHECK(countingFS->numReads == readsBefore + 3);
+
+		vfs::CachingFileSystem::Statistics statistics = cachingFS->getStatistics();
+		CHECK(statistics.evictions == 1);
+		CHECK(statistics.cachedFiles == 3);
+		CHECK(statistics.cachedBytes == 3 * fileSize);
+
+		CHECK(cachingFS->readFile("file0.bin") != nullptr);
+		CHECK(countingFS->numReads == readsBefore + 3);
+		CHECK(cachingFS->readFile("file1.bin") != nullptr);
+		CHECK(countingFS->numReads == readsBefore + 4);
+
+		cachingFS->setBudget(fileSize);
+		CHECK(cachingFS->getStatistics().cachedFiles == 1);
+		cachingFS->setBudget(fileSize - 1);
+		CHECK(cachingFS->getStatistics().cachedFiles == 0);
+		CHECK(cachingFS->readFile("file1.bin") != nullptr); // too large to be cached
+		CHECK(cachingFS->getStatistics().cachedFiles == 0);
+		cachingFS->setBudget(3 * fileSize);
+	}
+
+	// prefetch
+	{
+		cachingFS->clear();
+		cachingFS->resetStatistics();
+		const int readsBefore = countingFS->numReads;
+
+		cachingFS->prefetch({ "file0.bin", "file1.bin", "file2.bin", "file0.bin", "dummy.bin" });
+		std::vector<char> expected(fileSize, 2);
+		CHECK(check_range(cachingFS->readFile("file2.bin"), expected.data(), expected.size()));
+		cachingFS->waitForPrefetches();
+		CHECK(countingFS->numReads == readsBefore + 4);
+
+		CHECK(cachingFS->readFile("file0.bin") != nullptr);
+		CHECK(cachingFS->readFile("file1.bin") != nullptr);
+		CHECK(cachingFS->readFileAsync("file1.bin").get() != nullptr);
+		CHECK(countingFS->numReads == readsBefore + 4);
+
+		vfs::CachingFileSystem::Statistics statistics = cachingFS->getStatistics();
+		CHECK(statistics.prefetches == 3);
+		CHECK(statistics.hits == 4);
+		CHECK(statistics.misses == 0);
+	}
+
+	// the cache waits for the callbacks of the reads in flight when it is destroyed
+	{
+		auto slowFS = std::make_shared<CountingFileSystem>();
+		slowFS->readDelayMilliseconds = 20;
+		auto slowCache = std::make_shared<vfs::CachingFileSystem>(std::make_shared<vfs::RelativeFileSystem>(slowFS, folder), 3 * fileSize);
+
+		std::atomic<int> numCompleted = 0;
+		std::vector<vfs::AsyncReadRequest> requests;
+		for (int index = 0; index < 3; index++)
+		{
+			requests.push_back({ "file" + std::to_string(index) + ".bin", [&numCompleted](std::shared_ptr<vfs::IBlob> blob)
+			{
+				if (blob)
+					++numCompleted;
+			} });
+		}
+		slowCache->readFilesAsync(std::move(requests));
+		slowCache.reset();
+		CHECK(numCompleted == 3);
+	}
+
+	cachingFS.reset();
+	std::filesystem::remove_all(folder);
+}
+
+#ifdef __linux__
+// Returns the amount of anonymous (heap) memory resident in the process, excluding file-backed pages.
+static double get_anonymous_rss_megabytes()
+{
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line))
+	{
+		if (line.rfind("RssAnon:", 0) == 0)
+			return double(std::stoull(line.substr(8))) / 1024.0;
+	}
+	return 0.0;
+}
+#endif
+
+void test_mapped_files()
+{
+	const std::filesystem::path archivePath = bpath / "test_vfs_archive.tar";
+	write_test_tar_archive(archivePath, 4, 100000);
+	{
+		vfs::TarFile tarFile(archivePath);
+		std::vector<char> expected(100000, 2);
+
+		std::shared_ptr<vfs::IBlob> blob = tarFile.mapFile("data/file2.bin");
+		CHECK(dynamic_cast<vfs::BlobView*>(blob.get()) != nullptr);
+		CHECK(check_range(blob, expected.data(), expected.size()));
+		CHECK(tarFile.mapFile("data/dummy.bin") == nullptr);
+
+		CHECK(dynamic_cast<vfs::BlobView*>(tarFile.readFile("data/file2.bin").get()) == nullptr);
+		tarFile.setMappingThreshold(50000);
+		blob = tarFile.readFile("data/file2.bin");
+		CHECK(dynamic_cast<vfs::BlobView*>(blob.get()) != nullptr);
+		CHECK(check_range(blob, expected.data(), expected.size()));
+	}
+	std::filesystem::remove(archivePath);
+
+	// Read a large file with and without mapping and touch every byte.
+	// The mapped path doesn't copy the file into the heap, the pages are read from the OS file cache on access.
+	// The benchmark uses a larger file and prints the throughput and the heap growth of both paths.
+	const bool benchmark = donut::test::benchmarksEnabled();
+	const std::filesystem::path filePath = bpath / "test_vfs_large.bin";
+	const size_t fileSize = size_t(benchmark ? 256 : 4) * 1024 * 1024;
+	{
+		std::vector<uint64_t> data(fileSize / sizeof(uint64_t));
+		for (size_t i = 0; i < data.size(); i++)
+			data[i] = i;
+		std::ofstream file(filePath, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(fileSize));
+	}
+
+	vfs::NativeFileSystem nativeFS;
+	for (bool mapped : { true, false })
+	{
+		nativeFS.setMappingThreshold(mapped ? 1024 * 1024 : 0);
+#ifdef __linux__
+		const double startRss = get_anonymous_rss_megabytes();
+#endif
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		std::shared_ptr<vfs::IBlob> blob = nativeFS.readFile(filePath);
+		CHECK(blob != nullptr);
+		CHECK(blob->size() == fileSize);
+		CHECK((dynamic_cast<vfs::MappedFileBlob*>(blob.get()) != nullptr) == mapped);
+
+		const uint64_t* values = static_cast<const uint64_t*>(blob->data());
+		uint64_t sum = 0;
+		for (size_t i = 0; i < fileSize / sizeof(uint64_t); i++)
+			sum += values[i];
+		const uint64_t count = fileSize / sizeof(uint64_t);
+		CHECK(sum == count * (count - 1) / 2);
+
+		if (!benchmark)
+			continue;
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		const double seconds = std::chrono::duration<double>(endTime - startTime).count();
+		printf("NativeFileSystem::readFile %s: %8.1f MB/s", mapped ? "mapped" : "copied", double(fileSize) / (1024.0 * 1024.0) / seconds);
+#ifdef __linux__
+		printf(", anonymous RSS +%.0f MB", get_anonymous_rss_megabytes() - startRss);
+#endif
+		printf("\n");
+	}
+
+	std::filesystem::remove(filePath);
+}
+
+#if defined(DONUT_WITH_MINIZ) || (defined(DONUT_WITH_LZ4) && defined(DONUT_WITH_ZSTD))
+// Reads the Donut headers and sources to use as typical compressible data, returns the total size.
+static size_t read_source_corpus(std::vector<std::vector<char>>& corpus)
+{
+	size_t corpusSize = 0;
+	for (const char* folder : { "include", "src" })
+	{
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(rpath.parent_path() / folder))
+		{
+			if (!entry.is_regular_file())
+				continue;
+
+			std::ifstream file(entry.path(), std::ios::binary);
+			corpus.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			corpusSize += corpus.back().size();
+		}
+	}
+	CHECK(!corpus.empty());
+	return corpusSize;
+}
+#endif
+
+void test_pack_file()
+{
+	const std::filesystem::path packPath = bpath / "test_vfs_archive.pak";
+	const std::string text = "Hello, pack!";
+	std::vector<uint8_t> binary(1024 * 1024);
+	for (size_t i = 0; i < binary.size(); i++)
+		binary[i] = uint8_t((i / 13) * 7);
+
+	{
+		vfs::PackWriter writer(packPath);
+		CHECK(writer.isOpen());
+		CHECK(writer.addFile("root.txt", text.data(), text.size()));
+		CHECK(writer.addFile("data/a.txt", text.data(), text.size()));
+		CHECK(writer.addFile("data/sub/b.bin", binary.data(), binary.size(), vfs::PackCompression::None));
+#ifdef DONUT_WITH_LZ4
+		CHECK(writer.addFile("data/sub/c.bin", binary.data(), binary.size(), vfs::PackCompression::LZ4));
+#endif
+#ifdef DONUT_WITH_ZSTD
+		CHECK(writer.addFile("data/sub/d.bin", binary.data(), binary.size(), vfs::PackCompression::Zstd));
+#endif
+		CHECK(writer.addFile("data/a.txt", text.data(), text.size()) == false);
+		CHECK(writer.finish());
+	}
+
+	{
+		vfs::PackFile packFile(packPath);
+		CHECK(packFile.isOpen());
+		CHECK(packFile.fileExists("root.txt") == true);
+		CHECK(packFile.fileExists("/data/a.txt") == true);
+		CHECK(packFile.fileExists("data/dummy.txt") == false);
+		CHECK(packFile.fileExists("data/sub") == false);
+		CHECK(packFile.folderExists("data/sub") == true);
+		CHECK(packFile.folderExists("data/a.txt") == false);
+		CHECK(packFile.readFile("data/dummy.txt") == nullptr);
+		CHECK(packFile.writeFile("data/dummy.txt", text.data(), text.size()) == false);
+
+		std::shared_ptr<vfs::IBlob> blob = packFile.readFile("data/a.txt");
+		CHECK(blob != nullptr);
+		CHECK(blob->size() == text.size());
+		CHECK(memcmp(blob->data(), text.data(), text.size()) == 0);
+
+		std::vector<std::string> names = { "data/sub/b.bin" };
+#ifdef DONUT_WITH_LZ4
+		names.push_back("data/sub/c.bin");
+#endif
+#ifdef DONUT_WITH_ZSTD
+		names.push_back("data/sub/d.bin");
+#endif
+		for (const std::string& name : names)
+		{
+			blob = packFile.readFile(name);
+			CHECK(blob != nullptr);
+			CHECK(blob->size() == binary.size());
+			CHECK(memcmp(blob->data(), binary.data(), binary.size()) == 0);
+
+			CHECK(check_range(packFile.readFileRange(name, 0, 100), binary.data(), 100));
+			CHECK(check_range(packFile.readFileRange(name, 5000, 70000), binary.data() + 5000, 70000));
+			CHECK(check_range(packFile.readFileRange(name, binary.size() - 5, 100), binary.data() + binary.size() - 5, 5));
+			CHECK(packFile.readFileRange(name, binary.size() + 1, 100) == nullptr);
+		}
+
+		std::vector<std::string> result;
+		CHECK(packFile.enumerateFiles("data", { ".txt" }, vfs::enumerate_to_vector(result)) == 1);
+		CHECK(result.size() == 1 && result[0] == "a.txt");
+		result.clear();
+		CHECK(packFile.enumerateFiles("data/sub", { }, vfs::enumerate_to_vector(result)) == int(names.size()));
+		result.clear();
+		CHECK(packFile.enumerateDirectories("data", vfs::enumerate_to_vector(result)) == 1);
+		CHECK(result.size() == 1 && result[0] == "sub");
+	}
+
+	// Open an archive with many small files and look up every file.
+	// The benchmark uses more files and prints the times, TarFile reads every header on open, PackFile only reads the footer.
+	{
+		const bool benchmark = donut::test::benchmarksEnabled();
+		const int numFiles = benchmark ? 20000 : 2000;
+		const std::filesystem::path tarPath = bpath / "test_vfs_archive.tar";
+		{
+			std::ofstream archive(tarPath, std::ios::binary);
+			vfs::PackWriter writer(packPath, 512);
+			for (int index = 0; index < numFiles; index++)
+			{
+				const std::string name = "files/" + std::to_string(index % 100) + "/file" + std::to_string(index) + ".txt";
+				write_tar_entry(archive, name, name.data(), name.size());
+				CHECK(writer.addFile(name, name.data(), name.size()));
+			}
+			write_tar_trailer(archive);
+		}
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		vfs::TarFile tarFile(tarPath);
+		auto tarOpenTime = std::chrono::high_resolution_clock::now();
+		vfs::PackFile packFile(packPath);
+		auto packOpenTime = std::chrono::high_resolution_clock::now();
+
+		CHECK(tarFile.isOpen());
+		CHECK(packFile.isOpen());
+		for (int index = 0; index < numFiles; index++)
+			CHECK(packFile.fileExists("files/" + std::to_string(index % 100) + "/file" + std::to_string(index) + ".txt"));
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		if (benchmark)
+		{
+			printf("Opening an archive with %d files: TarFile %.2f ms, PackFile %.3f ms; %d PackFile lookups %.2f ms\n", numFiles,
+				std::chrono::duration<double, std::milli>(tarOpenTime - startTime).count(),
+				std::chrono::duration<double, std::milli>(packOpenTime - tarOpenTime).count(), numFiles,
+				std::chrono::duration<double, std::milli>(endTime - packOpenTime).count());
+		}
+
+		std::filesystem::remove(tarPath);
+	}
+
+	// not a pack archive
+	{
+		std::ofstream file(packPath, std::ios::binary);
+		file << "This is not a pack archive, it's just text.";
+	}
+	CHECK(vfs::PackFile(packPath).isOpen() == false);
+
+	// crafted table of contents sizes and entry offsets that overflow when added to the offsets
+	auto write_pack = [&packPath, &text](uint32_t numEntries, uint64_t entryOffset)
+	{
+		{
+			vfs::PackWriter writer(packPath, 16);
+			CHECK(writer.addFile("root.txt", text.data(), text.size()));
+			CHECK(writer.finish());
+		}
+
+		struct { uint64_t tocOffset; uint32_t numEntries, namesSize, version, magic; } footer;
+		std::fstream file(packPath, std::ios::binary | std::ios::in | std::ios::out);
+		file.seekg(-int(sizeof(footer)), std::ios::end);
+		const uint64_t footerOffset = uint64_t(file.tellg());
+		file.read(reinterpret_cast<char*>(&footer), sizeof(footer));
+		if (entryOffset)
+		{
+			file.seekp(std::streamoff(footer.tocOffset + 8));
+			file.write(reinterpret_cast<const char*>(&entryOffset), sizeof(entryOffset));
+		}
+		if (numEntries)
+		{
+			footer.numEntries = numEntries;
+			footer.tocOffset = footerOffset - (uint64_t(numEntries) * 48 + footer.namesSize);
+		}
+		file.seekp(std::streamoff(footerOffset));
+		file.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+	};
+
+	write_pack(0, 0);
+	CHECK(vfs::PackFile(packPath).readFile("root.txt") != nullptr);
+	write_pack(0x10000000, 0);
+	CHECK(vfs::PackFile(packPath).isOpen() == false);
+	write_pack(0, uint64_t(-8));
+	{
+		vfs::PackFile packFile(packPath);
+		CHECK(packFile.isOpen());
+		CHECK(packFile.readFile("root.txt") == nullptr);
+		CHECK(packFile.readFileRange("root.txt", 0, 1) == nullptr);
+	}
+
+	std::filesystem::remove(packPath);
+}
+
+void test_archive_enumeration()
+{
+	// Enumerate the files in one directory and with a wildcard path, and compare with matching every name
+	// with the regular expression. The benchmark uses an archive with 100k files and prints the times.
+	const bool benchmark = donut::test::benchmarksEnabled();
+	const std::filesystem::path packPath = bpath / "test_vfs_enumeration.pak";
+	const int numDirectories = benchmark ? 100 : 50;
+	const int numFilesPerDirectory = benchmark ? 1000 : 100;
+	std::vector<std::string> names;
+	{
+		vfs::PackWriter writer(packPath, 16);
+		for (int directory = 0; directory < numDirectories; directory++)
+		{
+			for (int index = 0; index < numFilesPerDirectory; index++)
+			{
+				const char* extension = (index % 4) == 0 ? ".dds" : ".png";
+				names.push_back("textures/set" + std::to_string(directory) + "/file" + std::to_string(index) + extension);
+				CHECK(writer.addFile(names.back(), extension, 1));
+			}
+		}
+		CHECK(writer.finish());
+	}
+
+	vfs::PackFile packFile(packPath);
+	CHECK(packFile.isOpen());
+
+	auto time = [](const std::function<void()>& function)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		function();
+		auto endTime = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	};
+
+	int numFound = 0;
+	auto count = [&numFound](std::string_view) { ++numFound; };
+
+	const double indexTime = time([&]() { CHECK(packFile.enumerateFiles("textures/set7", { ".dds" }, count) == numFilesPerDirectory / 4); });
+	const double directoryTime = time([&]() { CHECK(packFile.enumerateFiles("textures/set42", { ".dds" }, count) == numFilesPerDirectory / 4); });
+	const double wildcardTime = time([&]() { CHECK(packFile.enumerateFiles("textures/*", { ".dds" }, count) == numDirectories * numFilesPerDirectory / 4); });
+
+	const double regexTime = time([&]()
+	{
+		std::regex regex(vfs::getFileSearchRegex("textures/*", { ".dds" }));
+		int numMatches = 0;
+		for (const std::string& name : names)
+			if (std::regex_match(name, regex))
+				++numMatches;
+		CHECK(numMatches == numDirectories * numFilesPerDirectory / 4);
+	});
+
+	if (benchmark)
+	{
+		printf("Enumerating an archive with %d files: first call with index creation %.2f ms, one directory %.3f ms, "
+			"wildcard path %.2f ms; std::regex scan %.2f ms\n",
+			numDirectories * numFilesPerDirectory, indexTime, directoryTime, wildcardTime, regexTime);
+	}
+
+	std::filesystem::remove(packPath);
+}
+
+#ifdef DONUT_WITH_LZ4
+void test_compression_layer()
+{
+	std::shared_ptr<vfs::NativeFileSystem> nativeFS = std::make_shared<vfs::NativeFileSystem>();
+	vfs::CompressionLayer compressionLayer(std::make_shared<vfs::RelativeFileSystem>(nativeFS, bpath));
+
+	// 24 MB of compressible but not trivial data, large enough to be decompressed in parallel
+	std::vector<uint32_t> data(6 * 1024 * 1024);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = uint32_t(i / 7) * 2654435761u % 1024;
+	const size_t dataSize = data.size() * sizeof(uint32_t);
+
+	// round trip through the block-indexed format
+	{
+		CHECK(compressionLayer.writeFile("test_vfs_data.bin.lz4", data.data(), dataSize));
+
+		std::shared_ptr<vfs::IBlob> blob = compressionLayer.readFile("test_vfs_data.bin");
+		CHECK(blob != nullptr);
+		CHECK(blob->size() == dataSize);
+		CHECK(memcmp(blob->data(), data.data(), dataSize) == 0);
+
+		compressionLayer.setMaxDecompressionThreads(1);
+		blob = compressionLayer.readFile("test_vfs_data.bin");
+		CHECK(blob != nullptr);
+		CHECK(memcmp(blob->data(), data.data(), dataSize) == 0);
+		compressionLayer.setMaxDecompressionThreads(0);
+
+		// ranges within one block, across blocks, and at the end of the file
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+		CHECK(check_range(compressionLayer.readFileRange("test_vfs_data.bin", 100, 200), bytes + 100, 200));
+		CHECK(check_range(compressionLayer.readFileRange("test_vfs_data.bin", 1024 * 1024 - 10, 3 * 1024 * 1024), bytes + 1024 * 1024 - 10, 3 * 1024 * 1024));
+		CHECK(check_range(compressionLayer.readFileRange("test_vfs_data.bin", dataSize - 10, 100), bytes + dataSize - 10, 10));
+		CHECK(compressionLayer.readFileRange("test_vfs_data.bin", dataSize + 1, 100) == nullptr);
+
+		// only the header, the block index and the overlapping blocks are read from the underlying file system
+		auto countingFS = std::make_shared<CountingFileSystem>();
+		vfs::CompressionLayer countingLayer(std::make_shared<vfs::RelativeFileSystem>(countingFS, bpath));
+		CHECK(check_range(countingLayer.readFileRange("test_vfs_data.bin", dataSize - 10, 100), bytes + dataSize - 10, 10));
+		CHECK(countingFS->numReads == 0);
+		CHECK(countingFS->numRangeBytes > 0);
+		CHECK(countingFS->numRangeBytes < 1024 * 1024);
+		CHECK(countingLayer.readFileRange("test_vfs_data.bin", dataSize + 1, 100) == nullptr);
+		CHECK(countingFS->numReads == 0);
+	}
+
+	// a block index that doesn't start at the beginning of the content is ignored
+	{
+		std::shared_ptr<vfs::IBlob> compressedBlob = nativeFS->readFile(bpath / "test_vfs_data.bin.lz4");
+		CHECK(compressedBlob != nullptr);
+		std::vector<uint8_t> compressed(compressedBlob->size());
+		memcpy(compressed.data(), compressedBlob->data(), compressed.size());
+		compressedBlob.reset();
+
+		// skippable frame payload: {compressedOffset, decompressedOffset}[numBlocks], numBlocks, "BIDX"
+		uint32_t numBlocks;
+		memcpy(&numBlocks, compressed.data() + compressed.size() - 8, sizeof(numBlocks));
+		CHECK(numBlocks > 1);
+		const size_t firstEntry = compressed.size() - 8 - size_t(numBlocks) * 16;
+		const uint64_t shiftedOffset = 1;
+		memcpy(compressed.data() + firstEntry + 8, &shiftedOffset, sizeof(shiftedOffset));
+		CHECK(nativeFS->writeFile(bpath / "test_vfs_data.bin.lz4", compressed.data(), compressed.size()));
+
+		std::shared_ptr<vfs::IBlob> blob = compressionLayer.readFile("test_vfs_data.bin");
+		CHECK(blob != nullptr);
+		CHECK(blob->size() == dataSize);
+		CHECK(memcmp(blob->data(), data.data(), dataSize) == 0);
+
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+		CHECK(check_range(compressionLayer.readFileRange("test_vfs_data.bin", 0, 1000), bytes, 1000));
+	}
+
+	// frames written by older versions or other tools, with linked and independent blocks but no block index
+	for (LZ4F_blockMode_t blockMode : { LZ4F_blockLinked, LZ4F_blockIndependent })
+	{
+		LZ4F_preferences_t preferences{};
+		preferences.frameInfo.contentSize = dataSize;
+		preferences.frameInfo.blockMode = blockMode;
+		preferences.frameInfo.blockSizeID = LZ4F_max256KB;
+
+		std::vector<uint8_t> compressed(LZ4F_compressFrameBound(dataSize, &preferences));
+		size_t compressedSize = LZ4F_compressFrame(compressed.data(), compressed.size(), data.data(), dataSize, &preferences);
+		CHECK(!LZ4F_isError(compressedSize));
+		CHECK(nativeFS->writeFile(bpath / "test_vfs_data.bin.lz4", compressed.data(), compressedSize));
+
+		std::shared_ptr<vfs::IBlob> blob = compressionLayer.readFile("test_vfs_data.bin");
+		CHECK(blob != nullptr);
+		CHECK(blob->size() == dataSize);
+		CHECK(memcmp(blob->data(), data.data(), dataSize) == 0);
+
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+		CHECK(check_range(compressionLayer.readFileRange("test_vfs_data.bin", 300000, 500000), bytes + 300000, 500000));
+	}
+
+	std::filesystem::remove(bpath / "test_vfs_data.bin.lz4");
+}
+#endif
+
+#ifdef DONUT_WITH_ZSTD
+void test_zstd_compression_layer()
+{
+	std::shared_ptr<vfs::NativeFileSystem> nativeFS = std::make_shared<vfs::NativeFileSystem>();
+	std::shared_ptr<vfs::RelativeFileSystem> binaryFS = std::make_shared<vfs::RelativeFileSystem>(nativeFS, bpath);
+	vfs::CompressionLayer compressionLayer(binaryFS);
+	compressionLayer.setCompressionLevel(3);
+
+	// 24 MB of compressible data, written as several independent frames
+	std::vector<uint32_t> data(6 * 1024 * 1024);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = uint32_t(i / 7) * 2654435761u % 1024;
+	const size_t dataSize = data.size() * sizeof(uint32_t);
+
+	{
+		CHECK(compressionLayer.writeFile("test_vfs_data.bin.zst", data.data(), dataSize));
+
+		std::shared_ptr<vfs::IBlob> blob = compressionLayer.readFile("test_vfs_data.bin");
+		CHECK(blob != nullptr);
+		CHECK(blob->size() == dataSize);
+		CHECK(memcmp(blob->data(), data.data(), dataSize) == 0);
+
+		compressionLayer.setMaxDecompressionThreads(1);
+		blob = compressionLayer.readFile("test_vfs_data.bin");
+		CHECK(blob != nullptr);
+		CHECK(memcmp(blob->data(), data.data(), dataSize) == 0);
+		compressionLayer.setMaxDecompressionThreads(0);
+
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+		CHECK(check_range(compressionLayer.readFileRange("test_vfs_data.bin", 100, 200), bytes + 100, 200));
+		CHECK(check_range(compressionLayer.readFileRange("test_vfs_data.bin", 4 * 1024 * 1024 - 10, 5 * 1024 * 1024), bytes + 4 * 1024 * 1024 - 10, 5 * 1024 * 1024));
+		CHECK(check_range(compressionLayer.readFileRange("test_vfs_data.bin", dataSize - 10, 100), bytes + dataSize - 10, 10));
+		CHECK(compressionLayer.readFileRange("test_vfs_data.bin", dataSize + 1, 100) == nullptr);
+	}
+
+	// a frame written by a streaming compressor, without the content size in the header
+	{
+		ZSTD_CCtx* context = ZSTD_createCCtx();
+		std::vector<uint8_t> compressed(ZSTD_compressBound(dataSize));
+		ZSTD_inBuffer input = { data.data(), dataSize, 0 };
+		ZSTD_outBuffer output = { compressed.data(), compressed.size(), 0 };
+		CHECK(!ZSTD_isError(ZSTD_compressStream2(context, &output, &input, ZSTD_e_continue)));
+		ZSTD_inBuffer emptyInput = { nullptr, 0, 0 };
+		CHECK(ZSTD_compressStream2(context, &output, &emptyInput, ZSTD_e_end) == 0);
+		ZSTD_freeCCtx(context);
+		CHECK(ZSTD_getFrameContentSize(compressed.data(), output.pos) == ZSTD_CONTENTSIZE_UNKNOWN);
+		CHECK(nativeFS->writeFile(bpath / "test_vfs_data.bin.zst", compressed.data(), output.pos));
+
+		std::shared_ptr<vfs::IBlob> blob = compressionLayer.readFile("test_vfs_data.bin");
+		CHECK(blob != nullptr);
+		CHECK(blob->size() == dataSize);
+		CHECK(memcmp(blob->data(), data.data(), dataSize) == 0);
+	}
+
+	// a trained dictionary, required to read the files compressed with it
+	{
+		std::string samples;
+		std::vector<size_t> sampleSizes;
+		for (int index = 0; index < 1000; index++)
+		{
+			std::string sample = "{ \"name\": \"node" + std::to_string(index) + "\", \"translation\": [" + std::to_string(index * 3) +
+				", 0, " + std::to_string(index % 17) + "], \"mesh\": " + std::to_string(index % 5) + " }";
+			samples += sample;
+			sampleSizes.push_back(sample.size());
+		}
+
+		std::vector<char> dictionary(4096);
+		const size_t dictionarySize = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), samples.data(), sampleSizes.data(), unsigned(sampleSizes.size()));
+		CHECK(!ZDICT_isError(dictionarySize));
+		CHECK(nativeFS->writeFile(bpath / "test_vfs.dict", dictionary.data(), dictionarySize));
+		CHECK(compressionLayer.loadZstdDictionary("test_vfs.dict"));
+		CHECK(compressionLayer.loadZstdDictionary("test_vfs_missing.dict") == false);
+
+		const std::string text = "{ \"name\": \"node12345\", \"translation\": [1, 0, 2], \"mesh\": 3 }";
+		CHECK(compressionLayer.writeFile("test_vfs_data.bin.zst", text.data(), text.size()));
+
+		std::shared_ptr<vfs::IBlob> blob = compressionLayer.readFile("test_vfs_data.bin");
+		CHECK(blob != nullptr);
+		CHECK(blob->size() == text.size());
+		CHECK(memcmp(blob->data(), text.data(), text.size()) == 0);
+
+		vfs::CompressionLayer layerWithoutDictionary(binaryFS);
+		CHECK(layerWithoutDictionary.readFile("test_vfs_data.bin") == nullptr);
+
+		// files compressed without a dictionary are still readable with one loaded, also on a single thread
+		std::vector<uint8_t> compressed(ZSTD_compressBound(dataSize));
+		const size_t compressedSize = ZSTD_compress(compressed.data(), compressed.size(), data.data(), dataSize, 3);
+		CHECK(!ZSTD_isError(compressedSize));
+		CHECK(nativeFS->writeFile(bpath / "test_vfs_data.bin.zst", compressed.data(), compressedSize));
+
+		for (uint32_t maxThreads : { 1u, 0u })
+		{
+			compressionLayer.setMaxDecompressionThreads(maxThreads);
+			blob = compressionLayer.readFile("test_vfs_data.bin");
+			CHECK(blob != nullptr);
+			CHECK(blob->size() == dataSize);
+			CHECK(memcmp(blob->data(), data.data(), dataSize) == 0);
+		}
+	}
+
+	std::filesystem::remove(bpath / "test_vfs.dict");
+	std::filesystem::remove(bpath / "test_vfs_data.bin.zst");
+}
+#endif
+
+#if defined(DONUT_WITH_LZ4) && defined(DONUT_WITH_ZSTD)
+// Compresses the library sources with LZ4, Zstandard, and Zstandard with a trained dictionary, packs each set
+// into a tar archive and reads it back. The benchmark reads it several times and prints the compression ratio
+// and the decompression throughput.
+void test_compressed_archives()
+{
+	const bool benchmark = donut::test::benchmarksEnabled();
+
+	std::vector<std::vector<char>> corpus;
+	const size_t corpusSize = read_source_corpus(corpus);
+
+	std::shared_ptr<vfs::NativeFileSystem> nativeFS = std::make_shared<vfs::NativeFileSystem>();
+	const std::filesystem::path folderPath = bpath / "test_vfs_compressed";
+	const std::filesystem::path archivePath = bpath / "test_vfs_compressed.tar";
+
+	struct Codec { const char* name; const char* extension; int level; bool dictionary; };
+	for (const Codec& codec : { Codec{ "LZ4", ".lz4", 5, false }, Codec{ "Zstandard", ".zst", 9, false }, Codec{ "Zstandard+dict", ".zst", 9, true } })
+	{
+		std::filesystem::create_directories(folderPath);
+		auto folderFS = std::make_shared<vfs::RelativeFileSystem>(nativeFS, folderPath);
+		vfs::CompressionLayer writer(folderFS);
+		writer.setCompressionLevel(codec.level);
+
+		if (codec.dictionary)
+		{
+			std::string samples;
+			std::vector<size_t> sampleSizes;
+			for (const std::vector<char>& file : corpus)
+			{
+				samples.append(file.data(), file.size());
+				sampleSizes.push_back(file.size());
+			}
+
+			std::vector<char> dictionary(32 * 1024);
+			const size_t dictionarySize = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), samples.data(), sampleSizes.data(), unsigned(sampleSizes.size()));
+			CHECK(!ZDICT_isError(dictionarySize));
+			CHECK(folderFS->writeFile("zstd.dict", dictionary.data(), dictionarySize));
+			CHECK(writer.loadZstdDictionary("zstd.dict"));
+		}
+
+		// compress every file, then pack the compressed files
+		std::ofstream archive(archivePath, std::ios::binary);
+		CHECK(archive.is_open());
+		size_t compressedSize = 0;
+		for (size_t index = 0; index < corpus.size(); index++)
+		{
+			const std::string name = "file" + std::to_string(index) + codec.extension;
+			CHECK(writer.writeFile(name, corpus[index].data(), corpus[index].size()));
+
+			std::shared_ptr<vfs::IBlob> compressed = folderFS->readFile(name);
+			CHECK(compressed != nullptr);
+			write_tar_entry(archive, name, compressed->data(), compressed->size());
+			compressedSize += compressed->size();
+		}
+		if (codec.dictionary)
+		{
+			std::shared_ptr<vfs::IBlob> dictionary = folderFS->readFile("zstd.dict");
+			write_tar_entry(archive, "zstd.dict", dictionary->data(), dictionary->size());
+			compressedSize += dictionary->size();
+		}
+		write_tar_trailer(archive);
+		archive.close();
+		std::filesystem::remove_all(folderPath);
+
+		// read everything back through the archive
+		vfs::CompressionLayer reader(std::make_shared<vfs::TarFile>(archivePath));
+		if (codec.dictionary)
+			CHECK(reader.loadZstdDictionary("zstd.dict"));
+
+		const int numPasses = benchmark ? 4 : 1;
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (int pass = 0; pass < numPasses; pass++)
+		{
+			for (size_t index = 0; index < corpus.size(); index++)
+			{
+				std::shared_ptr<vfs::IBlob> blob = reader.readFile("file" + std::to_string(index));
+				CHECK(blob != nullptr);
+				CHECK(blob->size() == corpus[index].size());
+				CHECK(blob->size() == 0 || memcmp(blob->data(), corpus[index].data(), blob->size()) == 0);
+			}
+		}
+		if (benchmark)
+		{
+			auto endTime = std::chrono::high_resolution_clock::now();
+			const double seconds = std::chrono::duration<double>(endTime - startTime).count();
+			const double megabytes = double(corpusSize * numPasses) / (1024.0 * 1024.0);
+
+			printf("%-15s %zu files, ratio %5.2f, decompression %8.1f MB/s\n", codec.name, corpus.size(),
+				double(corpusSize) / double(compressedSize), megabytes / seconds);
+		}
+	}
+
+	std::filesystem::remove(archivePath);
+}
+#endif
+
+#ifdef DONUT_WITH_MINIZ
+// Reads all files with readFilesAsync, checks the contents, and returns the time in seconds.
+static double read_files_in_parallel(vfs::IFileSystem& fs, const std::vector<std::vector<char>>& corpus)
+{
+	std::atomic<int> numCompleted = 0;
+	std::atomic<int> numCorrect = 0;
+	std::vector<vfs::AsyncReadRequest> requests;
+	for (size_t index = 0; index < corpus.size(); index++)
+	{
+		const std::vector<char>& expected = corpus[index];
+		requests.push_back(vfs::AsyncReadRequest{ "file" + std::to_string(index), [&numCompleted, &numCorrect, &expected](std::shared_ptr<vfs::IBlob> blob)
+		{
+			if (blob && blob->size() == expected.size() && memcmp(blob->data(), expected.data(), blob->size()) == 0)
+				++numCorrect;
+			++numCompleted;
+		}});
+	}
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	fs.readFilesAsync(std::move(requests));
+	while (numCompleted < int(corpus.size()))
+		std::this_thread::yield();
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	CHECK(numCorrect == int(corpus.size()));
+	return std::chrono::duration<double>(endTime - startTime).count();
+}
+
+void test_zip_file()
+{
+	const std::filesystem::path archivePath = bpath / "test_vfs_archive.zip";
+	const size_t fileSize = 100000;
+	std::vector<char> storedData(fileSize);
+	std::vector<char> deflatedData(fileSize);
+	for (size_t i = 0; i < fileSize; i++)
+	{
+		storedData[i] = char(i * 7);
+		deflatedData[i] = char((i / 100) & 0xff);
+	}
+
+	{
+		mz_zip_archive zipArchive;
+		memset(&zipArchive, 0, sizeof(zipArchive));
+		CHECK(mz_zip_writer_init_file(&zipArchive, archivePath.generic_string().c_str(), 0));
+		CHECK(mz_zip_writer_add_mem(&zipArchive, "data/", nullptr, 0, 0));
+		CHECK(mz_zip_writer_add_mem(&zipArchive, "data/stored.bin", storedData.data(), storedData.size(), MZ_NO_COMPRESSION));
+		CHECK(mz_zip_writer_add_mem(&zipArchive, "data/deflated.bin", deflatedData.data(), deflatedData.size(), MZ_DEFAULT_LEVEL));
+		CHECK(mz_zip_writer_finalize_archive(&zipArchive));
+		CHECK(mz_zip_writer_end(&zipArchive));
+	}
+
+	{
+		vfs::ZipFile zipFile(archivePath);
+		CHECK(zipFile.isOpen());
+		CHECK(zipFile.folderExists("data"));
+		CHECK(zipFile.fileExists("data/stored.bin"));
+		CHECK(zipFile.fileExists("/data/deflated.bin"));
+		CHECK(!zipFile.fileExists("data/dummy.bin"));
+		CHECK(zipFile.readFile("data/dummy.bin") == nullptr);
+
+		// stored files are views into the mapped archive
+		std::shared_ptr<vfs::IBlob> blob = zipFile.readFile("data/stored.bin");
+		CHECK(dynamic_cast<vfs::BlobView*>(blob.get()) != nullptr);
+		CHECK(check_range(blob, storedData.data(), fileSize));
+		CHECK(check_range(zipFile.readFileRange("data/stored.bin", 1000, 500), storedData.data() + 1000, 500));
+		CHECK(check_range(zipFile.readFileRange("data/stored.bin", fileSize - 10, 500), storedData.data() + fileSize - 10, 10));
+		CHECK(check_range(zipFile.readFileRange("data/stored.bin", fileSize, 1), nullptr, 0));
+		CHECK(zipFile.readFileRange("data/stored.bin", fileSize + 1, 1) == nullptr);
+
+		blob = zipFile.readFile("data/deflated.bin");
+		CHECK(dynamic_cast<vfs::BlobView*>(blob.get()) == nullptr);
+		CHECK(check_range(blob, deflatedData.data(), fileSize));
+		CHECK(check_range(zipFile.readFileRange("data/deflated.bin", 5000, 100), deflatedData.data() + 5000, 100));
+
+		// stored and deflated files read concurrently from many threads, without shared decompressor state
+		std::atomic<int> failures = 0;
+		std::vector<std::thread> threads;
+		for (int thread = 0; thread < 8; thread++)
+		{
+			threads.emplace_back([&zipFile, &storedData, &deflatedData, &failures, thread]()
+			{
+				for (int iteration = 0; iteration < 50; iteration++)
+				{
+					const bool stored = (thread + iteration) % 2 == 0;
+					std::shared_ptr<vfs::IBlob> blob = zipFile.readFile(stored ? "data/stored.bin" : "data/deflated.bin");
+					if (!check_range(blob, stored ? storedData.data() : deflatedData.data(), fileSize))
+						++failures;
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+		CHECK(failures == 0);
+
+		std::vector<std::string> files;
+		CHECK(zipFile.enumerateFiles("data", { ".bin" }, vfs::enumerate_to_vector(files)) == 2);
+	}
+	std::filesystem::remove(archivePath);
+
+	// Read the same files from a zip archive and from a tar archive with LZ4 compressed files,
+	// on one thread and with readFilesAsync. The benchmark prints the throughput of both.
+	// Empty files are skipped because readFile returns nullptr for them.
+	const bool benchmark = donut::test::benchmarksEnabled();
+	std::vector<std::vector<char>> corpus;
+	const size_t corpusSize = read_source_corpus(corpus);
+	const double megabytes = double(corpusSize) / (1024.0 * 1024.0);
+	corpus.erase(std::remove_if(corpus.begin(), corpus.end(), [](const std::vector<char>& file) { return file.empty(); }), corpus.end());
+
+	{
+		mz_zip_archive zipArchive;
+		memset(&zipArchive, 0, sizeof(zipArchive));
+		CHECK(mz_zip_writer_init_file(&zipArchive, archivePath.generic_string().c_str(), 0));
+		for (size_t index = 0; index < corpus.size(); index++)
+		{
+			const std::string name = "file" + std::to_string(index);
+			CHECK(mz_zip_writer_add_mem(&zipArchive, name.c_str(), corpus[index].data(), corpus[index].size(), MZ_DEFAULT_LEVEL));
+		}
+		CHECK(mz_zip_writer_finalize_archive(&zipArchive));
+		CHECK(mz_zip_writer_end(&zipArchive));
+	}
+
+	{
+		vfs::ZipFile zipFile(archivePath);
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (size_t index = 0; index < corpus.size(); index++)
+		{
+			std::shared_ptr<vfs::IBlob> blob = zipFile.readFile("file" + std::to_string(index));
+			CHECK(blob != nullptr);
+			CHECK(blob->size() == corpus[index].size());
+		}
+		auto endTime = std::chrono::high_resolution_clock::now();
+		const double seconds = std::chrono::duration<double>(endTime - startTime).count();
+		const double parallelSeconds = read_files_in_parallel(zipFile, corpus);
+
+		if (benchmark)
+		{
+			printf("ZipFile          %zu files, %8.1f MB/s on one thread, %8.1f MB/s with readFilesAsync\n",
+				corpus.size(), megabytes / seconds, megabytes / parallelSeconds);
+		}
+	}
+	std::filesystem::remove(archivePath);
+
+#ifdef DONUT_WITH_LZ4
+	{
+		const std::filesystem::path folderPath = bpath / "test_vfs_compressed";
+		const std::filesystem::path tarPath = bpath / "test_vfs_compressed.tar";
+		std::filesystem::create_directories(folderPath);
+		auto folderFS = std::make_shared<vfs::RelativeFileSystem>(std::make_shared<vfs::NativeFileSystem>(), folderPath);
+		vfs::CompressionLayer writer(folderFS);
+
+		std::ofstream archive(tarPath, std::ios::binary);
+		for (size_t index = 0; index < corpus.size(); index++)
+		{
+			const std::string name = "file" + std::to_string(index) + ".lz4";
+			CHECK(writer.writeFile(name, corpus[index].data(), corpus[index].size()));
+			std::shared_ptr<vfs::IBlob> compressed = folderFS->readFile(name);
+			write_tar_entry(archive, name, compressed->data(), compressed->size());
+		}
+		write_tar_trailer(archive);
+		archive.close();
+		std::filesystem::remove_all(folderPath);
+
+		vfs::CompressionLayer reader(std::make_shared<vfs::TarFile>(tarPath));
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (size_t index = 0; index < corpus.size(); index++)
+			CHECK(reader.readFile("file" + std::to_string(index)) != nullptr);
+		auto endTime = std::chrono::high_resolution_clock::now();
+		const double seconds = std::chrono::duration<double>(endTime - startTime).count();
+		const double parallelSeconds = read_files_in_parallel(reader, corpus);
+
+		if (benchmark)
+		{
+			printf("TarFile+LZ4      %zu files, %8.1f MB/s on one thread, %8.1f MB/s with readFilesAsync\n",
+				corpus.size(), megabytes / seconds, megabytes / parallelSeconds);
+		}
+
+		std::filesystem::remove(tarPath);
+	}
+#endif
+}
+#endif
+
 int main(int, char** argv)
 {
 	try
@@ -184,6 +1553,26 @@ int main(int, char** argv)
 		test_native_filesystem();
 		test_relative_filesystem();
 		test_root_filesystem();
+		test_file_search_pattern();
+		test_async_reads();
+		test_tar_file();
+		test_read_file_range();
+		test_mapped_files();
+		test_caching_filesystem();
+		test_pack_file();
+		test_archive_enumeration();
+#ifdef DONUT_WITH_LZ4
+		test_compression_layer();
+#endif
+#ifdef DONUT_WITH_ZSTD
+		test_zstd_compression_layer();
+#endif
+#if defined(DONUT_WITH_LZ4) && defined(DONUT_WITH_ZSTD)
+		test_compressed_archives();
+#endif
+#ifdef DONUT_WITH_MINIZ
+		test_zip_file();
+#endif
 	}
 	catch (const std::runtime_error & err)
 	{
@@ -0,0 +1,258 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/ChunkImporter.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/TextureCache.h>
+#include <donut/core/vfs/VFS.h>
+#include <donut/core/log.h>
+#include <donut/tests/utils.h>
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+std::filesystem::path bpath(DONUT_TEST_BINARY_DIR);
+
+// 2x2 uncompressed 32-bit TGA
+static void write_texture_file(const std::filesystem::path& path)
+{
+	const uint8_t header[18] = { 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 2, 0, 32, 8 };
+	const uint8_t pixels[16] = { 255, 0, 0, 255, 0, 255, 0, 255, 0, 0, 255, 255, 255, 255, 255, 255 };
+
+	FILE* file = fopen(path.string().c_str(), "wb");
+	CHECK(file);
+	fwrite(header, 1, sizeof(header), file);
+	fwrite(pixels, 1, sizeof(pixels), file);
+	fclose(file);
+}
+
+// A model like GltfImporter produces : one mesh with two geometries and two materials,
+// instanced on two nodes
+static SceneImportResult make_model(const std::shared_ptr<LoadedTexture>& texture)
+{
+	auto buffers = std::make_shared<BufferGroup>();
+	for (uint32_t quad = 0; quad < 2; quad++)
+	{
+		float x = float(quad);
+		buffers->positionData.insert(buffers->positionData.end(), {
+			float3(x, 0.f, 0.f), float3(x + 1.f, 0.f, 0.f), float3(x + 1.f, 1.f, 0.f), float3(x, 1.f, 0.f) });
+		buffers->texcoord1Data.insert(buffers->texcoord1Data.end(), {
+			float2(0.f, 0.f), float2(1.f, 0.f), float2(1.f, 1.f), float2(0.f, 1.f) });
+		buffers->indexData.insert(buffers->indexData.end(), { 0, 1, 2, 0, 2, 3 });
+	}
+	buffers->normalData.assign(buffers->positionData.size(), vectorToSnorm8(float3(0.f, 0.f, 1.f)));
+
+	auto textured = std::make_shared<Material>();
+	textured->name = "textured";
+	textured->domain = MaterialDomain::AlphaTested;
+	textured->baseOrDiffuseTexture = texture;
+	textured->baseOrDiffuseColor = float3(0.5f, 0.25f, 0.125f);
+	textured->roughness = 0.75f;
+	textured->alphaCutoff = 0.25f;
+	textured->doubleSided = true;
+	textured->enableHair = true;
+	textured->hair.melanin = 0.125f;
+
+	auto plain = std::make_shared<Material>();
+	plain->name = "plain";
+	plain->emissiveColor = float3(1.f, 2.f, 3.f);
+	plain->metalness = 1.f;
+
+	auto mesh = std::make_shared<MeshInfo>();
+	mesh->name = "quads";
+	mesh->buffers = buffers;
+	mesh->totalVertices = uint32_t(buffers->positionData.size());
+	mesh->totalIndices = uint32_t(buffers->indexData.size());
+	mesh->objectSpaceBounds = box3(float3(0.f), float3(2.f, 1.f, 0.f));
+
+	for (uint32_t quad = 0; quad < 2; quad++)
+	{
+		auto geometry = std::make_shared<MeshGeometry>();
+		geometry->material = quad ? plain : textured;
+		geometry->indexOffsetInMesh = quad * 6;
+		geometry->vertexOffsetInMesh = quad * 4;
+		geometry->numIndices = 6;
+		geometry->numVertices = 4;
+		geometry->objectSpaceBounds = box3(float3(float(quad), 0.f, 0.f), float3(float(quad) + 1.f, 1.f, 0.f));
+		mesh->geometries.push_back(geometry);
+	}
+
+	// an orphaned subgraph, like the importers return
+	auto graph = std::make_shared<SceneGraph>();
+	auto root = std::make_shared<SceneGraphNode>();
+	root->SetName("model");
+
+	for (int index = 0; index < 2; index++)
+	{
+		auto node = std::make_shared<SceneGraphNode>();
+		node->SetName(index ? "right" : "left");
+		node->SetTranslation(double3(index ? 5.0 : -5.0, 0.0, 0.0));
+		node->SetLeaf(std::make_shared<MeshInstance>(mesh));
+		graph->Attach(root, node);
+	}
+
+	SceneImportResult result;
+	result.rootNode = root;
+	return result;
+}
+
+static bool materials_match(const Material& a, const Material& b)
+{
+	return a.name == b.name
+		&& a.domain == b.domain
+		&& a.baseOrDiffuseTexture == b.baseOrDiffuseTexture
+		&& a.metalRoughOrSpecularTexture == b.metalRoughOrSpecularTexture
+		&& all(a.baseOrDiffuseColor == b.baseOrDiffuseColor)
+		&& all(a.emissiveColor == b.emissiveColor)
+		&& a.metalness == b.metalness
+		&& a.roughness == b.roughness
+		&& a.alphaCutoff == b.alphaCutoff
+		&& a.doubleSided == b.doubleSided
+		&& a.enableHair == b.enableHair
+		&& a.hair.melanin == b.hair.melanin;
+}
+
+void test_chunk_importer_round_trip()
+{
+	auto fs = std::make_shared<vfs::NativeFileSystem>();
+	auto textureCache = std::make_shared<TextureCache>(nullptr, fs, nullptr);
+	ChunkImporter importer(fs, std::make_shared<SceneTypeFactory>());
+
+	std::filesystem::path texturePath = bpath / "test_chunk_importer.tga";
+	std::filesystem::path modelPath = bpath / "test_chunk_importer.donutmesh";
+	write_texture_file(texturePath);
+
+	auto texture = textureCache->LoadTextureFromFileDeferred(texturePath, true);
+	CHECK(texture);
+
+	SceneImportResult model = make_model(texture);
+	CHECK(importer.Save(modelPath, model));
+
+	SceneImportResult loaded;
+	CHECK(importer.Load(modelPath, *textureCache, nullptr, loaded));
+	CHECK(loaded.rootNode);
+
+	auto original = std::make_shared<SceneGraph>();
+	original->SetRootNode(model.rootNode);
+	auto scene = std::make_shared<SceneGraph>();
+	scene->SetRootNode(loaded.rootNode);
+
+	// meshes
+	CHECK(scene->GetMeshInstances().size() == 2);
+	CHECK(scene->GetMeshes().size() == 1);
+
+	const MeshInfo& srcMesh = **original->GetMeshes().begin();
+	const MeshInfo& dstMesh = **scene->GetMeshes().begin();
+	CHECK(dstMesh.name == srcMesh.name);
+	CHECK(dstMesh.totalVertices == srcMesh.totalVertices);
+	CHECK(dstMesh.totalIndices == srcMesh.totalIndices);
+	CHECK(dstMesh.geometries.size() == srcMesh.geometries.size());
+	CHECK(dstMesh.buffers->indexData == srcMesh.buffers->indexData);
+	CHECK(dstMesh.buffers->normalData == srcMesh.buffers->normalData);
+	CHECK(memcmp(dstMesh.buffers->positionData.data(), srcMesh.buffers->positionData.data(),
+		srcMesh.buffers->positionData.size() * sizeof(float3)) == 0);
+	CHECK(memcmp(dstMesh.buffers->texcoord1Data.data(), srcMesh.buffers->texcoord1Data.data(),
+		srcMesh.buffers->texcoord1Data.size() * sizeof(float2)) == 0);
+
+	// materials, with the texture reloaded from the same file
+	CHECK(scene->GetMaterials().size() == 2);
+	for (size_t index = 0; index < srcMesh.geometries.size(); index++)
+	{
+		const MeshGeometry& srcGeometry = *srcMesh.geometries[index];
+		const MeshGeometry& dstGeometry = *dstMesh.geometries[index];
+		CHECK(dstGeometry.numIndices == srcGeometry.numIndices);
+		CHECK(dstGeometry.indexOffsetInMesh == srcGeometry.indexOffsetInMesh);
+		CHECK(dstGeometry.vertexOffsetInMesh == srcGeometry.vertexOffsetInMesh);
+		CHECK(dstGeometry.material);
+		CHECK(materials_match(*dstGeometry.material, *srcGeometry.material));
+		CHECK(dstGeometry.material->materialIndexInModel == int(index));
+	}
+
+	// node transforms, with the saved nodes attached directly to the loaded root
+	CHECK(loaded.rootNode->GetName() == "model");
+	for (const auto& instance : scene->GetMeshInstances())
+	{
+		const SceneGraphNode* node = instance->GetNode();
+		CHECK(node);
+		CHECK(node->GetParent() == loaded.rootNode.get());
+		double x = node->GetName() == "right" ? 5.0 : -5.0;
+		CHECK(node->GetTranslation().x == x);
+	}
+
+	// another round trip keeps the same hierarchy
+	SceneImportResult reloaded;
+	CHECK(importer.Save(modelPath, loaded));
+	CHECK(importer.Load(modelPath, *textureCache, nullptr, reloaded));
+	CHECK(reloaded.rootNode->GetName() == "model");
+	CHECK(reloaded.rootNode->GetNumChildren() == 2);
+	for (size_t index = 0; index < reloaded.rootNode->GetNumChildren(); index++)
+	{
+		CHECK(reloaded.rootNode->GetChild(index)->GetLeaf());
+		CHECK(reloaded.rootNode->GetChild(index)->GetNumChildren() == 0);
+	}
+
+	std::filesystem::remove(modelPath);
+	std::filesystem::remove(texturePath);
+}
+
+void test_chunk_importer_embedded_textures()
+{
+	auto fs = std::make_shared<vfs::NativeFileSystem>();
+	ChunkImporter importer(fs, std::make_shared<SceneTypeFactory>());
+
+	// textures decoded from memory have no file that the chunk file could reference
+	auto texture = std::make_shared<LoadedTexture>();
+	texture->path = "model.glb[0]";
+	texture->mimeType = "image/png";
+
+	int errors = 0;
+	log::SetCallback([&errors](log::Severity severity, char const*) { if (severity == log::Severity::Error) ++errors; });
+
+	std::filesystem::path modelPath = bpath / "test_chunk_importer_embedded.donutmesh";
+	CHECK(!importer.Save(modelPath, make_model(texture)));
+	CHECK(errors > 0);
+	CHECK(!std::filesystem::exists(modelPath));
+
+	log::ResetCallback();
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_chunk_importer_round_trip();
+		test_chunk_importer_embedded_textures();
+	}
+	catch (const std::runtime_error & err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
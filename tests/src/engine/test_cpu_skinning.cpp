@@ -0,0 +1,358 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/CpuSkinning.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/SceneTypes.h>
+#include <donut/tests/utils.h>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+static const size_t c_JointCount = 64;
+
+// Unpack_R8_SNORM and Pack_R8_SNORM from packing.hlsli
+static float unpack_snorm8(uint32_t value)
+{
+	return clamp(float(int8_t(value & 0xff)) / 127.f, -1.f, 1.f);
+}
+
+static uint32_t pack_snorm8(float value)
+{
+	return uint32_t(int(clamp(value, -1.f, 1.f) * 127.f)) & 0xff;
+}
+
+static float4 unpack_rgba8_snorm(uint32_t value)
+{
+	return float4(unpack_snorm8(value), unpack_snorm8(value >> 8), unpack_snorm8(value >> 16), unpack_snorm8(value >> 24));
+}
+
+static uint32_t pack_rgba8_snorm(float4 value)
+{
+	return pack_snorm8(value.x) | (pack_snorm8(value.y) << 8) | (pack_snorm8(value.z) << 16) | (pack_snorm8(value.w) << 24);
+}
+
+// Straight translation of skinning_cs.hlsl for one vertex
+static void reference_skin_vertex(const BufferGroup& input, size_t index, const std::vector<float4x4>& jointMatrices,
+	float3& position, uint32_t& normal, uint32_t& tangent)
+{
+	float4x4 jointMatrix = float4x4::zero();
+	for (int i = 0; i < 4; i++)
+	{
+		if (input.weightData[index][i] > 0.f)
+			jointMatrix += jointMatrices[input.jointData[index][i]] * input.weightData[index][i];
+	}
+
+	position = (float4(input.positionData[index], 1.f) * jointMatrix).xyz();
+
+	float4 n = unpack_rgba8_snorm(input.normalData[index]);
+	float4 t = unpack_rgba8_snorm(input.tangentData[index]);
+	n = float4(normalize((float4(n.xyz(), 0.f) * jointMatrix).xyz()), n.w);
+	t = float4(normalize((float4(t.xyz(), 0.f) * jointMatrix).xyz()), t.w);
+	normal = pack_rgba8_snorm(n);
+	tangent = pack_rgba8_snorm(t);
+}
+
+static std::vector<float4x4> make_joint_matrices(std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> value(-1.f, 1.f);
+
+	std::vector<float4x4> jointMatrices;
+	for (size_t i = 0; i < c_JointCount; i++)
+	{
+		quat rotation = normalize(quat(value(rng), value(rng), value(rng), value(rng)));
+		float3 scale = float3(1.f) + 0.2f * float3(value(rng), value(rng), value(rng));
+		float3 offset = float3(value(rng), value(rng), value(rng));
+		jointMatrices.push_back(affineToHomogeneous(scaling(scale) * rotation.toAffine() * translation(offset)));
+	}
+	return jointMatrices;
+}
+
+static BufferGroup make_vertices(std::mt19937& rng, size_t vertexCount)
+{
+	std::uniform_real_distribution<float> value(-1.f, 1.f);
+	std::uniform_int_distribution<uint32_t> joint(0, c_JointCount - 1);
+	std::uniform_int_distribution<uint32_t> byte(0, 255);
+
+	BufferGroup buffers;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		buffers.positionData.push_back(float3(value(rng), value(rng), value(rng)) * 10.f);
+		buffers.normalData.push_back(byte(rng) | (byte(rng) << 8) | (byte(rng) << 16) | (byte(rng) << 24));
+		buffers.tangentData.push_back(byte(rng) | (byte(rng) << 8) | (byte(rng) << 16) | (byte(rng) << 24));
+		buffers.texcoord1Data.push_back(float2(value(rng), value(rng)));
+		buffers.jointData.push_back(vector<uint16_t, 4>(uint16_t(joint(rng)), uint16_t(joint(rng)), uint16_t(joint(rng)), uint16_t(joint(rng))));
+
+		// Some vertices are only influenced by some of their joints
+		float4 weights = float4(std::max(value(rng), 0.f), std::max(value(rng), 0.f), std::max(value(rng), 0.f), 1.f);
+		buffers.weightData.push_back(weights / (weights.x + weights.y + weights.z + weights.w));
+	}
+	return buffers;
+}
+
+template<typename T>
+static bool streams_equal(const T* a, const T* b, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		if (any(a[i] != b[i]))
+			return false;
+	}
+	return true;
+}
+
+template<typename T>
+static bool streams_equal(const std::vector<T>& a, const std::vector<T>& b)
+{
+	return a.size() == b.size() && streams_equal(a.data(), b.data(), a.size());
+}
+
+// Packed snorm components that differ by more than one step
+static bool snorm8_differs(uint32_t a, uint32_t b)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		int ca = int(int8_t(a >> (i * 8)));
+		int cb = int(int8_t(b >> (i * 8)));
+		if (std::abs(ca - cb) > 1)
+			return true;
+	}
+	return false;
+}
+
+void test_skinning_matches_shader()
+{
+	std::mt19937 rng(1);
+	std::vector<float4x4> jointMatrices = make_joint_matrices(rng);
+	BufferGroup input = make_vertices(rng, 1000);
+
+	uint32_t const firstVertex = 100;
+	uint32_t const vertexCount = 800;
+
+	BufferGroup output;
+	CHECK(SkinVertices(input, firstVertex, vertexCount, jointMatrices.data(), jointMatrices.size(), output));
+	CHECK(output.positionData.size() == vertexCount);
+	CHECK(streams_equal(output.prevPositionData, output.positionData));
+	CHECK(output.normalData.size() == vertexCount);
+	CHECK(output.tangentData.size() == vertexCount);
+	CHECK(output.texcoord2Data.empty());
+	CHECK(streams_equal(output.texcoord1Data.data(), input.texcoord1Data.data() + firstVertex, vertexCount));
+
+	size_t directionMismatches = 0;
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		float3 position;
+		uint32_t normal, tangent;
+		reference_skin_vertex(input, firstVertex + i, jointMatrices, position, normal, tangent);
+
+		CHECK(length(output.positionData[i] - position) <= 1e-4f * std::max(length(position), 1.f));
+
+		// The rounding of values that land exactly between two snorm steps may go either way
+		CHECK(!snorm8_differs(output.normalData[i], normal));
+		CHECK(!snorm8_differs(output.tangentData[i], tangent));
+		if (output.normalData[i] != normal || output.tangentData[i] != tangent)
+			++directionMismatches;
+	}
+	CHECK(directionMismatches < vertexCount / 100);
+}
+
+void test_skinning_prev_positions()
+{
+	std::mt19937 rng(2);
+	std::vector<float4x4> jointMatrices = make_joint_matrices(rng);
+	BufferGroup input = make_vertices(rng, 100);
+
+	BufferGroup output;
+	CHECK(SkinVertices(input, 0, 100, jointMatrices.data(), jointMatrices.size(), output));
+	std::vector<float3> firstPositions = output.positionData;
+
+	for (float4x4& matrix : jointMatrices)
+		matrix.row3 += float4(1.f, 0.f, 0.f, 0.f);
+
+	CHECK(SkinVertices(input, 0, 100, jointMatrices.data(), jointMatrices.size(), output));
+	CHECK(streams_equal(output.prevPositionData, firstPositions));
+	for (size_t i = 0; i < 100; i++)
+	{
+		float weightSum = input.weightData[i].x + input.weightData[i].y + input.weightData[i].z + input.weightData[i].w;
+		CHECK(std::abs(output.positionData[i].x - firstPositions[i].x - weightSum) < 1e-4f);
+	}
+
+	// A different vertex count starts over with the first frame
+	CHECK(SkinVertices(input, 0, 50, jointMatrices.data(), jointMatrices.size(), output));
+	CHECK(output.positionData.size() == 50);
+	CHECK(streams_equal(output.prevPositionData, output.positionData));
+}
+
+void test_skinning_invalid_input()
+{
+	std::mt19937 rng(3);
+	std::vector<float4x4> jointMatrices = make_joint_matrices(rng);
+	BufferGroup input = make_vertices(rng, 10);
+
+	BufferGroup output;
+	CHECK(!SkinVertices(input, 5, 10, jointMatrices.data(), jointMatrices.size(), output));
+
+	input.normalData.resize(5);
+	CHECK(!SkinVertices(input, 0, 10, jointMatrices.data(), jointMatrices.size(), output));
+
+	// Joints outside of the matrix array are skipped
+	input.normalData.clear();
+	input.tangentData.clear();
+	input.jointData[0] = vector<uint16_t, 4>(0, 1000, 1000, 1000);
+	input.weightData[0] = float4(0.5f, 0.5f, 0.f, 0.f);
+	jointMatrices[0] = float4x4::identity();
+	CHECK(SkinVertices(input, 0, 10, jointMatrices.data(), jointMatrices.size(), output));
+	CHECK(all(output.positionData[0] == input.positionData[0] * 0.5f));
+	CHECK(output.normalData.empty());
+	CHECK(output.tangentData.empty());
+}
+
+void test_skinning_parallel(tf::Executor* executor)
+{
+	std::mt19937 rng(4);
+	std::vector<float4x4> jointMatrices = make_joint_matrices(rng);
+	BufferGroup input = make_vertices(rng, 20000);
+
+	BufferGroup serial, parallel;
+	CHECK(SkinVertices(input, 0, 20000, jointMatrices.data(), jointMatrices.size(), serial));
+	CHECK(SkinVertices(input, 0, 20000, jointMatrices.data(), jointMatrices.size(), parallel, executor));
+	CHECK(streams_equal(serial.positionData, parallel.positionData));
+	CHECK(serial.normalData == parallel.normalData);
+	CHECK(serial.tangentData == parallel.tangentData);
+}
+
+void test_skinned_mesh_instance()
+{
+	auto prototype = std::make_shared<MeshInfo>();
+	prototype->buffers = std::make_shared<BufferGroup>();
+	prototype->buffers->positionData = { float3(0.f), float3(1.f, 0.f, 0.f), float3(1.f, 0.f, 0.f) };
+	prototype->buffers->jointData = { vector<uint16_t, 4>(uint16_t(0)), vector<uint16_t, 4>(uint16_t(0)), vector<uint16_t, 4>(0, 1, 0, 0) };
+	prototype->buffers->weightData = { float4(1.f, 0.f, 0.f, 0.f), float4(1.f, 0.f, 0.f, 0.f), float4(0.5f, 0.5f, 0.f, 0.f) };
+	prototype->vertexOffset = 1;
+	prototype->totalVertices = 2;
+
+	auto graph = std::make_shared<SceneGraph>();
+	auto root = std::make_shared<SceneGraphNode>();
+	graph->SetRootNode(root);
+	root->SetTranslation(double3(5.0, 0.0, 0.0));
+	auto joint0 = graph->Attach(root, std::make_shared<SceneGraphNode>());
+	joint0->SetTranslation(double3(0.0, 2.0, 0.0));
+	auto joint1 = graph->Attach(root, std::make_shared<SceneGraphNode>());
+	joint1->SetTranslation(double3(0.0, 0.0, 4.0));
+
+	auto instance = std::make_shared<SkinnedMeshInstance>(std::make_shared<SceneTypeFactory>(), prototype);
+	instance->joints.push_back({ joint0, float4x4::identity() });
+	instance->joints.push_back({ joint1, affineToHomogeneous(translation(float3(0.f, 0.f, -2.f))) });
+	root->SetLeaf(instance);
+	graph->Refresh(0);
+
+	// The joint transforms are relative to the node of the instance
+	BufferGroup output;
+	CHECK(SkinVertices(*instance, output));
+	CHECK(output.positionData.size() == 2);
+	CHECK(all(output.positionData[0] == float3(1.f, 2.f, 0.f)));
+	CHECK(all(output.positionData[1] == float3(1.f, 1.f, 1.f)));
+
+	// The CPU streams are released when Scene uploads the buffers
+	prototype->buffers->positionData.clear();
+	CHECK(!SkinVertices(*instance, output));
+}
+
+void benchmark_skinning(tf::Executor* executor)
+{
+	std::mt19937 rng(5);
+	std::vector<float4x4> jointMatrices = make_joint_matrices(rng);
+	uint32_t const vertexCount = 200000;
+	BufferGroup input = make_vertices(rng, vertexCount);
+	BufferGroup output;
+
+	auto measure = [&](tf::Executor* executor)
+	{
+		double best = 0.0;
+		for (int run = 0; run < 10; run++)
+		{
+			auto startTime = std::chrono::high_resolution_clock::now();
+			SkinVertices(input, 0, vertexCount, jointMatrices.data(), jointMatrices.size(), output, executor);
+			auto endTime = std::chrono::high_resolution_clock::now();
+			double time = std::chrono::duration<double>(endTime - startTime).count();
+			best = (run == 0) ? time : std::min(best, time);
+		}
+		return best;
+	};
+
+	double const serialTime = measure(nullptr);
+	printf("Skinning %u vertices with normals and tangents: %.2f ms, %.1fM vertices/s/core",
+		vertexCount, serialTime * 1e3, double(vertexCount) / serialTime * 1e-6);
+
+#ifdef DONUT_WITH_TASKFLOW
+	if (executor)
+	{
+		double const parallelTime = measure(executor);
+		size_t const workers = executor->num_workers();
+		printf(", with %zu workers %.2f ms, %.1fM vertices/s/core", workers, parallelTime * 1e3,
+			double(vertexCount) / parallelTime / double(workers) * 1e-6);
+	}
+#endif
+	printf("\n");
+}
+
+int main(int, char**)
+{
+	try
+	{
+#ifdef DONUT_WITH_TASKFLOW
+		tf::Executor executor;
+		tf::Executor* executorPtr = &executor;
+#else
+		tf::Executor* executorPtr = nullptr;
+#endif
+
+		test_skinning_matches_shader();
+		test_skinning_prev_positions();
+		test_skinning_invalid_input();
+		test_skinning_parallel(executorPtr);
+		test_skinned_mesh_instance();
+
+		if (donut::test::benchmarksEnabled())
+		{
+			benchmark_skinning(executorPtr);
+		}
+	}
+	catch (const std::runtime_error& err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,495 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/KeyframeAnimation.h>
+#include <donut/tests/utils.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine::animation;
+
+// Creates a sampler with random keyframes. With interval == 0, the keyframe times are random and
+// some are repeated to test the search with discontinuities; otherwise the keyframes are uniform
+// and the values change smoothly, like captured motion.
+static std::shared_ptr<Sampler> make_sampler(std::mt19937& rng, InterpolationMode mode, size_t keyframeCount, float interval = 0.f)
+{
+	std::uniform_real_distribution<float> value(-10.f, 10.f);
+	std::uniform_real_distribution<float> step(0.01f, 0.05f);
+
+	auto sampler = std::make_shared<Sampler>();
+	sampler->SetInterpolationMode(mode);
+
+	float time = 0.f;
+	for (size_t i = 0; i < keyframeCount; i++)
+	{
+		Keyframe keyframe;
+		keyframe.time = interval > 0.f ? float(i) * interval : time;
+		keyframe.value = float4(value(rng), value(rng), value(rng), value(rng));
+		if (interval > 0.f && i > 0)
+			keyframe.value = sampler->GetKeyframes().back().value + keyframe.value * 0.002f;
+		if (mode == InterpolationMode::Slerp)
+			keyframe.value = normalize(keyframe.value);
+		keyframe.inTangent = float4(value(rng), value(rng), value(rng), value(rng));
+		keyframe.outTangent = float4(value(rng), value(rng), value(rng), value(rng));
+		sampler->AddKeyframe(keyframe);
+
+		if (i % 7 != 3)
+			time += step(rng);
+	}
+
+	return sampler;
+}
+
+static bool same(const std::optional<float4>& a, const std::optional<float4>& b)
+{
+	if (a.has_value() != b.has_value())
+		return false;
+	return !a.has_value() || all(a.value() == b.value());
+}
+
+void test_sampler_cursor()
+{
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> randomTime(-1.f, 30.f);
+
+	for (InterpolationMode mode : { InterpolationMode::Step, InterpolationMode::Linear, InterpolationMode::Slerp,
+		InterpolationMode::CatmullRomSpline, InterpolationMode::HermiteSpline })
+	{
+		for (size_t keyframeCount : { size_t(0), size_t(1), size_t(2), size_t(3), size_t(500) })
+		{
+			auto sampler = make_sampler(rng, mode, keyframeCount);
+			const float endTime = sampler->GetEndTime();
+
+			SamplerBatch batch;
+			batch.AddSampler(*sampler);
+			CHECK(batch.GetSamplerCount() == 1);
+
+			// sequential playback, past the end and looping back
+			SamplerCursor cursor;
+			for (float time = -0.1f; time < endTime * 2.f + 0.1f; time += 0.007f)
+			{
+				float t = time > endTime ? time - endTime : time;
+				for (bool extrapolate : { false, true })
+				{
+					std::optional<float4> expected = sampler->Evaluate(t, extrapolate);
+					CHECK(same(sampler->Evaluate(t, cursor, extrapolate), expected));
+
+					std::optional<float4> result;
+					batch.Evaluate(t, &result, extrapolate);
+					CHECK(same(result, expected));
+				}
+			}
+
+			// random access, including the keyframe times themselves
+			for (int i = 0; i < 1000; i++)
+			{
+				float t = (i % 2 == 0 || keyframeCount == 0)
+					? randomTime(rng)
+					: sampler->GetKeyframes()[rng() % keyframeCount].time;
+
+				std::optional<float4> expected = sampler->Evaluate(t, true);
+				CHECK(same(sampler->Evaluate(t, cursor, true), expected));
+
+				std::optional<float4> result;
+				batch.Evaluate(t, &result, true);
+				CHECK(same(result, expected));
+			}
+		}
+	}
+
+	// exact keyframe values at keyframe times, the first of the repeated keyframes is skipped
+	auto sampler = make_sampler(rng, InterpolationMode::Linear, 20);
+	const auto& keyframes = sampler->GetKeyframes();
+	SamplerCursor cursor;
+	for (size_t i = 1; i + 1 < keyframes.size(); i++)
+	{
+		if (keyframes[i].time == keyframes[i + 1].time)
+			continue;
+		std::optional<float4> value = sampler->Evaluate(keyframes[i].time, cursor);
+		CHECK(value.has_value() && all(value.value() == keyframes[i].value));
+	}
+
+	// a cursor past the end of a shorter sampler is ignored
+	SamplerCursor farCursor;
+	farCursor.interval = 1000;
+	CHECK(same(sampler->Evaluate(0.1f, farCursor), sampler->Evaluate(0.1f)));
+	CHECK(farCursor.interval < keyframes.size());
+
+	// ranges of a batch
+	SamplerBatch batch;
+	std::vector<std::shared_ptr<Sampler>> samplers;
+	for (int i = 0; i < 10; i++)
+	{
+		samplers.push_back(make_sampler(rng, InterpolationMode(i % 5), 10 + i));
+		CHECK(batch.AddSampler(*samplers.back()) == size_t(i));
+	}
+	std::optional<float4> results[4];
+	batch.Evaluate(0.13f, 3, 4, results, true);
+	for (int i = 0; i < 4; i++)
+		CHECK(same(results[i], samplers[3 + i]->Evaluate(0.13f, true)));
+}
+
+void benchmark_sampler_cursor()
+{
+	// a crowd: many channels with 20 seconds of motion at 30 keyframes per second, played at 60 fps
+	const size_t channelCount = 4096;
+	const size_t keyframeCount = 600;
+	const int frameCount = 1200;
+
+	std::mt19937 rng(5);
+	std::vector<std::shared_ptr<Sampler>> samplers;
+	SamplerBatch batch;
+	for (size_t i = 0; i < channelCount; i++)
+	{
+		InterpolationMode mode = (i % 3 == 1) ? InterpolationMode::Slerp : InterpolationMode::Linear;
+		samplers.push_back(make_sampler(rng, mode, keyframeCount, 1.f / 30.f));
+		batch.AddSampler(*samplers.back());
+	}
+
+	std::vector<std::optional<float4>> results(channelCount);
+	std::vector<SamplerCursor> cursors(channelCount);
+	float sink = 0.f;
+
+	auto measure = [&](auto const& evaluate) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			float time = float(frame) / 60.f;
+			evaluate(time);
+			sink += results[frame % channelCount].value_or(float4(0.f)).x;
+		}
+		auto endTime = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::nano>(endTime - startTime).count() / double(frameCount * channelCount);
+	};
+
+	double searchTime = measure([&](float time) {
+		for (size_t i = 0; i < channelCount; i++)
+			results[i] = samplers[i]->Evaluate(time, true);
+	});
+
+	double cursorTime = measure([&](float time) {
+		for (size_t i = 0; i < channelCount; i++)
+			results[i] = samplers[i]->Evaluate(time, cursors[i], true);
+	});
+
+	double batchTime = measure([&](float time) {
+		batch.Evaluate(time, results.data(), true);
+	});
+
+	printf("Sampling %zu channels with %zu keyframes: binary search %.1f ns, cursor %.1f ns (%.1fx), batch %.1f ns (%.1fx) per channel\n",
+		channelCount, keyframeCount, searchTime, cursorTime, searchTime / cursorTime, batchTime, searchTime / batchTime);
+
+	CHECK(std::isfinite(sink));
+}
+
+// Creates a sampler that looks like a motion capture channel: 30 keyframes per second of a smooth
+// motion with a little noise. Rotations are normalized quaternions, translations have 3 components.
+static std::shared_ptr<Sampler> make_capture_sampler(std::mt19937& rng, InterpolationMode mode, size_t keyframeCount)
+{
+	std::uniform_real_distribution<float> phase(0.f, 6.28f);
+	std::uniform_real_distribution<float> frequency(0.1f, 1.5f);
+	std::uniform_real_distribution<float> noise(-1e-5f, 1e-5f);
+
+	float4 phases = float4(phase(rng), phase(rng), phase(rng), phase(rng));
+	float4 frequencies = float4(frequency(rng), frequency(rng), frequency(rng), frequency(rng));
+
+	auto sampler = std::make_shared<Sampler>();
+	sampler->SetInterpolationMode(mode);
+
+	for (size_t i = 0; i < keyframeCount; i++)
+	{
+		Keyframe keyframe;
+		keyframe.time = float(i) / 30.f;
+		for (int c = 0; c < 4; c++)
+			keyframe.value[c] = std::sin(phases[c] + frequencies[c] * keyframe.time) + noise(rng);
+
+		if (mode == InterpolationMode::Slerp)
+			keyframe.value = normalize(keyframe.value);
+		else
+			keyframe.value.w = 0.f;
+
+		sampler->AddKeyframe(keyframe);
+	}
+
+	return sampler;
+}
+
+static float sampler_error(InterpolationMode mode, const std::optional<float4>& a, const std::optional<float4>& b)
+{
+	if (!a.has_value() || !b.has_value())
+		return (a.has_value() == b.has_value()) ? 0.f : INFINITY;
+
+	if (mode == InterpolationMode::Slerp)
+	{
+		double4 qa = normalize(double4(a.value()));
+		double4 qb = normalize(double4(b.value()));
+		if (dot(qa, qb) < 0.0)
+			qb = -qb;
+		return float(4.0 * std::asin(std::min(1.0, length(qa - qb) * 0.5)));
+	}
+
+	float4 difference = abs(a.value() - b.value());
+	return std::max(std::max(difference.x, difference.y), std::max(difference.z, difference.w));
+}
+
+// Compresses a copy of the sampler and checks that the result is within the tolerance of the original.
+static void check_compression(const Sampler& original, float tolerance, Sampler& compressed)
+{
+	compressed = original;
+	CHECK(compressed.Compress(tolerance));
+	CHECK(compressed.IsCompressed());
+	CHECK(compressed.GetKeyframes().empty());
+	CHECK(compressed.GetKeyframeCount() <= original.GetKeyframeCount());
+	CHECK(std::abs(compressed.GetStartTime() - original.GetStartTime()) < 1e-6f);
+	CHECK(std::abs(compressed.GetEndTime() - original.GetEndTime()) <= (original.GetEndTime() - original.GetStartTime()) / 65535.f);
+
+	const InterpolationMode mode = original.GetMode();
+	const auto& keyframes = original.GetKeyframes();
+	SamplerCursor cursor;
+	for (size_t i = 0; i < keyframes.size(); i++)
+	{
+		// at the original keyframe times, which the compressed times are never later than
+		const float time = keyframes[i].time;
+		CHECK(sampler_error(mode, compressed.Evaluate(time, cursor, true), original.Evaluate(time, true)) <= tolerance * 1.01f + 1e-6f);
+
+		// between the keyframes, where the linear segments of both samplers don't have breakpoints
+		if (i + 1 < keyframes.size() && mode != InterpolationMode::Step)
+		{
+			const float middle = (keyframes[i].time + keyframes[i + 1].time) * 0.5f;
+			CHECK(sampler_error(mode, compressed.Evaluate(middle, cursor, true), original.Evaluate(middle, true)) <= tolerance * 1.01f + 1e-6f);
+		}
+	}
+
+	// sequential and random access evaluation, extrapolation, and decoding into a batch
+	SamplerBatch batch;
+	batch.AddSampler(compressed);
+	SamplerCursor sequentialCursor;
+	for (float time = -0.1f; time < original.GetEndTime() + 0.1f; time += 0.011f)
+	{
+		for (bool extrapolate : { false, true })
+		{
+			std::optional<float4> expected = compressed.Evaluate(time, extrapolate);
+			CHECK(same(compressed.Evaluate(time, sequentialCursor, extrapolate), expected));
+
+			std::optional<float4> result;
+			batch.Evaluate(time, &result, extrapolate);
+			CHECK(same(result, expected));
+		}
+	}
+	CHECK(!compressed.Evaluate(original.GetEndTime() + 1.f, false).has_value());
+}
+
+void test_sampler_compression()
+{
+	std::mt19937 rng(7);
+
+	Sampler compressed;
+	for (InterpolationMode mode : { InterpolationMode::Step, InterpolationMode::Linear, InterpolationMode::Slerp })
+	{
+		for (float tolerance : { 1e-2f, 1e-3f, 1e-4f })
+		{
+			for (size_t keyframeCount : { size_t(1), size_t(2), size_t(3), size_t(300) })
+			{
+				auto sampler = make_capture_sampler(rng, mode, keyframeCount);
+				check_compression(*sampler, tolerance, compressed);
+			}
+
+			// noisy random keyframes without repeated times
+			auto sampler = make_sampler(rng, mode, 300, 0.03f);
+			check_compression(*sampler, tolerance, compressed);
+		}
+	}
+
+	// captured keyframes are on the frame grid and keep their times, jittered ones are quantized
+	// and evaluated at their original times
+	std::uniform_real_distribution<float> jitter(0.3e-3f, 0.9e-3f);
+	for (InterpolationMode mode : { InterpolationMode::Step, InterpolationMode::Linear, InterpolationMode::Slerp })
+	{
+		auto uniform = make_capture_sampler(rng, mode, 300);
+		check_compression(*uniform, 1e-3f, compressed);
+		CHECK(std::abs(compressed.GetCompressedKeyframes()->timeStep - 1.f / 30.f) < 1e-6f);
+
+		Sampler jittered = *uniform;
+		for (size_t i = 1; i + 1 < jittered.GetKeyframes().size(); i++)
+			jittered.GetKeyframes()[i].time += ((i & 1) ? jitter(rng) : -jitter(rng)) / 30.f;
+
+		const float duration = jittered.GetEndTime() - jittered.GetStartTime();
+		check_compression(jittered, 1e-3f, compressed);
+		CHECK(compressed.GetCompressedKeyframes()->timeStep == duration / 65535.f);
+	}
+
+	// tight tolerances fall back to storing floats and still compress the constant components
+	auto translation = make_capture_sampler(rng, InterpolationMode::Linear, 100);
+	check_compression(*translation, 1e-7f, compressed);
+	CHECK(compressed.GetCompressedKeyframes()->encoding == CompressedKeyframes::Encoding::Float);
+	CHECK(compressed.GetCompressedKeyframes()->componentCount == 3);
+
+	// constant tracks only keep the time range
+	Sampler constant;
+	constant.SetInterpolationMode(InterpolationMode::Linear);
+	for (int i = 0; i < 100; i++)
+		constant.AddKeyframe(Keyframe{ float(i) * 0.1f, float4(1.f, 2.f, 3.f, 0.f) });
+	check_compression(constant, 1e-4f, compressed);
+	CHECK(compressed.GetKeyframeCount() == 2);
+	CHECK(compressed.GetMemoryUsage() < constant.GetMemoryUsage() / 20);
+	CHECK(all(compressed.Evaluate(5.f).value() == float4(1.f, 2.f, 3.f, 0.f)));
+
+	// a linear motion only keeps the end points
+	Sampler line;
+	line.SetInterpolationMode(InterpolationMode::Linear);
+	for (int i = 0; i <= 100; i++)
+		line.AddKeyframe(Keyframe{ float(i) * 0.1f, float4(float(i), -2.f * float(i), 0.f, 0.f) });
+	check_compression(line, 1e-2f, compressed);
+	CHECK(compressed.GetKeyframeCount() == 2);
+
+	// unsupported samplers are not changed
+	auto spline = make_sampler(rng, InterpolationMode::CatmullRomSpline, 10);
+	CHECK(!spline->Compress(1e-3f));
+	CHECK(!spline->IsCompressed());
+
+	Sampler discontinuous;
+	discontinuous.SetInterpolationMode(InterpolationMode::Linear);
+	discontinuous.AddKeyframe(Keyframe{ 0.f, float4(0.f) });
+	discontinuous.AddKeyframe(Keyframe{ 1.f, float4(0.f) });
+	discontinuous.AddKeyframe(Keyframe{ 1.f, float4(1.f) });
+	discontinuous.AddKeyframe(Keyframe{ 2.f, float4(1.f) });
+	CHECK(!discontinuous.Compress(1e-3f));
+	CHECK(discontinuous.GetKeyframes().size() == 4);
+
+	// adding a keyframe decompresses the sampler
+	check_compression(*translation, 1e-3f, compressed);
+	size_t const compressedCount = compressed.GetKeyframeCount();
+	std::optional<float4> before = compressed.Evaluate(1.f);
+	compressed.AddKeyframe(Keyframe{ 100.f, float4(0.f) });
+	CHECK(!compressed.IsCompressed());
+	CHECK(compressed.GetKeyframes().size() == compressedCount + 1);
+	CHECK(same(compressed.Evaluate(1.f), before));
+}
+
+// Compresses a motion capture library: skeletons with rotations on all joints, a translated root and constant scaling.
+// The benchmark compresses more skeletons, compares the playback cost with the original samplers and prints the results.
+void test_sampler_compression_ratio()
+{
+	const bool benchmark = donut::test::benchmarksEnabled();
+	const size_t skeletonCount = benchmark ? 16 : 1;
+	const size_t jointCount = 60;
+	const size_t keyframeCount = 900;
+	const float translationTolerance = 1e-4f;
+	const float rotationTolerance = 1e-4f;
+
+	std::mt19937 rng(9);
+	size_t uncompressedSize = 0;
+	size_t compressedSize = 0;
+	size_t uncompressedKeyframes = 0;
+	size_t compressedKeyframes = 0;
+	std::vector<std::shared_ptr<Sampler>> originals;
+	std::vector<std::shared_ptr<Sampler>> samplers;
+
+	auto add = [&](std::shared_ptr<Sampler> sampler, float tolerance)
+	{
+		uncompressedSize += sampler->GetKeyframeCount() * sizeof(Keyframe);
+		uncompressedKeyframes += sampler->GetKeyframeCount();
+		originals.push_back(std::make_shared<Sampler>(*sampler));
+		CHECK(sampler->Compress(tolerance));
+		compressedSize += sampler->GetMemoryUsage();
+		compressedKeyframes += sampler->GetKeyframeCount();
+		samplers.push_back(sampler);
+	};
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (size_t skeleton = 0; skeleton < skeletonCount; skeleton++)
+	{
+		add(make_capture_sampler(rng, InterpolationMode::Linear, keyframeCount), translationTolerance);
+		for (size_t joint = 0; joint < jointCount; joint++)
+		{
+			add(make_capture_sampler(rng, InterpolationMode::Slerp, keyframeCount), rotationTolerance);
+
+			auto scaling = std::make_shared<Sampler>();
+			scaling->SetInterpolationMode(InterpolationMode::Linear);
+			for (size_t i = 0; i < keyframeCount; i++)
+				scaling->AddKeyframe(Keyframe{ float(i) / 30.f, float4(1.f, 1.f, 1.f, 0.f) });
+			add(scaling, translationTolerance);
+		}
+	}
+	auto endTime = std::chrono::high_resolution_clock::now();
+	double const compressionTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+
+	double const ratio = double(uncompressedSize) / double(compressedSize);
+	CHECK(ratio >= 5.0);
+
+	if (!benchmark)
+		return;
+
+	// playback cost of the compressed samplers
+	std::vector<SamplerCursor> cursors(samplers.size());
+	float sink = 0.f;
+	auto measure = [&](const std::vector<std::shared_ptr<Sampler>>& list)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		const int frameCount = 600;
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			for (size_t i = 0; i < list.size(); i++)
+				sink += list[i]->Evaluate(float(frame) / 60.f, cursors[i], true).value_or(float4(0.f)).x;
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::nano>(end - start).count() / double(frameCount * list.size());
+	};
+	double const originalTime = measure(originals);
+	std::fill(cursors.begin(), cursors.end(), SamplerCursor());
+	double const compressedTime = measure(samplers);
+
+	printf("Compressed %zu channels in %.0f ms: %zu to %zu keyframes, %zu to %zu KB (%.1fx), evaluation %.1f ns vs %.1f ns per channel\n",
+		samplers.size(), compressionTime, uncompressedKeyframes, compressedKeyframes,
+		uncompressedSize / 1024, compressedSize / 1024, ratio, compressedTime, originalTime);
+
+	CHECK(std::isfinite(sink));
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_sampler_cursor();
+		test_sampler_compression();
+		test_sampler_compression_ratio();
+
+		if (donut::test::benchmarksEnabled())
+		{
+			benchmark_sampler_cursor();
+		}
+	}
+	catch (const std::runtime_error & err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,251 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/KTX2File.h>
+#include <donut/engine/TextureCache.h>
+#include <donut/core/vfs/VFS.h>
+#include <donut/tests/utils.h>
+
+#ifdef DONUT_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace donut;
+using namespace donut::engine;
+
+static const uint8_t c_KTX2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const size_t c_HeaderSize = 80;
+static const size_t c_LevelIndexSize = 24;
+static const uint32_t c_VkFormatR8G8B8A8Unorm = 37;
+static const uint32_t c_SupercompressionZstd = 2;
+
+struct KTX2Level
+{
+	std::vector<uint8_t> data;
+	uint64_t uncompressedSize = 0;
+};
+
+static void write32(std::vector<uint8_t>& file, size_t offset, uint32_t value)
+{
+	memcpy(file.data() + offset, &value, sizeof(value));
+}
+
+static void write64(std::vector<uint8_t>& file, size_t offset, uint64_t value)
+{
+	memcpy(file.data() + offset, &value, sizeof(value));
+}
+
+// Builds a KTX2 file without a data format descriptor, with the levels stored in the order of the level index
+static std::vector<uint8_t> make_ktx2(uint32_t width, uint32_t height, uint32_t supercompression, const std::vector<KTX2Level>& levels)
+{
+	std::vector<uint8_t> file(c_HeaderSize + c_LevelIndexSize * levels.size());
+	memcpy(file.data(), c_KTX2Identifier, sizeof(c_KTX2Identifier));
+	write32(file, 12, c_VkFormatR8G8B8A8Unorm);
+	write32(file, 16, 1); // typeSize
+	write32(file, 20, width);
+	write32(file, 24, height);
+	write32(file, 32, 0); // layerCount
+	write32(file, 36, 1); // faceCount
+	write32(file, 40, uint32_t(levels.size()));
+	write32(file, 44, supercompression);
+
+	for (size_t level = 0; level < levels.size(); level++)
+	{
+		const size_t indexOffset = c_HeaderSize + c_LevelIndexSize * level;
+		write64(file, indexOffset + 0, file.size());
+		write64(file, indexOffset + 8, levels[level].data.size());
+		write64(file, indexOffset + 16, levels[level].uncompressedSize);
+		file.insert(file.end(), levels[level].data.begin(), levels[level].data.end());
+	}
+
+	return file;
+}
+
+static std::shared_ptr<vfs::IBlob> make_blob(const std::vector<uint8_t>& data)
+{
+	void* copy = malloc(data.size());
+	memcpy(copy, data.data(), data.size());
+	return std::make_shared<vfs::Blob>(copy, data.size());
+}
+
+static std::vector<uint8_t> make_pixels(uint32_t width, uint32_t height, uint8_t seed)
+{
+	std::vector<uint8_t> pixels(size_t(width) * height * 4);
+	for (size_t i = 0; i < pixels.size(); i++)
+		pixels[i] = uint8_t(i * 3 + seed);
+	return pixels;
+}
+
+static bool check_level(const TextureData& texture, uint32_t mipLevel, const std::vector<uint8_t>& pixels, uint32_t width)
+{
+	const TextureSubresourceData& layout = texture.dataLayout[0][mipLevel];
+	const uint8_t* data = static_cast<const uint8_t*>(texture.data->data());
+
+	return layout.rowPitch == width * 4
+		&& layout.dataSize == pixels.size()
+		&& size_t(layout.dataOffset) + layout.dataSize <= texture.data->size()
+		&& memcmp(data + layout.dataOffset, pixels.data(), pixels.size()) == 0;
+}
+
+void test_ktx2_uncompressed()
+{
+	std::vector<uint8_t> mip0 = make_pixels(8, 4, 1);
+	std::vector<uint8_t> mip1 = make_pixels(4, 2, 2);
+	std::vector<uint8_t> file = make_ktx2(8, 4, 0, { { mip0, mip0.size() }, { mip1, mip1.size() } });
+
+	TextureData texture;
+	texture.data = make_blob(file);
+	const void* fileData = texture.data->data();
+
+	CHECK(LoadKTX2TextureFromMemory(texture));
+	CHECK(texture.format == nvrhi::Format::RGBA8_UNORM);
+	CHECK(texture.dimension == nvrhi::TextureDimension::Texture2D);
+	CHECK(texture.width == 8);
+	CHECK(texture.height == 4);
+	CHECK(texture.mipLevels == 2);
+	CHECK(texture.arraySize == 1);
+
+	// Uncompressed levels are used in place
+	CHECK(texture.data->data() == fileData);
+	CHECK(check_level(texture, 0, mip0, 8));
+	CHECK(check_level(texture, 1, mip1, 4));
+}
+
+void test_ktx2_zstd()
+{
+#ifdef DONUT_WITH_ZSTD
+	std::vector<uint8_t> mip0 = make_pixels(16, 16, 3);
+	std::vector<uint8_t> mip1 = make_pixels(8, 8, 4);
+
+	auto compress = [](const std::vector<uint8_t>& data)
+	{
+		KTX2Level level;
+		level.data.resize(ZSTD_compressBound(data.size()));
+		size_t size = ZSTD_compress(level.data.data(), level.data.size(), data.data(), data.size(), 3);
+		CHECK(!ZSTD_isError(size));
+		level.data.resize(size);
+		level.uncompressedSize = data.size();
+		return level;
+	};
+
+	std::vector<uint8_t> file = make_ktx2(16, 16, c_SupercompressionZstd, { compress(mip0), compress(mip1) });
+
+	TextureData texture;
+	texture.data = make_blob(file);
+
+	CHECK(LoadKTX2TextureFromMemory(texture));
+	CHECK(texture.format == nvrhi::Format::RGBA8_UNORM);
+	CHECK(texture.mipLevels == 2);
+	CHECK(texture.data->size() == mip0.size() + mip1.size());
+	CHECK(check_level(texture, 0, mip0, 16));
+	CHECK(check_level(texture, 1, mip1, 8));
+
+	// A level that doesn't decompress to its declared size is rejected
+	KTX2Level truncated = compress(mip1);
+	truncated.uncompressedSize += 1;
+	texture = TextureData();
+	texture.data = make_blob(make_ktx2(16, 16, c_SupercompressionZstd, { compress(mip0), truncated }));
+	CHECK(!LoadKTX2TextureFromMemory(texture));
+#endif
+}
+
+void test_ktx2_malformed()
+{
+	std::vector<uint8_t> mip0 = make_pixels(4, 4, 5);
+	const std::vector<uint8_t> file = make_ktx2(4, 4, 0, { { mip0, mip0.size() } });
+	const size_t levelIndexOffset = c_HeaderSize;
+
+	auto load = [](const std::vector<uint8_t>& data)
+	{
+		TextureData texture;
+		texture.data = make_blob(data);
+		return LoadKTX2TextureFromMemory(texture);
+	};
+
+	CHECK(load(file));
+
+	// Truncated header and level index
+	CHECK(!load(std::vector<uint8_t>(file.begin(), file.begin() + 40)));
+	CHECK(!load(std::vector<uint8_t>(file.begin(), file.begin() + c_HeaderSize + 8)));
+
+	// Wrong identifier
+	std::vector<uint8_t> broken = file;
+	broken[1] = 'X';
+	CHECK(!load(broken));
+
+	// Level data past the end of the file
+	broken = file;
+	write64(broken, levelIndexOffset + 8, mip0.size() + 1);
+	CHECK(!load(broken));
+
+	// Level offset and length that overflow when added together
+	broken = file;
+	write64(broken, levelIndexOffset + 0, 16);
+	write64(broken, levelIndexOffset + 8, UINT64_MAX - 8);
+	CHECK(!load(broken));
+
+	broken = file;
+	write64(broken, levelIndexOffset + 0, UINT64_MAX - 8);
+	write64(broken, levelIndexOffset + 8, 16);
+	CHECK(!load(broken));
+
+	// Level count that doesn't fit into the file
+	broken = file;
+	write32(broken, 40, 0x10000000);
+	CHECK(!load(broken));
+
+	// Level that is smaller than the image it should contain
+	broken = file;
+	write32(broken, 20, 8);
+	CHECK(!load(broken));
+
+	// Dimensions and layer counts beyond the texture limits, whose sizes overflow
+	broken = file;
+	write32(broken, 20, UINT32_MAX);
+	CHECK(!load(broken));
+
+	broken = file;
+	write32(broken, 32, 0x80000000);
+	write32(broken, 36, 6);
+	CHECK(!load(broken));
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_ktx2_uncompressed();
+		test_ktx2_zstd();
+		test_ktx2_malformed();
+	}
+	catch (const std::runtime_error& err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,287 @@
+/*
+* Copyright (c) 2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/SceneGraph.h>
+#include <donut/tests/utils.h>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::engine::animation;
+
+static const size_t c_AnimationCount = 4;
+static const size_t c_NodesPerAnimation = 1024;
+static const size_t c_ChainLength = 4;
+static const size_t c_KeyframeCount = 60;
+
+// Creates a sampler with smoothly changing values at 30 keyframes per second.
+static std::shared_ptr<Sampler> make_sampler(std::mt19937& rng, AnimationAttribute attribute)
+{
+	std::uniform_real_distribution<float> value(-1.f, 1.f);
+
+	auto sampler = std::make_shared<Sampler>();
+	sampler->SetInterpolationMode(attribute == AnimationAttribute::Rotation ? InterpolationMode::Slerp : InterpolationMode::Linear);
+
+	float4 current = float4(value(rng), value(rng), value(rng), value(rng));
+	for (size_t i = 0; i < c_KeyframeCount; i++)
+	{
+		Keyframe keyframe;
+		keyframe.time = float(i) / 30.f;
+		keyframe.value = attribute == AnimationAttribute::Rotation ? normalize(current) : current;
+		sampler->AddKeyframe(keyframe);
+
+		current += float4(value(rng), value(rng), value(rng), value(rng)) * 0.05f;
+	}
+
+	return sampler;
+}
+
+// Builds a graph with chains of nodes under the root, and animations that target every node
+// with translation, rotation and scaling channels.
+static void make_scene(std::mt19937& rng, std::shared_ptr<SceneGraph>& graph, std::vector<std::shared_ptr<SceneGraphNode>>& nodes,
+	std::vector<std::shared_ptr<SceneGraphAnimation>>& animations)
+{
+	graph = std::make_shared<SceneGraph>();
+	auto root = std::make_shared<SceneGraphNode>();
+	graph->SetRootNode(root);
+
+	std::shared_ptr<SceneGraphNode> parent = root;
+	for (size_t i = 0; i < c_AnimationCount * c_NodesPerAnimation; i++)
+	{
+		if (i % c_ChainLength == 0)
+			parent = root;
+		parent = graph->Attach(parent, std::make_shared<SceneGraphNode>());
+		nodes.push_back(parent);
+	}
+
+	for (size_t a = 0; a < c_AnimationCount; a++)
+	{
+		auto animation = std::make_shared<SceneGraphAnimation>();
+		for (size_t n = 0; n < c_NodesPerAnimation; n++)
+		{
+			const auto& node = nodes[a * c_NodesPerAnimation + n];
+			for (AnimationAttribute attribute : { AnimationAttribute::Translation, AnimationAttribute::Rotation, AnimationAttribute::Scaling })
+				animation->AddChannel(std::make_shared<SceneGraphAnimationChannel>(make_sampler(rng, attribute), node, attribute));
+		}
+		animations.push_back(animation);
+	}
+
+	graph->Refresh(0);
+}
+
+struct NodeTransform
+{
+	double3 translation;
+	dquat rotation;
+	double3 scaling;
+};
+
+static std::vector<NodeTransform> get_transforms(const std::vector<std::shared_ptr<SceneGraphNode>>& nodes)
+{
+	std::vector<NodeTransform> transforms;
+	for (const auto& node : nodes)
+		transforms.push_back({ node->GetTranslation(), node->GetRotation(), node->GetScaling() });
+	return transforms;
+}
+
+static bool transforms_match(const std::vector<NodeTransform>& a, const std::vector<NodeTransform>& b)
+{
+	if (a.size() != b.size())
+		return false;
+
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (any(a[i].translation != b[i].translation) || any(a[i].scaling != b[i].scaling) ||
+			a[i].rotation.x != b[i].rotation.x || a[i].rotation.y != b[i].rotation.y ||
+			a[i].rotation.z != b[i].rotation.z || a[i].rotation.w != b[i].rotation.w)
+			return false;
+	}
+	return true;
+}
+
+void test_animator_matches_channels(tf::Executor* executor)
+{
+	std::mt19937 rng(11);
+	std::shared_ptr<SceneGraph> graph;
+	std::vector<std::shared_ptr<SceneGraphNode>> nodes;
+	std::vector<std::shared_ptr<SceneGraphAnimation>> animations;
+	make_scene(rng, graph, nodes, animations);
+
+	SceneGraphAnimator animator;
+	for (const auto& animation : animations)
+		animator.AddAnimation(animation);
+	CHECK(animator.GetAnimationCount() == c_AnimationCount);
+	CHECK(animator.GetTransformChannelCount() == c_AnimationCount * c_NodesPerAnimation * 3);
+
+	uint32_t frameIndex = 1;
+	for (float time : { 0.f, 0.51f, 0.52f, 1.2f, 0.3f, 5.f })
+	{
+		for (const auto& animation : animations)
+			animation->Apply(time);
+		auto expected = get_transforms(nodes);
+		graph->Refresh(frameIndex++);
+		graph->Refresh(frameIndex++);
+		CHECK(!graph->HasPendingTransformChanges());
+
+		CHECK(animator.Apply(time, executor));
+		CHECK(transforms_match(get_transforms(nodes), expected));
+		CHECK(graph->HasPendingTransformChanges());
+		for (const auto& node : nodes)
+		{
+			CHECK((node->GetDirtyFlags() & SceneGraphNode::DirtyFlags::LocalTransform) != 0);
+			CHECK((node->GetDirtyFlags() & SceneGraphNode::DirtyFlags::SubgraphTransforms) != 0);
+		}
+
+		graph->Refresh(frameIndex++);
+		CHECK(all(nodes.back()->GetLocalToParentTransform().m_translation == nodes.back()->GetTranslation()));
+	}
+
+	// Every animation at its own time
+	float times[c_AnimationCount] = { 0.1f, 0.7f, 1.9f, 0.25f };
+	for (size_t a = 0; a < c_AnimationCount; a++)
+		animations[a]->Apply(times[a]);
+	auto expected = get_transforms(nodes);
+	graph->Refresh(frameIndex++);
+	CHECK(animator.Apply(times, executor));
+	CHECK(transforms_match(get_transforms(nodes), expected));
+}
+
+void test_animator_expired_target()
+{
+	std::mt19937 rng(5);
+	auto graph = std::make_shared<SceneGraph>();
+	auto root = std::make_shared<SceneGraphNode>();
+	graph->SetRootNode(root);
+	auto kept = graph->Attach(root, std::make_shared<SceneGraphNode>());
+	auto removed = graph->Attach(root, std::make_shared<SceneGraphNode>());
+
+	auto animation = std::make_shared<SceneGraphAnimation>();
+	animation->AddChannel(std::make_shared<SceneGraphAnimationChannel>(make_sampler(rng, AnimationAttribute::Translation), kept, AnimationAttribute::Translation));
+	animation->AddChannel(std::make_shared<SceneGraphAnimationChannel>(make_sampler(rng, AnimationAttribute::Translation), removed, AnimationAttribute::Translation));
+
+	SceneGraphAnimator animator;
+	animator.AddAnimation(animation);
+	CHECK(animator.Apply(0.5f));
+
+	graph->Detach(removed);
+	removed.reset();
+	graph->Refresh(0);
+
+	double3 const before = kept->GetTranslation();
+	CHECK(!animator.Apply(1.f));
+	CHECK(any(kept->GetTranslation() != before));
+}
+
+void benchmark_animator(tf::Executor* executor)
+{
+	std::mt19937 rng(3);
+	std::shared_ptr<SceneGraph> graph;
+	std::vector<std::shared_ptr<SceneGraphNode>> nodes;
+	std::vector<std::shared_ptr<SceneGraphAnimation>> animations;
+	make_scene(rng, graph, nodes, animations);
+
+	SceneGraphAnimator animator;
+	for (const auto& animation : animations)
+		animator.AddAnimation(animation);
+
+	size_t const channelCount = animator.GetTransformChannelCount();
+	size_t const frameCount = 60;
+
+	// Refresh the graph between frames so that the dirty flags are reset like in a real application,
+	// but only measure the time spent in applying the animations.
+	auto measure = [&](auto&& apply)
+	{
+		double best = 0.0;
+		for (int run = 0; run < 5; run++)
+		{
+			double total = 0.0;
+			for (size_t frame = 0; frame < frameCount; frame++)
+			{
+				auto startTime = std::chrono::high_resolution_clock::now();
+				apply(float(frame) / 60.f);
+				auto endTime = std::chrono::high_resolution_clock::now();
+				total += std::chrono::duration<double, std::micro>(endTime - startTime).count();
+				graph->Refresh(uint32_t(frame));
+			}
+			double time = total / double(frameCount);
+			best = (run == 0) ? time : std::min(best, time);
+		}
+		return best;
+	};
+
+	double const channelsTime = measure([&](float time)
+		{
+			for (const auto& animation : animations)
+				animation->Apply(time);
+		});
+	double const animatorTime = measure([&](float time) { animator.Apply(time); });
+
+	printf("Applying %zu channels: channels %.0f us, animator %.0f us (%.1fx)",
+		channelCount, channelsTime, animatorTime, channelsTime / animatorTime);
+
+#ifdef DONUT_WITH_TASKFLOW
+	if (executor)
+	{
+		double const parallelTime = measure([&](float time) { animator.Apply(time, executor); });
+		printf(", animator with %zu workers %.0f us (%.1fx)", executor->num_workers(), parallelTime, channelsTime / parallelTime);
+	}
+#endif
+	printf("\n");
+}
+
+int main(int, char**)
+{
+	try
+	{
+#ifdef DONUT_WITH_TASKFLOW
+		tf::Executor executor;
+		tf::Executor* executorPtr = &executor;
+#else
+		tf::Executor* executorPtr = nullptr;
+#endif
+
+		test_animator_matches_channels(nullptr);
+		test_animator_matches_channels(executorPtr);
+		test_animator_expired_target();
+
+		if (donut::test::benchmarksEnabled())
+		{
+			benchmark_animator(executorPtr);
+		}
+	}
+	catch (const std::runtime_error& err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
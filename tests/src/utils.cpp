@@ -21,3 +21,12 @@
 */
 
 #include <donut/tests/utils.h>
+
+#include <cstdlib>
+#include <cstring>
+
+bool donut::test::benchmarksEnabled()
+{
+	const char* value = getenv("DONUT_TEST_BENCHMARKS");
+	return value && *value && strcmp(value, "0") != 0;
+}
@@ -0,0 +1,37 @@
+#
+# Copyright (c) 2014-2020, NVIDIA CORPORATION. All rights reserved.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+# DEALINGS IN THE SOFTWARE.
+
+
+
+add_library(basisu_transcoder STATIC EXCLUDE_FROM_ALL
+    basis_universal/transcoder/basisu_transcoder.cpp
+    basis_universal/transcoder/basisu_transcoder.h
+)
+target_include_directories(basisu_transcoder INTERFACE basis_universal/transcoder)
+target_compile_definitions(basisu_transcoder PUBLIC BASISD_SUPPORT_KTX2=1 BASISD_SUPPORT_KTX2_ZSTD=1)
+
+# UASTC textures in KTX2 containers may be supercompressed with Zstandard.
+# Use the shared zstd library if it's available, or the decoder bundled with Basis Universal otherwise.
+if (TARGET zstd)
+    target_link_libraries(basisu_transcoder zstd)
+else()
+    target_sources(basisu_transcoder PRIVATE basis_universal/zstd/zstddeclib.c)
+endif()